@@ -15,12 +15,27 @@
 #include "interrupt.h"
 #include "spi.h"
 #include "mems_LIS3DSH.h"
+#include "ring_buffer.h"
+#include "scheduler.h"
+#include "boot.h"
+#include "memory.h"
 
 /*----------------------------------------------------------------------------
 	MAIN function
  *----------------------------------------------------------------------------*/
 
 int _rcvd = 0x00000000;	
+int16_t _sample[3];
+
+#define EVENT_SAMPLES			0x1
+#define SAMPLES_PER_BLINK	50
+
+static int16_t samples[64][3] MEM_CCM;											// CPU only, filled by the INT1 handler
+static BOOT_Handler vectors[BOOT_VECTOR_NUMBER] __attribute__((aligned(BOOT_VECTOR_ALIGN)));
+static RING_Buffer samples_ring;
+
+static SCHED_Task sensor_task, led_task;
+static SCHED_Event samples_ready = { &sensor_task, EVENT_SAMPLES };
  
 void initGreenLed(void)
 {
@@ -28,26 +43,50 @@ void initGreenLed(void)
 	LED_CLK_ENABLE();	
 	
 	/* LED Green Init and ON */
-	LED_initLed(LED_GREEN);
-	LED_initLed(LED_BLUE);
-	LED_initLed(LED_RED);
-	LED_initLed(LED_ORANGE);
+	LED_initAllLeds();
 	LED_switchON(LED_GREEN);		
 }
 
+/* Samples pushed by the INT1 callback, which posts EVENT_SAMPLES */
+static void on_samples(uint32_t events, void * context)
+{
+	static uint32_t count;
+	
+	(void) events;
+	(void) context;
+	while (RING_pop(&samples_ring, _sample))
+	{
+		_rcvd = _sample[0];
+		if (++count % SAMPLES_PER_BLINK == 0)
+			SCHED_post(&led_task, 0x1);
+	}
+}
+
+static void on_blink(uint32_t events, void * context)
+{
+	(void) events;
+	(void) context;
+	LED_toggle(LED_GREEN);
+}
+
 int main (void) {
 
+	BOOT_relocateVectors(vectors);
+	IRQ_initGrouping();												// Before the drivers set their priorities
 	initGreenLed();
 	
+	SCHED_init();
+	SCHED_initTask(&sensor_task, on_samples, NULL, 0);
+	SCHED_initTask(&led_task, on_blink, NULL, 1);
+	
 	MEMS_CLK_ENABLE();
 	MEMS_init();
 	
 	MEMS_setBitsInRegister(MEMS_CTRL_REG4, MEMS_CTRL_REG4_XEN | MEMS_CTRL_REG4_YEN | MEMS_CTRL_REG4_ZEN);
 	MEMS_setValueBitsInRegister(MEMS_CTRL_REG4, MEMS_CTRL_REG4_ODR, (6 << 4));
 	
-	while (1) 
-	{
-		_rcvd = MEMS_getTemperature();
-	}
+	RING_init(&samples_ring, samples, sizeof(samples[0]), 64);
+	MEMS_startDataReady(&samples_ring, SCHED_signal, &samples_ready);
+	
+	SCHED_run();																	// Asleep between the events
 }
-
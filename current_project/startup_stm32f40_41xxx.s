@@ -40,7 +40,9 @@
 
 Stack_Size      EQU     0x00000400
 
-                AREA    STACK, NOINIT, READWRITE, ALIGN=3
+                AREA    STACK, NOINIT, READWRITE, ALIGN=5
+                EXPORT  Stack_Mem                  ; Painted and guarded (stack.h)
+                EXPORT  __initial_sp
 Stack_Mem       SPACE   Stack_Size
 __initial_sp
 
@@ -49,7 +51,7 @@ __initial_sp
 ;   <o>  Heap Size (in Bytes) <0x0-0xFFFFFFFF:8>
 ; </h>
 
-Heap_Size       EQU     0x00000200
+Heap_Size       EQU     0x00000000
 
                 AREA    HEAP, NOINIT, READWRITE, ALIGN=3
 __heap_base
@@ -177,10 +179,13 @@ __Vectors_Size  EQU  __Vectors_End - __Vectors
 Reset_Handler    PROC
                  EXPORT  Reset_Handler             [WEAK]
         IMPORT  SystemInit
+        IMPORT  BOOT_init
         IMPORT  __main
 
                  LDR     R0, =SystemInit
                  BLX     R0
+                 LDR     R0, =BOOT_init             ; FPU and flash accelerator (boot.h)
+                 BLX     R0
                  LDR     R0, =__main
                  BX      R0
                  ENDP
@@ -408,7 +413,6 @@ FPU_IRQHandler
 ;*******************************************************************************
                  IF      :DEF:__MICROLIB
                 
-                 EXPORT  __initial_sp
                  EXPORT  __heap_base
                  EXPORT  __heap_limit
                 
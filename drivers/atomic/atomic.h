@@ -0,0 +1,92 @@
+/**
+* @file 		atomic.h
+* @brief		Header file of the atomic register access layer.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to update the peripheral
+* registers shared by the main code and the interrupt handlers without
+* masking the interrupts.
+*
+*		1. A read-modify-write (REG |= bit) is a load, an ORR and a store: a
+*		handler which changes another bit of the register between the load
+*		and the store has its change undone by the store.
+*		2. One bit: ATOMIC_SET_BIT() and ATOMIC_CLEAR_BIT() write the
+*		bit-band alias of the bit, one store, the bus does the read-modify-
+*		write locked. Peripheral region only (0x40000000..0x400FFFFF: APB1,
+*		APB2 and AHB1, with GPIO, RCC and DMA), not AHB2 nor the core
+*		registers (SCB, DWT...).
+*		3. A field or several bits: ATOMIC_MODIFY32() and ATOMIC_MODIFY16()
+*		load the register with LDREX and store it with STREX, again if an
+*		exception ran in between (its entry clears the exclusive monitor).
+*		4. Neither for the flags cleared by writing 1 (EXTI PR, DMA IFCR):
+*		the other flags, written back as read, would be cleared too. Write
+*		the bit alone (EXTI->PR = bit). The flags cleared by writing 0 (TIM
+*		SR) are cleared with the complement (TIM->SR = ~flag): the others
+*		get 1, which does nothing.
+*		5. The register given to the macros is the lvalue, not its address.
+*		Use it as follow:
+*				ATOMIC_SET_BIT(SPI1->CR1, SPI_CR1_SPE);
+*				ATOMIC_BIT(EXTI->IMR, line) = 1;
+*				ATOMIC_MODIFY32(GPIOD->MODER, 0x3 << 2*pin, 0x1 << 2*pin);
+*
+*/
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stm32f4xx.h>
+
+/* Bit-band alias word of a bit of a peripheral register */
+#ifndef ATOMIC_BIT
+#define ATOMIC_BIT(reg, bit)		(*(__IO uint32_t *) (PERIPH_BB_BASE + (((uint32_t) &(reg) - PERIPH_BASE) << 5) + ((uint32_t) (bit) << 2)))
+#endif
+
+/* Registers of the exclusive accesses */
+#ifndef ATOMIC_REG32
+#define ATOMIC_REG32						__IO uint32_t
+#define ATOMIC_REG16						__IO uint16_t
+#endif
+
+#define ATOMIC_BIT_NUMBER(mask)						(31 - __CLZ(mask))						///< Bit of a one-bit mask
+#define ATOMIC_SET_BIT(reg, mask)					(ATOMIC_BIT((reg), ATOMIC_BIT_NUMBER(mask)) = 1)
+#define ATOMIC_CLEAR_BIT(reg, mask)				(ATOMIC_BIT((reg), ATOMIC_BIT_NUMBER(mask)) = 0)
+#define ATOMIC_MODIFY32(reg, clear, set)	ATOMIC_modify32(&(reg), (clear), (set))
+#define ATOMIC_MODIFY16(reg, clear, set)	ATOMIC_modify16(&(reg), (clear), (set))
+
+/**
+ * 32-bit register modified.
+ * The function loads the register with LDREX, clears then sets the bits
+ * and stores it with STREX, again until no exception ran in between.
+ * @param[in]	reg Register.
+ * @param[in]	clear Bits cleared.
+ * @param[in]	set Bits set, after the clear.
+ */
+static __inline void ATOMIC_modify32(ATOMIC_REG32 * reg, uint32_t clear, uint32_t set)
+{
+	uint32_t value;
+
+	do
+	{
+		value = __LDREXW(reg);
+	} while (__STREXW((value & ~clear) | set, reg) != 0);
+}
+
+/**
+ * 16-bit register modified (SPI, TIM).
+ * @param[in]	reg Register.
+ * @param[in]	clear Bits cleared.
+ * @param[in]	set Bits set, after the clear.
+ */
+static __inline void ATOMIC_modify16(ATOMIC_REG16 * reg, uint16_t clear, uint16_t set)
+{
+	uint16_t value;
+
+	do
+	{
+		value = __LDREXH(reg);
+	} while (__STREXH((uint16_t) ((value & ~clear) | set), reg) != 0);
+}
+
+#endif
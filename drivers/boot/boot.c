@@ -0,0 +1,54 @@
+/**
+* @file 		boot.c
+* @brief		Source file of the boot stage.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions run between the reset and main() to
+* set up the core and the flash for speed. No interrupt is enabled yet:
+* the core registers are written with plain read-modify-writes.
+*
+*/
+
+#include "boot.h"
+
+void BOOT_init(void)
+{
+	STACK_initMain();
+#if (__FPU_PRESENT == 1)
+	BOOT_initFPU();
+#endif
+	BOOT_initFlash(RCC_readHCLK());
+}
+
+void BOOT_initFPU(void)
+{
+	SCB->CPACR |= BOOT_CPACR_FPU;
+	FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+	__DSB();
+	__ISB();																						// Next instruction may be an FP one
+}
+
+void BOOT_initFlash(u32 hclk)
+{
+	u32 latency = (hclk - 1) / RCC_WAIT_STATE_HZ;
+
+	// Caches reset while disabled (RM0090, 3.5.2), wait states before they serve
+	FLASH->ACR = latency;
+	FLASH->ACR = latency | FLASH_ACR_ICRST | FLASH_ACR_DCRST;
+	FLASH->ACR = latency;
+	FLASH->ACR = latency | FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+	while ((FLASH->ACR & FLASH_ACR_LATENCY) != latency);				// Used once read back
+}
+
+void BOOT_relocateVectors(BOOT_Handler * table)
+{
+	u32 i;
+
+	for (i = 0; i < BOOT_VECTOR_NUMBER; i++)
+		table[i] = __Vectors[i];
+	__DSB();
+	SCB->VTOR = (uintptr_t) table;
+	__DSB();
+}
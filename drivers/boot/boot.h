@@ -0,0 +1,88 @@
+/**
+* @file 		boot.h
+* @brief		Header file of the boot stage.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions run between the reset and main() to
+* set up the core and the flash for speed.
+*
+*		1. BOOT_init() is called by Reset_Handler after SystemInit() and
+*		before __main (startup_stm32f40_41xxx.s): the C library isn't
+*		initialised yet, the boot stage uses no RAM variable (HCLK is read
+*		from the RCC registers, not from SystemCoreClock).
+*		2. FPU: CP10 and CP11 full access, with the automatic and lazy state
+*		preservation (FPCCR ASPEN, LSPEN): an exception reserves the frame
+*		of the FP registers but stacks them only if its handler uses the FPU.
+*		3. Flash: wait states of HCLK, prefetch, instruction and data caches
+*		of the ART accelerator, reset before they are enabled. A fetch out of
+*		the caches stalls the CPU for the wait states (5 at 168 MHz).
+*		4. BOOT_relocateVectors() copies the vector table to RAM and points
+*		VTOR to it: the vector read of an exception entry no longer waits for
+*		the flash, and the handlers can be changed at run time. The table is
+*		in RAM: call it from main(), __main clears and initialises the RAM.
+*		5. The main stack is painted first, for its peak use (stack.h).
+*		6. Use it as follow:
+*				static BOOT_Handler vectors[BOOT_VECTOR_NUMBER] __attribute__((aligned(BOOT_VECTOR_ALIGN)));
+*
+*				int main(void)
+*				{
+*					BOOT_relocateVectors(vectors);
+*					...
+*
+*/
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "rcc.h"
+#include "stack.h"
+
+#define BOOT_VECTOR_NUMBER		(16 + 82)							///< Core exceptions and interrupts of the STM32F40x
+#define BOOT_VECTOR_ALIGN			512										///< VTOR: table aligned on its size rounded up to a power of 2
+#define BOOT_CPACR_FPU				(0xFUL << 20)					///< CP10 and CP11 full access
+
+/* Vector table entry, the first one is the initial stack pointer */
+typedef void (*BOOT_Handler)(void);
+
+/* Vector table in the flash (startup_stm32f40_41xxx.s) */
+extern const BOOT_Handler __Vectors[];
+
+
+/*----------------------------------------------------------------------------
+  Boot stage
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Boot stage.
+ * This function paints the main stack, enables the FPU (if present) and
+ * the flash accelerator for the HCLK set by SystemInit().
+ * @par Called by Reset_Handler, before the C library initialisation.
+ */
+void BOOT_init(void);
+
+/**
+ * FPU enabled.
+ * This function gives full access to CP10 and CP11 and sets the automatic
+ * and lazy stacking of the FP context.
+ */
+void BOOT_initFPU(void);
+
+/**
+ * Flash accelerator enabled.
+ * This function sets the wait states of hclk, resets the ART caches and
+ * enables them with the prefetch.
+ * @param[in]	hclk AHB clock the flash runs at, in Hz.
+ */
+void BOOT_initFlash(u32 hclk);
+
+/**
+ * Vector table relocated to RAM.
+ * This function copies the flash vector table and points VTOR to the copy.
+ * @param[out]	table RAM table of BOOT_VECTOR_NUMBER entries aligned on
+ * BOOT_VECTOR_ALIGN, not in the CCM (not on the bus of the vector reads).
+ */
+void BOOT_relocateVectors(BOOT_Handler * table);
+
+#endif
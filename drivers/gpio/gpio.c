@@ -12,6 +12,45 @@
 */
 
 #include "gpio.h"
+#include "atomic.h"
+
+/*----------------------------------------------------------------------------
+  GPIO port configuration (all registers)
+ *----------------------------------------------------------------------------*/
+
+void GPIO_configPins(GPIO_TypeDef * GPIO, uint16_t mask, const GPIO_PinConfig * config)
+{
+	uint32_t mask2 = 0;																	// 2-bit fields of the pins
+	uint32_t afr_mask[2] = { 0, 0 };
+	uint32_t afr_value[2] = { 0, 0 };
+	uint8_t pin;
+	
+	for (pin = 0; pin < GPIO_MAX_PIN; pin++)
+	{
+		if (mask & (0x1 << pin))
+		{
+			mask2 |= (0x3 << 2*pin);
+			afr_mask[pin / 8] |= (0xF << 4*(pin % 8));
+			afr_value[pin / 8] |= ((uint32_t) (config->alternate & 0xF) << 4*(pin % 8));
+		}
+	}
+	if (mask2 == 0)
+		return;
+	
+	ATOMIC_MODIFY32(GPIO->OTYPER, mask, config->output_type ? mask : 0);
+	// 0x55555555 has 0b01 in each 2-bit field: multiplying spreads a value to every field
+	ATOMIC_MODIFY32(GPIO->OSPEEDR, mask2, mask2 & (0x55555555 * config->speed));
+	ATOMIC_MODIFY32(GPIO->PUPDR, mask2, mask2 & (0x55555555 * config->pull));
+	if (config->mode == GPIO_MODE_ALTERNATE)
+	{
+		if (afr_mask[0])
+			ATOMIC_MODIFY32(GPIO->AFR[0], afr_mask[0], afr_value[0]);
+		if (afr_mask[1])
+			ATOMIC_MODIFY32(GPIO->AFR[1], afr_mask[1], afr_value[1]);
+	}
+	ATOMIC_MODIFY32(GPIO->MODER, mask2, mask2 & (0x55555555 * config->mode));
+}
+
 
 /*----------------------------------------------------------------------------
   GPIO port mode register (GPIOx_MODER)
@@ -21,7 +60,7 @@ void GPIO_initInput(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->MODER &= ~(0x3 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->MODER, 0x3 << 2*pin, 0x0);
 	}
 }
 
@@ -29,8 +68,7 @@ void GPIO_initOutput(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->MODER &= ~(0x3 << 2*pin);
-		GPIO->MODER |= (0x1 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->MODER, 0x3 << 2*pin, 0x1 << 2*pin);
 	}
 }
 
@@ -38,8 +76,7 @@ void GPIO_initAlternate(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->MODER &= ~(0x3 << 2*pin);
-		GPIO->MODER |= (0x2 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->MODER, 0x3 << 2*pin, 0x2 << 2*pin);
 	}
 }
 
@@ -47,8 +84,7 @@ void GPIO_initAnalog(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->MODER &= ~(0x3 << 2*pin);
-		GPIO->MODER |= (0x3 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->MODER, 0x3 << 2*pin, 0x3 << 2*pin);
 	}
 }
 
@@ -61,7 +97,7 @@ void GPIO_initOutputPushpull(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->OTYPER &= ~(0x1 << pin);
+		ATOMIC_BIT(GPIO->OTYPER, pin) = 0;
 	}
 }
 
@@ -69,8 +105,7 @@ void GPIO_initOutputOpendrain(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 		if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->OTYPER &= ~(0x1 << pin);
-		GPIO->OTYPER |= (0x1 << pin);
+		ATOMIC_BIT(GPIO->OTYPER, pin) = 1;
 	}
 }
 
@@ -83,7 +118,7 @@ void GPIO_initOutputLowspeed(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->OSPEEDR &= ~(0x3 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->OSPEEDR, 0x3 << 2*pin, 0x0);
 	}
 }
 
@@ -91,8 +126,7 @@ void GPIO_initOutputMediumspeed(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->OSPEEDR &= ~(0x3 << 2*pin);
-		GPIO->OSPEEDR |= (0x1 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->OSPEEDR, 0x3 << 2*pin, 0x1 << 2*pin);
 	}
 }
 
@@ -100,8 +134,7 @@ void GPIO_initOutputFastspeed(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->OSPEEDR &= ~(0x3 << 2*pin);
-		GPIO->OSPEEDR |= (0x2 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->OSPEEDR, 0x3 << 2*pin, 0x2 << 2*pin);
 	}
 }
 
@@ -109,8 +142,7 @@ void GPIO_initOutputHighspeed(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->OSPEEDR &= ~(0x3 << 2*pin);
-		GPIO->OSPEEDR |= (0x3 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->OSPEEDR, 0x3 << 2*pin, 0x3 << 2*pin);
 	}
 }
 
@@ -123,8 +155,7 @@ void GPIO_initNopull(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->PUPDR &= ~(0x3 << 2*pin);
-		GPIO->PUPDR |= (0x0 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->PUPDR, 0x3 << 2*pin, 0x0);
 	}
 }
 
@@ -132,8 +163,7 @@ void GPIO_initPullup(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->PUPDR &= ~(0x3 << 2*pin);
-		GPIO->PUPDR |= (0x1 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->PUPDR, 0x3 << 2*pin, 0x1 << 2*pin);
 	}
 }
 
@@ -141,8 +171,7 @@ void GPIO_initPulldown(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->PUPDR &= ~(0x3 << 2*pin);
-		GPIO->PUPDR |= (0x2 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->PUPDR, 0x3 << 2*pin, 0x2 << 2*pin);
 	}
 }
 
@@ -150,8 +179,7 @@ void GPIO_initReserved(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->PUPDR &= ~(0x3 << 2*pin);
-		GPIO->PUPDR |= (0x3 << 2*pin);
+		ATOMIC_MODIFY32(GPIO->PUPDR, 0x3 << 2*pin, 0x3 << 2*pin);
 	}
 }
 
@@ -165,8 +193,7 @@ void GPIO_setPin(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->BSRRL &= ~(0x1 << pin);
-		GPIO->BSRRL |= (0x1 << pin);
+		GPIO->BSRRL = (0x1 << pin);
 	}
 }	
 
@@ -174,8 +201,7 @@ void GPIO_resetPin(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->BSRRH &= ~(0x1 << pin);
-		GPIO->BSRRH |= (0x1 << pin);
+		GPIO->BSRRH = (0x1 << pin);
 	}
 }
 
@@ -185,13 +211,11 @@ void GPIO_writePin(GPIO_TypeDef * GPIO, uint8_t pin, GPIO_PinState pin_State)
 	{
 		if (pin_State == GPIO_PIN_HIGH)
 		{
-			GPIO->BSRRL &= ~(0x1 << pin);
-			GPIO->BSRRL |= (0x1 << pin);
+			GPIO->BSRRL = (0x1 << pin);
 		}
 		else if (pin_State == GPIO_PIN_LOW)
 		{
-			GPIO->BSRRH &= ~(0x1 << pin);
-			GPIO->BSRRH |= (0x1 << pin);
+			GPIO->BSRRH = (0x1 << pin);
 		}
 	}
 }
@@ -200,7 +224,7 @@ void GPIO_togglePin(GPIO_TypeDef * GPIO, uint8_t pin)
 {
 	if (pin < GPIO_MAX_PIN) 
 	{
-		GPIO->ODR ^= (0x1 << pin);
+		GPIO_togglePins(GPIO, (0x1 << pin));
 	}	
 }
 
@@ -20,6 +20,19 @@
 *				GPIO_initFastspeed(GPIOD, LED_NUMBER);
 *				GPIO_initPullup(GPIOD, LED_NUMBER);
 *				GPIO_setPin(GPIOD, LED_NUMBER);
+*		4. Several pins of a port can be configured at once, each
+*		configuration register being written once (see GPIO_configPins):
+*				const GPIO_PinConfig led = { GPIO_MODE_OUTPUT, GPIO_OTYPE_PUSHPULL,
+*																		 GPIO_SPEED_FAST, GPIO_PULL_NONE, 0 };
+*				GPIO_configPins(GPIOD, (0x1 << 12) | (0x1 << 13), &led);
+*		5. On the hot paths (chip selects, leds) use the inline fast path,
+*		the pin is checked at compile time and each call is one BSRR store:
+*				GPIO_SET_PIN(GPIOD, 12);
+*				GPIO_togglePins(GPIOD, GPIO_PIN(12) | GPIO_PIN(13));
+*		6. The configuration functions are interrupt-safe (atomic.h): the
+*		2-bit fields are written with LDREX/STREX, OTYPER through its
+*		bit-band alias, a handler configuring other pins of the port is
+*		never undone.
 */
 
 #ifndef GPIO_H
@@ -30,6 +43,14 @@
 
 #define GPIO_MAX_PIN 		16				///< Number max of pin for each port
 
+/* 32-bit view of the BSRRL/BSRRH halves: set bits in 0..15, reset bits in 16..31 */
+#ifndef GPIO_BSRR
+#define GPIO_BSRR(GPIO)		(*(__IO uint32_t *) &(GPIO)->BSRRL)
+#endif
+
+/* Mask of a pin, pin must be a constant expression (compilation error when >= GPIO_MAX_PIN) */
+#define GPIO_PIN(pin)			((uint16_t) ((0x1 << (pin)) + 0 * sizeof(char[((pin) < GPIO_MAX_PIN) ? 1 : -1])))
+
 /* Enum type to define the 3 logic levels of a pin */
 typedef enum 
 {
@@ -38,6 +59,67 @@ typedef enum
 	GPIO_PIN_UNDEF
 }GPIO_PinState;
 
+/* Values of the 2-bit MODER fields */
+typedef enum
+{
+	GPIO_MODE_INPUT = 0,
+	GPIO_MODE_OUTPUT,
+	GPIO_MODE_ALTERNATE,
+	GPIO_MODE_ANALOG
+}GPIO_Mode;
+
+/* Values of the 1-bit OTYPER fields */
+typedef enum
+{
+	GPIO_OTYPE_PUSHPULL = 0,
+	GPIO_OTYPE_OPENDRAIN
+}GPIO_OutputType;
+
+/* Values of the 2-bit OSPEEDR fields */
+typedef enum
+{
+	GPIO_SPEED_LOW = 0,
+	GPIO_SPEED_MEDIUM,
+	GPIO_SPEED_FAST,
+	GPIO_SPEED_HIGH
+}GPIO_Speed;
+
+/* Values of the 2-bit PUPDR fields */
+typedef enum
+{
+	GPIO_PULL_NONE = 0,
+	GPIO_PULL_UP,
+	GPIO_PULL_DOWN
+}GPIO_Pull;
+
+/* Configuration applied to a set of pins by GPIO_configPins */
+typedef struct
+{
+	GPIO_Mode mode;
+	GPIO_OutputType output_type;
+	GPIO_Speed speed;
+	GPIO_Pull pull;
+	uint8_t alternate;								///< Alternate function number (0..15), used in GPIO_MODE_ALTERNATE only
+}GPIO_PinConfig;
+
+
+/*----------------------------------------------------------------------------
+  GPIO port configuration (all registers)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * GPIO pins configuration.
+ * The function computes the fields of all the pins of the mask and writes
+ * OTYPER, OSPEEDR, PUPDR, AFR[0]/AFR[1] (alternate mode only, and only the
+ * halves holding a pin of the mask) and finally MODER, once each.
+ * @param[in]	GPIO GPIO to initialize.
+ * @param[in]	mask Pins to configure (bit n for pin n).
+ * @param[in]	config Configuration of the pins.
+ * @par MODER is written last, so a pin switched to output or alternate mode
+ * only drives once its type, speed, pull and alternate function are set.
+ */
+void GPIO_configPins(GPIO_TypeDef * GPIO, uint16_t mask, const GPIO_PinConfig * config);
+
 
 /*----------------------------------------------------------------------------
   GPIO port mode register (GPIOx_MODER)
@@ -194,7 +276,7 @@ void GPIO_resetPin(GPIO_TypeDef * GPIO, uint8_t pin);
 
 /**
  * GPIO pin set as the indicated logic level.
- * The function sets the appropriate 1 bit of the GPIO BSRRL or BSRRH register (0b1).
+ * The function writes the appropriate 1 bit of the GPIO BSRRL or BSRRH register (0b1).
  * @param[in]	GPIO GPIO to write.
  * @param[in]	pin Pin set as desired level.
  * @param[in]	pinState Desired logic level.
@@ -203,14 +285,60 @@ void GPIO_writePin(GPIO_TypeDef * GPIO, uint8_t pin, GPIO_PinState pin_State);
 
 /**
  * GPIO pin toggled.
- * The function toggles the appropriate 1 bit of the GPIO ODR register.
+ * The function reads ODR and sets or resets the pin with one BSRR write.
  * @param[in]	GPIO GPIO to toggle.
  * @param[in]	pin Pin to toggle.
- * @par This function is not atomic.
  */
 void GPIO_togglePin(GPIO_TypeDef * GPIO, uint8_t pin);
 
 
+/*----------------------------------------------------------------------------
+  GPIO fast path (inline, one BSRR store)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * GPIO pins set as high logic level.
+ * The function writes the mask in the set half of BSRR.
+ * @param[in]	GPIO GPIO to set.
+ * @param[in]	mask Pins to set (see GPIO_PIN).
+ */
+static __inline void GPIO_setPins(GPIO_TypeDef * GPIO, uint16_t mask)
+{
+	GPIO_BSRR(GPIO) = mask;
+}
+
+/**
+ * GPIO pins set as low logic level.
+ * The function writes the mask in the reset half of BSRR.
+ * @param[in]	GPIO GPIO to reset.
+ * @param[in]	mask Pins to reset (see GPIO_PIN).
+ */
+static __inline void GPIO_resetPins(GPIO_TypeDef * GPIO, uint16_t mask)
+{
+	GPIO_BSRR(GPIO) = (uint32_t) mask << 16;
+}
+
+/**
+ * GPIO pins toggled.
+ * The function reads ODR and writes in BSRR the reset bits of the pins
+ * which are high and the set bits of the pins which are low.
+ * @param[in]	GPIO GPIO to toggle.
+ * @param[in]	mask Pins to toggle (see GPIO_PIN).
+ * @par The other pins of the port are never written, unlike an ODR
+ * read-modify-write which can undo a change made by an interrupt.
+ */
+static __inline void GPIO_togglePins(GPIO_TypeDef * GPIO, uint16_t mask)
+{
+	uint32_t odr = GPIO->ODR;
+	
+	GPIO_BSRR(GPIO) = ((odr & mask) << 16) | (~odr & mask);
+}
+
+#define GPIO_SET_PIN(GPIO, pin)			GPIO_setPins((GPIO), GPIO_PIN(pin))			///< Constant pin set
+#define GPIO_RESET_PIN(GPIO, pin)		GPIO_resetPins((GPIO), GPIO_PIN(pin))		///< Constant pin reset
+#define GPIO_TOGGLE_PIN(GPIO, pin)	GPIO_togglePins((GPIO), GPIO_PIN(pin))	///< Constant pin toggle
+
+
 /*----------------------------------------------------------------------------
   GPIO port input data register (GPIOx_IDR)
  *----------------------------------------------------------------------------*/
@@ -14,6 +14,30 @@
 */
 
 #include "interrupt.h"
+#include "atomic.h"
+#include "memory.h"
+
+/* Attached callback of a line */
+typedef struct
+{
+	EXTI_Callback callback;
+	void * context;
+}EXTI_Handler;
+
+static EXTI_Handler exti_handlers[EXTI_MAX_LINE];
+static u16 exti_attached;																		///< Bit n set when line n has a callback
+
+/* NVIC interrupt of each line */
+static const IRQn_Type exti_irqn[EXTI_MAX_LINE] =
+{
+	EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn,
+	EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn,
+	EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn
+};
+
+/* Lines of each shared interrupt routine */
+#define EXTI_LINES_9_5			0x03E0
+#define EXTI_LINES_15_10		0xFC00
 
 /*----------------------------------------------------------------------------
   Interrupt mask register (EXTI_IMR)
@@ -28,7 +52,20 @@ void EXTI_enableLine(u8 line)
 {
 	if (line < EXTI_MAX_LINE)
 	{
-		EXTI->IMR |= (0x1 << line);
+		ATOMIC_BIT(EXTI->IMR, line) = 1;
+	}
+}
+
+/**
+ * EXTI line disable.
+ * The function clears the appropriate 1 bit of the EXTI IMR register (0b0).
+ * @param[in]	line EXTI line to disable.
+ */
+void EXTI_disableLine(u8 line)
+{
+	if (line < EXTI_MAX_LINE)
+	{
+		ATOMIC_BIT(EXTI->IMR, line) = 0;
 	}
 }
 
@@ -48,26 +85,10 @@ void EXTI_setLinePin(u8 line, u8 pin)
 {	
 	if (line < EXTI_MAX_LINE && pin <= SYSCFG_EXTICR_EXTI_PI)
 	{
-		if (line < 4)
-		{
-			SYSCFG->EXTICR[0] &= ~(0xF << (4 * (line % 4)));
-			SYSCFG->EXTICR[0] |= (pin << (4 * (line % 4)));
-		}
-		else if (line < 8)
-		{
-			SYSCFG->EXTICR[1] &= ~(0xF << (4 * (line % 4)));
-			SYSCFG->EXTICR[1] |= (pin << (4 * (line % 4)));
-		}
-		else if (line < 12)
-		{
-			SYSCFG->EXTICR[2] &= ~(0xF << (4 * (line % 4)));
-			SYSCFG->EXTICR[2] |= (pin << (4 * (line % 4))); 
-		}
-		else if (line < EXTI_MAX_LINE)
-		{
-			SYSCFG->EXTICR[3] &= ~(0xF << (4 * (line % 4)));
-			SYSCFG->EXTICR[3] |= (pin << (4 * (line % 4))); 
-		}
+		// 4 lines per register: EXTICR[line / 4], 4 bits at line % 4
+		u8 shift = 4 * (line & 0x3);
+		
+		ATOMIC_MODIFY32(SYSCFG->EXTICR[line >> 2], 0xFUL << shift, (u32) pin << shift);
 	}
 }
 
@@ -85,7 +106,7 @@ void EXTI_setFallingEdge(u8 line)
 {
 	if (line < EXTI_MAX_LINE)
 	{
-		EXTI->FTSR |= (0x1 << line);
+		ATOMIC_BIT(EXTI->FTSR, line) = 1;
 	}
 }
 
@@ -103,7 +124,7 @@ void EXTI_setRisingEdge(u8 line)
 {
 	if (line < EXTI_MAX_LINE)
 	{
-		EXTI->RTSR |= (0x1 << line);
+		ATOMIC_BIT(EXTI->RTSR, line) = 1;
 	}
 }
 
@@ -114,13 +135,225 @@ void EXTI_setRisingEdge(u8 line)
 
 /**
  * EXTI line pending status cleared.
- * The function sets the appropriate 1 bit of the EXTI PR register (0b1).
+ * The function writes 1 to the appropriate bit of the EXTI PR register (0b1).
  * @param[in]	line EXTI line to clear.
  */
 void EXTI_clearPending(u8 line)
 {
 	if (line < EXTI_MAX_LINE)
 	{
-		EXTI->PR |= (0x1 << line);
+		EXTI->PR = (0x1 << line);															// Write-1-to-clear: |= would clear every pending line
+	}
+}
+
+
+/*----------------------------------------------------------------------------
+  Dispatch table
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Callback attached to an EXTI line.
+ * The function selects the port, sets the edges, clears the pending status,
+ * then enables the line and its NVIC interrupt. A callback already attached
+ * to the line is replaced.
+ * @param[in]	line EXTI line (0..15), the pin number.
+ * @param[in]	edge Edges triggering the callback.
+ * @param[in]	port Port of the pin (SYSCFG_EXTICR_EXTI_PA..SYSCFG_EXTICR_EXTI_PI).
+ * @param[in]	callback Function called when the line is pending.
+ * @param[in]	context Passed to the callback.
+ * @retval bool False if an argument is out of range, nothing is done.
+ */
+bool EXTI_attach(u8 line, EXTI_Edge edge, u8 port, EXTI_Callback callback, void * context)
+{
+	u32 bit;
+	
+	if (line >= EXTI_MAX_LINE || port > SYSCFG_EXTICR_EXTI_PI || callback == NULL
+		|| edge < EXTI_EDGE_RISING || edge > EXTI_EDGE_BOTH)
+		return false;
+	
+	bit = 0x1UL << line;
+	ATOMIC_BIT(EXTI->IMR, line) = 0;														// Handler not called while it changes
+	exti_handlers[line].callback = callback;
+	exti_handlers[line].context = context;
+	exti_attached |= bit;
+	
+	EXTI_setLinePin(line, port);
+	if (edge & EXTI_EDGE_RISING)
+		ATOMIC_BIT(EXTI->RTSR, line) = 1;
+	else
+		ATOMIC_BIT(EXTI->RTSR, line) = 0;
+	if (edge & EXTI_EDGE_FALLING)
+		ATOMIC_BIT(EXTI->FTSR, line) = 1;
+	else
+		ATOMIC_BIT(EXTI->FTSR, line) = 0;
+	EXTI->PR = bit;
+	ATOMIC_BIT(EXTI->IMR, line) = 1;
+	NVIC_EnableIRQ(exti_irqn[line]);
+	
+	return true;
+}
+
+/**
+ * Callback detached from an EXTI line.
+ * The function disables the line and clears its edges and pending status.
+ * The NVIC interrupt is disabled when no other attached line shares it.
+ * @param[in]	line EXTI line (0..15).
+ */
+void EXTI_detach(u8 line)
+{
+	u32 bit;
+	u8 other;
+	
+	if (line >= EXTI_MAX_LINE)
+		return;
+	
+	bit = 0x1UL << line;
+	ATOMIC_BIT(EXTI->IMR, line) = 0;
+	ATOMIC_BIT(EXTI->RTSR, line) = 0;
+	ATOMIC_BIT(EXTI->FTSR, line) = 0;
+	EXTI->PR = bit;
+	exti_attached &= ~bit;
+	exti_handlers[line].callback = NULL;
+	exti_handlers[line].context = NULL;
+	
+	for (other = 0; other < EXTI_MAX_LINE; other++)
+	{
+		if ((exti_attached & (0x1 << other)) && exti_irqn[other] == exti_irqn[line])
+			return;
 	}
+	NVIC_DisableIRQ(exti_irqn[line]);
+}
+
+/**
+ * NVIC interrupt of an EXTI line.
+ * @param[in]	line EXTI line (0..15).
+ * @retval IRQn_Type EXTI0_IRQn..EXTI4_IRQn, EXTI9_5_IRQn or EXTI15_10_IRQn.
+ */
+IRQn_Type EXTI_getIRQn(u8 line)
+{
+	return exti_irqn[line & (EXTI_MAX_LINE - 1)];
+}
+
+/*
+ * Calls the callbacks of the pending lines among lines. All of them are
+ * cleared first with a single write, an edge during a callback pends its
+ * line again. Highest line first, one CLZ per pending line. Run from the
+ * SRAM with the handlers: the edge to callback latency has no wait state.
+ */
+MEM_RAMCODE static void EXTI_dispatch(u32 lines)
+{
+	u32 pending = EXTI->PR & lines;
+	u8 line;
+	
+	EXTI->PR = pending;
+	while (pending != 0)
+	{
+		line = 31 - __CLZ(pending);
+		pending &= ~(0x1UL << line);
+		if (exti_handlers[line].callback != NULL)
+			exti_handlers[line].callback(line, exti_handlers[line].context);
+	}
+}
+
+MEM_RAMCODE void EXTI0_IRQHandler(void)
+{
+	EXTI_dispatch(0x0001);
+}
+
+MEM_RAMCODE void EXTI1_IRQHandler(void)
+{
+	EXTI_dispatch(0x0002);
+}
+
+MEM_RAMCODE void EXTI2_IRQHandler(void)
+{
+	EXTI_dispatch(0x0004);
+}
+
+MEM_RAMCODE void EXTI3_IRQHandler(void)
+{
+	EXTI_dispatch(0x0008);
+}
+
+MEM_RAMCODE void EXTI4_IRQHandler(void)
+{
+	EXTI_dispatch(0x0010);
+}
+
+MEM_RAMCODE void EXTI9_5_IRQHandler(void)
+{
+	EXTI_dispatch(EXTI_LINES_9_5);
+}
+
+MEM_RAMCODE void EXTI15_10_IRQHandler(void)
+{
+	EXTI_dispatch(EXTI_LINES_15_10);
+}
+
+
+/*----------------------------------------------------------------------------
+  NVIC priorities
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Priority grouping of the project.
+ * The function sets AIRCR PRIGROUP to IRQ_PRIORITY_GROUP.
+ */
+void IRQ_initGrouping(void)
+{
+	NVIC_SetPriorityGrouping(IRQ_PRIORITY_GROUP);
+}
+
+/**
+ * Priority of an interrupt or system exception.
+ * @param[in]	IRQn Interrupt or system exception.
+ * @param[in]	level Preemption level (0..IRQ_LEVELS-1).
+ * @param[in]	sub Sub-priority (0..IRQ_SUB_LEVELS-1).
+ * @retval bool False if level or sub is out of range.
+ */
+bool IRQ_setPriority(IRQn_Type IRQn, u8 level, u8 sub)
+{
+	if (level >= IRQ_LEVELS || sub >= IRQ_SUB_LEVELS)
+		return false;
+	
+	NVIC_SetPriority(IRQn, NVIC_EncodePriority(IRQ_PRIORITY_GROUP, level, sub));
+	return true;
+}
+
+/**
+ * Preemption level of an interrupt or system exception.
+ * @param[in]	IRQn Interrupt or system exception.
+ * @retval u8 Level.
+ */
+u8 IRQ_getLevel(IRQn_Type IRQn)
+{
+	uint32_t level, sub;
+	
+	NVIC_DecodePriority(NVIC_GetPriority(IRQn), IRQ_PRIORITY_GROUP, &level, &sub);
+	return (u8) level;
+}
+
+/**
+ * Interrupts of a level and the less urgent ones masked.
+ * @param[in]	level Level masked (1..IRQ_LEVELS-1).
+ * @retval u32 Previous BASEPRI.
+ */
+u32 IRQ_lock(u8 level)
+{
+	u32 key = __get_BASEPRI();
+	u32 basepri = (u32) level << (8 - IRQ_PREEMPT_BITS);							// Level in the top bits, as the priorities
+	
+	// BASEPRI 0 masks nothing: level 0 can't be masked this way
+	if (level > 0 && level < IRQ_LEVELS && (key == 0 || basepri < key))
+		__set_BASEPRI(basepri);
+	return key;
+}
+
+/**
+ * Lock released.
+ * @param[in]	key Value returned by the matching IRQ_lock.
+ */
+void IRQ_unlock(u32 key)
+{
+	__set_BASEPRI(key);
 }
@@ -45,6 +45,28 @@
 *				EXTI_setFallingEdge(0);
 *				EXTI_setRisingEdge(0);
 *				EXTI_setLinePin(0, SYSCFG_EXTICR_EXTI_PA);
+*		5. interrupt.c defines all the EXTI interrupt routines (EXTI0..4,
+*		EXTI9_5, EXTI15_10): the application attaches a callback per line
+*		instead of writing them. The pending lines of a routine are
+*		cleared at once, then the callbacks are called from the highest
+*		line down, found with CLZ: a shared routine costs the lines
+*		actually pending, not the 5 or 6 it covers.
+*				__SYSCFG_CLK_ENABLE();
+*				EXTI_attach(0, EXTI_EDGE_BOTH, SYSCFG_EXTICR_EXTI_PA, on_button, NULL);
+*		6. The priorities are split in IRQ_LEVELS preemption levels
+*		(IRQ_PREEMPT_BITS bits) and sub-priorities, which only order the
+*		pending interrupts of a level. IRQ_initGrouping() is called once,
+*		before any IRQ_setPriority(). The levels of the project:
+*				IRQ_LEVEL_URGENT		never masked by IRQ_lock, must not wait for another handler
+*				IRQ_LEVEL_DRIVER		SPI, DMA, MEMS INT1
+*				IRQ_LEVEL_TIMER			timers
+*				IRQ_LEVEL_DEFERRED	PendSV (work_queue.h), long processing
+*		IRQ_lock() masks a level and the levels below with BASEPRI: the
+*		more urgent ones still preempt the critical section, unlike with
+*		__disable_irq():
+*				u32 key = IRQ_lock(IRQ_LEVEL_TIMER);			// Timers and PendSV masked
+*				...
+*				IRQ_unlock(key);
 *		
 */
 
@@ -52,6 +74,7 @@
 #define INTERRUPT_H
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <stm32f4xx.h>
 
 /* Redefinition of SYSCFG EXTI configuration registers 
@@ -68,6 +91,28 @@
 
 #define EXTI_MAX_LINE 					16															///< Number max of EXTI lines 0..15
 
+#define IRQ_PREEMPT_BITS				2																///< Priority bits of the preemption level
+#define IRQ_PRIORITY_GROUP			(7 - IRQ_PREEMPT_BITS)					///< AIRCR PRIGROUP of IRQ_initGrouping
+#define IRQ_LEVELS							(0x1 << IRQ_PREEMPT_BITS)
+#define IRQ_SUB_LEVELS					(0x1 << (__NVIC_PRIO_BITS - IRQ_PREEMPT_BITS))
+
+/* Preemption levels of the project, 0 the most urgent */
+#define IRQ_LEVEL_URGENT				0
+#define IRQ_LEVEL_DRIVER				1
+#define IRQ_LEVEL_TIMER					2
+#define IRQ_LEVEL_DEFERRED			3
+
+/* Edges triggering an attached line */
+typedef enum
+{
+	EXTI_EDGE_RISING = 1,
+	EXTI_EDGE_FALLING = 2,
+	EXTI_EDGE_BOTH = 3
+}EXTI_Edge;
+
+/* Callback of an attached line, called in the EXTI interrupt routine */
+typedef void (*EXTI_Callback)(u8 line, void * context);
+
 /*----------------------------------------------------------------------------
   Interrupt mask register (EXTI_IMR)
  *----------------------------------------------------------------------------*/
@@ -79,6 +124,13 @@
  */
 void EXTI_enableLine(u8 line);
 
+/**
+ * EXTI line disable.
+ * The function clears the appropriate 1 bit of the EXTI IMR register (0b0).
+ * @param[in]	line EXTI line to disable.
+ */
+void EXTI_disableLine(u8 line);
+
 
 /*----------------------------------------------------------------------------
   SYSCFG external interrupt configuration registers (SYSCFG_EXTICR)
@@ -124,9 +176,89 @@ void EXTI_setFallingEdge(u8 line);
 
 /**
  * EXTI line pending status cleared.
- * The function sets the appropriate 1 bit of the EXTI PR register (0b1).
+ * The function writes 1 to the appropriate bit of the EXTI PR register (0b1).
  * @param[in]	line EXTI line to clear.
+ * @par PR bits are cleared by writing 1: the other lines are written 0 and keep their status.
  */
 void EXTI_clearPending(u8 line);
 
+
+/*----------------------------------------------------------------------------
+  Dispatch table
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Callback attached to an EXTI line.
+ * The function selects the port, sets the edges, clears the pending status,
+ * then enables the line and its NVIC interrupt. A callback already attached
+ * to the line is replaced.
+ * @param[in]	line EXTI line (0..15), the pin number.
+ * @param[in]	edge Edges triggering the callback.
+ * @param[in]	port Port of the pin (SYSCFG_EXTICR_EXTI_PA..SYSCFG_EXTICR_EXTI_PI).
+ * @param[in]	callback Function called when the line is pending.
+ * @param[in]	context Passed to the callback.
+ * @retval bool False if an argument is out of range, nothing is done.
+ * @par The SYSCFG clock must be enabled.
+ */
+bool EXTI_attach(u8 line, EXTI_Edge edge, u8 port, EXTI_Callback callback, void * context);
+
+/**
+ * Callback detached from an EXTI line.
+ * The function disables the line and clears its edges and pending status.
+ * The NVIC interrupt is disabled when no other attached line shares it.
+ * @param[in]	line EXTI line (0..15).
+ */
+void EXTI_detach(u8 line);
+
+/**
+ * NVIC interrupt of an EXTI line.
+ * @param[in]	line EXTI line (0..15).
+ * @retval IRQn_Type EXTI0_IRQn..EXTI4_IRQn, EXTI9_5_IRQn or EXTI15_10_IRQn.
+ * @par Lines 5..9 and 10..15 share their interrupt, hence its priority.
+ */
+IRQn_Type EXTI_getIRQn(u8 line);
+
+
+/*----------------------------------------------------------------------------
+  NVIC priorities
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Priority grouping of the project.
+ * The function sets AIRCR PRIGROUP to IRQ_PRIORITY_GROUP: IRQ_PREEMPT_BITS
+ * bits of preemption level, the others of sub-priority.
+ */
+void IRQ_initGrouping(void);
+
+/**
+ * Priority of an interrupt or system exception.
+ * @param[in]	IRQn Interrupt, or system exception (PendSV_IRQn, SysTick_IRQn...).
+ * @param[in]	level Preemption level (0..IRQ_LEVELS-1), 0 the most urgent.
+ * @param[in]	sub Sub-priority (0..IRQ_SUB_LEVELS-1) among the pending interrupts of the level.
+ * @retval bool False if level or sub is out of range, nothing is done.
+ */
+bool IRQ_setPriority(IRQn_Type IRQn, u8 level, u8 sub);
+
+/**
+ * Preemption level of an interrupt or system exception.
+ * @param[in]	IRQn Interrupt or system exception.
+ * @retval u8 Level set by IRQ_setPriority.
+ */
+u8 IRQ_getLevel(IRQn_Type IRQn);
+
+/**
+ * Interrupts of a level and the less urgent ones masked.
+ * The function raises BASEPRI to the level, never lowers it: a lock
+ * nested in a stronger one changes nothing.
+ * @param[in]	level Level masked (1..IRQ_LEVELS-1), nothing is masked otherwise.
+ * @retval u32 Key to pass to IRQ_unlock, the previous BASEPRI.
+ */
+u32 IRQ_lock(u8 level);
+
+/**
+ * Lock released.
+ * @param[in]	key Value returned by the matching IRQ_lock.
+ */
+void IRQ_unlock(u32 key);
+
 #endif
@@ -13,25 +13,42 @@
 #include "rcc.h"
 #include "timer.h"
 #include "interrupt.h"
+#include "work_queue.h"
+#include "scheduler.h"
 
 /*----------------------------------------------------------------------------
   MAIN function
  *----------------------------------------------------------------------------*/
  
-void TIM3_IRQHandler(void)
+static void toggle_all(void * context)
 {
-	TIM_resetIRFlag(TIM3);
+	(void) context;
 	LED_toggle(LED_BLUE);
 	LED_toggle(LED_GREEN);
 	LED_toggle(LED_RED);
 	LED_toggle(LED_ORANGE);
 }
 
-void EXTI0_IRQHandler(void)
+void TIM3_IRQHandler(void)
+{
+	TIM_resetIRFlag(TIM3);
+	WORK_defer(toggle_all, NULL);														// LEDs toggled in PendSV
+}
+
+static SCHED_Task button_task;
+static SCHED_Event button_pressed = { &button_task, 0x1 };
+
+static void on_button_task(uint32_t events, void * context)
 {
+	(void) events;
+	(void) context;
 	LED_toggle(LED_BLUE);
-	EXTI_clearPending(0);
-	NVIC_ClearPendingIRQ(EXTI0_IRQn);
+}
+
+static void on_button(u8 line, void * context)
+{
+	(void) line;
+	SCHED_signal(context);																	// LED toggled in the task
 }
 
 int main (void) {
@@ -46,6 +63,11 @@ int main (void) {
 	LED_initLed(LED_ORANGE);
 	LED_switchON(LED_GREEN);	
 	
+	IRQ_initGrouping();
+	WORK_init();
+	SCHED_init();
+	SCHED_initTask(&button_task, on_button_task, NULL, 0);
+	
 	/* Tests timer */
 	__TIM3_CLK_ENABLE();
 	
@@ -56,13 +78,11 @@ int main (void) {
 	TIM3->DIER = TIM_DIER_UIE;
 	TIM_resetIRFlag(TIM3);
 	
+	IRQ_setPriority(TIM3_IRQn, IRQ_LEVEL_TIMER, 0);
 	NVIC_EnableIRQ(TIM3_IRQn); // Enable interrupt from TIM3 (NVIC level)
-	NVIC_EnableIRQ(EXTI0_IRQn);
-	EXTI_enableLine(0);
-	EXTI_setFallingEdge(0);
-	EXTI_setRisingEdge(0);
 	
 	__SYSCFG_CLK_ENABLE();
+	EXTI_attach(0, EXTI_EDGE_BOTH, SYSCFG_EXTICR_EXTI_PA, on_button, &button_pressed);
 	EXTI_setLinePin(0, SYSCFG_EXTICR_EXTI_PA);
 	EXTI_setLinePin(1, SYSCFG_EXTICR_EXTI_PB);
 	EXTI_setLinePin(4, SYSCFG_EXTICR_EXTI_PC);
@@ -75,6 +95,6 @@ int main (void) {
 	EXTI_setLinePin(250, SYSCFG_EXTICR_EXTI_PI);
 	EXTI_setLinePin(16, SYSCFG_EXTICR_EXTI_PB);
 
-	while (1);
+	SCHED_run();
 }
 
@@ -0,0 +1,57 @@
+/**
+* @file 		memory.h
+* @brief		Header file of the code and data placement.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the attributes which place hot code in the SRAM
+* and CPU-only data in the core-coupled memory (CCM). The regions are
+* described by the scatter file (current_project/f4discovery.sct).
+*
+*		1. Code in the flash waits for the wait states (5 at 168 MHz) on
+*		each fetch out of the ART caches. MEM_RAMCODE functions run from the
+*		SRAM (region RW_IRAM1) with no wait state: the handler of an
+*		interrupt no longer depends on what the main loop left in the cache.
+*		2. The CCM (64 KB at 0x10000000) is on the D-bus only: no code runs
+*		from it and the DMA can't reach it. MEM_CCM data are read by the CPU
+*		with no wait state and no contention with the DMA on the SRAM: ring
+*		buffers, sample blocks, stacks. Never a DMA buffer, SPI_transferDMA()
+*		and TIM_startCCRStream() refuse them (MEM_IN_CCM).
+*		3. There is no copy loop to write: __main (scatter loading of the C
+*		library) copies the ramcode section from the flash to the SRAM and
+*		clears the ccmram section before main(). Nothing placed may be used
+*		by the boot stage (boot.h), which runs before __main.
+*		4. The CCM clock (RCC AHB1ENR CCMDATARAMEN) is on at reset.
+*		5. Use it as follow:
+*				MEM_RAMCODE void EXTI0_IRQHandler(void)
+*				{
+*					...
+*				}
+*
+*				static int16_t samples[64][3] MEM_CCM;
+*
+*/
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stm32f4xx.h>
+#include <stdint.h>
+
+#define MEM_CCM_SIZE				0x10000												///< 64 KB of core-coupled memory
+
+/* Function run from the SRAM, placed before the declarator */
+#ifndef MEM_RAMCODE
+#define MEM_RAMCODE					__attribute__((section("ramcode")))
+#endif
+
+/* Zero-initialised variable in the CCM, placed after the declarator */
+#ifndef MEM_CCM
+#define MEM_CCM							__attribute__((section("ccmram"), zero_init))
+#endif
+
+/* Address in the CCM, out of reach of the DMA */
+#define MEM_IN_CCM(address)	((uintptr_t) (address) - CCMDATARAM_BASE < MEM_CCM_SIZE)
+
+#endif
@@ -9,7 +9,236 @@
 *	Source file listing the functions required to initialize the different
 * clocks of the system.
 *
-* /!\ So far, only the clocks of the GPIOs are enabled
+*		1. SYSCLK never runs on a PLL being configured: it is switched to
+*		the HSI first, which is always on.
+*		2. The flash wait states are raised before SYSCLK goes up and
+*		lowered once it went down, the voltage scale is written while the
+*		PLL is off (RM0090, 5.4.1).
 */
 
 #include "rcc.h"
+
+#define RCC_PLL_INPUT_HZ		2000000UL							///< VCO input, lowest jitter
+#define RCC_VCO_MIN_HZ			100000000UL
+#define RCC_USB_HZ					48000000UL
+
+static RCC_ClockListener * rcc_listeners;
+
+/*----------------------------------------------------------------------------
+  Clock tree
+ *----------------------------------------------------------------------------*/
+
+/* Smallest PPRE field value keeping HCLK / prescaler <= max (0xx: 1, 1xx: 2 to 16) */
+static u32 RCC_solveAPB(u32 hclk, u32 max)
+{
+	u32 shift = 0;
+	
+	while ((hclk >> shift) > max && shift < 4)
+		shift++;
+	return (shift == 0) ? 0 : 0x4 | (shift - 1);
+}
+
+/* Division of a PPRE field value, as a shift */
+static u32 RCC_getAPBShift(u32 ppre)
+{
+	return (ppre & 0x4) ? (ppre & 0x3) + 1 : 0;
+}
+
+/* SYSCLK switched, once the source is running */
+static void RCC_switch(u32 sw)
+{
+	ATOMIC_MODIFY32(RCC->CFGR, RCC_CFGR_SW, sw);
+	while ((RCC->CFGR & RCC_CFGR_SWS) != (sw << 2));
+}
+
+static void RCC_setLatency(u32 latency)
+{
+	ATOMIC_MODIFY32(FLASH->ACR, FLASH_ACR_LATENCY, latency);
+	while ((FLASH->ACR & FLASH_ACR_LATENCY) != latency);				// Used once read back
+}
+
+bool RCC_solveClocks(u32 sysclk, RCC_ClockConfig * config)
+{
+	u32 vco, p, q;
+	
+	if (sysclk == RCC_HSI_HZ)
+	{
+		config->cfgr = RCC_CFGR_SW_HSI;
+		config->pllcfgr = 0;
+	}
+	else if (sysclk == RCC_HSE_HZ)
+	{
+		config->cfgr = RCC_CFGR_SW_HSE;
+		config->pllcfgr = 0;
+	}
+	else
+	{
+		if (sysclk < RCC_SYSCLK_MIN || sysclk > RCC_SYSCLK_MAX || sysclk % 1000000 != 0)
+			return false;
+		
+		// SYSCLK = HSE / M * N / P, HSE / M = 2 MHz: N = VCO / 2 MHz, whole for any whole MHz
+		for (p = 2; sysclk * p < RCC_VCO_MIN_HZ; p += 2);
+		vco = sysclk * p;
+		q = (vco + RCC_USB_HZ - 1) / RCC_USB_HZ;
+		config->cfgr = RCC_CFGR_SW_PLL;
+		config->pllcfgr = (RCC_HSE_HZ / RCC_PLL_INPUT_HZ) | ((vco / RCC_PLL_INPUT_HZ) << 6)
+										| ((p / 2 - 1) << 16) | RCC_PLLCFGR_PLLSRC_HSE | (q << 24);
+	}
+	config->sysclk = sysclk;
+	config->cfgr |= RCC_CFGR_HPRE_DIV1 | (RCC_solveAPB(sysclk, RCC_PCLK1_MAX) << 10) | (RCC_solveAPB(sysclk, RCC_PCLK2_MAX) << 13);
+	config->latency = (u8) ((sysclk - 1) / RCC_WAIT_STATE_HZ);
+	config->scale1 = (sysclk > RCC_SCALE2_MAX);
+	
+	return true;
+}
+
+bool RCC_applyClocks(const RCC_ClockConfig * config)
+{
+	u32 sw = config->cfgr & RCC_CFGR_SW;
+	u32 latency = FLASH->ACR & FLASH_ACR_LATENCY;
+	u32 polls = 0;
+	
+	// HSE started first: if it fails, nothing has changed
+	if (sw != RCC_CFGR_SW_HSI)
+	{
+		ATOMIC_SET_BIT(RCC->CR, RCC_CR_HSEON);
+		while (!(RCC->CR & RCC_CR_HSERDY))
+		{
+			if (++polls == RCC_HSE_TIMEOUT)
+			{
+				ATOMIC_CLEAR_BIT(RCC->CR, RCC_CR_HSEON);							// Not ready: SYSCLK isn't on it
+				return false;
+			}
+		}
+	}
+	
+	ATOMIC_SET_BIT(RCC->CR, RCC_CR_HSION);
+	while (!(RCC->CR & RCC_CR_HSIRDY));
+	RCC_switch(RCC_CFGR_SW_HSI);
+	ATOMIC_CLEAR_BIT(RCC->CR, RCC_CR_PLLON);
+	while (RCC->CR & RCC_CR_PLLRDY);
+	
+	PWR_CLK_ENABLE();
+	ATOMIC_BIT(PWR->CR, ATOMIC_BIT_NUMBER(PWR_CR_VOS)) = config->scale1 ? 1 : 0;
+	if (config->pllcfgr != 0)
+	{
+		RCC->PLLCFGR = config->pllcfgr;
+		ATOMIC_SET_BIT(RCC->CR, RCC_CR_PLLON);
+		while (!(RCC->CR & RCC_CR_PLLRDY));
+	}
+	
+	if (config->latency > latency)
+		RCC_setLatency(config->latency);
+	ATOMIC_MODIFY32(RCC->CFGR, RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2, config->cfgr & ~RCC_CFGR_SW);
+	RCC_switch(sw);
+	if (config->latency < latency)
+		RCC_setLatency(config->latency);
+	if (sw == RCC_CFGR_SW_HSI)
+		ATOMIC_CLEAR_BIT(RCC->CR, RCC_CR_HSEON);
+	
+	SystemCoreClock = config->sysclk;
+	return true;
+}
+
+bool RCC_setSysclk(u32 sysclk)
+{
+	RCC_ClockConfig config;
+	RCC_ClockListener * listener;
+	
+	if (!RCC_solveClocks(sysclk, &config) || !RCC_applyClocks(&config))
+		return false;
+	for (listener = rcc_listeners; listener != NULL; listener = listener->next)
+		listener->callback(listener->context);
+	
+	return true;
+}
+
+u32 RCC_getHCLK(void)
+{
+	return SystemCoreClock;
+}
+
+u32 RCC_readHCLK(void)
+{
+	u32 cfgr = RCC->CFGR;
+	u32 pllcfgr = RCC->PLLCFGR;
+	u32 hclk, hpre;
+	
+	switch (cfgr & RCC_CFGR_SWS)
+	{
+		case RCC_CFGR_SWS_HSE:
+			hclk = RCC_HSE_HZ;
+			break;
+		case RCC_CFGR_SWS_PLL:
+			hclk = ((pllcfgr & RCC_PLLCFGR_PLLSRC) ? RCC_HSE_HZ : RCC_HSI_HZ) / (pllcfgr & RCC_PLLCFGR_PLLM)
+						* ((pllcfgr & RCC_PLLCFGR_PLLN) >> 6) / ((((pllcfgr & RCC_PLLCFGR_PLLP) >> 16) + 1) * 2);
+			break;
+		default:
+			hclk = RCC_HSI_HZ;
+			break;
+	}
+	
+	// HPRE 0xxx: 1, 1000..1011: 2 to 16, 1100..1111: 64 to 512
+	hpre = (cfgr & RCC_CFGR_HPRE) >> 4;
+	if (hpre & 0x8)
+		hclk >>= (hpre & 0x7) + ((hpre >= 0xC) ? 2 : 1);
+	return hclk;
+}
+
+u32 RCC_getPCLK1(void)
+{
+	return SystemCoreClock >> RCC_getAPBShift((RCC->CFGR & RCC_CFGR_PPRE1) >> 10);
+}
+
+u32 RCC_getPCLK2(void)
+{
+	return SystemCoreClock >> RCC_getAPBShift((RCC->CFGR & RCC_CFGR_PPRE2) >> 13);
+}
+
+u32 RCC_getTIMCLK(RCC_Bus bus)
+{
+	u32 cfgr = RCC->CFGR;
+	u32 shift = (bus == RCC_BUS_APB1) ? RCC_getAPBShift((cfgr & RCC_CFGR_PPRE1) >> 10)
+																		: RCC_getAPBShift((cfgr & RCC_CFGR_PPRE2) >> 13);
+	
+	if (shift == 0)
+		return SystemCoreClock;
+	return (SystemCoreClock >> shift) * 2;
+}
+
+
+/*----------------------------------------------------------------------------
+  Clock listeners
+ *----------------------------------------------------------------------------*/
+
+void RCC_addListener(RCC_ClockListener * listener, RCC_ClockCallback callback, void * context)
+{
+	RCC_ClockListener ** last = &rcc_listeners;
+	
+	for (; *last != NULL; last = &(*last)->next)
+	{
+		if (*last == listener)
+			break;
+	}
+	listener->callback = callback;
+	listener->context = context;
+	if (*last == NULL)
+	{
+		listener->next = NULL;
+		*last = listener;
+	}
+}
+
+void RCC_removeListener(RCC_ClockListener * listener)
+{
+	RCC_ClockListener ** link = &rcc_listeners;
+	
+	for (; *link != NULL; link = &(*link)->next)
+	{
+		if (*link == listener)
+		{
+			*link = listener->next;
+			return;
+		}
+	}
+}
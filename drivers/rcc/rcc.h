@@ -9,38 +9,196 @@
 *	Header file listing the functions required to initialize the different
 * clocks of the system.
 *
-* /!\ So far, only the clocks of the GPIOs are enabled
+*		1. The peripheral clocks are enabled with the *_CLK_ENABLE() macros.
+*		2. RCC_setSysclk() runs SYSCLK at a requested frequency: the HSI
+*		(16 MHz) or the HSE (8 MHz crystal of the Discovery, HSE_VALUE must
+*		be 8000000 in the project defines) directly, the PLL from the HSE
+*		otherwise (whole MHz, RCC_SYSCLK_MIN..RCC_SYSCLK_MAX). HCLK is
+*		SYSCLK, the APB prescalers are the smallest ones within the APB
+*		limits, the flash wait states and the voltage scale follow HCLK.
+*		3. RCC_getHCLK(), RCC_getPCLK1(), RCC_getPCLK2() and RCC_getTIMCLK()
+*		compute the bus clocks from SystemCoreClock and the prescalers of
+*		CFGR: the drivers compute their dividers from them, never from a
+*		fixed frequency.
+*		4. The drivers depending on a bus clock (SPI1 baud rate, timer wheel,
+*		kernel tick) add a listener, called once the new clocks run. Call
+*		RCC_setSysclk() with the buses idle (no SPI transfer in flight).
+*		5. Use it as follow (low clock while idle, 168 MHz for the bursts):
+*				RCC_setSysclk(RCC_HSE_HZ);
+*				...
+*				RCC_setSysclk(RCC_SYSCLK_MAX);
 */
 
 #ifndef RCC_H
 #define RCC_H
 
+#include <stdbool.h>
+#include "atomic.h"
+
+#define RCC_HSI_HZ					16000000UL						///< Internal RC oscillator
+#define RCC_HSE_HZ					HSE_VALUE							///< Crystal, 8 MHz on the Discovery
+#define RCC_SYSCLK_MIN			13000000UL						///< Lowest PLL output (VCO >= 100 MHz, P = 8)
+#define RCC_SYSCLK_MAX			168000000UL
+#define RCC_PCLK1_MAX				42000000UL						///< APB1 limit
+#define RCC_PCLK2_MAX				84000000UL						///< APB2 limit
+#define RCC_WAIT_STATE_HZ		30000000UL						///< HCLK per flash wait state (2.7 V - 3.6 V)
+#define RCC_SCALE2_MAX			144000000UL						///< Max HCLK in voltage scale 2
+#define RCC_HSE_TIMEOUT			0x10000								///< Polls of HSERDY before giving up
+
 /* Clock enable for GPIOx */
-#define GPIOA_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOAEN)
-#define GPIOB_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOBEN)
-#define GPIOC_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOCEN)
-#define GPIOD_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIODEN)
-#define GPIOE_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOEEN)
-#define GPIOF_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOFEN)
-#define GPIOG_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOGEN)
-#define GPIOH_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOHEN)
-#define GPIOI_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOIEN)
-#define GPIOJ_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOJEN)
-#define GPIOK_CLK_ENABLE() 			(RCC->AHB1ENR  |= RCC_AHB1ENR_GPIOKEN)
+#define GPIOA_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOAEN)
+#define GPIOB_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOBEN)
+#define GPIOC_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOCEN)
+#define GPIOD_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIODEN)
+#define GPIOE_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOEEN)
+#define GPIOF_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOFEN)
+#define GPIOG_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOGEN)
+#define GPIOH_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOHEN)
+#define GPIOI_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOIEN)
+#define GPIOJ_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOJEN)
+#define GPIOK_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_GPIOKEN)
+
+/* Clock enable for DMAx */
+#define DMA1_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_DMA1EN)
+#define DMA2_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->AHB1ENR, RCC_AHB1ENR_DMA2EN)
 
 /* Clock enable for TIMx */
-#define TIM2_CLK_ENABLE()				(RCC->APB1ENR |= RCC_APB1ENR_TIM2EN)
-#define TIM3_CLK_ENABLE()				(RCC->APB1ENR |= RCC_APB1ENR_TIM3EN)
-#define TIM4_CLK_ENABLE()				(RCC->APB1ENR |= RCC_APB1ENR_TIM4EN)
-#define TIM5_CLK_ENABLE()				(RCC->APB1ENR |= RCC_APB1ENR_TIM5EN)
-#define TIM6_CLK_ENABLE()				(RCC->APB1ENR |= RCC_APB1ENR_TIM6EN)
-#define TIM7_CLK_ENABLE()				(RCC->APB1ENR |= RCC_APB1ENR_TIM7EN)
+#define TIM2_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM2EN)
+#define TIM3_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM3EN)
+#define TIM4_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM4EN)
+#define TIM5_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM5EN)
+#define TIM6_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM6EN)
+#define TIM7_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM7EN)
 
 /* Clock enable for SPI1 */
-#define SPI1_CLK_ENABLE() 			(RCC->APB2ENR |= RCC_APB2ENR_SPI1EN)
+#define SPI1_CLK_ENABLE() 			ATOMIC_SET_BIT(RCC->APB2ENR, RCC_APB2ENR_SPI1EN)
+
+/* Clock enable for PWR - Power controller */
+#define PWR_CLK_ENABLE()				ATOMIC_SET_BIT(RCC->APB1ENR, RCC_APB1ENR_PWREN)
 
 /* Clock enable for SYSCFG - System Configuration */
-#define SYSCFG_CLK_ENABLE()			(RCC->APB2ENR |= 0x00004000)
+#define SYSCFG_CLK_ENABLE()			ATOMIC_SET_BIT(RCC->APB2ENR, RCC_APB2ENR_SYSCFGEN)
+
+
+/* APB bus of a peripheral */
+typedef enum
+{
+	RCC_BUS_APB1 = 0,
+	RCC_BUS_APB2
+}RCC_Bus;
+
+/* Register values of a clock configuration (see RCC_solveClocks) */
+typedef struct
+{
+	u32 sysclk;														///< Hz
+	u32 cfgr;															///< SW, HPRE, PPRE1 and PPRE2 fields of CFGR
+	u32 pllcfgr;													///< PLLCFGR, 0 when the PLL is off
+	u8 latency;														///< Flash wait states
+	bool scale1;													///< Voltage scale 1 (HCLK above RCC_SCALE2_MAX)
+}RCC_ClockConfig;
+
+/* Function called after a clock change */
+typedef void (*RCC_ClockCallback)(void * context);
+
+/* Listener of the clock changes, owned by the driver */
+typedef struct RCC_ClockListener
+{
+	RCC_ClockCallback callback;
+	void * context;
+	struct RCC_ClockListener * next;
+}RCC_ClockListener;
+
+
+/*----------------------------------------------------------------------------
+  Clock tree
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Clock configuration of a SYSCLK frequency.
+ * This function computes the register values without writing them.
+ * @param[in]	sysclk Requested SYSCLK in Hz (RCC_HSI_HZ, RCC_HSE_HZ or a
+ * whole number of MHz in RCC_SYSCLK_MIN..RCC_SYSCLK_MAX).
+ * @param[out]	config Register values.
+ * @retval bool false if sysclk can't be generated exactly.
+ * @par PLL input at 2 MHz (lowest jitter), smallest P with a VCO of at
+ * least 100 MHz, Q for the closest USB clock at most 48 MHz.
+ */
+bool RCC_solveClocks(u32 sysclk, RCC_ClockConfig * config);
+
+/**
+ * Clock configuration applied.
+ * The function runs SYSCLK on the HSI while the PLL is configured, raises
+ * the flash wait states before the switch and lowers them after, and
+ * stops the oscillators not used anymore. SystemCoreClock is updated, the
+ * listeners are not called (see RCC_setSysclk).
+ * @param[in]	config Register values (see RCC_solveClocks).
+ * @retval bool false if the HSE didn't start, the clocks are unchanged.
+ */
+bool RCC_applyClocks(const RCC_ClockConfig * config);
+
+/**
+ * SYSCLK frequency set.
+ * The function solves and applies the configuration of sysclk, then calls
+ * the clock listeners in the order they were added.
+ * @param[in]	sysclk Requested SYSCLK in Hz (see RCC_solveClocks).
+ * @retval bool false if sysclk can't be generated or the HSE didn't
+ * start, nothing is changed.
+ */
+bool RCC_setSysclk(u32 sysclk);
+
+/**
+ * AHB clock frequency.
+ * @retval u32 HCLK in Hz (SystemCoreClock).
+ */
+u32 RCC_getHCLK(void);
+
+/**
+ * AHB clock frequency from the registers.
+ * This function decodes SWS, PLLCFGR and HPRE without SystemCoreClock:
+ * it may run before the C library initialisation (boot stage).
+ * @retval u32 HCLK in Hz.
+ */
+u32 RCC_readHCLK(void);
+
+/**
+ * APB1 clock frequency.
+ * This function divides HCLK by the PPRE1 prescaler of the RCC CFGR register.
+ * @retval u32 PCLK1 in Hz.
+ */
+u32 RCC_getPCLK1(void);
+
+/**
+ * APB2 clock frequency.
+ * This function divides HCLK by the PPRE2 prescaler of the RCC CFGR register.
+ * @retval u32 PCLK2 in Hz.
+ */
+u32 RCC_getPCLK2(void);
+
+/**
+ * Timer clock frequency of an APB bus.
+ * @param[in]	bus RCC_BUS_APB1 (TIM2-TIM7, TIM12-TIM14) or RCC_BUS_APB2 (TIM1, TIM8-TIM11).
+ * @retval u32 PCLK of the bus, x2 when its prescaler is not 1.
+ */
+u32 RCC_getTIMCLK(RCC_Bus bus);
+
 
+/*----------------------------------------------------------------------------
+  Clock listeners
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Clock listener added.
+ * @param[out]	listener Listener, owned by the caller until removed.
+ * @param[in]	callback Function called after each clock change.
+ * @param[in]	context Passed to the callback.
+ * @par A listener already added is not added twice.
+ */
+void RCC_addListener(RCC_ClockListener * listener, RCC_ClockCallback callback, void * context);
+
+/**
+ * Clock listener removed.
+ * @param[in]	listener Listener added by RCC_addListener, or never added.
+ */
+void RCC_removeListener(RCC_ClockListener * listener);
 
 #endif
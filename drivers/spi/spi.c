@@ -1,139 +1,177 @@
 #include "spi.h"
+#include "interrupt.h"
+#include "atomic.h"
+#include "rcc.h"
+#include "memory.h"
 
 void SPI_initUnidirectionalData2LineUni(SPI_TypeDef * SPI) 
 {
-	SPI->CR1 &= ~SPI_CR1_BIDIMODE;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_BIDIMODE);
 }
 
 void SPI_initBidirectionalData2LineUni(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_BIDIMODE;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_BIDIMODE);
 }
 
 // Receive-only mode
 void SPI_initBidirectionalOutputDisabled(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_BIDIOE;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_BIDIOE);
 }	
 
 void SPI_initBidirectionalOutputEnabled(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_BIDIOE;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_BIDIOE);
 }
 
 void SPI_initUnidirectionalFullDuplex(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_RXONLY;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_RXONLY);
 }
 
 void SPI_initUnidirectionalOutputDisabled(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_RXONLY;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_RXONLY);
 }
 
 void SPI_initHardwareCRCDisabled(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_CRCEN;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_CRCEN);
 }
 	
 void SPI_initHardwareCRCEnabled(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_CRCEN;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_CRCEN);
 }
 
 void SPI_initCRCDataPhase(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_CRCNEXT;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_CRCNEXT);
 }
 
 void SPI_initCRCTransferNext(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_CRCNEXT;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_CRCNEXT);
 }
 
 void SPI_initDataFrameFormat8b(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_DFF;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_DFF);
 }
 
 void SPI_initDataFrameFormat16b(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_DFF;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_DFF);
 }
 
 void SPI_initSoftwareSlaveMgmtDisabled(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_SSM;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_SSM);
 }
 
 void SPI_initSoftwareSlaveMgmtEnabled(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_SSM;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_SSM);
 }	
 
 void SPI_initSetInternalSlaveSelectLow(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_SSI;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_SSI);
 }
 
 void SPI_initSetInternalSlaveSelectHigh(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_SSI;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_SSI);
 }
 
 void SPI_initFrameFormatMSBFirst(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_LSBFIRST;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_LSBFIRST);
 }
 
 void SPI_initFrameFormatLSBFirst(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_LSBFIRST;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_LSBFIRST);
 }
 
 void SPI_initBaudRate(SPI_TypeDef * SPI, uint8_t SPI_BaudRatePrescaler)
 {
-	SPI->CR1 &= ~SPI_CR1_BR;
-	SPI->CR1 |= (SPI_BaudRatePrescaler << 3);
+	ATOMIC_MODIFY16(SPI->CR1, SPI_CR1_BR, (SPI_BaudRatePrescaler << 3) & SPI_CR1_BR);
+}
+
+/* SPI1 baud rate limit, set again by the clock listener */
+static u32 spi1_max_hz;
+static RCC_ClockListener spi1_clock;
+
+static u32 SPI_getClock(SPI_TypeDef * SPI)
+{
+	return (SPI == SPI1) ? RCC_getPCLK2() : RCC_getPCLK1();					// SPI2 and SPI3 on APB1
+}
+
+static void SPI_onClockChange(void * context)
+{
+	SPI_setBaudRate((SPI_TypeDef *) context, spi1_max_hz);
+}
+
+u32 SPI_setBaudRate(SPI_TypeDef * SPI, u32 max_hz)
+{
+	u32 pclk = SPI_getClock(SPI);
+	uint8_t prescaler = SPI_BaudRatePrescaler_2;
+	
+	while ((pclk >> (prescaler + 1)) > max_hz && prescaler < SPI_BaudRatePrescaler_256)
+		prescaler++;
+	SPI_initBaudRate(SPI, prescaler);
+	if (SPI == SPI1)
+	{
+		spi1_max_hz = max_hz;
+		RCC_addListener(&spi1_clock, SPI_onClockChange, SPI);
+	}
+	return pclk >> (prescaler + 1);
+}
+
+u32 SPI_getBaudRate(SPI_TypeDef * SPI)
+{
+	return SPI_getClock(SPI) >> (((SPI->CR1 & SPI_CR1_BR) >> 3) + 1);
 }
 
 void SPI_initSlaveConfiguration(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_MSTR;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_MSTR);
 }
 
 void SPI_initMasterConfiguration(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_MSTR;	
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_MSTR);
 }
 
 void SPI_initClockPolarityIdleLow(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_CPOL;	
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_CPOL);
 }
 
 void SPI_initClockPolarityIdleHigh(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_CPOL;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_CPOL);
 }
 
 void SPI_initClockPhaseEdgeOne(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_CPHA;	
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_CPHA);
 }
 void SPI_initClockPhaseEdgeTwo(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_CPHA;	
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_CPHA);
 }
 
 void SPI_disable(SPI_TypeDef * SPI)
 {
-	SPI->CR1 &= ~SPI_CR1_SPE;
+	ATOMIC_CLEAR_BIT(SPI->CR1, SPI_CR1_SPE);
 }
 
 void SPI_enable(SPI_TypeDef * SPI)
 {
-	SPI->CR1 |= SPI_CR1_SPE;
+	ATOMIC_SET_BIT(SPI->CR1, SPI_CR1_SPE);
 }
 
 uint16_t SPI_readData(SPI_TypeDef * SPI)
@@ -146,6 +184,54 @@ void SPI_writeData(SPI_TypeDef * SPI, uint16_t data)
 	SPI->DR = data;
 }
 
+/* OVR cleared by a read of DR, then of SR, once the frames in flight ended */
+MEM_RAMCODE static void SPI_clearOverrun(SPI_TypeDef * SPI)
+{
+	uint16_t status;
+	
+	while (SPI->SR & SPI_SR_BSY);
+	SPI_readData(SPI);
+	status = SPI->SR;
+	(void) status;
+}
+
+MEM_RAMCODE bool SPI_transferBuffer(SPI_TypeDef * SPI, const uint8_t * tx, uint8_t * rx, uint16_t length)
+{
+	uint16_t tx_index = 0;
+	uint16_t rx_index = 0;
+	
+	if (SPI_hasDataToReceive(SPI))										// Stale byte would be taken as the first one
+		SPI_readData(SPI);
+	
+	while (rx_index < length)
+	{
+		uint16_t status = SPI->SR;
+		
+		// A frame lost would never be received: the transfer is dropped
+		if (status & SPI_SR_OVR)
+		{
+			SPI_clearOverrun(SPI);
+			return false;
+		}
+		
+		// At most 2 frames in flight: one in the shift register, one in the Tx buffer,
+		// an interrupt longer than one frame between two polls overruns
+		if ((status & SPI_SR_TXE) && tx_index < length && (tx_index - rx_index) < 2)
+		{
+			SPI->DR = (tx != NULL) ? tx[tx_index] : 0x00;
+			tx_index++;
+		}
+		if (status & SPI_SR_RXNE)
+		{
+			uint8_t data = (uint8_t) SPI->DR;
+			if (rx != NULL)
+				rx[rx_index] = data;
+			rx_index++;
+		}
+	}
+	return true;
+}
+
 bool SPI_hasDataToReceive(SPI_TypeDef * SPI)
 {
 	if ((SPI->SR & SPI_SR_RXNE) == 0x0)
@@ -170,3 +256,232 @@ bool SPI_isBusy(SPI_TypeDef * SPI)
 		return true;
 }
 
+/*----------------------------------------------------------------------------
+  SPI DMA transfers (SPI_CR2 TXDMAEN/RXDMAEN)
+ *----------------------------------------------------------------------------*/
+
+/* All the interrupt flags of the Rx (0) and Tx (3) streams */
+#define SPI1_DMA_FLAGS		(DMA_LIFCR_CFEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTCIF0 \
+												| DMA_LIFCR_CFEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CTEIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTCIF3)
+
+#define SPI1_DMA_CR				((uint32_t) SPI1_DMA_CHANNEL << 25 | DMA_SxCR_PL_1)
+
+static volatile bool spi1_dma_busy = false;
+static SPI_Callback spi1_dma_callback;
+static void * spi1_dma_context;
+static const uint8_t spi1_dma_tx_dummy = 0x00;
+static uint8_t spi1_dma_rx_dummy;
+
+void SPI_initDMA(SPI_TypeDef * SPI)
+{
+	if (SPI == SPI1)
+	{
+		IRQ_setPriority(SPI1_DMA_RX_IRQn, IRQ_LEVEL_DRIVER, 0);
+		NVIC_EnableIRQ(SPI1_DMA_RX_IRQn);
+	}
+}
+
+bool SPI_transferDMA(SPI_TypeDef * SPI, const uint8_t * tx, uint8_t * rx, uint16_t length, SPI_Callback callback, void * context)
+{
+	uint32_t primask;
+	bool idle;
+	
+	if (SPI != SPI1 || length == 0)
+		return false;
+	if (MEM_IN_CCM(tx) || MEM_IN_CCM(rx))								// Out of reach of the DMA
+		return false;
+	
+	// Bus taken as SPI_submit does, no queued transaction started in between
+	primask = __get_PRIMASK();
+	__disable_irq();
+	idle = !spi1_dma_busy && !SPI_isQueueBusy(SPI);
+	if (idle)
+		spi1_dma_busy = true;
+	__set_PRIMASK(primask);
+	if (!idle)
+		return false;
+	
+	spi1_dma_callback = callback;
+	spi1_dma_context = context;
+	
+	if (SPI_hasDataToReceive(SPI))										// Stale byte would be taken as the first one
+		SPI_readData(SPI);
+	
+	DMA2->LIFCR = SPI1_DMA_FLAGS;
+	
+	// Rx first, so that no received byte is missed once Tx starts
+	SPI1_DMA_RX_STREAM->PAR = (uintptr_t) &SPI->DR;
+	SPI1_DMA_RX_STREAM->M0AR = (uintptr_t) (rx != NULL ? rx : &spi1_dma_rx_dummy);
+	SPI1_DMA_RX_STREAM->NDTR = length;
+	SPI1_DMA_RX_STREAM->CR = SPI1_DMA_CR | (rx != NULL ? DMA_SxCR_MINC : 0) | DMA_SxCR_TCIE | DMA_SxCR_EN;
+	
+	SPI1_DMA_TX_STREAM->PAR = (uintptr_t) &SPI->DR;
+	SPI1_DMA_TX_STREAM->M0AR = (uintptr_t) (tx != NULL ? tx : &spi1_dma_tx_dummy);
+	SPI1_DMA_TX_STREAM->NDTR = length;
+	SPI1_DMA_TX_STREAM->CR = SPI1_DMA_CR | (tx != NULL ? DMA_SxCR_MINC : 0) | DMA_SxCR_DIR_0 | DMA_SxCR_EN;
+	
+	ATOMIC_MODIFY16(SPI->CR2, 0, SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+	
+	return true;
+}
+
+bool SPI_isDMABusy(SPI_TypeDef * SPI)
+{
+	if (SPI == SPI1)
+		return spi1_dma_busy;
+	else
+		return false;
+}
+
+/* Rx stream completes last: every byte has been shifted at this point */
+MEM_RAMCODE void DMA2_Stream0_IRQHandler(void)
+{
+	SPI_Callback callback = spi1_dma_callback;
+	
+	if (DMA2->LISR & DMA_LISR_TCIF0)
+	{
+		DMA2->LIFCR = SPI1_DMA_FLAGS;
+		ATOMIC_MODIFY16(SPI1->CR2, SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN, 0);
+		spi1_dma_busy = false;
+		
+		if (callback != NULL)
+			callback(spi1_dma_context);
+	}
+}
+
+
+/*----------------------------------------------------------------------------
+  SPI transaction queue (SPI_CR2 TXEIE/RXNEIE)
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	SPI_Transaction slots[SPI_QUEUE_SIZE];
+	volatile uint8_t head;													// Transaction on the bus
+	volatile uint8_t count;
+	uint16_t tx_index;
+	uint16_t rx_index;
+} SPI_Queue;
+
+static SPI_Queue spi1_queue;
+
+MEM_RAMCODE static void SPI_startTransaction(SPI_TypeDef * SPI, SPI_Queue * queue)
+{
+	const SPI_Transaction * transaction = &queue->slots[queue->head];
+	
+	queue->tx_index = 0;
+	queue->rx_index = 0;
+	
+	if (SPI_hasDataToReceive(SPI))										// Stale byte would be taken as the first one
+		SPI_readData(SPI);
+	if (transaction->cs_port != NULL)
+		GPIO_resetPin(transaction->cs_port, transaction->cs_pin);
+	
+	ATOMIC_MODIFY16(SPI->CR2, 0, SPI_CR2_TXEIE | SPI_CR2_RXNEIE | SPI_CR2_ERRIE);
+}
+
+void SPI_initQueue(SPI_TypeDef * SPI)
+{
+	if (SPI == SPI1)
+	{
+		spi1_queue.head = 0;
+		spi1_queue.count = 0;
+		IRQ_setPriority(SPI1_IRQn, IRQ_LEVEL_DRIVER, 0);
+		NVIC_EnableIRQ(SPI1_IRQn);
+	}
+}
+
+bool SPI_submit(SPI_TypeDef * SPI, const SPI_Transaction * transaction)
+{
+	bool queued = false;
+	uint32_t primask;
+	
+	if (SPI != SPI1 || transaction->length == 0)
+		return false;
+	
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (spi1_queue.count < SPI_QUEUE_SIZE && !spi1_dma_busy)
+	{
+		spi1_queue.slots[(spi1_queue.head + spi1_queue.count) % SPI_QUEUE_SIZE] = *transaction;
+		spi1_queue.count++;
+		if (spi1_queue.count == 1)
+			SPI_startTransaction(SPI, &spi1_queue);
+		queued = true;
+	}
+	__set_PRIMASK(primask);
+	
+	return queued;
+}
+
+bool SPI_isQueueBusy(SPI_TypeDef * SPI)
+{
+	if (SPI == SPI1)
+		return (spi1_queue.count != 0);
+	else
+		return false;
+}
+
+/* CS raised, next transaction started, then the callback of this one */
+MEM_RAMCODE static void SPI_endTransaction(SPI_TypeDef * SPI, SPI_Queue * queue, SPI_Status status)
+{
+	const SPI_Transaction * transaction = &queue->slots[queue->head];
+	SPI_Callback callback = transaction->callback;
+	void * context = transaction->context;
+	
+	if (transaction->cs_port != NULL)
+		GPIO_setPin(transaction->cs_port, transaction->cs_pin);
+	if (transaction->status != NULL)
+		*transaction->status = status;
+	queue->head = (queue->head + 1) % SPI_QUEUE_SIZE;
+	queue->count--;
+	
+	if (queue->count != 0)
+		SPI_startTransaction(SPI, queue);
+	else
+		ATOMIC_MODIFY16(SPI->CR2, SPI_CR2_TXEIE | SPI_CR2_RXNEIE | SPI_CR2_ERRIE, 0);
+	
+	if (callback != NULL)
+		callback(context);
+}
+
+/* Rx is served first: the Tx buffer is refilled as soon as it empties, so the
+   next frame is already loaded when the current one is read back. Late by more
+   than a frame, a frame is lost (OVR) and the transaction would never end */
+MEM_RAMCODE void SPI1_IRQHandler(void)
+{
+	SPI_Queue * queue = &spi1_queue;
+	const SPI_Transaction * transaction = &queue->slots[queue->head];
+	uint16_t status = SPI1->SR;
+	
+	if (status & SPI_SR_OVR)
+	{
+		SPI_clearOverrun(SPI1);
+		SPI_endTransaction(SPI1, queue, SPI_OVERRUN);
+		return;
+	}
+	
+	if (status & SPI_SR_RXNE)
+	{
+		uint8_t data = (uint8_t) SPI1->DR;
+		
+		if (transaction->rx != NULL)
+			transaction->rx[queue->rx_index] = data;
+		queue->rx_index++;
+		
+		if (queue->rx_index == transaction->length)
+		{
+			SPI_endTransaction(SPI1, queue, SPI_DONE);
+			return;
+		}
+	}
+	
+	if ((status & SPI_SR_TXE) && queue->tx_index < transaction->length)
+	{
+		SPI1->DR = (transaction->tx != NULL) ? transaction->tx[queue->tx_index] : 0x00;
+		queue->tx_index++;
+		if (queue->tx_index == transaction->length)
+			ATOMIC_CLEAR_BIT(SPI1->CR2, SPI_CR2_TXEIE);
+	}
+}
+
@@ -9,8 +9,9 @@
 * read the Tx, Rx and isBusy status and read and write data in the
 * data registers.
 *
-*		1. The I2S mode, the CRC, the interrupts and the DMA functions 
-*		are not supported.
+*		1. The I2S mode and the CRC are not supported. DMA transfers and
+*		queued transactions are only supported on SPI1 and must not be
+*		mixed while one of them is on-going.
 *		2. Use the function defined in the RCC drivers to set the SPI 
 *		clocks.
 *				ex: SPI1_CLK_ENABLE();
@@ -19,7 +20,7 @@
 *				// Init GPIO corresponding to SPI lines (clock gpio, init gpio)
 *				// Set desired GPIO to Alternate Functions
 *				SPI_initUnidirectionalData2LineUni(MEMS_SPI); 							
-*				SPI_initBaudRate(MEMS_SPI, SPI_BaudRatePrescaler_2);
+*				SPI_setBaudRate(MEMS_SPI, MEMS_SPI_MAX_HZ);
 *				SPI_initClockPolarityIdleHigh(MEMS_SPI);
 *				SPI_initClockPhaseEdgeTwo(MEMS_SPI);
 *				SPI_initDataFrameFormat8b(MEMS_SPI);
@@ -28,6 +29,26 @@
 *				SPI_initSetInternalSlaveSelectHigh(MEMS_SPI);
 *				SPI_initMasterConfiguration(MEMS_SPI);
 *				SPI_enable(MEMS_SPI);
+*		4. DMA transfers need the DMA2 clock and the DMA interrupt:
+*				DMA2_CLK_ENABLE();
+*				SPI_initDMA(MEMS_SPI);
+*				SPI_transferDMA(MEMS_SPI, tx, rx, 7, callback, context);
+*		The callback is called from DMA2_Stream0_IRQHandler (defined in
+*		spi.c) once the last byte has been received. The chip select is
+*		left to the caller.
+*		5. Queued transactions are driven by SPI1_IRQHandler (defined in
+*		spi.c), SPI_submit() returns as soon as the transaction is queued:
+*				SPI_initQueue(MEMS_SPI);
+*				SPI_Transaction t = { MEMS_GPIO_CS, MEMS_PIN_CS, tx, rx, 7, callback, context };
+*				SPI_submit(MEMS_SPI, &t);
+*		The chip select is driven low before the first byte and high after
+*		the last one, then the callback is called and the next transaction
+*		starts from the same interrupt. There is one interrupt per byte, so
+*		the CPU is only freed at prescalers where a frame lasts longer than
+*		the interrupt (/16 and slower); use DMA transfers below. A
+*		transaction whose interrupt came more than a frame late overruns
+*		(ERRIE): it is dropped, CS raised, its status set to SPI_OVERRUN,
+*		and the next one starts.
 */
 
 #ifndef SPI_H
@@ -35,6 +56,8 @@
 
 #include <stm32f4xx.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "gpio.h"
 
 /* Define the different values of SPI Baud Rate Prescaler */
 #define SPI_BaudRatePrescaler_2         ((uint8_t)0x00)
@@ -46,6 +69,37 @@
 #define SPI_BaudRatePrescaler_128       ((uint8_t)0x06)
 #define SPI_BaudRatePrescaler_256       ((uint8_t)0x07)
 
+/* DMA streams serving SPI1 (RM0090 table 43, channel 3) */
+#define SPI1_DMA_RX_STREAM							DMA2_Stream0
+#define SPI1_DMA_TX_STREAM							DMA2_Stream3
+#define SPI1_DMA_CHANNEL								3
+#define SPI1_DMA_RX_IRQn								DMA2_Stream0_IRQn
+
+#define SPI_QUEUE_SIZE									8					///< Number max of queued transactions
+
+/* Function called at the end of a non-blocking transfer */
+typedef void (*SPI_Callback)(void * context);
+
+/* End of a queued transaction */
+typedef enum
+{
+	SPI_DONE = 0,									///< Every byte transferred
+	SPI_OVERRUN										///< Frame lost, transaction dropped
+}SPI_Status;
+
+/* Transaction of the interrupt-driven queue */
+typedef struct
+{
+	GPIO_TypeDef * cs_port;				///< GPIO of the chip select, NULL if none
+	uint8_t cs_pin;								///< Pin of the chip select (active low)
+	const uint8_t * tx;						///< Bytes to send, NULL to send 0x00
+	uint8_t * rx;									///< Buffer receiving the bytes, NULL to drop them
+	uint16_t length;							///< Number of bytes to transfer
+	SPI_Callback callback;				///< Called from the SPI interrupt at the end (may be NULL)
+	void * context;								///< Argument given to the callback
+	volatile SPI_Status * status;	///< Written before the callback is called (may be NULL)
+}SPI_Transaction;
+
 /*----------------------------------------------------------------------------
   SPI control register 1 (SPI_CR1)
  *----------------------------------------------------------------------------*/
@@ -200,6 +254,25 @@ void SPI_initFrameFormatLSBFirst(SPI_TypeDef * SPI);
  */
 void SPI_initBaudRate(SPI_TypeDef * SPI, uint8_t SPI_BaudRatePrescaler); 
 
+/**
+ * SPI baud rate set from a maximum frequency.
+ * This function sets the smallest prescaler whose baud rate, computed from
+ * the APB clock of the SPI (see RCC_getPCLK2), is at most max_hz.
+ * @param[in]	SPI SPI to initialize.
+ * @param[in]	max_hz Highest SCK frequency of the slave in Hz.
+ * @retval u32 Baud rate set in Hz, above max_hz only if the /256 prescaler is.
+ * @par The SPI must be idle. SPI1 keeps max_hz: its prescaler is set
+ * again after each clock change (see RCC_setSysclk).
+ */
+u32 SPI_setBaudRate(SPI_TypeDef * SPI, u32 max_hz);
+
+/**
+ * SPI baud rate.
+ * @param[in]	SPI SPI.
+ * @retval u32 SCK frequency in Hz, from the APB clock and the BR[2:0] bits.
+ */
+u32 SPI_getBaudRate(SPI_TypeDef * SPI);
+
 /**
  * SPI set as master.
  * This function resets the MSTR bit of the SPI CR1 register (0b0).
@@ -295,4 +368,94 @@ uint16_t SPI_readData(SPI_TypeDef * SPI);
  */
 void SPI_writeData(SPI_TypeDef * SPI, uint16_t data);
 
+/**
+ * Full-duplex transfer of a buffer (polling).
+ * This function keeps the Tx register loaded one frame ahead of the Rx register
+ * so that the frames are shifted back-to-back, and returns once the last byte
+ * has been received.
+ * @param[in]	SPI SPI to use (8-bit data frame format).
+ * @param[in]	tx Bytes to send, or NULL to send 0x00.
+ * @param[out]	rx Buffer receiving the bytes, or NULL to drop them.
+ * @param[in]	length Number of bytes to transfer.
+ * @retval bool false if the SPI overran, the transfer is then stopped.
+ * @par An interrupt lasting more than one frame during the transfer makes the
+ * SPI overrun, a received frame is lost: the function clears OVR and
+ * returns false once the frames in flight ended. Mask the interrupts or
+ * use a slower baud rate to avoid it.
+ */
+bool SPI_transferBuffer(SPI_TypeDef * SPI, const uint8_t * tx, uint8_t * rx, uint16_t length);
+
+
+/*----------------------------------------------------------------------------
+  SPI DMA transfers (SPI_CR2 TXDMAEN/RXDMAEN)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * SPI DMA initialized.
+ * This function enables the interrupt of the DMA stream receiving the SPI data.
+ * @param[in]	SPI SPI to initialize (only SPI1 is supported).
+ * @par The DMA2 clock must have been enabled beforehand (DMA2_CLK_ENABLE()).
+ */
+void SPI_initDMA(SPI_TypeDef * SPI);
+
+/**
+ * Full-duplex transfer by DMA.
+ * This function programs the Rx and Tx DMA streams of the SPI and returns
+ * immediately. The callback is called from the DMA interrupt once the last
+ * byte has been received.
+ * @param[in]	SPI SPI to use (only SPI1 is supported).
+ * @param[in]	tx Bytes to send, or NULL to send 0x00.
+ * @param[out]	rx Buffer receiving the bytes, or NULL to drop them.
+ * @param[in]	length Number of bytes to transfer (1..65535).
+ * @param[in]	callback Function called at the end of the transfer (may be NULL).
+ * @param[in]	context Argument given to the callback.
+ * @retval true Transfer started.
+ * @retval false SPI not supported, empty transfer, a transfer is on-going
+ * or a buffer is in the CCM (memory.h).
+ * @par tx and rx must stay valid until the callback is called.
+ */
+bool SPI_transferDMA(SPI_TypeDef * SPI, const uint8_t * tx, uint8_t * rx, uint16_t length, SPI_Callback callback, void * context);
+
+/**
+ * SPI DMA transfer on-going.
+ * @param[in]	SPI SPI to read.
+ * @retval true A DMA transfer is on-going.
+ * @retval false The SPI is free for a new DMA transfer.
+ */
+bool SPI_isDMABusy(SPI_TypeDef * SPI);
+
+
+/*----------------------------------------------------------------------------
+  SPI transaction queue (SPI_CR2 TXEIE/RXNEIE)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * SPI transaction queue initialized.
+ * This function empties the queue and enables the SPI interrupt.
+ * @param[in]	SPI SPI to initialize (only SPI1 is supported).
+ */
+void SPI_initQueue(SPI_TypeDef * SPI);
+
+/**
+ * Transaction submitted.
+ * This function copies the transaction in the queue and returns immediately.
+ * The transaction starts at once if the queue was empty, otherwise right after
+ * the previous one, from the SPI interrupt.
+ * @param[in]	SPI SPI to use (only SPI1 is supported).
+ * @param[in]	transaction Transaction to queue.
+ * @retval true Transaction queued.
+ * @retval false SPI not supported, empty transaction, queue full or DMA transfer on-going.
+ * @par The tx and rx buffers must stay valid until the callback is called.
+ * This function can be called from a transaction callback.
+ */
+bool SPI_submit(SPI_TypeDef * SPI, const SPI_Transaction * transaction);
+
+/**
+ * SPI queue has transactions.
+ * @param[in]	SPI SPI to read.
+ * @retval true A transaction is on-going or queued.
+ * @retval false The queue is empty.
+ */
+bool SPI_isQueueBusy(SPI_TypeDef * SPI);
+
 #endif
@@ -0,0 +1,91 @@
+/**
+* @file 		stack.c
+* @brief		Source file of the stack usage instrumentation.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions required to paint the stacks, find
+* their peak use and guard the main stack with the MPU.
+*
+*/
+
+#include "stack.h"
+
+/* Main stack of the startup file */
+#ifndef STACK_MAIN_BASE
+extern uint32_t Stack_Mem[];
+extern uint32_t __initial_sp[];
+#define STACK_MAIN_BASE			Stack_Mem
+#define STACK_MAIN_TOP			__initial_sp
+#endif
+
+#define STACK_GUARD_RASR		(MPU_RASR_XN_Msk | (0x0UL << MPU_RASR_AP_Pos) | (4UL << MPU_RASR_SIZE_Pos) | MPU_RASR_ENABLE_Msk)	///< No access, 2^(4+1) bytes
+
+/* Lowest word used by the code, above the guard */
+#ifdef STACK_GUARD_ENABLED
+#define STACK_MAIN_LOW			(STACK_MAIN_BASE + STACK_GUARD_SIZE / 4)
+#else
+#define STACK_MAIN_LOW			STACK_MAIN_BASE
+#endif
+
+void STACK_paint(uint32_t * base, uint32_t words)
+{
+	uint32_t i;
+
+	for (i = 0; i < words; i++)
+		base[i] = STACK_PAINT;
+}
+
+uint32_t STACK_getPeak(const uint32_t * base, uint32_t words)
+{
+	uint32_t i = 0;
+
+	while (i < words && base[i] == STACK_PAINT)
+		i++;
+	return (words - i) * 4;
+}
+
+bool STACK_setGuard(uint8_t region, const uint32_t * base)
+{
+	if (region > 7 || (uintptr_t) base % STACK_GUARD_SIZE != 0)
+		return false;
+
+	__DSB();
+	MPU->RNR = region;
+	MPU->RBAR = (uintptr_t) base;
+	MPU->RASR = STACK_GUARD_RASR;
+	MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+	SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+	__DSB();
+	__ISB();																							// Next accesses checked
+	return true;
+}
+
+/* Leaf loop, nothing of this function lives below MSP */
+void STACK_initMain(void)
+{
+	uint32_t * word = STACK_MAIN_LOW;
+	uint32_t * sp = (uint32_t *) __get_MSP();
+
+	while (word < sp)
+		*word++ = STACK_PAINT;
+#ifdef STACK_GUARD_ENABLED
+	STACK_setGuard(STACK_GUARD_REGION, STACK_MAIN_BASE);
+#endif
+}
+
+uint32_t STACK_getMainSize(void)
+{
+	return (STACK_MAIN_TOP - STACK_MAIN_LOW) * 4;
+}
+
+uint32_t STACK_getMainUsed(void)
+{
+	return (STACK_MAIN_TOP - (uint32_t *) __get_MSP()) * 4;
+}
+
+uint32_t STACK_getMainPeak(void)
+{
+	return STACK_getPeak(STACK_MAIN_LOW, STACK_MAIN_TOP - STACK_MAIN_LOW);
+}
@@ -0,0 +1,104 @@
+/**
+* @file 		stack.h
+* @brief		Header file of the stack usage instrumentation.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to measure the use of the
+* main stack (MSP) and of the thread stacks, and to make an overflow of
+* the main stack fault instead of corrupting the RAM below it.
+*
+*		1. A stack is painted with STACK_PAINT when it is still unused: at
+*		reset for the main stack (STACK_initMain, called by BOOT_init), at
+*		KERNEL_createThread() for the thread stacks. A stack grows down, the
+*		peak is found by looking for the lowest word which isn't the paint
+*		anymore: it misses the words written with the paint value only.
+*		2. The main stack is Stack_Mem of startup_stm32f40_41xxx.s,
+*		Stack_Size bytes below __initial_sp. STACK_getMainUsed() is the
+*		current use (MSP), STACK_getMainPeak() the most since the reset, of
+*		the main code and of all the handlers, which run on MSP.
+*		3. Built with STACK_GUARD_ENABLED, STACK_initMain() also sets MPU
+*		region STACK_GUARD_REGION with no access on the STACK_GUARD_SIZE
+*		lowest bytes of the main stack, which the code no longer uses: the
+*		first push below faults (MemManage, or HardFault when the fault
+*		handler can't stack either) at the instruction which overflowed.
+*		The other regions are left to the application, the default memory
+*		map stays in use (PRIVDEFENA). Stack_Mem is aligned on 32 bytes.
+*		4. Use it as follow:
+*				printf("MSP %u/%u bytes\n", STACK_getMainPeak(), STACK_getMainSize());
+*				printf("sensor %u bytes\n", STACK_getPeak(sensor.stack, sensor.stack_words));
+*
+*/
+
+#ifndef STACK_H
+#define STACK_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+#define STACK_PAINT					0xCDCDCDCDUL										///< Value of the unused words
+#define STACK_GUARD_SIZE		32																///< Bytes, smallest MPU region
+#define STACK_GUARD_REGION	7																	///< Highest MPU region, wins over the others
+
+
+/*----------------------------------------------------------------------------
+  Any stack
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Stack painted.
+ * @param[out]	base Lowest word of the stack, not in use.
+ * @param[in]	words Size of the stack in 32-bit words.
+ */
+void STACK_paint(uint32_t * base, uint32_t words);
+
+/**
+ * Peak use of a painted stack.
+ * @param[in]	base Lowest word of the stack.
+ * @param[in]	words Size of the stack in 32-bit words.
+ * @retval uint32_t Bytes written since the paint, from the top.
+ */
+uint32_t STACK_getPeak(const uint32_t * base, uint32_t words);
+
+/**
+ * MPU guard region set.
+ * This function forbids any access to the STACK_GUARD_SIZE bytes at base
+ * and enables the MPU and the MemManage fault.
+ * @param[in]	region MPU region (0..7).
+ * @param[in]	base Lowest word of the stack, aligned on STACK_GUARD_SIZE.
+ * @retval bool false if region is out of range or base isn't aligned.
+ */
+bool STACK_setGuard(uint8_t region, const uint32_t * base);
+
+
+/*----------------------------------------------------------------------------
+  Main stack (MSP)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Main stack painted, and guarded with STACK_GUARD_ENABLED.
+ * This function paints the main stack below MSP.
+ * @par Called by BOOT_init, before the C library initialisation.
+ */
+void STACK_initMain(void);
+
+/**
+ * Size of the main stack.
+ * @retval uint32_t Bytes usable, without the guard.
+ */
+uint32_t STACK_getMainSize(void);
+
+/**
+ * Current use of the main stack.
+ * @retval uint32_t Bytes above MSP.
+ */
+uint32_t STACK_getMainUsed(void);
+
+/**
+ * Peak use of the main stack.
+ * @retval uint32_t Most bytes used since STACK_initMain().
+ */
+uint32_t STACK_getMainPeak(void);
+
+#endif
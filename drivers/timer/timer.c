@@ -13,6 +13,10 @@
 *
 */
 #include "timer.h"
+#include "atomic.h"
+#include "rcc.h"
+#include "memory.h"
+#include <stddef.h>
 
 /*----------------------------------------------------------------------------
   TIMx control register 1 (TIMx_CR1)
@@ -20,18 +24,17 @@
 
 void TIM_enable(TIM_TypeDef * TIM) 
 {
-	TIM->CR1 |= TIM_CR1_CEN;	
+	ATOMIC_SET_BIT(TIM->CR1, TIM_CR1_CEN);
 }
 
 void TIM_initUpcount(TIM_TypeDef * TIM)
 {
-	TIM->CR1 &= ~TIM_CR1_DIR;
+	ATOMIC_CLEAR_BIT(TIM->CR1, TIM_CR1_DIR);
 }
 
 void TIM_initDowncount(TIM_TypeDef * TIM)
 {
-	TIM->CR1 &= ~TIM_CR1_DIR;
-	TIM->CR1 |= TIM_CR1_DIR;
+	ATOMIC_SET_BIT(TIM->CR1, TIM_CR1_DIR);
 }
 
 
@@ -39,11 +42,18 @@ void TIM_initDowncount(TIM_TypeDef * TIM)
   TIMx auto-reload register (TIMx_ARR)
  *----------------------------------------------------------------------------*/
 
-void TIM_setARR(TIM_TypeDef * TIM, u16 arr)
+void TIM_setARR(TIM_TypeDef * TIM, u32 arr)
 {
 	TIM->ARR = arr;
 }
 
+u32 TIM_getARRMax(TIM_TypeDef * TIM)
+{
+	if (TIM == TIM2 || TIM == TIM5)
+		return TIM_ARR_MAX_32;
+	return TIM_ARR_MAX_16;
+}
+
 
 /*----------------------------------------------------------------------------
   TIMx prescaler (TIMx_PSC)
@@ -61,7 +71,7 @@ void TIM_setPSC(TIM_TypeDef * TIM, u16 psc)
  
 void TIM_resetCNT(TIM_TypeDef * TIM)
 {
-	TIM->EGR |= TIM_EGR_UG;
+	TIM->EGR = TIM_EGR_UG;																	// Write-only, no read
 }
 
 
@@ -71,7 +81,99 @@ void TIM_resetCNT(TIM_TypeDef * TIM)
  
 void TIM_resetIRFlag(TIM_TypeDef * TIM)
 {
-	TIM->SR &= ~TIM_SR_UIF;
+	TIM->SR = (uint16_t) ~TIM_SR_UIF;												// rc_w0: the other flags written 1, unchanged
+}
+
+
+/*----------------------------------------------------------------------------
+  TIMx capture/compare mode and enable registers (TIMx_CCMR1/2, TIMx_CCER)
+ *----------------------------------------------------------------------------*/
+
+void TIM_initPWM(TIM_TypeDef * TIM, u8 channel)
+{
+	u8 shift;
+	u16 mask, mode;
+	
+	if (channel < 1 || channel > TIM_CHANNELS)
+		return;
+	
+	// Channels 1 and 3 in the low byte of CCMR1 and CCMR2, 2 and 4 in the high byte
+	shift = ((channel - 1) % 2) * 8;
+	mask = (u16) ((TIM_CCMR1_CC1S | TIM_CCMR1_OC1M | TIM_CCMR1_OC1PE) << shift);
+	mode = (u16) ((TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1PE) << shift);
+	if (channel <= 2)
+		ATOMIC_MODIFY16(TIM->CCMR1, mask, mode);
+	else
+		ATOMIC_MODIFY16(TIM->CCMR2, mask, mode);
+	ATOMIC_BIT(TIM->CCER, 4*(channel - 1)) = 1;															// CCxE
+	ATOMIC_SET_BIT(TIM->CR1, TIM_CR1_ARPE);
+}
+
+
+/*----------------------------------------------------------------------------
+  TIMx capture/compare registers (TIMx_CCR1-4)
+ *----------------------------------------------------------------------------*/
+
+void TIM_setCCR(TIM_TypeDef * TIM, u8 channel, u32 value)
+{
+	if (channel == 1)
+		TIM->CCR1 = value;
+	else if (channel == 2)
+		TIM->CCR2 = value;
+	else if (channel == 3)
+		TIM->CCR3 = value;
+	else if (channel == 4)
+		TIM->CCR4 = value;
+}
+
+
+/*----------------------------------------------------------------------------
+  TIMx DMA burst (TIMx_DIER UDE, TIMx_DCR, TIMx_DMAR)
+ *----------------------------------------------------------------------------*/
+
+/* All the interrupt flags of DMA1 stream 6 */
+#define TIM4_DMA_UP_FLAGS		(DMA_HIFCR_CFEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTCIF6)
+
+/* Half-word memory to TIMx_DMAR, low priority */
+#define TIM4_DMA_UP_CR			((uint32_t) TIM4_DMA_UP_CHANNEL << 25 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC | DMA_SxCR_DIR_0)
+
+bool TIM_startCCRStream(TIM_TypeDef * TIM, const u16 * frames, u16 length, bool repeat)
+{
+	if (TIM != TIM4 || length == 0 || length > 0xFFFF / TIM_CHANNELS || TIM_isCCRStreamBusy(TIM))
+		return false;
+	if (MEM_IN_CCM(frames))																// Out of reach of the DMA
+		return false;
+	
+	ATOMIC_CLEAR_BIT(TIM->DIER, TIM_DIER_UDE);
+	DMA1->HIFCR = TIM4_DMA_UP_FLAGS;
+	TIM4_DMA_UP_STREAM->PAR = (uintptr_t) &TIM->DMAR;
+	TIM4_DMA_UP_STREAM->M0AR = (uintptr_t) frames;
+	TIM4_DMA_UP_STREAM->NDTR = length * TIM_CHANNELS;
+	TIM4_DMA_UP_STREAM->CR = TIM4_DMA_UP_CR | (repeat ? DMA_SxCR_CIRC : 0) | DMA_SxCR_EN;
+	
+	// Each update request: TIM_CHANNELS transfers through DMAR, to CCR1 and the next registers
+	TIM->DCR = (TIM_CHANNELS - 1) << 8 | (offsetof(TIM_TypeDef, CCR1) / 4);
+	ATOMIC_SET_BIT(TIM->DIER, TIM_DIER_UDE);
+	
+	return true;
+}
+
+void TIM_stopCCRStream(TIM_TypeDef * TIM)
+{
+	if (TIM != TIM4)
+		return;
+	
+	ATOMIC_CLEAR_BIT(TIM->DIER, TIM_DIER_UDE);
+	ATOMIC_CLEAR_BIT(TIM4_DMA_UP_STREAM->CR, DMA_SxCR_EN);
+	while (TIM4_DMA_UP_STREAM->CR & DMA_SxCR_EN);					// Current burst completed
+}
+
+bool TIM_isCCRStreamBusy(TIM_TypeDef * TIM)
+{
+	if (TIM == TIM4)
+		return (TIM4_DMA_UP_STREAM->CR & DMA_SxCR_EN) != 0;
+	else
+		return false;
 }
 
 
@@ -79,10 +181,79 @@ void TIM_resetIRFlag(TIM_TypeDef * TIM)
   More than one registers
  *----------------------------------------------------------------------------*/
  
-void TIM_setPeriod(TIM_TypeDef * TIM, u32 usperiod)
+u32 TIM_getClock(TIM_TypeDef * TIM)
+{
+	(void) TIM;																					// TIM2-TIM7 are all on APB1
+	return RCC_getTIMCLK(RCC_BUS_APB1);
+}
+
+bool TIM_solvePeriod(uint64_t ticks, u32 arr_max, TIM_PeriodConfig * config)
 {
-	u32 tim_clk = (SystemCoreClock * 1 / 4 * 2);
+	uint64_t arr_count = (uint64_t) arr_max + 1;
+	uint64_t best_error = ~(uint64_t) 0;
+	uint64_t psc_count, count, product, error;
+	
+	if (ticks == 0)
+	{
+		config->psc = 0;
+		config->arr = 0;
+		config->ticks = 1;
+		return false;
+	}
+	if (ticks > arr_count * (TIM_PSC_MAX + 1))
+	{
+		config->psc = TIM_PSC_MAX;
+		config->arr = arr_max;
+		config->ticks = arr_count * (TIM_PSC_MAX + 1);
+		return false;
+	}
 	
-	TIM->PSC = DEFAULT_PSC;
-	TIM->ARR = (usperiod * (tim_clk / 1000000)) / (TIM->PSC + 1) ;
+	// Smallest prescaler first: on equal error, the finest resolution wins
+	for (psc_count = (ticks + arr_count - 1) / arr_count; psc_count <= TIM_PSC_MAX + 1; psc_count++)
+	{
+		if (psc_count > ticks)
+			break;																						// ARR = 0 from here, the error only grows
+		// ARR + 1 = round(ticks / (PSC + 1)), <= arr_count as psc_count >= ticks / arr_count
+		if (ticks < 0x80000000)
+			count = ((u32) ticks + (u32) psc_count / 2) / (u32) psc_count;		// 32-bit division when possible
+		else
+			count = (ticks + psc_count / 2) / psc_count;
+		product = psc_count * count;
+		error = (product > ticks) ? product - ticks : ticks - product;
+		if (error < best_error)
+		{
+			best_error = error;
+			config->psc = (u16) (psc_count - 1);
+			config->arr = (u32) (count - 1);
+			config->ticks = product;
+			if (error == 0)
+				break;
+		}
+	}
+	return true;
+}
+
+void TIM_applyPeriod(TIM_TypeDef * TIM, const TIM_PeriodConfig * config)
+{
+	TIM->PSC = config->psc;
+	TIM->ARR = config->arr;
+}
+
+uint64_t TIM_setPeriodNs(TIM_TypeDef * TIM, uint64_t nsperiod)
+{
+	u32 tim_clk = TIM_getClock(TIM);
+	TIM_PeriodConfig config;
+	uint64_t ticks;
+	
+	// ns * clk may overflow 64 bits: whole seconds and remainder apart
+	ticks = (nsperiod / 1000000000) * tim_clk + ((nsperiod % 1000000000) * tim_clk + 500000000) / 1000000000;
+	TIM_solvePeriod(ticks, TIM_getARRMax(TIM), &config);
+	TIM_applyPeriod(TIM, &config);
+	
+	return (config.ticks / tim_clk) * 1000000000 + ((config.ticks % tim_clk) * 1000000000 + tim_clk / 2) / tim_clk;
+}
+
+uint64_t TIM_setPeriod(TIM_TypeDef * TIM, u32 usperiod)
+{
+	return TIM_setPeriodNs(TIM, (uint64_t) usperiod * 1000);
 }
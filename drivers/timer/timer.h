@@ -16,6 +16,8 @@
 *		following formula:
 *			TIMxCLK = SystemCoreClock / AHBPSC / APB1PSC * 2
 *						  = 168 MHz / 1 / 4 * 2 = 84 MHz
+*		TIM_getClock() gets it from the RCC drivers (RCC_getTIMCLK), for the
+*		clock set by RCC_setSysclk().
 *		2. Use the function defined in the RCC drivers to set the TIMER 
 *		clocks.
 *				ex: __GPIOD_CLK_ENABLE();
@@ -23,20 +25,60 @@
 *			__TIM3_CLK_ENABLE();
 *			TIM_enable(TIM3);
 *			TIM_initUpcount(TIM3);
-*			TIM_setARR(TIM3, 8400);
 *			TIM_setPeriod(TIM3, 5000000);
 *			TIM_resetCNT(TIM3);
 *		4. In the interruption handler, it is necessary to reset the interruption
 *		flag.
 *			TIM_resetIRFlag(TIM3);
+*		5. TIM_setPeriod() and TIM_setPeriodNs() search the PSC/ARR pair with
+*		the smallest period error, then the smallest PSC (finest resolution),
+*		and return the achieved period. For a constant period, the pair can
+*		be computed at compile time instead (finest resolution, error of at
+*		most (PSC + 1) / 2 timer clock cycles):
+*			#define SAMPLE_TICKS	TIM_TICKS_NS(84000000, 22676)
+*			TIM_setPSC(TIM3, TIM_PSC_FOR(SAMPLE_TICKS, TIM_ARR_MAX_16));
+*			TIM_setARR(TIM3, TIM_ARR_FOR(SAMPLE_TICKS, TIM_ARR_MAX_16));
+*		6. TIM_initPWM() sets a channel of TIM2-TIM5 in PWM mode 1 with a
+*		preloaded CCR: a new duty cycle is used from the next update event,
+*		so a period is never cut. The GPIO pin must be set in the alternate
+*		function of the timer.
+*		7. TIM_startCCRStream() writes a new CCR1..CCR4 frame at each update
+*		event by DMA burst (TIM4 only, DMA1 clock enabled beforehand): the
+*		duty cycles follow the table with no CPU at all. A frame written at
+*		an update is used from the next one.
+*			static const u16 frames[2][TIM_CHANNELS] = { { 999, 0, 0, 0 }, { 0, 999, 0, 0 } };
+*			TIM_startCCRStream(TIM4, frames[0], 2, true);
 */
 #ifndef TIMER_H
 #define TIMER_H
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <stm32f4xx.h>
 
-#define DEFAULT_PSC 	9999	///< Default PSC value
+#define TIM_PSC_MAX					0xFFFF				///< Max PSC value
+#define TIM_ARR_MAX_16			0xFFFF				///< Max ARR value of TIM3, TIM4, TIM6 and TIM7
+#define TIM_ARR_MAX_32			0xFFFFFFFF		///< Max ARR value of TIM2 and TIM5
+#define TIM_CHANNELS				4							///< Capture/compare channels of TIM2-TIM5
+
+/* DMA stream serving the TIM4 update requests (RM0090 table 42, channel 2) */
+#define TIM4_DMA_UP_STREAM			DMA1_Stream6
+#define TIM4_DMA_UP_CHANNEL			2
+
+/* Timer clock cycles of a period in ns, rounded (constant expression) */
+#define TIM_TICKS_NS(clk, ns)					(((uint64_t) (clk) * (ns) + 500000000) / 1000000000)
+/* Smallest PSC able to count ticks (>= 1) cycles with an ARR <= arr_max (constant expression) */
+#define TIM_PSC_FOR(ticks, arr_max)		(((uint64_t) (ticks) + (arr_max)) / ((uint64_t) (arr_max) + 1) - 1)
+/* ARR giving the closest period to ticks cycles with TIM_PSC_FOR (constant expression) */
+#define TIM_ARR_FOR(ticks, arr_max)		(((uint64_t) (ticks) + (TIM_PSC_FOR(ticks, arr_max) + 1) / 2) / (TIM_PSC_FOR(ticks, arr_max) + 1) - 1)
+
+/* Prescaler and auto-reload pair of a period */
+typedef struct
+{
+	u16 psc;
+	u32 arr;
+	uint64_t ticks;												///< Achieved period in timer clock cycles, (psc + 1) * (arr + 1)
+}TIM_PeriodConfig;
 
 /*----------------------------------------------------------------------------
   TIMx control register 1 (TIMx_CR1)
@@ -70,11 +112,20 @@ void TIM_initDowncount(TIM_TypeDef * TIM);
 
 /**
  * Auto-Reload register set at desired value.
- * This function writes the desired ARR in the TIM ARR 16-bit register.
+ * This function writes the desired ARR in the TIM ARR register (32-bit on
+ * TIM2 and TIM5, 16-bit on the other timers).
  * @param[in]	TIM Timer to set.
  * @param[in]	_arr Value of ARR.
  */
-void TIM_setARR(TIM_TypeDef * TIM, u16 arr);
+void TIM_setARR(TIM_TypeDef * TIM, u32 arr);
+
+/**
+ * Max value of the Auto-Reload register.
+ * @param[in]	TIM Timer.
+ * @retval TIM_ARR_MAX_32 for TIM2 and TIM5
+ * @retval TIM_ARR_MAX_16 for the other timers
+ */
+u32 TIM_getARRMax(TIM_TypeDef * TIM);
 
 
 /*----------------------------------------------------------------------------
@@ -115,22 +166,129 @@ void TIM_resetCNT(TIM_TypeDef * TIM);
 void TIM_resetIRFlag(TIM_TypeDef * TIM);
 
 
+/*----------------------------------------------------------------------------
+  TIMx capture/compare mode and enable registers (TIMx_CCMR1/2, TIMx_CCER)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Channel set in PWM mode.
+ * This function sets the channel in output compare PWM mode 1 (active
+ * while CNT < CCR) with CCR preload, enables its output (active high)
+ * and the ARR preload (ARPE bit of the TIM CR1 register).
+ * @param[in]	TIM Timer to set (TIM2-TIM5).
+ * @param[in]	channel Channel, 1 to TIM_CHANNELS.
+ * @par Nothing is done for an out of range channel. CCR is 0 (output
+ * inactive) until it is set.
+ */
+void TIM_initPWM(TIM_TypeDef * TIM, u8 channel);
+
+
+/*----------------------------------------------------------------------------
+  TIMx capture/compare registers (TIMx_CCR1-4)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Capture/compare register set.
+ * In PWM mode, the output is active for value timer counts out of
+ * ARR + 1: 0 is always inactive, ARR + 1 and more always active.
+ * @param[in]	TIM Timer to set (TIM2-TIM5).
+ * @param[in]	channel Channel, 1 to TIM_CHANNELS.
+ * @param[in]	value Value of CCR.
+ */
+void TIM_setCCR(TIM_TypeDef * TIM, u8 channel, u32 value);
+
+
+/*----------------------------------------------------------------------------
+  TIMx DMA burst (TIMx_DIER UDE, TIMx_DCR, TIMx_DMAR)
+ *----------------------------------------------------------------------------*/
+
+/**
+ * CCR frames streamed by DMA.
+ * This function programs the DMA stream of the timer update requests and
+ * the DMA burst of the timer: each update event writes the next frame of
+ * TIM_CHANNELS values in CCR1..CCR4. It returns immediately.
+ * @param[in]	TIM Timer (TIM4 only).
+ * @param[in]	frames length * TIM_CHANNELS values, kept by reference until
+ * the stream stops.
+ * @param[in]	length Number of frames, at most 0xFFFF / TIM_CHANNELS.
+ * @param[in]	repeat true to start again from the first frame after the last one.
+ * @retval bool false if the timer isn't supported, length is out of range,
+ * a stream is running or frames are in the CCM (memory.h).
+ */
+bool TIM_startCCRStream(TIM_TypeDef * TIM, const u16 * frames, u16 length, bool repeat);
+
+/**
+ * CCR stream stopped.
+ * The CCRs keep the last frame written. Nothing is done if no stream runs.
+ * @param[in]	TIM Timer (TIM4 only).
+ */
+void TIM_stopCCRStream(TIM_TypeDef * TIM);
+
+/**
+ * CCR stream running.
+ * @param[in]	TIM Timer.
+ * @retval bool true until the last frame is written (never if repeated).
+ */
+bool TIM_isCCRStreamBusy(TIM_TypeDef * TIM);
+
+
 /*----------------------------------------------------------------------------
   More than one registers
  *----------------------------------------------------------------------------*/
  
+/**
+ * Timer clock frequency.
+ * This function returns the APB1 timer clock of the RCC drivers: PCLK1, x2
+ * when the APB1 prescaler is not 1 (see RCC_getTIMCLK).
+ * @param[in]	TIM Timer (TIM2-TIM7, all on APB1).
+ * @retval u32 Frequency of the timer clock in Hz.
+ */
+u32 TIM_getClock(TIM_TypeDef * TIM);
+
+/**
+ * Prescaler and auto-reload pair of a period.
+ * This function searches the pair whose period (PSC + 1) * (ARR + 1) is
+ * the closest to ticks, and among them the one with the smallest PSC.
+ * @param[in]	ticks Period in timer clock cycles.
+ * @param[in]	arr_max Max value of ARR (see TIM_getARRMax).
+ * @param[out]	config PSC, ARR and achieved period.
+ * @retval true The period is in range (error of at most (PSC + 1) / 2 cycles).
+ * @retval false ticks is 0 or too long, config holds the closest period.
+ * @par Up to TIM_PSC_MAX + 1 divisions when ticks doesn't fit in ARR,
+ * the search stops at the first exact pair.
+ */
+bool TIM_solvePeriod(uint64_t ticks, u32 arr_max, TIM_PeriodConfig * config);
+
+/**
+ * Timer set with a prescaler and auto-reload pair.
+ * This function writes the TIM PSC and ARR registers. The new PSC is used
+ * after the next update event (see TIM_resetCNT).
+ * @param[in]	TIM Timer to set.
+ * @param[in]	config Pair computed by TIM_solvePeriod.
+ */
+void TIM_applyPeriod(TIM_TypeDef * TIM, const TIM_PeriodConfig * config);
+
+/**
+ * Timer set to generate an event (overflow or underflow) at a constant period.
+ * This function solves the PSC and ARR pair of the period at the current
+ * TIMxCLK (see TIM_solvePeriod) and writes them.
+ * @param[in]	TIM Timer to set.
+ * @param[in]	nsperiod Period of the interruption in ns.
+ * @retval uint64_t Achieved period in ns (rounded).
+ * @details
+ * For TIMxCLK = 84MHz, the resolution is 11.9ns up to 780s on the 16-bit
+ * timers and up to 51s on the 32-bit ones. The longest period of the 16-bit
+ * timers is 51s.
+ */
+uint64_t TIM_setPeriodNs(TIM_TypeDef * TIM, uint64_t nsperiod);
+
 /**
  * Timer set to generate an event (overflow or underflow) at a constant period.
- * This function sets the TIM PSC register and then calculates the value of TIM ARR 
- * register according to the TIMxCLK.
+ * This function calls TIM_setPeriodNs.
  * @param[in]	TIM Timer to set.
  * @param[in]	_usPeriod Period of the interruption in s.
- * @details 
- * CLK resolution 1MHz (less than this, the division by 1000000 makes it invisible)
- * For CLC Timer = 84MHz and PSC = 9999, 
- * 							 	- ARR = 0x0001: T = 0x1/8400 ~ 119ms
- * 								- ARR = 0xFFFF: T = 0xFFF/8400 ~ 7800ms
+ * @retval uint64_t Achieved period in ns (rounded).
  */
-void TIM_setPeriod(TIM_TypeDef * TIM, u32 usperiod);
+uint64_t TIM_setPeriod(TIM_TypeDef * TIM, u32 usperiod);
 
 #endif
@@ -0,0 +1,129 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_boot.c
+ * Purpose: Reset to first sample, step by step of the boot stage
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Starts from the clocks left by SystemInit (168 MHz, 5 wait states) with
+ * the flash accelerator off, as after a power-on reset, then adds the
+ * steps of the boot stage one at a time. The code is charged to the flash
+ * model with HOST_execute(), at the sizes and cycles of an -O2 build:
+ *		- __main: 16-byte loops copying 1 KB of .data and clearing 8 KB of
+ *		.bss, one iteration per word.
+ *		- main() up to the sampling: 12 KB of straight-line code, then the
+ *		real MEMS_init() and MEMS_startDataReady() on the LIS3DSH model.
+ *		- Data-ready interrupt: 512 bytes of handler code on top of the
+ *		driver.
+ * The vector read overlaps the stacking: the RAM vector table is expected
+ * to buy no time. The FPU step is not timed, an FPU build needs it.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "host_lis3dsh.h"
+#include "mems_LIS3DSH.h"
+#include "boot.h"
+
+#define ODR_CYCLES				(168000000 / 1600)					///< First sample 1/ODR after the start
+#define LOOP_ADDRESS			(FLASH_BASE + 0x1000)
+#define MAIN_ADDRESS			(FLASH_BASE + 0x2000)
+#define HANDLER_ADDRESS		(FLASH_BASE + 0x8000)
+
+typedef enum
+{
+	STEP_NONE = 0,
+	STEP_PREFETCH,
+	STEP_CACHES,
+	STEP_VECTORS
+}Step;
+
+static const char * const step_names[] =
+{
+	"SystemInit only (ART off)",
+	"+ prefetch",
+	"+ I/D caches (BOOT_init)",
+	"+ vector table in RAM"
+};
+
+static BOOT_Handler vectors[BOOT_VECTOR_NUMBER] __attribute__((aligned(BOOT_VECTOR_ALIGN)));
+static volatile uint64_t sample_time;
+
+static void on_sample(void * context)
+{
+	(void) context;
+	HOST_execute(HANDLER_ADDRESS, 512, 300);
+	if (sample_time == 0)
+		sample_time = HOST_getCycles();
+}
+
+static void new_sample(void * context)
+{
+	*(uint64_t *) context = HOST_getCycles();
+	HOST_LIS3DSH_setSample(1, 2, 3);
+}
+
+/* __main: word loops of the scatter loading */
+static void library_init(void)
+{
+	uint32_t words;
+
+	for (words = 0; words < (1024 + 8192) / 4; words++)
+		HOST_execute(LOOP_ADDRESS, 16, 4);
+}
+
+static void run(Step step)
+{
+	static int16_t storage[16][3];
+	RING_Buffer ring;
+	uint64_t start, main_start, sampling, edge = 0;
+
+	HOST_reset();
+	FLASH->ACR = FLASH_ACR_LATENCY_5WS;
+	start = HOST_getCycles();
+
+	// Boot stage
+	if (step >= STEP_PREFETCH)
+		FLASH->ACR = FLASH->ACR | FLASH_ACR_PRFTEN;
+	if (step >= STEP_CACHES)
+		BOOT_init();
+	library_init();
+	main_start = HOST_getCycles();
+
+	// main() up to the first sample
+	if (step >= STEP_VECTORS)
+		BOOT_relocateVectors(vectors);
+	HOST_execute(MAIN_ADDRESS, 12 * 1024, 8 * 1024);
+	HOST_LIS3DSH_attach(MEMS_SPI, MEMS_GPIO_CS, MEMS_PIN_CS);
+	HOST_LIS3DSH_attachInt1(MEMS_GPIO_INT1, MEMS_PIN_INT1);
+	MEMS_CLK_ENABLE();
+	MEMS_init();
+	RING_init(&ring, storage, sizeof(storage[0]), 16);
+	sample_time = 0;
+	MEMS_startDataReady(&ring, on_sample, NULL);
+	sampling = HOST_getCycles();
+	HOST_schedule(ODR_CYCLES, new_sample, &edge);
+	while (sample_time == 0)
+		HOST_advance(100);
+
+	printf("  %-28s %9llu %9llu %9llu %9.1f %9llu\n", step_names[step],
+				 (unsigned long long) (main_start - start), (unsigned long long) (sampling - main_start),
+				 (unsigned long long) (sample_time - edge), (sample_time - start) / 168.0,
+				 (unsigned long long) HOST_getFetchStalls());
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	uint8_t step;
+
+	printf("Reset to first sample at 168 MHz, 5 wait states, first sample at ODR 1600 Hz\n");
+	printf("  %-28s %9s %9s %9s %9s %9s\n", "cycles", "__main", "main to", "edge to", "total", "flash");
+	printf("  %-28s %9s %9s %9s %9s %9s\n", "", "", "sampling", "sample", "(us)", "stalls");
+	for (step = STEP_NONE; step <= STEP_VECTORS; step++)
+		run((Step) step);
+	return 0;
+}
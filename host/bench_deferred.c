@@ -0,0 +1,144 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_deferred.c
+ * Purpose: Interrupt latency with the work done in the handler or deferred to PendSV
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	A periodic interrupt (EXTI1, every PERIOD cycles) needs WORK_CYCLES
+ * of processing, an urgent interrupt (EXTI2) arrives at a random time of
+ * the period. Both have the same NVIC priority, the same level of
+ * interrupt.h. Done in the EXTI1 handler, the processing delays the
+ * urgent handler by up to WORK_CYCLES. Deferred to PendSV, which any
+ * interrupt preempts, the EXTI1 handler only queues it.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "interrupt.h"
+#include "rcc.h"
+#include "work_queue.h"
+
+#define PERIOD				20000
+#define WORK_CYCLES		4000
+#define PERIODS				2000
+
+typedef struct
+{
+	uint32_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t total;
+} Stats;
+
+static Stats urgent_latency, top_half, work_done;
+static uint64_t periodic_edge, urgent_edge;
+static bool deferred;
+static uint32_t seed = 12345;
+
+static void stats_add(Stats * s, uint64_t value)
+{
+	if (s->count == 0 || value < s->min)
+		s->min = value;
+	if (value > s->max)
+		s->max = value;
+	s->total += value;
+	s->count++;
+}
+
+static void stats_print(const char * name, const Stats * s)
+{
+	printf("  %-22s %8llu %8llu %8llu\n", name, (unsigned long long) s->min,
+				 (unsigned long long) (s->total / s->count), (unsigned long long) s->max);
+}
+
+static void pulse(GPIO_TypeDef * GPIO, uint8_t pin)
+{
+	HOST_GPIO_setInput(GPIO, pin, true);
+	HOST_GPIO_setInput(GPIO, pin, false);
+}
+
+static void raise_periodic(void * context)
+{
+	(void) context;
+	periodic_edge = HOST_getCycles();
+	pulse(GPIOA, 1);
+}
+
+static void raise_urgent(void * context)
+{
+	(void) context;
+	urgent_edge = HOST_getCycles();
+	pulse(GPIOA, 2);
+}
+
+static void process(void * context)
+{
+	(void) context;
+	HOST_busy(WORK_CYCLES);
+	stats_add(&work_done, HOST_getCycles() - periodic_edge);
+}
+
+static void on_periodic(u8 line, void * context)
+{
+	uint64_t start = HOST_getCycles();
+
+	(void) line;
+	(void) context;
+	if (deferred)
+		WORK_defer(process, NULL);
+	else
+		process(NULL);
+	stats_add(&top_half, HOST_getCycles() - start);
+}
+
+static void on_urgent(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	stats_add(&urgent_latency, HOST_getCycles() - urgent_edge);
+}
+
+static void run(bool defer)
+{
+	uint32_t n;
+
+	HOST_reset();
+	memset(&urgent_latency, 0, sizeof(Stats));
+	memset(&top_half, 0, sizeof(Stats));
+	memset(&work_done, 0, sizeof(Stats));
+	deferred = defer;
+
+	WORK_init();
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_periodic, NULL);
+	EXTI_attach(2, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_urgent, NULL);
+
+	for (n = 0; n < PERIODS; n++)
+	{
+		seed = seed * 1103515245 + 12345;
+		HOST_schedule(0, raise_periodic, NULL);
+		HOST_schedule((seed >> 8) % PERIOD, raise_urgent, NULL);
+		HOST_advance(PERIOD);
+	}
+	EXTI_detach(1);
+	EXTI_detach(2);
+
+	printf("%s\n", defer ? "Deferred to PendSV" : "Processing in the EXTI1 handler");
+	printf("  cycles                      min     mean      max\n");
+	stats_print("urgent IRQ latency", &urgent_latency);
+	stats_print("EXTI1 handler", &top_half);
+	stats_print("edge to work done", &work_done);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	printf("%d periods of %d cycles, %d cycles of work per period\n", PERIODS, PERIOD, WORK_CYCLES);
+	run(false);
+	run(true);
+	return 0;
+}
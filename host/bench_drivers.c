@@ -0,0 +1,151 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_drivers.c
+ * Purpose: Register accesses and CPU cycles of one call of each driver
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Each call runs once on a freshly reset model, after the clocks and
+ * the configuration it needs. The accesses are the CPU register reads
+ * and writes counted by the model, whatever the peripheral, the cycles
+ * those of HOST_getCpuCycles (accesses, exception entries and exits).
+ * The MEMS reads go to the LIS3DSH model on SPI1: the wait for the
+ * frames shows as SR reads.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "host_lis3dsh.h"
+#include "gpio.h"
+#include "interrupt.h"
+#include "timer.h"
+#include "rcc.h"
+#include "led.h"
+#include "mems_LIS3DSH.h"
+#include "boot.h"
+
+static const GPIO_PinConfig output = { GPIO_MODE_OUTPUT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_FAST, GPIO_PULL_NONE, 0 };
+static const u16 frames[4][TIM_CHANNELS] = { { 0 } };
+
+static void on_line(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+}
+
+static void setup_none(void)
+{
+}
+
+static void setup_gpio(void)
+{
+	GPIOD_CLK_ENABLE();
+	GPIO_initOutput(GPIOD, 12);
+}
+
+static void setup_exti(void)
+{
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, NULL);
+}
+
+static void setup_tim(void)
+{
+	TIM3_CLK_ENABLE();
+	TIM4_CLK_ENABLE();
+	TIM_initPWM(TIM4, 1);
+}
+
+static void setup_led(void)
+{
+	LED_CLK_ENABLE();
+	LED_initAllLeds();
+}
+
+static void setup_mems(void)
+{
+	HOST_LIS3DSH_attach(MEMS_SPI, MEMS_GPIO_CS, MEMS_PIN_CS);
+	MEMS_CLK_ENABLE();
+	MEMS_init();
+}
+
+static void gpio_init_output(void)			{ GPIO_initOutput(GPIOD, 13); }
+static void gpio_config_pins(void)			{ GPIO_configPins(GPIOD, 0xF000, &output); }
+static void gpio_set_pin(void)					{ GPIO_setPin(GPIOD, 12); }
+static void gpio_toggle_pin(void)				{ GPIO_togglePin(GPIOD, 12); }
+static void gpio_toggle_pins(void)			{ GPIO_togglePins(GPIOD, GPIO_PIN(12) | GPIO_PIN(13)); }
+static void gpio_read_pin(void)					{ (void) GPIO_readPin(GPIOD, 12); }
+static void exti_attach(void)						{ EXTI_attach(2, EXTI_EDGE_BOTH, SYSCFG_EXTICR_EXTI_PA, on_line, NULL); }
+static void exti_detach(void)						{ EXTI_detach(1); }
+static void exti_interrupt(void)				{ HOST_GPIO_setInput(GPIOA, 1, true); }
+static void tim_set_period(void)				{ TIM_setPeriod(TIM3, 1000); }
+static void tim_reset_flag(void)				{ TIM_resetIRFlag(TIM3); }
+static void tim_set_ccr(void)						{ TIM_setCCR(TIM4, 1, 500); }
+static void tim_start_stream(void)			{ TIM_startCCRStream(TIM4, frames[0], 4, true); }
+static void rcc_set_sysclk(void)				{ RCC_setSysclk(84000000); }
+static void rcc_read_hclk(void)					{ (void) RCC_readHCLK(); }
+static void boot_init_flash(void)				{ BOOT_initFlash(RCC_readHCLK()); }
+static void led_toggle(void)						{ LED_toggle(LED_GREEN); }
+static void mems_get_data(void)					{ (void) MEMS_getData(MEMS_CTRL_REG4); }
+static void mems_get_xyz(void)
+{
+	int16_t out[3];
+
+	MEMS_getOutXYZ(out);
+}
+
+typedef struct
+{
+	const char * name;
+	void (*setup)(void);
+	void (*call)(void);
+} Call;
+
+static const Call calls[] =
+{
+	{ "GPIO_initOutput",				setup_gpio,		gpio_init_output },
+	{ "GPIO_configPins (4 pins)",	setup_gpio,		gpio_config_pins },
+	{ "GPIO_setPin",						setup_gpio,		gpio_set_pin },
+	{ "GPIO_togglePin",					setup_gpio,		gpio_toggle_pin },
+	{ "GPIO_togglePins (2 pins)",	setup_gpio,		gpio_toggle_pins },
+	{ "GPIO_readPin",						setup_gpio,		gpio_read_pin },
+	{ "EXTI_attach",						setup_exti,		exti_attach },
+	{ "EXTI_detach",						setup_exti,		exti_detach },
+	{ "EXTI1 edge to return",		setup_exti,		exti_interrupt },
+	{ "TIM_setPeriod",					setup_tim,		tim_set_period },
+	{ "TIM_resetIRFlag",				setup_tim,		tim_reset_flag },
+	{ "TIM_setCCR",							setup_tim,		tim_set_ccr },
+	{ "TIM_startCCRStream",			setup_tim,		tim_start_stream },
+	{ "RCC_setSysclk (84 MHz)",	setup_none,		rcc_set_sysclk },
+	{ "RCC_readHCLK",						setup_none,		rcc_read_hclk },
+	{ "BOOT_initFlash",					setup_none,		boot_init_flash },
+	{ "LED_toggle",							setup_led,		led_toggle },
+	{ "MEMS_getData",						setup_mems,		mems_get_data },
+	{ "MEMS_getOutXYZ",					setup_mems,		mems_get_xyz },
+};
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	uint32_t reads, writes, reads_after, writes_after;
+	uint64_t cpu;
+	uint8_t i;
+
+	printf("One call of each driver on the register model, 168 MHz\n");
+	printf("  %-26s %6s %6s %8s\n", "call", "reads", "writes", "cycles");
+	for (i = 0; i < sizeof(calls) / sizeof(calls[0]); i++)
+	{
+		HOST_reset();
+		calls[i].setup();
+		HOST_getAccessCount(NULL, &reads, &writes);
+		cpu = HOST_getCpuCycles();
+		calls[i].call();
+		HOST_getAccessCount(NULL, &reads_after, &writes_after);
+		printf("  %-26s %6u %6u %8llu\n", calls[i].name, reads_after - reads, writes_after - writes,
+					 (unsigned long long) (HOST_getCpuCycles() - cpu));
+	}
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_irq_latency.c
+ * Purpose: Interrupt entry latency per preemption level, flat or grouped priorities
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	The load of an application: a driver interrupt (EXTI0, DRIVER_CYCLES
+ * twice per period), a timer interrupt (EXTI9_5, TIMER_CYCLES once per
+ * period) deferring WORK_CYCLES of processing to PendSV. The latency of
+ * each level is triggered once per period at a random time, by the model
+ * events (as a bus master would, whatever the CPU runs).
+ *	Flat, all the interrupts have priority 0 as when the drivers only
+ * called NVIC_EnableIRQ (PendSV stays the lowest): any of them waits for
+ * the handler running. Grouped, each has its level of interrupt.h.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "latency.h"
+#include "rcc.h"
+#include "work_queue.h"
+
+#define PERIOD					20000
+#define DRIVER_CYCLES		600
+#define TIMER_CYCLES		1500
+#define WORK_CYCLES			6000
+#define PERIODS					2000
+
+static uint32_t seed = 12345;
+static uint32_t missed;
+
+static uint32_t random(uint32_t range)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) % range;
+}
+
+static void pulse(void * context)
+{
+	uint8_t pin = (uint8_t) (uintptr_t) context;
+
+	HOST_GPIO_setInput(GPIOA, pin, true);
+	HOST_GPIO_setInput(GPIOA, pin, false);
+}
+
+static void trigger(void * context)
+{
+	if (!LAT_trigger((u8) (uintptr_t) context))
+		missed++;
+}
+
+static void process(void * context)
+{
+	(void) context;
+	HOST_busy(WORK_CYCLES);
+}
+
+static void on_driver(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	HOST_busy(DRIVER_CYCLES);
+}
+
+static void on_timer(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	HOST_busy(TIMER_CYCLES);
+	WORK_defer(process, NULL);
+}
+
+static void run(bool grouped)
+{
+	uint32_t n;
+	u8 level;
+
+	HOST_reset();
+	missed = 0;
+	if (grouped)
+		IRQ_initGrouping();
+	WORK_init();
+	SYSCFG_CLK_ENABLE();
+	LAT_init();
+	for (level = 0; level < IRQ_LEVELS; level++)
+		LAT_attach(level);
+	IRQ_setPriority(EXTI0_IRQn, IRQ_LEVEL_DRIVER, 0);
+	IRQ_setPriority(EXTI9_5_IRQn, IRQ_LEVEL_TIMER, 0);
+	EXTI_attach(0, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_driver, NULL);
+	EXTI_attach(5, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_timer, NULL);
+	if (!grouped)
+	{
+		for (level = 0; level < IRQ_LEVELS; level++)
+			NVIC_SetPriority(EXTI_getIRQn(LAT_LINE_BASE + level), 0);
+		NVIC_SetPriority(EXTI0_IRQn, 0);
+		NVIC_SetPriority(EXTI9_5_IRQn, 0);
+	}
+
+	for (n = 0; n < PERIODS; n++)
+	{
+		HOST_schedule(0, pulse, (void *) 5);
+		HOST_schedule(random(PERIOD), pulse, (void *) 0);
+		HOST_schedule(random(PERIOD), pulse, (void *) 0);
+		for (level = 0; level < IRQ_LEVELS; level++)
+			HOST_schedule(random(PERIOD), trigger, (void *) (uintptr_t) level);
+		HOST_advance(PERIOD);
+	}
+
+	printf("%s\n", grouped ? "Grouped: one preemption level each" : "Flat: all at priority 0");
+	printf("  cycles            min     mean      max   jitter\n");
+	for (level = 0; level < IRQ_LEVELS; level++)
+	{
+		const LAT_Stats * s = LAT_getStats(level);
+
+		printf("  level %u       %8u %8u %8u %8u\n", level, s->min, LAT_getMean(s), s->max, LAT_getJitter(s));
+		LAT_detach(level);
+	}
+	printf("  triggers missed (previous one not handled): %u\n", missed);
+	EXTI_detach(0);
+	EXTI_detach(5);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	printf("%d periods of %d cycles: driver IRQ 2 x %d, timer IRQ %d, PendSV %d cycles per period\n",
+				 PERIODS, PERIOD, DRIVER_CYCLES, TIMER_CYCLES, WORK_CYCLES);
+	run(false);
+	run(true);
+	return 0;
+}
@@ -0,0 +1,234 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_kernel.c
+ * Purpose: Preemptive kernel context switch and semaphore signal latencies
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Context switch: two threads hand a token back and forth through two
+ * semaphores, the waiting one is the more urgent: each give switches.
+ * Virtual cycles from the give to the return of the take in the other
+ * thread (PendSV entry, HOST_KERNEL_SWITCH_CYCLES, exit and the lock
+ * sections), and host nanoseconds per switch, timed with the profiling
+ * service built with PROF_HOST_CLOCK.
+ *	Signal: the task mix of bench_scheduler as threads. A sensor interrupt
+ * every SENSOR_PERIOD gives the semaphore of the sensor thread (priority
+ * 0), which wakes the output thread (priority 2) every OUTPUT_SAMPLES
+ * samples, a LED interrupt wakes the LED thread (priority 1). The sensor
+ * thread preempts the output thread: its response doesn't depend on
+ * OUTPUT_CYCLES, unlike with the cooperative scheduler.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "host_kernel.h"
+#include "kernel.h"
+#include "interrupt.h"
+#include "profiling.h"
+#include "rcc.h"
+
+#define SWITCH_ROUNDS			20000
+#define SENSOR_PERIOD			10000
+#define SENSOR_CYCLES			300
+#define OUTPUT_SAMPLES		16
+#define OUTPUT_CYCLES			15000
+#define LED_PERIOD				168000
+#define LED_CYCLES				100
+#define RUN_CYCLES				168000000								///< 1 s at 168 MHz
+
+static uint32_t stacks[3][KERNEL_STACK_MIN];
+static KERNEL_Thread threads[3];
+
+/*----------------------------------------------------------------------------
+  Context switch
+ *----------------------------------------------------------------------------*/
+
+static KERNEL_Sem ping, pong;
+static uint64_t give_time, switch_total, switch_max;
+static uint32_t switches;
+
+static void measure(void)
+{
+	uint64_t latency = HOST_getCycles() - give_time;
+
+	switch_total += latency;
+	if (latency > switch_max)
+		switch_max = latency;
+	switches++;
+}
+
+static void pinger(void * arg)
+{
+	uint32_t round;
+
+	(void) arg;
+	for (round = 0; round < SWITCH_ROUNDS; round++)
+	{
+		give_time = HOST_getCycles();
+		KERNEL_semGive(&pong);																	// Switches to the ponger
+		KERNEL_semTake(&ping, KERNEL_WAIT_FOREVER);
+		measure();
+	}
+}
+
+static void ponger(void * arg)
+{
+	(void) arg;
+	for (;;)
+	{
+		KERNEL_semTake(&pong, KERNEL_WAIT_FOREVER);
+		measure();
+		give_time = HOST_getCycles();
+		KERNEL_semGive(&ping);																	// Blocks in take: switches to the pinger
+	}
+}
+
+static void context_switch(void)
+{
+	uint64_t start, elapsed;
+
+	HOST_reset();
+	IRQ_initGrouping();
+	KERNEL_init();
+	KERNEL_semInit(&ping, 0);
+	KERNEL_semInit(&pong, 0);
+	KERNEL_createThread(&threads[0], "pinger", pinger, NULL, 2, stacks[0], KERNEL_STACK_MIN);
+	KERNEL_createThread(&threads[1], "ponger", ponger, NULL, 1, stacks[1], KERNEL_STACK_MIN);
+	switch_total = 0;
+	switch_max = 0;
+	switches = 0;
+
+	start = PROF_getTimestamp();
+	while (threads[0].state != KERNEL_EXITED)
+		HOST_KERNEL_run(RUN_CYCLES);
+	elapsed = PROF_getTimestamp() - start;
+
+	printf("  %u switches, give to take %.1f cycles mean, %llu max\n",
+				 switches, (double) switch_total / switches, (unsigned long long) switch_max);
+	printf("  %.1f ns per switch on the host\n", (double) elapsed / KERNEL_getSwitchCount());
+}
+
+
+/*----------------------------------------------------------------------------
+  Signal
+ *----------------------------------------------------------------------------*/
+
+static KERNEL_Sem sensor_sem, output_sem, led_sem;
+static uint64_t sensor_edge, sensor_max, sensor_total;
+static uint32_t samples, outputs, leds;
+
+static void on_line(u8 line, void * context)
+{
+	(void) line;
+	KERNEL_signal(context);
+}
+
+static void pulse(uint8_t pin)
+{
+	HOST_GPIO_setInput(GPIOA, pin, true);
+	HOST_GPIO_setInput(GPIOA, pin, false);
+}
+
+static void raise_sensor(void * context)
+{
+	(void) context;
+	sensor_edge = HOST_getCycles();
+	pulse(0);
+	HOST_schedule(SENSOR_PERIOD, raise_sensor, NULL);
+}
+
+static void raise_led(void * context)
+{
+	(void) context;
+	pulse(1);
+	HOST_schedule(LED_PERIOD, raise_led, NULL);
+}
+
+static void sensor_main(void * arg)
+{
+	uint64_t response;
+
+	(void) arg;
+	for (;;)
+	{
+		KERNEL_semTake(&sensor_sem, KERNEL_WAIT_FOREVER);
+		response = HOST_getCycles() - sensor_edge;
+		sensor_total += response;
+		if (response > sensor_max)
+			sensor_max = response;
+		HOST_busy(SENSOR_CYCLES);
+		if (++samples % OUTPUT_SAMPLES == 0)
+			KERNEL_semGive(&output_sem);
+	}
+}
+
+static void output_main(void * arg)
+{
+	(void) arg;
+	for (;;)
+	{
+		KERNEL_semTake(&output_sem, KERNEL_WAIT_FOREVER);
+		HOST_busy(OUTPUT_CYCLES);
+		outputs++;
+	}
+}
+
+static void led_main(void * arg)
+{
+	(void) arg;
+	for (;;)
+	{
+		KERNEL_semTake(&led_sem, KERNEL_WAIT_FOREVER);
+		HOST_busy(LED_CYCLES);
+		leds++;
+	}
+}
+
+static void signal_latency(void)
+{
+	uint64_t cpu;
+
+	HOST_reset();
+	IRQ_initGrouping();
+	KERNEL_init();
+	KERNEL_semInit(&sensor_sem, 0);
+	KERNEL_semInit(&output_sem, 0);
+	KERNEL_semInit(&led_sem, 0);
+	KERNEL_createThread(&threads[0], "sensor", sensor_main, NULL, 0, stacks[0], KERNEL_STACK_MIN);
+	KERNEL_createThread(&threads[1], "led", led_main, NULL, 1, stacks[1], KERNEL_STACK_MIN);
+	KERNEL_createThread(&threads[2], "output", output_main, NULL, 2, stacks[2], KERNEL_STACK_MIN);
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(0, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, &sensor_sem);
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, &led_sem);
+	IRQ_setPriority(EXTI_getIRQn(0), IRQ_LEVEL_DRIVER, 0);
+	IRQ_setPriority(EXTI_getIRQn(1), IRQ_LEVEL_DRIVER, 1);
+	HOST_schedule(SENSOR_PERIOD, raise_sensor, NULL);
+	HOST_schedule(LED_PERIOD, raise_led, NULL);
+
+	cpu = HOST_getCpuCycles();
+	HOST_KERNEL_run(RUN_CYCLES);
+	cpu = HOST_getCpuCycles() - cpu;
+
+	printf("  %u samples, %u outputs, %u LED updates, %u context switches\n",
+				 samples, outputs, leds, KERNEL_getSwitchCount());
+	printf("  CPU busy %.1f %% of %llu cycles, asleep the rest\n",
+				 100.0 * cpu / HOST_getCycles(), (unsigned long long) HOST_getCycles());
+	printf("  sensor edge to thread %.1f cycles mean, %llu max (output thread %d cycles)\n",
+				 (double) sensor_total / samples, (unsigned long long) sensor_max, OUTPUT_CYCLES);
+	EXTI_detach(0);
+	EXTI_detach(1);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	HOST_reset();
+	printf("Context switch, %d rounds\n", SWITCH_ROUNDS);
+	context_switch();
+	printf("Signal: sensor every %d cycles, LED every %d cycles\n", SENSOR_PERIOD, LED_PERIOD);
+	signal_latency();
+	return 0;
+}
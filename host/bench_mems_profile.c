@@ -0,0 +1,106 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_mems_profile.c
+ * Purpose: Cost of the MEMS service under load, measured by its profiling sections
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Built with PROF_ENABLED. The LIS3DSH model produces samples at 1600 Hz
+ * while the main loop polls the temperature with MEMS_getData() and
+ * drains the data-ready ring, then the same with the FIFO stream mode.
+ * Reports the MEMS_init, MEMS_getData and INT1 interrupt sections in CPU
+ * cycles of the model.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "host_lis3dsh.h"
+#include "mems_LIS3DSH.h"
+#include "profiling.h"
+
+#define ODR_CYCLES		(168000000 / 1600)					///< Sample period at ODR 1600 Hz
+#define SAMPLES				400
+
+static void report(const char * title)
+{
+	const PROF_Section * section;
+	uint8_t id, bin;
+
+	printf("%s\n", title);
+	printf("  section          count      min     mean      max   histogram (log2 bin:count)\n");
+	for (id = 0; id < PROF_getSectionCount(); id++)
+	{
+		section = PROF_getSection(id);
+		if (section->count == 0)
+			continue;
+		printf("  %-14s %7u %8u %8u %8u  ", section->name, section->count,
+					 section->min, PROF_getMean(section), section->max);
+		for (bin = 0; bin < PROF_HISTOGRAM_BINS; bin++)
+		{
+			if (section->histogram[bin] != 0)
+				printf(" %u:%u", bin, section->histogram[bin]);
+		}
+		printf("\n");
+	}
+}
+
+static void on_samples(int16_t (*samples)[3], uint8_t count, void * context)
+{
+	(void) samples;
+	*(uint32_t *) context += count;
+}
+
+/* Main loop polling the MEMS while the samples arrive */
+static void run(RING_Buffer * ring)
+{
+	int16_t sample[3];
+	uint64_t next = HOST_getCycles();
+	int16_t n;
+
+	for (n = 0; n < SAMPLES; n++)
+	{
+		next += ODR_CYCLES;
+		while (HOST_getCycles() < next)
+		{
+			MEMS_getData(MEMS_TEMPERATURE);
+			if (ring != NULL)
+				while (RING_pop(ring, sample));
+		}
+		HOST_LIS3DSH_setSample(n, (int16_t) -n, (int16_t) (2 * n));
+	}
+	HOST_advance(1);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	static int16_t storage[64][3];
+	RING_Buffer ring;
+	uint32_t received = 0;
+
+	HOST_reset();
+	PROF_init();
+	HOST_LIS3DSH_attach(MEMS_SPI, MEMS_GPIO_CS, MEMS_PIN_CS);
+	HOST_LIS3DSH_attachInt1(MEMS_GPIO_INT1, MEMS_PIN_INT1);
+	MEMS_CLK_ENABLE();
+	MEMS_init();
+	printf("%d samples at 1600 Hz, durations in CPU cycles (168 MHz)\n", SAMPLES);
+
+	RING_init(&ring, storage, sizeof(storage[0]), 64);
+	MEMS_startDataReady(&ring, NULL, NULL);
+	run(&ring);
+	MEMS_stopDataReady();
+	report("Data-ready mode (one interrupt per sample)");
+
+	PROF_reset();
+	MEMS_startFifoStream(25, on_samples, &received);
+	run(NULL);
+	MEMS_stopFifoStream();
+	report("FIFO stream mode (watermark 25)");
+	if (received < SAMPLES - 25)
+		printf("  %u samples received, expected at least %d\n", received, SAMPLES - 25);
+	return 0;
+}
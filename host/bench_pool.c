@@ -0,0 +1,117 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_pool.c
+ * Purpose: Allocation latency of the fixed-block pool against malloc
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Built with PROF_ENABLED and PROF_HOST_CLOCK: each allocation and free
+ * is a profiling section, in ns of the Linux clock. The same random
+ * sequence keeps up to LIVE blocks: a sample block of SAMPLE_SIZE bytes
+ * taken from the pool, or a buffer of 16 to SAMPLE_SIZE bytes from the C
+ * library heap, which fragments it. The pool costs the same whatever the
+ * sequence, malloc depends on the state of the heap: compare the max and
+ * the spread of the histograms, the min and mean are close on a PC.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_model.h"
+#include "pool.h"
+#include "profiling.h"
+
+#define SAMPLE_SIZE		(32 * 6)											///< 32 samples of 3 axes
+#define LIVE					64
+#define OPERATIONS		200000
+
+static uint64_t storage[POOL_STORAGE_SIZE(SAMPLE_SIZE, LIVE)];
+static POOL_Pool pool;
+static void * live[LIVE];
+static uint32_t seed = 12345;
+
+static uint32_t random(uint32_t range)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) % range;
+}
+
+static void report(const char * title)
+{
+	const PROF_Section * section;
+	uint8_t id, bin;
+
+	printf("%s\n", title);
+	printf("  section          count      min     mean      max   histogram (log2 bin:count)\n");
+	for (id = 0; id < PROF_getSectionCount(); id++)
+	{
+		section = PROF_getSection(id);
+		if (section->count == 0)
+			continue;
+		printf("  %-14s %7u %8u %8u %8u  ", section->name, section->count,
+					 section->min, PROF_getMean(section), section->max);
+		for (bin = 0; bin < PROF_HISTOGRAM_BINS; bin++)
+		{
+			if (section->histogram[bin] != 0)
+				printf(" %u:%u", bin, section->histogram[bin]);
+		}
+		printf("\n");
+	}
+}
+
+static void run(bool heap)
+{
+	PROF_Id alloc_id = PROF_register(heap ? "malloc" : "POOL_alloc");
+	PROF_Id free_id = PROF_register(heap ? "free" : "POOL_free");
+	uint32_t n, slot, start;
+
+	seed = 12345;
+	for (n = 0; n < OPERATIONS; n++)
+	{
+		slot = random(LIVE);
+		if (live[slot] == NULL)
+		{
+			uint32_t size = 16 + random(SAMPLE_SIZE - 16 + 1);
+
+			start = PROF_begin();
+			live[slot] = heap ? malloc(size) : POOL_alloc(&pool);
+			PROF_end(alloc_id, start);
+			((volatile uint8_t *) live[slot])[0] = (uint8_t) n;
+		}
+		else
+		{
+			start = PROF_begin();
+			if (heap)
+				free(live[slot]);
+			else
+				POOL_free(&pool, live[slot]);
+			PROF_end(free_id, start);
+			live[slot] = NULL;
+		}
+	}
+	for (slot = 0; slot < LIVE; slot++)
+	{
+		if (heap)
+			free(live[slot]);
+		else
+			POOL_free(&pool, live[slot]);
+		live[slot] = NULL;
+	}
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	HOST_reset();
+	PROF_init();
+	POOL_init(&pool, storage, SAMPLE_SIZE, LIVE);
+
+	printf("%d random allocations and frees, up to %d blocks of %d bytes live\n", OPERATIONS, LIVE, SAMPLE_SIZE);
+	run(false);
+	run(true);
+	report("Latency (ns)");
+	printf("  pool peak %u blocks, %u failures\n", POOL_getPeak(&pool), POOL_getFailures(&pool));
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_ram_isr.c
+ * Purpose: Interrupt latency with the handlers in the flash or in the SRAM
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	An EXTI1 edge arrives at a random time of each period while the main
+ * loop runs from the flash, ART accelerator on (BOOT_initFlash, 5 wait
+ * states). The latency is counted from the edge to the first instruction
+ * of the application callback, through the code of an -O2 build:
+ *		- EXTI1_IRQHandler: 32 bytes, 8 cycles.
+ *		- EXTI_dispatch(): 96 bytes, 30 cycles, plus its EXTI PR accesses.
+ *		- Callback prologue: 128 bytes, 40 cycles.
+ * then the callback runs 256 bytes of processing. A main loop of 512
+ * bytes leaves the handlers in the 64 lines of the instruction cache, one
+ * of 8 KB evicts them between two edges. In the SRAM (MEM_RAMCODE) the
+ * handlers never wait, whatever the main loop.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include "host_model.h"
+#include "interrupt.h"
+#include "boot.h"
+
+#define PERIOD					20000
+#define PERIODS					2000
+#define CHUNK_SIZE			256																		///< Main loop code run per HOST_execute()
+#define CHUNK_CYCLES		160
+#define MAIN_ADDRESS		(FLASH_BASE + 0x4000)
+#define HANDLER_OFFSET	0x10000																///< Handlers apart from the main loop
+
+typedef struct
+{
+	const char * name;
+	uint32_t handlers;																						///< Base address of the handlers
+	uint32_t main_size;																						///< Size of the main loop
+} Case;
+
+static const Case cases[] =
+{
+	{ "flash, 512 B main loop",		FLASH_BASE + HANDLER_OFFSET,	512 },
+	{ "flash, 8 KB main loop",		FLASH_BASE + HANDLER_OFFSET,	8 * 1024 },
+	{ "SRAM, 8 KB main loop",			SRAM1_BASE + HANDLER_OFFSET,	8 * 1024 }
+};
+
+typedef struct
+{
+	uint32_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t total;
+} Stats;
+
+static Stats latency;
+static uint64_t edge;
+static uint32_t handlers;
+static uint32_t seed = 12345;
+
+static void stats_add(Stats * s, uint64_t value)
+{
+	if (s->count == 0 || value < s->min)
+		s->min = value;
+	if (value > s->max)
+		s->max = value;
+	s->total += value;
+	s->count++;
+}
+
+static void raise_edge(void * context)
+{
+	(void) context;
+	edge = HOST_getCycles();
+	HOST_GPIO_setInput(GPIOA, 1, true);
+	HOST_GPIO_setInput(GPIOA, 1, false);
+}
+
+/* The driver code charged before the callback, then the callback */
+static void on_edge(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	HOST_execute(handlers, 32, 8);
+	HOST_execute(handlers + 0x100, 96, 30);
+	HOST_execute(handlers + 0x200, 128, 40);
+	stats_add(&latency, HOST_getCycles() - edge);
+	HOST_execute(handlers + 0x280, 256, 150);
+}
+
+static void run(const Case * c)
+{
+	uint32_t n, offset = 0;
+	uint64_t end, stalls;
+
+	HOST_reset();
+	memset(&latency, 0, sizeof(Stats));
+	handlers = c->handlers;
+	BOOT_initFlash(RCC_readHCLK());
+
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_edge, NULL);
+
+	for (n = 0; n < PERIODS; n++)
+	{
+		seed = seed * 1103515245 + 12345;
+		HOST_schedule((seed >> 8) % PERIOD, raise_edge, NULL);
+		end = HOST_getCycles() + PERIOD;
+		while (HOST_getCycles() < end)
+		{
+			HOST_execute(MAIN_ADDRESS + offset, CHUNK_SIZE, CHUNK_CYCLES);
+			offset = (offset + CHUNK_SIZE) % c->main_size;
+		}
+	}
+	stalls = HOST_getFetchStalls();
+	EXTI_detach(1);
+
+	printf("  %-24s %8llu %8llu %8llu %8llu %8llu\n", c->name, (unsigned long long) latency.min,
+				 (unsigned long long) (latency.total / latency.count), (unsigned long long) latency.max,
+				 (unsigned long long) (latency.max - latency.min), (unsigned long long) (stalls / PERIODS));
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	uint8_t i;
+
+	printf("Edge to callback at 168 MHz, 5 wait states, %d edges\n", PERIODS);
+	printf("  %-24s %8s %8s %8s %8s %8s\n", "cycles", "min", "mean", "max", "jitter", "stalls");
+	printf("  %-24s %8s %8s %8s %8s %8s\n", "", "", "", "", "", "/period");
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+		run(&cases[i]);
+	return 0;
+}
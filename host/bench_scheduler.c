@@ -0,0 +1,182 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_scheduler.c
+ * Purpose: Cooperative scheduler dispatch cost and a simulated task mix
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Dispatch: N tasks spread over the priorities are posted then run
+ * until none is ready. Host nanoseconds per post and run, timed with the
+ * profiling service built with PROF_HOST_CLOCK: the PRIMASK sections
+ * go through the model, only the growth with N is meaningful.
+ *	Task mix, in virtual cycles: a sensor interrupt every SENSOR_PERIOD
+ * wakes the sensor task (priority 0), which wakes the output task
+ * (priority 2) every OUTPUT_SAMPLES samples, a LED interrupt wakes the
+ * LED task (priority 1). The core sleeps in WFI between them. A task
+ * isn't preempted by a more urgent one: the sensor task waits for the
+ * output task when it is woken during it.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "scheduler.h"
+#include "interrupt.h"
+#include "profiling.h"
+#include "rcc.h"
+
+#define DISPATCH_ROUNDS		20000
+#define SENSOR_PERIOD			10000
+#define SENSOR_CYCLES			300
+#define OUTPUT_SAMPLES		16
+#define OUTPUT_CYCLES			15000
+#define LED_PERIOD				168000
+#define LED_CYCLES				100
+#define RUN_CYCLES				168000000								///< 1 s at 168 MHz
+
+/*----------------------------------------------------------------------------
+  Dispatch cost
+ *----------------------------------------------------------------------------*/
+
+static uint32_t dispatched;
+
+static void count(uint32_t events, void * context)
+{
+	(void) events;
+	(void) context;
+	dispatched++;
+}
+
+static void dispatch(uint32_t tasks)
+{
+	static SCHED_Task table[64];
+	uint64_t start, elapsed;
+	uint32_t round, i;
+
+	SCHED_init();
+	for (i = 0; i < tasks; i++)
+		SCHED_initTask(&table[i], count, NULL, (uint8_t) (i % SCHED_PRIORITIES));
+
+	dispatched = 0;
+	start = PROF_getTimestamp();
+	for (round = 0; round < DISPATCH_ROUNDS; round++)
+	{
+		for (i = 0; i < tasks; i++)
+			SCHED_post(&table[i], 0x1);
+		while (SCHED_runNext());
+	}
+	elapsed = PROF_getTimestamp() - start;
+	printf("  %2u ready tasks  %6.1f ns per post and run\n", tasks, (double) elapsed / dispatched);
+}
+
+
+/*----------------------------------------------------------------------------
+  Task mix
+ *----------------------------------------------------------------------------*/
+
+static SCHED_Task sensor, output, led;
+static SCHED_Event sensor_event = { &sensor, 0x1 };
+static SCHED_Event led_event = { &led, 0x1 };
+static uint64_t sensor_edge, sensor_max;
+static uint32_t samples, outputs, leds;
+
+static void on_line(u8 line, void * context)
+{
+	(void) line;
+	SCHED_signal(context);
+}
+
+static void pulse(uint8_t pin)
+{
+	HOST_GPIO_setInput(GPIOA, pin, true);
+	HOST_GPIO_setInput(GPIOA, pin, false);
+}
+
+static void raise_sensor(void * context)
+{
+	(void) context;
+	sensor_edge = HOST_getCycles();
+	pulse(0);
+	HOST_schedule(SENSOR_PERIOD, raise_sensor, NULL);
+}
+
+static void raise_led(void * context)
+{
+	(void) context;
+	pulse(1);
+	HOST_schedule(LED_PERIOD, raise_led, NULL);
+}
+
+static void on_sensor(uint32_t events, void * context)
+{
+	uint64_t response = HOST_getCycles() - sensor_edge;
+
+	(void) events;
+	(void) context;
+	if (response > sensor_max)
+		sensor_max = response;
+	HOST_busy(SENSOR_CYCLES);
+	if (++samples % OUTPUT_SAMPLES == 0)
+		SCHED_post(&output, 0x1);
+}
+
+static void on_output(uint32_t events, void * context)
+{
+	(void) events;
+	(void) context;
+	HOST_busy(OUTPUT_CYCLES);
+	outputs++;
+}
+
+static void on_led(uint32_t events, void * context)
+{
+	(void) events;
+	(void) context;
+	HOST_busy(LED_CYCLES);
+	leds++;
+}
+
+static void mix(void)
+{
+	uint64_t cpu;
+
+	HOST_reset();
+	SCHED_init();
+	SCHED_initTask(&sensor, on_sensor, NULL, 0);
+	SCHED_initTask(&led, on_led, NULL, 1);
+	SCHED_initTask(&output, on_output, NULL, 2);
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(0, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, &sensor_event);
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, &led_event);
+	HOST_schedule(SENSOR_PERIOD, raise_sensor, NULL);
+	HOST_schedule(LED_PERIOD, raise_led, NULL);
+
+	cpu = HOST_getCpuCycles();
+	while (HOST_getCycles() < RUN_CYCLES)
+		SCHED_runOnce();
+	cpu = HOST_getCpuCycles() - cpu;
+
+	printf("  %u samples, %u outputs, %u LED updates, %u task runs, %u sleeps\n",
+				 samples, outputs, leds, SCHED_getRunCount(), SCHED_getIdleCount());
+	printf("  CPU busy %.1f %% of %llu cycles, asleep the rest\n",
+				 100.0 * cpu / HOST_getCycles(), (unsigned long long) HOST_getCycles());
+	printf("  sensor edge to task max %llu cycles (output task %d cycles)\n",
+				 (unsigned long long) sensor_max, OUTPUT_CYCLES);
+	EXTI_detach(0);
+	EXTI_detach(1);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	HOST_reset();
+	printf("Dispatch, %d rounds\n", DISPATCH_ROUNDS);
+	dispatch(1);
+	dispatch(8);
+	dispatch(64);
+	printf("Task mix: sensor every %d cycles, LED every %d cycles\n", SENSOR_PERIOD, LED_PERIOD);
+	mix();
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_spi_dma.c
+ * Purpose: CPU cost of an accelerometer burst, polled vs DMA
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Reads 7 bytes (address + OUT_X_L..OUT_Z_H) SAMPLES times, once with
+ * the byte-wise busy-wait loop of mems_LIS3DSH.c and once with
+ * SPI_transferDMA(), and reports the CPU cycles spent per burst on the
+ * virtual clock of the host model (WFI time is not CPU time).
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "spi.h"
+#include "rcc.h"
+
+#define SAMPLES		1000
+#define BURST			7
+
+static uint8_t slave_exchange(void * ctx, uint8_t mosi)
+{
+	(void) ctx;
+	return (uint8_t) (mosi + 1);
+}
+
+static void setup(void)
+{
+	HOST_SPISlave desc = { NULL, slave_exchange, NULL, NULL, NULL, 0 };
+
+	HOST_reset();
+	HOST_SPI_attachSlave(SPI1, &desc);
+	SPI1_CLK_ENABLE();
+	DMA2_CLK_ENABLE();
+	SPI_initBaudRate(SPI1, SPI_BaudRatePrescaler_2);
+	SPI_initMasterConfiguration(SPI1);
+	SPI_initSoftwareSlaveMgmtEnabled(SPI1);
+	SPI_initSetInternalSlaveSelectHigh(SPI1);
+	SPI_enable(SPI1);
+	SPI_initDMA(SPI1);
+}
+
+static void burst_polled(const uint8_t * tx, uint8_t * rx)
+{
+	uint8_t i;
+
+	for (i = 0; i < BURST; i++)
+	{
+		while (SPI_hasDataToSend(SPI1));
+		SPI_writeData(SPI1, tx[i]);
+		while (!SPI_hasDataToReceive(SPI1));
+		rx[i] = (uint8_t) SPI_readData(SPI1);
+	}
+}
+
+static void report(const char * name, uint64_t start, uint64_t cpu_start)
+{
+	uint64_t total = HOST_getCycles() - start;
+	uint64_t cpu = HOST_getCpuCycles() - cpu_start;
+
+	printf("%-8s %8.1f cycles/burst  %8.1f CPU cycles/burst  CPU load %5.1f %%\n", name,
+		(double) total / SAMPLES, (double) cpu / SAMPLES, 100.0 * (double) cpu / (double) total);
+}
+
+int main(void)
+{
+	uint8_t tx[BURST] = { 0xE8, 0, 0, 0, 0, 0, 0 };
+	uint8_t rx[BURST];
+	uint64_t start, cpu_start;
+	int i;
+
+	printf("SPI1 /2, %d bytes per burst, %d bursts\n", BURST, SAMPLES);
+
+	setup();
+	start = HOST_getCycles();
+	cpu_start = HOST_getCpuCycles();
+	for (i = 0; i < SAMPLES; i++)
+		burst_polled(tx, rx);
+	report("polled", start, cpu_start);
+
+	setup();
+	start = HOST_getCycles();
+	cpu_start = HOST_getCpuCycles();
+	for (i = 0; i < SAMPLES; i++)
+	{
+		SPI_transferDMA(SPI1, tx, rx, BURST, NULL, NULL);
+		while (SPI_isDMABusy(SPI1))
+			__WFI();
+	}
+	report("dma", start, cpu_start);
+
+	return 0;
+}
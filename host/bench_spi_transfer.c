@@ -0,0 +1,97 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_spi_transfer.c
+ * Purpose: SPI polled throughput, byte-wise loop vs SPI_transferBuffer()
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Transfers LENGTH bytes full-duplex at several baud rate prescalers,
+ * once with the byte-wise busy-wait loop mems_LIS3DSH.c used before
+ * SPI_transferBuffer() and once with SPI_transferBuffer(), and reports
+ * the throughput at 168 MHz and the idle SCK periods between frames.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host_model.h"
+#include "spi.h"
+#include "rcc.h"
+
+#define LENGTH		1024
+#define CPU_HZ		168000000.0
+
+static uint8_t slave_exchange(void * ctx, uint8_t mosi)
+{
+	(void) ctx;
+	return (uint8_t) (mosi + 1);
+}
+
+static void setup(uint16_t prescaler)
+{
+	HOST_SPISlave desc = { NULL, slave_exchange, NULL, NULL, NULL, 0 };
+
+	HOST_reset();
+	HOST_SPI_attachSlave(SPI1, &desc);
+	SPI1_CLK_ENABLE();
+	SPI_initBaudRate(SPI1, prescaler);
+	SPI_initMasterConfiguration(SPI1);
+	SPI_initSoftwareSlaveMgmtEnabled(SPI1);
+	SPI_initSetInternalSlaveSelectHigh(SPI1);
+	SPI_enable(SPI1);
+}
+
+static void transfer_bytewise(const uint8_t * tx, uint8_t * rx, uint16_t length)
+{
+	uint16_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		while (SPI_hasDataToSend(SPI1));
+		SPI_writeData(SPI1, tx[i]);
+		while (!SPI_hasDataToReceive(SPI1));
+		rx[i] = (uint8_t) SPI_readData(SPI1);
+	}
+}
+
+/* Returns the throughput in bytes/s */
+static double run(int pipelined, uint16_t prescaler, unsigned divider)
+{
+	static uint8_t tx[LENGTH], rx[LENGTH];
+	HOST_SPIStats stats;
+	uint64_t start, total;
+	double bytes_per_s;
+
+	setup(prescaler);
+	start = HOST_getCycles();
+	if (pipelined)
+		SPI_transferBuffer(SPI1, tx, rx, LENGTH);
+	else
+		transfer_bytewise(tx, rx, LENGTH);
+	total = HOST_getCycles() - start;
+	HOST_SPI_getStats(SPI1, &stats);
+
+	bytes_per_s = LENGTH * CPU_HZ / (double) total;
+	printf("  %-10s %9.0f bytes/s  %5.2f idle SCK/frame  (max %llu CPU cycles)\n",
+		pipelined ? "pipelined" : "byte-wise", bytes_per_s,
+		(double) stats.gap_cycles / (double) (stats.frames - 1) / (double) (2 * divider),
+		(unsigned long long) stats.max_gap);
+	return bytes_per_s;
+}
+
+int main(void)
+{
+	static const uint16_t prescalers[4] = { SPI_BaudRatePrescaler_2, SPI_BaudRatePrescaler_4, SPI_BaudRatePrescaler_8, SPI_BaudRatePrescaler_32 };
+	static const unsigned dividers[4] = { 2, 4, 8, 32 };
+	int i;
+
+	printf("SPI1, %d bytes per transfer\n", LENGTH);
+	for (i = 0; i < 4; i++)
+	{
+		double bytewise, pipelined;
+
+		printf("/%u\n", dividers[i]);
+		bytewise = run(0, prescalers[i], dividers[i]);
+		pipelined = run(1, prescalers[i], dividers[i]);
+		printf("  gain %.2fx\n", pipelined / bytewise);
+	}
+	return 0;
+}
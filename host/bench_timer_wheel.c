@@ -0,0 +1,194 @@
+/*----------------------------------------------------------------------------
+ * Name:    bench_timer_wheel.c
+ * Purpose: Timer wheel insert/cancel/expire cost vs a sorted list
+ * Note(s): make -C host bench
+ *----------------------------------------------------------------------------
+ *
+ *	Starts N one-shot timers with random delays in [1, MAX_DELAY], cancels
+ * half of them, then ticks until the others have expired, once with the
+ * timer wheel and once with a sorted doubly linked list (the usual
+ * single hardware timer multiplexing). Both mask the interrupts around
+ * start and cancel. Reports host nanoseconds per operation, timed with
+ * the profiling service built with PROF_HOST_CLOCK: only the ratio
+ * between the two is meaningful for the target.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_model.h"
+#include "timer_wheel.h"
+#include "profiling.h"
+
+#define MAX_DELAY		65536
+#define MAX_TIMERS	16384
+
+/*----------------------------------------------------------------------------
+  Sorted list baseline
+ *----------------------------------------------------------------------------*/
+
+typedef struct SortedTimer
+{
+	struct SortedTimer * next;
+	struct SortedTimer * prev;
+	uint32_t expiry;
+	WHEEL_Callback callback;
+	void * context;
+} SortedTimer;
+
+typedef struct
+{
+	SortedTimer head;
+	uint32_t now;
+} SortedList;
+
+static void sorted_init(SortedList * list)
+{
+	list->head.next = &list->head;
+	list->head.prev = &list->head;
+	list->now = 0;
+}
+
+static void sorted_start(SortedList * list, SortedTimer * timer, uint32_t delay, WHEEL_Callback callback, void * context)
+{
+	SortedTimer * after;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();																	// Same critical section as the wheel
+	after = list->head.prev;
+	timer->expiry = list->now + delay - 1;
+	timer->callback = callback;
+	timer->context = context;
+	while (after != &list->head && (int32_t) (after->expiry - timer->expiry) > 0)
+		after = after->prev;
+	timer->prev = after;
+	timer->next = after->next;
+	after->next->prev = timer;
+	after->next = timer;
+	__set_PRIMASK(primask);
+}
+
+static void sorted_unlink(SortedTimer * timer)
+{
+	timer->prev->next = timer->next;
+	timer->next->prev = timer->prev;
+}
+
+static void sorted_cancel(SortedTimer * timer)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	sorted_unlink(timer);
+	__set_PRIMASK(primask);
+}
+
+static void sorted_tick(SortedList * list)
+{
+	SortedTimer * timer;
+
+	while (list->head.next != &list->head && list->head.next->expiry == list->now)
+	{
+		timer = list->head.next;
+		sorted_unlink(timer);
+		timer->callback(timer->context);
+	}
+	list->now++;
+}
+
+/*----------------------------------------------------------------------------
+  Bench
+ *----------------------------------------------------------------------------*/
+
+static WHEEL_Timer wheel_timers[MAX_TIMERS];
+static SortedTimer sorted_timers[MAX_TIMERS];
+static uint32_t delays[MAX_TIMERS];
+static uint32_t order[MAX_TIMERS];
+static uint32_t fired;
+
+static void on_expiry(void * context)
+{
+	(void) context;
+	fired++;
+}
+
+static double now_ns(void)
+{
+	return (double) PROF_getTimestamp();
+}
+
+static void bench(uint32_t n)
+{
+	static WHEEL_Wheel wheel;
+	static SortedList list;
+	double t0, insert[2], cancel[2], expire[2];
+	uint32_t i, tick;
+
+	for (i = 0; i < n; i++)
+	{
+		delays[i] = 1 + rand() % MAX_DELAY;
+		order[i] = i;
+	}
+	for (i = n - 1; i > 0; i--)
+	{
+		uint32_t j = rand() % (i + 1), swap = order[i];
+		order[i] = order[j];
+		order[j] = swap;
+	}
+
+	WHEEL_init(&wheel);
+	fired = 0;
+	t0 = now_ns();
+	for (i = 0; i < n; i++)
+		WHEEL_start(&wheel, &wheel_timers[i], delays[i], 0, on_expiry, NULL);
+	insert[0] = (now_ns() - t0) / n;
+	t0 = now_ns();
+	for (i = 0; i < n / 2; i++)
+		WHEEL_cancel(&wheel, &wheel_timers[order[i]]);
+	cancel[0] = (now_ns() - t0) / (n / 2);
+	t0 = now_ns();
+	for (tick = 0; tick < MAX_DELAY; tick++)
+		WHEEL_tick(&wheel);
+	expire[0] = (now_ns() - t0) / MAX_DELAY;
+	if (fired != n - n / 2)
+		printf("  wheel: %u expired, expected %u\n", fired, n - n / 2);
+
+	sorted_init(&list);
+	fired = 0;
+	t0 = now_ns();
+	for (i = 0; i < n; i++)
+		sorted_start(&list, &sorted_timers[i], delays[i], on_expiry, NULL);
+	insert[1] = (now_ns() - t0) / n;
+	t0 = now_ns();
+	for (i = 0; i < n / 2; i++)
+		sorted_cancel(&sorted_timers[order[i]]);
+	cancel[1] = (now_ns() - t0) / (n / 2);
+	t0 = now_ns();
+	for (tick = 0; tick < MAX_DELAY; tick++)
+		sorted_tick(&list);
+	expire[1] = (now_ns() - t0) / MAX_DELAY;
+	if (fired != n - n / 2)
+		printf("  sorted: %u expired, expected %u\n", fired, n - n / 2);
+
+	printf("%6u  %8.1f %8.1f   %8.1f %8.1f   %8.1f %8.1f\n", n,
+				 insert[0], insert[1], cancel[0], cancel[1], expire[0], expire[1]);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	static const uint32_t sizes[] = { 16, 256, 1024, 4096, MAX_TIMERS };
+	uint32_t i;
+
+	HOST_reset();
+	srand(1);
+	printf("Delays in [1, %d] ticks, ns per operation (host)\n", MAX_DELAY);
+	printf("timers    insert            cancel            tick (expire)\n");
+	printf("          wheel   sorted    wheel   sorted    wheel   sorted\n");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		bench(sizes[i]);
+	return 0;
+}
@@ -0,0 +1,47 @@
+/**
+* @file 		host_kernel.h
+* @brief		Header file of the kernel port of the host build.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	Header file listing the functions required to run the threads of the
+* preemptive kernel (kernel.h) on the host peripheral model.
+*
+*		1. The threads are ucontext contexts with stacks of the heap, the
+*		stacks given to KERNEL_createThread are unused. KERNEL_init frees
+*		the contexts of the previous threads.
+*		2. PendSV_Handler runs the deferred work and requests the switch,
+*		done by the thread hook of the model (HOST_setThreadHook) when it
+*		returns to thread mode, as the exception return would. It counts
+*		HOST_KERNEL_SWITCH_CYCLES of the target handler.
+*		3. Once the kernel started, an event pends SysTick every
+*		SystemCoreClock / KERNEL_TICK_HZ cycles.
+*		4. The test (main context) runs the threads for a number of cycles
+*		then checks their state: HOST_KERNEL_run returns once the clock
+*		reached the deadline and the kernel isn't locked. The next call
+*		resumes the thread which was running.
+*		5. A test usually goes like this, built with KERNEL_ENABLED:
+*				HOST_reset();
+*				IRQ_initGrouping();
+*				KERNEL_init();
+*				KERNEL_createThread(&thread, "t", entry, NULL, 1, stack, 64);
+*				HOST_KERNEL_run(100000);
+*				// check the threads
+*/
+
+#ifndef HOST_KERNEL_H
+#define HOST_KERNEL_H
+
+#include "host_model.h"
+
+#define HOST_KERNEL_SWITCH_CYCLES		40							///< PendSV save, KERNEL_switch and restore, without the FPU registers
+
+/**
+ * Threads run for cycles of the virtual clock.
+ * The first call after KERNEL_init starts the kernel (KERNEL_start).
+ * @param[in]	cycles Cycles before returning to the caller.
+ */
+void HOST_KERNEL_run(uint32_t cycles);
+
+#endif
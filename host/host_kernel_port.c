@@ -0,0 +1,162 @@
+/**
+* @file 		host_kernel_port.c
+* @brief		Kernel port of the host build.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	See host_kernel.h.
+*
+*/
+
+#include <stdlib.h>
+#include <ucontext.h>
+#include "host_kernel.h"
+#include "kernel_port.h"
+#include "interrupt.h"
+#include "work_queue.h"
+
+#define HOST_KERNEL_STACK		(256 * 1024)
+
+typedef struct HostThread
+{
+	ucontext_t context;
+	KERNEL_Entry entry;
+	void * arg;
+	struct HostThread * next;														///< Contexts freed by KPORT_init
+	char stack[HOST_KERNEL_STACK];
+}HostThread;
+
+static HostThread * host_threads;
+static ucontext_t host_main;																///< Context of HOST_KERNEL_run
+static bool host_started;
+static bool host_switch;																		///< Requested by PendSV
+static uint64_t host_deadline;
+
+static ucontext_t * host_context(KERNEL_Thread * thread)
+{
+	return &((HostThread *) thread->sp)->context;
+}
+
+static void host_entry(void)
+{
+	HostThread * thread = (HostThread *) KERNEL_getCurrent()->sp;
+
+	thread->entry(thread->arg);
+	KERNEL_exit();
+}
+
+static void host_tick(void * ctx)
+{
+	(void) ctx;
+	NVIC_SetPendingIRQ(SysTick_IRQn);
+	HOST_schedule(SystemCoreClock / KERNEL_TICK_HZ, host_tick, NULL);
+}
+
+/* Deadline: PendSV wakes the idle thread, the hook returns to the test */
+static void host_stop(void * ctx)
+{
+	(void) ctx;
+	NVIC_SetPendingIRQ(PendSV_IRQn);
+}
+
+/* Back in thread mode: return to the test, then switch as PendSV requested */
+static void host_threadHook(void)
+{
+	KERNEL_Thread * from = KERNEL_getCurrent();
+
+	if (HOST_getCycles() >= host_deadline && __get_BASEPRI() == 0 && __get_PRIMASK() == 0)
+	{
+		HOST_setThreadHook(NULL);
+		swapcontext(host_context(from), &host_main);							// Resumed by the next HOST_KERNEL_run
+	}
+	if (host_switch)
+	{
+		host_switch = false;
+		KERNEL_switch(from->sp);
+		if (KERNEL_getCurrent() != from)
+			swapcontext(host_context(from), host_context(KERNEL_getCurrent()));
+	}
+}
+
+void HOST_KERNEL_run(uint32_t cycles)
+{
+	host_deadline = HOST_getCycles() + cycles;
+	HOST_schedule(cycles, host_stop, NULL);
+	if (!host_started)
+		KERNEL_start();
+	else
+	{
+		HOST_setThreadHook(host_threadHook);
+		swapcontext(&host_main, host_context(KERNEL_getCurrent()));
+	}
+}
+
+
+/*----------------------------------------------------------------------------
+  Port
+ *----------------------------------------------------------------------------*/
+
+void KPORT_init(void)
+{
+	HostThread * thread;
+
+	while (host_threads != NULL)
+	{
+		thread = host_threads;
+		host_threads = thread->next;
+		free(thread);
+	}
+	host_started = false;
+	host_switch = false;
+	WORK_init();
+}
+
+void * KPORT_initStack(uint32_t * stack, uint32_t words, KERNEL_Entry entry, void * arg)
+{
+	HostThread * thread = (HostThread *) malloc(sizeof(HostThread));
+
+	KPORT_initFrame(stack, words, entry, arg);												// Image of the target stack
+	thread->entry = entry;
+	thread->arg = arg;
+	thread->next = host_threads;
+	host_threads = thread;
+	getcontext(&thread->context);
+	thread->context.uc_stack.ss_sp = thread->stack;
+	thread->context.uc_stack.ss_size = sizeof(thread->stack);
+	thread->context.uc_link = NULL;
+	makecontext(&thread->context, host_entry, 0);
+	return thread;
+}
+
+void KPORT_start(void)
+{
+	IRQ_setPriority(SysTick_IRQn, IRQ_LEVEL_TIMER, 0);
+	HOST_schedule(SystemCoreClock / KERNEL_TICK_HZ, host_tick, NULL);
+	host_started = true;
+	KERNEL_switch(NULL);
+	HOST_setThreadHook(host_threadHook);
+	swapcontext(&host_main, host_context(KERNEL_getCurrent()));
+}
+
+void KPORT_idle(void)
+{
+	__WFI();
+}
+
+
+/*----------------------------------------------------------------------------
+  Handlers
+ *----------------------------------------------------------------------------*/
+
+void PendSV_Handler(void)
+{
+	WORK_runDeferred();
+	HOST_busy(HOST_KERNEL_SWITCH_CYCLES);
+	host_switch = true;
+}
+
+void SysTick_Handler(void)
+{
+	KERNEL_tick();
+}
@@ -0,0 +1,274 @@
+/**
+* @file 		host_lis3dsh.c
+* @brief		LIS3DSH model of the host build.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	See host_lis3dsh.h.
+*
+*/
+
+#include <string.h>
+#include "host_lis3dsh.h"
+#include "mems_LIS3DSH.h"
+
+#define LIS3DSH_READ			0x80
+#define LIS3DSH_ADDRESS		0x7F
+
+typedef struct
+{
+	uint8_t reg[0x80];
+	int16_t sample[3];				///< Last sample, copied in the output registers when not held
+	bool held[3];							///< Axis held by BDU between the reads of its low and high bytes
+	bool first;								///< Next byte is the address byte
+	bool read;
+	uint8_t address;
+	uint32_t windows;
+	int16_t fifo[MEMS_FIFO_SIZE][3];
+	uint8_t fifo_head;
+	uint8_t fifo_count;
+	GPIO_TypeDef * int1_port;					///< NULL when INT1 isn't connected
+	uint8_t int1_pin;
+} HostLIS3DSH;
+
+static HostLIS3DSH host_lis3dsh;
+
+static void lis3dsh_updateAxis(HostLIS3DSH * s, int axis)
+{
+	s->reg[MEMS_OUT_X_L + 2 * axis] = (uint8_t) s->sample[axis];
+	s->reg[MEMS_OUT_X_H + 2 * axis] = (uint8_t) ((uint16_t) s->sample[axis] >> 8);
+}
+
+static bool lis3dsh_isFifoEnabled(const HostLIS3DSH * s)
+{
+	return (s->reg[MEMS_CTRL_REG6] & MEMS_CTRL_REG6_FIFO_EN)
+		&& (s->reg[MEMS_FIFO_CTRL] & MEMS_FIFO_CTRL_FMODE) != MEMS_FIFO_CTRL_BYPASS;
+}
+
+/* FIFO_SRC, output registers of the oldest FIFO sample and INT1 */
+static void lis3dsh_update(HostLIS3DSH * s)
+{
+	uint8_t watermark = s->reg[MEMS_FIFO_CTRL] & MEMS_FIFO_CTRL_WTMP;
+	uint8_t src = s->fifo_count & MEMS_FIFO_SRC_FSS;
+	uint8_t ctrl6 = s->reg[MEMS_CTRL_REG6];
+	bool int1 = false;
+
+	if ((ctrl6 & MEMS_CTRL_WTM_EN) && s->fifo_count >= watermark && watermark > 0)
+		src |= MEMS_FIFO_SRC_WTM;
+	if (s->fifo_count == MEMS_FIFO_SIZE)
+		src |= MEMS_FIFO_SRC_OVRN;
+	if (s->fifo_count == 0)
+		src |= MEMS_FIFO_SRC_EMPTY;
+	s->reg[MEMS_FIFO_SRC] = src;
+
+	if (lis3dsh_isFifoEnabled(s) && s->fifo_count > 0)
+	{
+		int axis;
+
+		for (axis = 0; axis < 3; axis++)
+		{
+			s->reg[MEMS_OUT_X_L + 2 * axis] = (uint8_t) s->fifo[s->fifo_head][axis];
+			s->reg[MEMS_OUT_X_H + 2 * axis] = (uint8_t) ((uint16_t) s->fifo[s->fifo_head][axis] >> 8);
+		}
+	}
+
+	if (s->reg[MEMS_CTRL_REG3] & MEMS_CTRL_REG3_INT1_EN)
+	{
+		int1 = ((ctrl6 & MEMS_CTRL_REG6_P1_WTM) && (src & MEMS_FIFO_SRC_WTM))
+			|| ((ctrl6 & MEMS_CTRL_REG6_P1_OVERRUN) && (src & MEMS_FIFO_SRC_OVRN))
+			|| ((ctrl6 & MEMS_CTRL_REG6_P1_EMPTY) && (src & MEMS_FIFO_SRC_EMPTY))
+			|| ((s->reg[MEMS_CTRL_REG3] & MEMS_CTRL_REG3_DR_EN) && (s->reg[MEMS_STATUS] & MEMS_STATUS_ZYXDA));
+	}
+	if (s->int1_port != NULL)
+		HOST_GPIO_setInput(s->int1_port, s->int1_pin, (s->reg[MEMS_CTRL_REG3] & MEMS_CTRL_REG3_IEA) ? int1 : !int1);
+}
+
+static void lis3dsh_pushFifo(HostLIS3DSH * s)
+{
+	uint8_t tail;
+
+	if (s->fifo_count == MEMS_FIFO_SIZE)
+	{
+		if ((s->reg[MEMS_FIFO_CTRL] & MEMS_FIFO_CTRL_FMODE) != MEMS_FIFO_CTRL_STREAM)
+			return;																							// FIFO mode stops when full
+		s->fifo_head = (s->fifo_head + 1) % MEMS_FIFO_SIZE;				// Stream mode drops the oldest sample
+		s->fifo_count--;
+	}
+	tail = (s->fifo_head + s->fifo_count) % MEMS_FIFO_SIZE;
+	memcpy(s->fifo[tail], s->sample, sizeof(s->sample));
+	s->fifo_count++;
+}
+
+static void lis3dsh_popFifo(HostLIS3DSH * s)
+{
+	if (s->fifo_count > 0)
+	{
+		s->fifo_head = (s->fifo_head + 1) % MEMS_FIFO_SIZE;
+		s->fifo_count--;
+	}
+}
+
+static void lis3dsh_select(void * ctx)
+{
+	HostLIS3DSH * s = (HostLIS3DSH *) ctx;
+
+	s->first = true;
+	s->windows++;
+}
+
+static uint8_t lis3dsh_readRegister(HostLIS3DSH * s, uint8_t address)
+{
+	uint8_t value = s->reg[address];
+
+	if (lis3dsh_isFifoEnabled(s))
+	{
+		if (address == MEMS_OUT_Z_H)
+		{
+			lis3dsh_popFifo(s);
+			lis3dsh_update(s);
+		}
+	}
+	else if (address >= MEMS_OUT_X_L && address <= MEMS_OUT_Z_H)
+	{
+		int axis = (address - MEMS_OUT_X_L) / 2;
+
+		if (address & 0x1)										// High byte: the axis is released
+		{
+			if (s->held[axis])
+			{
+				s->held[axis] = false;
+				lis3dsh_updateAxis(s, axis);
+			}
+			if (axis == 2)
+			{
+				s->reg[MEMS_STATUS] &= (uint8_t) ~MEMS_STATUS_ZYXDA;
+				lis3dsh_update(s);
+			}
+		}
+		else if (s->reg[MEMS_CTRL_REG4] & MEMS_CTRL_REG4_BDU)
+			s->held[axis] = true;
+	}
+	return value;
+}
+
+static bool lis3dsh_isReadOnly(uint8_t address)
+{
+	return address <= MEMS_WHO_AM_I || (address >= MEMS_STATUS && address <= MEMS_OUT_Z_H) || address == MEMS_FIFO_SRC;
+}
+
+/* Control registers back to their reset value (CTRL_REG3 STRT) */
+static void lis3dsh_softReset(HostLIS3DSH * s)
+{
+	uint8_t address;
+
+	for (address = MEMS_OFFSET_X; address <= MEMS_CSHIFT_Z; address++)
+		s->reg[address] = 0;
+	s->reg[MEMS_CTRL_REG3] = 0;
+	s->reg[MEMS_CTRL_REG4] = MEMS_CTRL_REG4_ZEN | MEMS_CTRL_REG4_YEN | MEMS_CTRL_REG4_XEN;
+	s->reg[MEMS_CTRL_REG5] = 0;
+	s->reg[MEMS_CTRL_REG6] = MEMS_CTRL_REG6_ADD_INC;
+	s->reg[MEMS_FIFO_CTRL] = 0;
+}
+
+static uint8_t lis3dsh_exchange(void * ctx, uint8_t mosi)
+{
+	HostLIS3DSH * s = (HostLIS3DSH *) ctx;
+	uint8_t miso = 0xFF;
+
+	if (s->first)
+	{
+		s->first = false;
+		s->read = (mosi & LIS3DSH_READ) != 0;
+		s->address = mosi & LIS3DSH_ADDRESS;
+		return miso;
+	}
+
+	if (s->read)
+		miso = lis3dsh_readRegister(s, s->address);
+	else if (!lis3dsh_isReadOnly(s->address))
+	{
+		s->reg[s->address] = mosi;
+		if (s->address == MEMS_CTRL_REG6)
+			s->reg[MEMS_CTRL_REG6] &= (uint8_t) ~MEMS_CTRL_REG6_BOOT;	// Reboot done at once
+		if (s->address == MEMS_CTRL_REG3 && (mosi & MEMS_CTRL_REG3_STRT))
+			lis3dsh_softReset(s);																// Soft reset done at once
+		if (!lis3dsh_isFifoEnabled(s))
+		{
+			s->fifo_count = 0;														// Bypass mode empties the FIFO
+			s->fifo_head = 0;
+		}
+		lis3dsh_update(s);
+	}
+
+	if (s->reg[MEMS_CTRL_REG6] & MEMS_CTRL_REG6_ADD_INC)
+	{
+		if (s->address == MEMS_OUT_Z_H && lis3dsh_isFifoEnabled(s))
+			s->address = MEMS_OUT_X_L;
+		else
+			s->address = (s->address + 1) & LIS3DSH_ADDRESS;
+	}
+	return miso;
+}
+
+void HOST_LIS3DSH_attach(SPI_TypeDef * SPI, GPIO_TypeDef * cs_port, uint8_t cs_pin)
+{
+	HOST_SPISlave slave = { lis3dsh_select, lis3dsh_exchange, NULL, &host_lis3dsh, cs_port, cs_pin };
+
+	memset(&host_lis3dsh, 0, sizeof(host_lis3dsh));
+	host_lis3dsh.reg[MEMS_INFO_1] = 0x21;
+	host_lis3dsh.reg[MEMS_WHO_AM_I] = 0x3F;
+	lis3dsh_softReset(&host_lis3dsh);
+	lis3dsh_update(&host_lis3dsh);
+	HOST_SPI_attachSlave(SPI, &slave);
+}
+
+void HOST_LIS3DSH_setSample(int16_t x, int16_t y, int16_t z)
+{
+	HostLIS3DSH * s = &host_lis3dsh;
+	int axis;
+
+	s->sample[0] = x;
+	s->sample[1] = y;
+	s->sample[2] = z;
+	if (lis3dsh_isFifoEnabled(s))
+	{
+		lis3dsh_pushFifo(s);
+	}
+	else
+	{
+		for (axis = 0; axis < 3; axis++)
+			if (!s->held[axis])
+				lis3dsh_updateAxis(s, axis);
+	}
+	s->reg[MEMS_STATUS] |= MEMS_STATUS_ZYXDA;
+	lis3dsh_update(s);
+}
+
+void HOST_LIS3DSH_attachInt1(GPIO_TypeDef * port, uint8_t pin)
+{
+	host_lis3dsh.int1_port = port;
+	host_lis3dsh.int1_pin = pin;
+	lis3dsh_update(&host_lis3dsh);
+}
+
+uint8_t HOST_LIS3DSH_getFifoCount(void)
+{
+	return host_lis3dsh.fifo_count;
+}
+
+void HOST_LIS3DSH_setRegister(uint8_t address, uint8_t value)
+{
+	host_lis3dsh.reg[address & LIS3DSH_ADDRESS] = value;
+	lis3dsh_update(&host_lis3dsh);
+}
+
+uint8_t HOST_LIS3DSH_getRegister(uint8_t address)
+{
+	return host_lis3dsh.reg[address & LIS3DSH_ADDRESS];
+}
+
+uint32_t HOST_LIS3DSH_getWindows(void)
+{
+	return host_lis3dsh.windows;
+}
@@ -0,0 +1,86 @@
+/**
+* @file 		host_lis3dsh.h
+* @brief		Header file of the LIS3DSH model of the host build.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	Header file listing the functions required to plug a LIS3DSH
+* accelerometer on a SPI of the host peripheral model and to feed it
+* with samples.
+*
+*		1. The model implements the 4-wire SPI protocol (bit 7 of the
+*		first byte set for a read), the register address auto-increment
+*		(CTRL_REG6 ADD_INC) and Block Data Update (CTRL_REG4 BDU).
+*		2. The FIFO supports the bypass, FIFO and stream modes, the
+*		watermark and the FIFO interrupts routed to INT1 (CTRL_REG6) with
+*		the polarity of CTRL_REG3 IEA. Reading OUT_Z_H pops a sample.
+*		The data-ready signal (CTRL_REG3 DR_EN) drives INT1 from a new
+*		sample until OUT_Z_H is read.
+*		3. A test usually goes like this:
+*				HOST_reset();
+*				HOST_LIS3DSH_attach(MEMS_SPI, MEMS_GPIO_CS, MEMS_PIN_CS);
+*				HOST_LIS3DSH_setSample(x, y, z);
+*				// call the MEMS service
+*/
+
+#ifndef HOST_LIS3DSH_H
+#define HOST_LIS3DSH_H
+
+#include "host_model.h"
+
+/**
+ * LIS3DSH attached.
+ * This function puts the registers of the model at their reset value
+ * and attaches it to the given SPI.
+ * @param[in]	SPI SPI the sensor is connected to.
+ * @param[in]	cs_port GPIO of the chip select line.
+ * @param[in]	cs_pin Pin of the chip select line.
+ */
+void HOST_LIS3DSH_attach(SPI_TypeDef * SPI, GPIO_TypeDef * cs_port, uint8_t cs_pin);
+
+/**
+ * INT1 connected.
+ * @param[in]	port GPIO the INT1 line drives (NULL to disconnect).
+ * @param[in]	pin Pin of the INT1 line.
+ */
+void HOST_LIS3DSH_attachInt1(GPIO_TypeDef * port, uint8_t pin);
+
+/**
+ * New sample.
+ * This function updates the output registers (but the ones held by Block
+ * Data Update), or pushes the sample in the FIFO when it is enabled, and
+ * sets the data available bits of STATUS.
+ * @param[in]	x X acceleration.
+ * @param[in]	y Y acceleration.
+ * @param[in]	z Z acceleration.
+ */
+void HOST_LIS3DSH_setSample(int16_t x, int16_t y, int16_t z);
+
+/**
+ * Register value, without any side effect.
+ * @param[in]	address Register address.
+ * @retval uint8_t Value of the register.
+ */
+uint8_t HOST_LIS3DSH_getRegister(uint8_t address);
+
+/**
+ * Unread samples in the FIFO.
+ * @retval uint8_t Number of samples (0..MEMS_FIFO_SIZE).
+ */
+uint8_t HOST_LIS3DSH_getFifoCount(void);
+
+/**
+ * Register value changed behind the MCU's back (no SPI traffic).
+ * @param[in]	address Register address.
+ * @param[in]	value New value of the register.
+ */
+void HOST_LIS3DSH_setRegister(uint8_t address, uint8_t value);
+
+/**
+ * Chip select windows seen by the sensor since HOST_LIS3DSH_attach().
+ * @retval uint32_t Number of windows.
+ */
+uint32_t HOST_LIS3DSH_getWindows(void);
+
+#endif
@@ -0,0 +1,1868 @@
+/**
+* @file 		host_model.c
+* @brief		Source file of the host peripheral model.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	Source file of the register model used by the host build. Each
+* peripheral block is registered with three hooks: one refreshing a
+* register before it is read, one applying the side-effects of a read
+* (ex: RXNE cleared by a DR read) and one applying the side-effects of
+* a write (ex: BSRR -> ODR). The same hooks are used by the DMA model
+* so DMA transfers behave like CPU accesses without costing CPU cycles.
+*
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include "host_model.h"
+
+/*----------------------------------------------------------------------------
+  Peripheral instances
+ *----------------------------------------------------------------------------*/
+
+GPIO_TypeDef host_GPIOA, host_GPIOB, host_GPIOC, host_GPIOD, host_GPIOE;
+SPI_TypeDef host_SPI1;
+DMA_TypeDef host_DMA1, host_DMA2;
+DMA_Stream_TypeDef host_DMA1_Stream[8], host_DMA2_Stream[8];
+RCC_TypeDef host_RCC;
+EXTI_TypeDef host_EXTI;
+SYSCFG_TypeDef host_SYSCFG;
+TIM_TypeDef host_TIM2, host_TIM3, host_TIM4, host_TIM5, host_TIM6, host_TIM7;
+FLASH_TypeDef host_FLASH;
+PWR_TypeDef host_PWR;
+SCB_Type host_SCB;
+DWT_Type host_DWT;
+CoreDebug_Type host_CoreDebug;
+FPU_Type host_FPU;
+MPU_Type host_MPU;
+uint32_t host_mainStack[HOST_MAIN_STACK_WORDS];
+uintptr_t host_msp;
+
+uint32_t SystemCoreClock = 168000000;
+
+void SystemInit(void)
+{
+}
+
+void SystemCoreClockUpdate(void)
+{
+}
+
+
+/*----------------------------------------------------------------------------
+  Peripheral registry
+ *----------------------------------------------------------------------------*/
+
+typedef struct HostPeriph HostPeriph;
+
+struct HostPeriph
+{
+	const char * name;
+	void * base;
+	size_t size;
+	uint8_t index;
+	void (*read)(HostPeriph * p, uint32_t offset);
+	void (*readDone)(HostPeriph * p, uint32_t offset);
+	void (*write)(HostPeriph * p, uint32_t offset, uint32_t old_value);
+	uint32_t reads;
+	uint32_t writes;
+};
+
+static void host_gpioRead(HostPeriph * p, uint32_t offset);
+static void host_gpioWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_spiRead(HostPeriph * p, uint32_t offset);
+static void host_spiReadDone(HostPeriph * p, uint32_t offset);
+static void host_spiWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_dmaWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_dmaStreamWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_extiWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_timWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_rccWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_flashWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_pwrWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_scbRead(HostPeriph * p, uint32_t offset);
+static void host_scbWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+static void host_dwtRead(HostPeriph * p, uint32_t offset);
+static void host_dwtWrite(HostPeriph * p, uint32_t offset, uint32_t old_value);
+
+#define HOST_PERIPH(name, inst, idx, rd, rddone, wr) \
+	{ name, (void *) &(inst), sizeof(inst), idx, rd, rddone, wr, 0, 0 }
+
+static HostPeriph host_periphs[] =
+{
+	HOST_PERIPH("GPIOA", host_GPIOA, 0, host_gpioRead, NULL, host_gpioWrite),
+	HOST_PERIPH("GPIOB", host_GPIOB, 1, host_gpioRead, NULL, host_gpioWrite),
+	HOST_PERIPH("GPIOC", host_GPIOC, 2, host_gpioRead, NULL, host_gpioWrite),
+	HOST_PERIPH("GPIOD", host_GPIOD, 3, host_gpioRead, NULL, host_gpioWrite),
+	HOST_PERIPH("GPIOE", host_GPIOE, 4, host_gpioRead, NULL, host_gpioWrite),
+	HOST_PERIPH("SPI1", host_SPI1, 0, host_spiRead, host_spiReadDone, host_spiWrite),
+	HOST_PERIPH("DMA1", host_DMA1, 0, NULL, NULL, host_dmaWrite),
+	HOST_PERIPH("DMA2", host_DMA2, 1, NULL, NULL, host_dmaWrite),
+	HOST_PERIPH("DMA1_Stream", host_DMA1_Stream, 0, NULL, NULL, host_dmaStreamWrite),
+	HOST_PERIPH("DMA2_Stream", host_DMA2_Stream, 1, NULL, NULL, host_dmaStreamWrite),
+	HOST_PERIPH("RCC", host_RCC, 0, NULL, NULL, host_rccWrite),
+	HOST_PERIPH("EXTI", host_EXTI, 0, NULL, NULL, host_extiWrite),
+	HOST_PERIPH("SYSCFG", host_SYSCFG, 0, NULL, NULL, NULL),
+	HOST_PERIPH("TIM2", host_TIM2, 2, NULL, NULL, host_timWrite),
+	HOST_PERIPH("TIM3", host_TIM3, 3, NULL, NULL, host_timWrite),
+	HOST_PERIPH("TIM4", host_TIM4, 4, NULL, NULL, host_timWrite),
+	HOST_PERIPH("TIM5", host_TIM5, 5, NULL, NULL, host_timWrite),
+	HOST_PERIPH("TIM6", host_TIM6, 6, NULL, NULL, host_timWrite),
+	HOST_PERIPH("TIM7", host_TIM7, 7, NULL, NULL, host_timWrite),
+	HOST_PERIPH("FLASH", host_FLASH, 0, NULL, NULL, host_flashWrite),
+	HOST_PERIPH("PWR", host_PWR, 0, NULL, NULL, host_pwrWrite),
+	HOST_PERIPH("SCB", host_SCB, 0, host_scbRead, NULL, host_scbWrite),
+	HOST_PERIPH("DWT", host_DWT, 0, host_dwtRead, NULL, host_dwtWrite),
+	HOST_PERIPH("CoreDebug", host_CoreDebug, 0, NULL, NULL, host_dwtWrite),
+	HOST_PERIPH("FPU", host_FPU, 0, NULL, NULL, NULL),
+	HOST_PERIPH("MPU", host_MPU, 0, NULL, NULL, NULL),
+};
+
+#define HOST_PERIPH_NUMBER	(sizeof(host_periphs) / sizeof(host_periphs[0]))
+
+static GPIO_TypeDef * const host_gpios[] = { &host_GPIOA, &host_GPIOB, &host_GPIOC, &host_GPIOD, &host_GPIOE };
+
+#define HOST_GPIO_NUMBER		(sizeof(host_gpios) / sizeof(host_gpios[0]))
+
+static HostPeriph * host_findPeriph(const void * reg)
+{
+	const char * addr = (const char *) reg;
+	uint32_t i;
+
+	for (i = 0; i < HOST_PERIPH_NUMBER; i++)
+	{
+		const char * base = (const char *) host_periphs[i].base;
+		if (addr >= base && addr < base + host_periphs[i].size)
+		{
+			return &host_periphs[i];
+		}
+	}
+	return NULL;
+}
+
+static uint32_t host_offset(const HostPeriph * p, const void * reg)
+{
+	return (uint32_t) ((const char *) reg - (const char *) p->base);
+}
+
+
+/*----------------------------------------------------------------------------
+  Clock, counters and log
+ *----------------------------------------------------------------------------*/
+
+static uint64_t host_now;
+static uint64_t host_cpu;
+static uint32_t host_unhandled;
+
+static HOST_Access * host_log;
+static uint32_t host_logSize;
+static uint32_t host_logCount;
+
+static void host_advanceTo(uint64_t target);
+static uint64_t host_nextChange(uint64_t until);
+static void host_dispatch(void);
+static void host_dmaService(void);
+
+static void host_logAccess(const void * reg, uint8_t size, uint32_t value, bool write, HOST_AccessKind kind)
+{
+	if (host_log != NULL)
+	{
+		if (host_logCount < host_logSize)
+		{
+			host_log[host_logCount].reg = reg;
+			host_log[host_logCount].value = value;
+			host_log[host_logCount].size = size;
+			host_log[host_logCount].write = write;
+			host_log[host_logCount].kind = kind;
+		}
+		host_logCount++;
+	}
+}
+
+static uint32_t host_rawRead(const void * reg, uint8_t size)
+{
+	uint32_t value = 0;
+	memcpy(&value, reg, size > 4 ? 4 : size);
+	return value;
+}
+
+void host_regRead(const void * reg, uint8_t size)
+{
+	HostPeriph * p = host_findPeriph(reg);
+
+	host_cpu += HOST_ACCESS_CYCLES;
+	host_advanceTo(host_now + HOST_ACCESS_CYCLES);
+	if (p != NULL)
+	{
+		p->reads++;
+		if (p->read != NULL)
+		{
+			p->read(p, host_offset(p, reg));
+		}
+	}
+}
+
+static void host_readDone(const void * reg, uint8_t size, HOST_AccessKind kind)
+{
+	HostPeriph * p = host_findPeriph(reg);
+
+	host_logAccess(reg, size, host_rawRead(reg, size), false, kind);
+	if (p != NULL && p->readDone != NULL)
+	{
+		p->readDone(p, host_offset(p, reg));
+	}
+	host_dispatch();
+}
+
+void host_regReadDone(const void * reg, uint8_t size)
+{
+	host_readDone(reg, size, HOST_ACCESS_PLAIN);
+}
+
+static void host_writeDone(HostPeriph * p, void * reg, uint32_t old_value)
+{
+	if (p != NULL)
+	{
+		p->writes++;
+		if (p->write != NULL)
+		{
+			p->write(p, host_offset(p, reg), old_value);
+		}
+	}
+	host_dmaService();
+	host_dispatch();
+}
+
+static void host_write(void * reg, uint8_t size, uint32_t old_value, HOST_AccessKind kind)
+{
+	HostPeriph * p = host_findPeriph(reg);
+	uint32_t value = host_rawRead(reg, size);
+
+	host_cpu += HOST_ACCESS_CYCLES;
+	host_logAccess(reg, size, value, true, kind);
+	if (size <= 4)
+	{
+		// The write lands at the end of the access: the events meanwhile
+		// (an EXTI edge setting PR...) see the previous value, not lost
+		memcpy(reg, &old_value, size);
+		host_advanceTo(host_now + HOST_ACCESS_CYCLES);
+		old_value = host_rawRead(reg, size);
+		memcpy(reg, &value, size);
+	}
+	else
+	{
+		host_advanceTo(host_now + HOST_ACCESS_CYCLES);
+	}
+	host_writeDone(p, reg, old_value);
+}
+
+void host_regWrite(void * reg, uint8_t size, uint32_t old_value)
+{
+	host_write(reg, size, old_value, HOST_ACCESS_PLAIN);
+}
+
+/*
+ * Exclusive monitor of the registers: set by LDREX, cleared by STREX and
+ * by the exception entry. The events of the model (hardware) don't clear
+ * it, as on target.
+ */
+static const void * host_monitor;
+
+uint32_t host_regLoadExclusive(const void * reg, uint8_t size)
+{
+	uint32_t value;
+
+	host_regRead(reg, size);
+	value = host_rawRead(reg, size);
+	host_monitor = reg;
+	host_readDone(reg, size, HOST_ACCESS_EXCLUSIVE);							// An interrupt taken here clears the monitor
+	return value;
+}
+
+uint32_t host_regStoreExclusive(void * reg, uint8_t size, uint32_t value)
+{
+	uint32_t old_value = host_rawRead(reg, size);
+
+	if (host_monitor != reg)
+	{
+		host_monitor = NULL;
+		return 1;																								// Not stored, no bus access
+	}
+	host_monitor = NULL;
+	memcpy(reg, &value, size);
+	host_write(reg, size, old_value, HOST_ACCESS_EXCLUSIVE);
+	return 0;
+}
+
+void host_regBitBand(void * reg, uint8_t size, uint8_t bit, uint32_t value)
+{
+	HostPeriph * p = host_findPeriph(reg);
+	uint32_t old_value, new_value;
+
+	// One store, the bus read-modify-write is locked at the end of the
+	// access: the events meanwhile (flags of the other bits) are kept
+	host_cpu += HOST_ACCESS_CYCLES;
+	host_advanceTo(host_now + HOST_ACCESS_CYCLES);
+	old_value = host_rawRead(reg, size);
+	if (value)
+		new_value = old_value | (0x1UL << bit);
+	else
+		new_value = old_value & ~(0x1UL << bit);
+	memcpy(reg, &new_value, size);
+	host_logAccess(reg, size, new_value, true, HOST_ACCESS_BITBAND);
+	host_writeDone(p, reg, old_value);
+}
+
+/* Bus accesses of the DMA: same side-effects, no CPU cycles, not logged */
+static uint32_t host_busRead(uintptr_t addr, uint8_t size)
+{
+	HostPeriph * p = host_findPeriph((const void *) addr);
+	uint32_t value;
+
+	if (p != NULL && p->read != NULL)
+	{
+		p->read(p, host_offset(p, (const void *) addr));
+	}
+	value = host_rawRead((const void *) addr, size);
+	if (p != NULL && p->readDone != NULL)
+	{
+		p->readDone(p, host_offset(p, (const void *) addr));
+	}
+	return value;
+}
+
+static void host_busWrite(uintptr_t addr, uint8_t size, uint32_t value)
+{
+	HostPeriph * p = host_findPeriph((const void *) addr);
+	uint32_t old_value = host_rawRead((const void *) addr, size);
+
+	memcpy((void *) addr, &value, size);
+	if (p != NULL && p->write != NULL)
+	{
+		p->write(p, host_offset(p, (const void *) addr), old_value);
+	}
+}
+
+uint64_t HOST_getCycles(void)
+{
+	return host_now;
+}
+
+uint64_t HOST_getCpuCycles(void)
+{
+	return host_cpu;
+}
+
+void HOST_getAccessCount(const void * periph, uint32_t * reads, uint32_t * writes)
+{
+	uint32_t r = 0, w = 0, i;
+
+	for (i = 0; i < HOST_PERIPH_NUMBER; i++)
+	{
+		if (periph == NULL || periph == host_periphs[i].base)
+		{
+			r += host_periphs[i].reads;
+			w += host_periphs[i].writes;
+		}
+	}
+	if (reads != NULL)
+		*reads = r;
+	if (writes != NULL)
+		*writes = w;
+}
+
+void HOST_startLog(HOST_Access * log, uint32_t size)
+{
+	host_log = log;
+	host_logSize = size;
+	host_logCount = 0;
+}
+
+uint32_t HOST_getLogCount(void)
+{
+	return host_logCount;
+}
+
+uint32_t HOST_getUnhandledCount(void)
+{
+	return host_unhandled;
+}
+
+
+/*----------------------------------------------------------------------------
+  GPIO
+ *----------------------------------------------------------------------------*/
+
+static uint16_t host_gpioInputs[HOST_GPIO_NUMBER];
+
+static void host_spiChipSelect(GPIO_TypeDef * GPIO, uint32_t old_odr, uint32_t new_odr);
+
+static void host_gpioRead(HostPeriph * p, uint32_t offset)
+{
+	GPIO_TypeDef * GPIO = (GPIO_TypeDef *) p->base;
+
+	if (offset == offsetof(GPIO_TypeDef, IDR))
+	{
+		uint32_t moder = GPIO->MODER.v;
+		uint32_t outputs = 0;
+		uint8_t pin;
+
+		for (pin = 0; pin < 16; pin++)
+		{
+			if (((moder >> (2 * pin)) & 0x3) == 0x1)
+				outputs |= (0x1 << pin);
+		}
+		GPIO->IDR.v = (GPIO->ODR.v & outputs) | (host_gpioInputs[p->index] & ~outputs);
+	}
+}
+
+static void host_gpioWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	GPIO_TypeDef * GPIO = (GPIO_TypeDef *) p->base;
+	uint32_t old_odr = GPIO->ODR.v;
+
+	if (offset == offsetof(GPIO_TypeDef, BSRRL))
+	{
+		// 16-bit BSRRL or 32-bit BSRR write (GPIO_BSRR), set has priority over reset
+		uint32_t bsrr;
+		memcpy(&bsrr, (const void *) &GPIO->BSRRL, sizeof(bsrr));
+		GPIO->ODR.v = (GPIO->ODR.v & ~(bsrr >> 16)) | (bsrr & 0xFFFF);
+		memset((void *) &GPIO->BSRRL, 0, sizeof(bsrr));
+	}
+	else if (offset == offsetof(GPIO_TypeDef, BSRRH))
+	{
+		GPIO->ODR.v &= ~(uint32_t) GPIO->BSRRH.v;
+		GPIO->BSRRH.v = 0;
+	}
+	else if (offset == offsetof(GPIO_TypeDef, ODR))
+	{
+		old_odr = old_value;
+	}
+	else if (offset == offsetof(GPIO_TypeDef, IDR))
+	{
+		GPIO->IDR.v = old_value;
+	}
+	GPIO->ODR.v &= 0xFFFF;
+	if (GPIO->ODR.v != old_odr)
+	{
+		host_spiChipSelect(GPIO, old_odr, GPIO->ODR.v);
+	}
+}
+
+
+static bool host_advancing;
+
+static void host_extiEdge(uint8_t port, uint8_t line, bool rising);
+
+void HOST_GPIO_setInput(GPIO_TypeDef * GPIO, uint8_t pin, bool level)
+{
+	uint8_t i;
+
+	for (i = 0; i < HOST_GPIO_NUMBER; i++)
+	{
+		if (host_gpios[i] == GPIO && pin < 16)
+		{
+			bool old_level = (host_gpioInputs[i] >> pin) & 0x1;
+
+			if (level)
+				host_gpioInputs[i] |= (0x1 << pin);
+			else
+				host_gpioInputs[i] &= ~(0x1 << pin);
+			if (level != old_level)
+			{
+				host_extiEdge(i, pin, level);
+				if (!host_advancing)											// Slaves call it at the end of a frame
+					host_dispatch();
+			}
+		}
+	}
+}
+
+
+/*----------------------------------------------------------------------------
+  EXTI
+ *----------------------------------------------------------------------------*/
+
+/* Edge on a GPIO input: EXTICR selects the port of each line */
+static void host_extiEdge(uint8_t port, uint8_t line, bool rising)
+{
+	uint32_t bit = 0x1 << line;
+	uint8_t selected = (host_SYSCFG.EXTICR[line / 4].v >> (4 * (line % 4))) & 0xF;
+
+	if (selected != port || !(host_EXTI.IMR.v & bit))
+		return;
+	if ((rising && (host_EXTI.RTSR.v & bit)) || (!rising && (host_EXTI.FTSR.v & bit)))
+		host_EXTI.PR.v |= bit;
+}
+
+static void host_extiWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	(void) p;
+
+	if (offset == offsetof(EXTI_TypeDef, PR))
+	{
+		uint32_t cleared = host_EXTI.PR.v;
+
+		host_EXTI.PR.v = old_value & ~cleared;
+		host_EXTI.SWIER.v &= ~cleared;
+	}
+	else if (offset == offsetof(EXTI_TypeDef, SWIER))
+	{
+		host_EXTI.PR.v |= host_EXTI.SWIER.v & ~old_value & host_EXTI.IMR.v;
+	}
+}
+
+static IRQn_Type host_extiIRQ(uint8_t line)
+{
+	static const IRQn_Type irqs[5] = { EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn, EXTI4_IRQn };
+
+	if (line < 5)
+		return irqs[line];
+	return (line < 10) ? EXTI9_5_IRQn : EXTI15_10_IRQn;
+}
+
+
+/*----------------------------------------------------------------------------
+  SPI
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	SPI_TypeDef * SPI;
+	IRQn_Type irq;
+	HOST_SPISlave slave;
+	bool has_slave;
+	bool selected;
+	uint32_t window;
+	bool tx_full;
+	uint16_t tx_buf;
+	bool shifting;
+	uint16_t shift_data;
+	uint64_t shift_end;
+	uint32_t shift_cycles;
+	bool rx_full;
+	uint16_t rx_buf;
+	bool ovr;
+	bool ovr_dr_read;																				///< First half of the OVR clear sequence done
+	bool has_last;
+	uint64_t last_end;
+	uint32_t last_window;
+	HOST_SPIStats stats;
+} HostSPI;
+
+static HostSPI host_spi1;
+
+static uint32_t host_apb2Div(void);
+
+static HostSPI * host_getSPI(SPI_TypeDef * SPI)
+{
+	return (SPI == &host_SPI1) ? &host_spi1 : NULL;
+}
+
+static uint32_t host_spiFrameCycles(const HostSPI * s)
+{
+	uint16_t cr1 = s->SPI->CR1.v;
+	uint32_t bits = (cr1 & SPI_CR1_DFF) ? 16 : 8;
+	uint32_t div = 2u << ((cr1 & SPI_CR1_BR) >> 3);
+
+	return bits * div * host_apb2Div();
+}
+
+static void host_spiStart(HostSPI * s)
+{
+	uint16_t cr1 = s->SPI->CR1.v;
+
+	if (s->shifting || !s->tx_full || !(cr1 & SPI_CR1_SPE) || !(cr1 & SPI_CR1_MSTR))
+		return;
+
+	if (s->has_last && s->last_window == s->window)
+	{
+		uint64_t gap = host_now - s->last_end;
+		s->stats.gap_cycles += gap;
+		if (gap > s->stats.max_gap)
+			s->stats.max_gap = gap;
+	}
+	s->shifting = true;
+	s->shift_data = s->tx_buf;
+	s->tx_full = false;
+	s->shift_cycles = host_spiFrameCycles(s);
+	s->shift_end = host_now + s->shift_cycles;
+}
+
+static void host_spiComplete(HostSPI * s)
+{
+	uint16_t miso = 0xFF;
+
+	if (s->has_slave && (s->selected || s->slave.cs_port == NULL))
+	{
+		miso = s->slave.exchange(s->slave.ctx, (uint8_t) s->shift_data);
+	}
+	if (s->rx_full || s->ovr)
+	{
+		s->ovr = true;																					// Frame lost, DR keeps the previous one
+		s->stats.overruns++;
+	}
+	else
+	{
+		s->rx_buf = miso;
+		s->rx_full = true;
+	}
+	s->shifting = false;
+	s->stats.frames++;
+	s->stats.busy_cycles += s->shift_cycles;
+	s->has_last = true;
+	s->last_end = host_now;
+	s->last_window = s->window;
+
+	host_dmaService();
+	host_spiStart(s);
+}
+
+static void host_spiRead(HostPeriph * p, uint32_t offset)
+{
+	HostSPI * s = host_getSPI((SPI_TypeDef *) p->base);
+
+	if (offset == offsetof(SPI_TypeDef, SR))
+	{
+		uint16_t sr = 0;
+		if (!s->tx_full)
+			sr |= SPI_SR_TXE;
+		if (s->rx_full)
+			sr |= SPI_SR_RXNE;
+		if (s->ovr)
+			sr |= SPI_SR_OVR;
+		if (s->shifting || s->tx_full)
+			sr |= SPI_SR_BSY;
+		s->SPI->SR.v = sr;
+	}
+	else if (offset == offsetof(SPI_TypeDef, DR))
+	{
+		s->SPI->DR.v = s->rx_buf;
+	}
+}
+
+static void host_spiReadDone(HostPeriph * p, uint32_t offset)
+{
+	HostSPI * s = host_getSPI((SPI_TypeDef *) p->base);
+
+	// OVR cleared by a read of DR, then of SR
+	if (offset == offsetof(SPI_TypeDef, DR))
+	{
+		s->rx_full = false;
+		s->ovr_dr_read = s->ovr;
+	}
+	else if (offset == offsetof(SPI_TypeDef, SR) && s->ovr_dr_read)
+	{
+		s->ovr = false;
+		s->ovr_dr_read = false;
+	}
+}
+
+static void host_spiWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	HostSPI * s = host_getSPI((SPI_TypeDef *) p->base);
+
+	if (offset == offsetof(SPI_TypeDef, DR))
+	{
+		if ((s->SPI->CR1.v & SPI_CR1_SPE) && !s->tx_full)
+		{
+			s->tx_buf = s->SPI->DR.v;
+			s->tx_full = true;
+		}
+		s->SPI->DR.v = s->rx_buf;
+		host_spiStart(s);
+	}
+	else if (offset == offsetof(SPI_TypeDef, SR))
+	{
+		s->SPI->SR.v = (uint16_t) old_value;
+	}
+	else if (offset == offsetof(SPI_TypeDef, CR1))
+	{
+		host_spiStart(s);
+	}
+}
+
+static void host_spiChipSelect(GPIO_TypeDef * GPIO, uint32_t old_odr, uint32_t new_odr)
+{
+	HostSPI * s = &host_spi1;
+	uint32_t mask;
+
+	if (!s->has_slave || s->slave.cs_port != GPIO)
+		return;
+
+	mask = 0x1 << s->slave.cs_pin;
+	if ((old_odr & mask) && !(new_odr & mask))
+	{
+		s->selected = true;
+		s->window++;
+		if (s->slave.select != NULL)
+			s->slave.select(s->slave.ctx);
+	}
+	else if (!(old_odr & mask) && (new_odr & mask))
+	{
+		s->selected = false;
+		s->window++;
+		if (s->slave.deselect != NULL)
+			s->slave.deselect(s->slave.ctx);
+	}
+}
+
+static bool host_spiLine(const HostSPI * s)
+{
+	uint16_t cr2 = s->SPI->CR2.v;
+
+	return ((cr2 & SPI_CR2_TXEIE) && !s->tx_full)
+		|| ((cr2 & SPI_CR2_RXNEIE) && s->rx_full)
+		|| ((cr2 & SPI_CR2_ERRIE) && s->ovr);
+}
+
+void HOST_SPI_attachSlave(SPI_TypeDef * SPI, const HOST_SPISlave * slave)
+{
+	HostSPI * s = host_getSPI(SPI);
+
+	if (s == NULL)
+		return;
+
+	if (slave != NULL)
+	{
+		s->slave = *slave;
+		s->has_slave = true;
+		s->selected = (slave->cs_port != NULL) && !(slave->cs_port->ODR.v & (0x1 << slave->cs_pin));
+	}
+	else
+	{
+		s->has_slave = false;
+		s->selected = false;
+	}
+}
+
+void HOST_SPI_getStats(SPI_TypeDef * SPI, HOST_SPIStats * stats)
+{
+	HostSPI * s = host_getSPI(SPI);
+
+	if (s != NULL)
+		*stats = s->stats;
+}
+
+void HOST_SPI_resetStats(SPI_TypeDef * SPI)
+{
+	HostSPI * s = host_getSPI(SPI);
+
+	if (s != NULL)
+	{
+		memset(&s->stats, 0, sizeof(s->stats));
+		s->has_last = false;
+	}
+}
+
+
+/*----------------------------------------------------------------------------
+  DMA
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	DMA_TypeDef * DMA;
+	DMA_Stream_TypeDef * streams;
+	IRQn_Type irqs[8];
+	uint32_t ndtr[8];
+	uint32_t index[8];
+} HostDMA;
+
+static HostDMA host_dmas[2] =
+{
+	{ &host_DMA1, host_DMA1_Stream,
+		{ DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+			DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn }, { 0 }, { 0 } },
+	{ &host_DMA2, host_DMA2_Stream,
+		{ DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+			DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn }, { 0 }, { 0 } },
+};
+
+static const uint8_t host_dmaFlagShift[4] = { 0, 6, 16, 22 };
+
+static HostReg32 * host_dmaISR(HostDMA * d, uint8_t stream)
+{
+	return (stream < 4) ? &d->DMA->LISR : &d->DMA->HISR;
+}
+
+static bool host_timBurst(TIM_TypeDef * TIM);
+
+/* Request lines of the DMA mapping (RM0090 tables 42 and 43) */
+static bool host_dmaRequest(uint8_t dma, uint8_t stream, uint8_t channel)
+{
+	if (dma == 1 && channel == 3)
+	{
+		uint16_t cr2 = host_SPI1.CR2.v;
+		if (stream == 0 || stream == 2)
+			return (cr2 & SPI_CR2_RXDMAEN) && host_spi1.rx_full;
+		if (stream == 3 || stream == 5)
+			return (cr2 & SPI_CR2_TXDMAEN) && !host_spi1.tx_full && (host_SPI1.CR1.v & SPI_CR1_SPE);
+	}
+	if (dma == 0 && channel == 2 && stream == 6)
+		return host_timBurst(&host_TIM4);
+	return false;
+}
+
+static void host_dmaTransfer(HostDMA * d, uint8_t stream)
+{
+	DMA_Stream_TypeDef * S = &d->streams[stream];
+	uint32_t cr = S->CR.v;
+	uint8_t psize = 1 << ((cr & DMA_SxCR_PSIZE) >> 11);
+	uint8_t msize = 1 << ((cr & DMA_SxCR_MSIZE) >> 13);
+	uintptr_t mem = S->M0AR.v + ((cr & DMA_SxCR_MINC) ? d->index[stream] * msize : 0);
+	HostReg32 * isr = host_dmaISR(d, stream);
+	uint8_t shift = host_dmaFlagShift[stream % 4];
+	uint32_t value = 0;
+
+	if ((cr & DMA_SxCR_DIR) == 0)
+	{
+		value = host_busRead(S->PAR.v, psize);
+		memcpy((void *) mem, &value, msize);
+	}
+	else
+	{
+		memcpy(&value, (const void *) mem, msize);
+		host_busWrite(S->PAR.v, psize, value);
+	}
+
+	d->index[stream]++;
+	S->NDTR.v--;
+	if (S->NDTR.v == d->ndtr[stream] / 2)
+	{
+		isr->v |= (DMA_LISR_HTIF0 << shift);
+	}
+	if (S->NDTR.v == 0)
+	{
+		isr->v |= (DMA_LISR_TCIF0 << shift);
+		if (cr & DMA_SxCR_CIRC)
+		{
+			S->NDTR.v = d->ndtr[stream];
+			d->index[stream] = 0;
+		}
+		else
+		{
+			S->CR.v &= ~DMA_SxCR_EN;
+		}
+	}
+}
+
+static void host_dmaService(void)
+{
+	bool progress = true;
+
+	while (progress)
+	{
+		uint8_t dma, stream;
+
+		progress = false;
+		for (dma = 0; dma < 2; dma++)
+		{
+			for (stream = 0; stream < 8; stream++)
+			{
+				DMA_Stream_TypeDef * S = &host_dmas[dma].streams[stream];
+				uint32_t cr = S->CR.v;
+
+				if (!(cr & DMA_SxCR_EN) || S->NDTR.v == 0)
+					continue;
+				if (!host_dmaRequest(dma, stream, (cr & DMA_SxCR_CHSEL) >> 25))
+					continue;
+				host_dmaTransfer(&host_dmas[dma], stream);
+				progress = true;
+			}
+		}
+	}
+}
+
+static bool host_dmaLine(HostDMA * d, uint8_t stream)
+{
+	uint32_t cr = d->streams[stream].CR.v;
+	uint32_t flags = host_dmaISR(d, stream)->v >> host_dmaFlagShift[stream % 4];
+
+	return ((cr & DMA_SxCR_TCIE) && (flags & DMA_LISR_TCIF0))
+		|| ((cr & DMA_SxCR_HTIE) && (flags & DMA_LISR_HTIF0))
+		|| ((cr & DMA_SxCR_TEIE) && (flags & DMA_LISR_TEIF0));
+}
+
+static void host_dmaWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	DMA_TypeDef * DMA = (DMA_TypeDef *) p->base;
+
+	if (offset == offsetof(DMA_TypeDef, LIFCR))
+	{
+		DMA->LISR.v &= ~DMA->LIFCR.v;
+		DMA->LIFCR.v = 0;
+	}
+	else if (offset == offsetof(DMA_TypeDef, HIFCR))
+	{
+		DMA->HISR.v &= ~DMA->HIFCR.v;
+		DMA->HIFCR.v = 0;
+	}
+	else if (offset == offsetof(DMA_TypeDef, LISR))
+	{
+		DMA->LISR.v = old_value;
+	}
+	else if (offset == offsetof(DMA_TypeDef, HISR))
+	{
+		DMA->HISR.v = old_value;
+	}
+}
+
+static void host_dmaStreamWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	HostDMA * d = &host_dmas[p->index];
+	uint8_t stream = offset / sizeof(DMA_Stream_TypeDef);
+	DMA_Stream_TypeDef * S = &d->streams[stream];
+
+	if (offset % sizeof(DMA_Stream_TypeDef) == offsetof(DMA_Stream_TypeDef, CR))
+	{
+		if ((S->CR.v & DMA_SxCR_EN) && !(old_value & DMA_SxCR_EN))
+		{
+			d->ndtr[stream] = S->NDTR.v;
+			d->index[stream] = 0;
+		}
+	}
+	else if (offset % sizeof(DMA_Stream_TypeDef) == offsetof(DMA_Stream_TypeDef, NDTR))
+	{
+		if (S->CR.v & DMA_SxCR_EN)
+			S->NDTR.v = old_value;
+	}
+}
+
+
+/*----------------------------------------------------------------------------
+  Timers
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	uint32_t compare[4];										///< Active CCR values
+	uint8_t burst;													///< DMA burst transfers left to DMAR
+	uint8_t burst_index;
+} HostTIM;
+
+static TIM_TypeDef * const host_timers[] = { &host_TIM2, &host_TIM3, &host_TIM4, &host_TIM5, &host_TIM6, &host_TIM7 };
+static HostTIM host_tims[6];
+
+#define HOST_TIM_NUMBER		(sizeof(host_timers) / sizeof(host_timers[0]))
+
+static HostTIM * host_getTIM(TIM_TypeDef * TIM)
+{
+	uint8_t i;
+
+	for (i = 0; i < HOST_TIM_NUMBER; i++)
+	{
+		if (host_timers[i] == TIM)
+			return &host_tims[i];
+	}
+	return NULL;
+}
+
+static HostReg32 * host_timCCR(TIM_TypeDef * TIM, uint8_t channel)
+{
+	HostReg32 * ccrs[4] = { &TIM->CCR1, &TIM->CCR2, &TIM->CCR3, &TIM->CCR4 };
+	return ccrs[channel];
+}
+
+/* OCxPE of a channel (0..3) */
+static bool host_timPreload(TIM_TypeDef * TIM, uint8_t channel)
+{
+	uint16_t ccmr = (channel < 2) ? TIM->CCMR1.v : TIM->CCMR2.v;
+	return (ccmr >> (8 * (channel % 2))) & TIM_CCMR1_OC1PE;
+}
+
+static void host_timUpdate(TIM_TypeDef * TIM)
+{
+	HostTIM * t = host_getTIM(TIM);
+	uint8_t channel;
+
+	TIM->SR.v |= TIM_SR_UIF;
+	for (channel = 0; channel < 4; channel++)
+		t->compare[channel] = host_timCCR(TIM, channel)->v;
+	if (TIM->DIER.v & TIM_DIER_UDE)
+	{
+		t->burst = ((TIM->DCR.v & TIM_DCR_DBL) >> 8) + 1;
+		t->burst_index = 0;
+	}
+}
+
+static bool host_timBurst(TIM_TypeDef * TIM)
+{
+	return host_getTIM(TIM)->burst != 0;
+}
+
+static void host_timWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	TIM_TypeDef * TIM = (TIM_TypeDef *) p->base;
+	HostTIM * t = host_getTIM(TIM);
+	uint8_t channel;
+
+	if (offset == offsetof(TIM_TypeDef, EGR))
+	{
+		if (TIM->EGR.v & TIM_EGR_UG)
+			host_timUpdate(TIM);
+		TIM->EGR.v = 0;																					// Write-only
+	}
+	else if (offset == offsetof(TIM_TypeDef, SR))
+		TIM->SR.v = old_value & TIM->SR.v;																// Cleared by writing 0
+	else if (offset == offsetof(TIM_TypeDef, DMAR))
+	{
+		// DMA burst: DMAR redirected to the register DBA + index
+		uint32_t target = 4 * ((TIM->DCR.v & TIM_DCR_DBA) + t->burst_index);
+		uint16_t value = TIM->DMAR.v;
+
+		if (t->burst != 0)
+		{
+			t->burst--;
+			t->burst_index = (t->burst == 0) ? 0 : t->burst_index + 1;
+		}
+		if (target + 4 <= sizeof(TIM_TypeDef))
+			host_busWrite((uintptr_t) TIM + target, 2, value);
+	}
+	else if (offset == offsetof(TIM_TypeDef, DIER))
+	{
+		if (!(TIM->DIER.v & TIM_DIER_UDE))
+			t->burst = 0;																						// Pending update request dropped
+	}
+	else if (offset >= offsetof(TIM_TypeDef, CCR1) && offset <= offsetof(TIM_TypeDef, CCR4))
+	{
+		channel = (offset - offsetof(TIM_TypeDef, CCR1)) / 4;
+		if (!host_timPreload(TIM, channel))
+			t->compare[channel] = host_timCCR(TIM, channel)->v;
+	}
+}
+
+void HOST_TIM_update(TIM_TypeDef * TIM)
+{
+	host_timUpdate(TIM);
+	host_dmaService();
+	host_dispatch();
+}
+
+uint32_t HOST_TIM_getCompare(TIM_TypeDef * TIM, uint8_t channel)
+{
+	return host_getTIM(TIM)->compare[channel - 1];
+}
+
+
+/*----------------------------------------------------------------------------
+  RCC, FLASH and PWR
+ *----------------------------------------------------------------------------*/
+
+static uint32_t host_clockFaults;
+
+static uint32_t host_apbShift(uint32_t ppre)
+{
+	return (ppre & 0x4) ? (ppre & 0x3) + 1 : 0;
+}
+
+/* HCLK/PCLK2, the SPI1 clock */
+static uint32_t host_apb2Div(void)
+{
+	return 0x1u << host_apbShift((host_RCC.CFGR.v & RCC_CFGR_PPRE2) >> 13);
+}
+
+/* SYSCLK of the source selected by SWS (HPRE not modelled: HCLK = SYSCLK) */
+static uint32_t host_sysclk(void)
+{
+	uint32_t pllcfgr = host_RCC.PLLCFGR.v;
+	uint32_t input = (pllcfgr & RCC_PLLCFGR_PLLSRC) ? HSE_VALUE : HSI_VALUE;
+	uint32_t m = pllcfgr & RCC_PLLCFGR_PLLM;
+
+	switch (host_RCC.CFGR.v & RCC_CFGR_SWS)
+	{
+		case RCC_CFGR_SWS_HSE:
+			return HSE_VALUE;
+		case RCC_CFGR_SWS_PLL:
+			if (m == 0)
+				return 0;
+			return (uint32_t) ((uint64_t) input / m * ((pllcfgr & RCC_PLLCFGR_PLLN) >> 6) / ((((pllcfgr & RCC_PLLCFGR_PLLP) >> 16) + 1) * 2));
+		default:
+			return HSI_VALUE;
+	}
+}
+
+/* Limits of RM0090 at 2.7 V - 3.6 V: wait states, voltage scale, APB clocks */
+static void host_checkClocks(void)
+{
+	uint32_t hclk = host_sysclk();
+	uint32_t cfgr = host_RCC.CFGR.v;
+
+	if ((host_FLASH.ACR.v & FLASH_ACR_LATENCY) < (hclk - 1) / 30000000
+		|| (hclk > 144000000 && !(host_PWR.CR.v & PWR_CR_VOS))
+		|| (hclk >> host_apbShift((cfgr & RCC_CFGR_PPRE1) >> 10)) > 42000000
+		|| (hclk >> host_apbShift((cfgr & RCC_CFGR_PPRE2) >> 13)) > 84000000)
+		host_clockFaults++;
+}
+
+static void host_rccWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	uint32_t cr = host_RCC.CR.v;
+	uint32_t sws = host_RCC.CFGR.v & RCC_CFGR_SWS;
+	uint32_t sw, ready;
+
+	(void) p;
+	if (offset == offsetof(RCC_TypeDef, CR))
+	{
+		// The sources of SYSCLK can't be stopped, the others are ready at once
+		if (sws == RCC_CFGR_SWS_HSI)
+			cr |= RCC_CR_HSION;
+		else if (sws == RCC_CFGR_SWS_HSE)
+			cr |= RCC_CR_HSEON;
+		else
+			cr |= RCC_CR_PLLON | ((host_RCC.PLLCFGR.v & RCC_PLLCFGR_PLLSRC) ? RCC_CR_HSEON : RCC_CR_HSION);
+		cr &= ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY);
+		if (cr & RCC_CR_HSION)
+			cr |= RCC_CR_HSIRDY;
+		if (cr & RCC_CR_HSEON)
+			cr |= RCC_CR_HSERDY;
+		if (cr & RCC_CR_PLLON)
+			cr |= RCC_CR_PLLRDY;
+		host_RCC.CR.v = cr;
+	}
+	else if (offset == offsetof(RCC_TypeDef, PLLCFGR))
+	{
+		if (cr & RCC_CR_PLLON)
+		{
+			host_RCC.PLLCFGR.v = old_value;															// Written only while the PLL is off
+			host_clockFaults++;
+		}
+	}
+	else if (offset == offsetof(RCC_TypeDef, CFGR))
+	{
+		// SWS follows SW once the source is ready
+		sw = host_RCC.CFGR.v & RCC_CFGR_SW;
+		ready = (sw == RCC_CFGR_SW_HSI) ? RCC_CR_HSIRDY : (sw == RCC_CFGR_SW_HSE) ? RCC_CR_HSERDY : RCC_CR_PLLRDY;
+		if (cr & ready)
+			sws = sw << 2;
+		host_RCC.CFGR.v = (host_RCC.CFGR.v & ~RCC_CFGR_SWS) | sws;
+		host_checkClocks();
+	}
+}
+
+/*
+ * ART instruction cache: 128-bit lines, LRU order (most recent first),
+ * line number + 1 per entry, 0 if empty. The vector read of an exception
+ * entry overlaps the stacking, its wait states are not charged.
+ */
+#define HOST_FLASH_LINE			16
+#define HOST_FLASH_SIZE			0x100000
+#define HOST_ART_LINES			64
+
+static uint32_t host_art[HOST_ART_LINES];
+static uint64_t host_fetchStalls;
+
+/* Flash at FLASH_BASE or aliased at 0 (boot from the flash) */
+static bool host_inFlash(uint32_t address)
+{
+	return address < HOST_FLASH_SIZE || (address >= FLASH_BASE && address - FLASH_BASE < HOST_FLASH_SIZE);
+}
+
+/* Wait states of a flash line fetch */
+static uint32_t host_flashLine(uint32_t line)
+{
+	uint32_t i = 0;
+	bool hit;
+
+	if (!(host_FLASH.ACR.v & FLASH_ACR_ICEN))
+		return host_FLASH.ACR.v & FLASH_ACR_LATENCY;
+	while (i < HOST_ART_LINES - 1 && host_art[i] != line + 1)
+		i++;
+	hit = (host_art[i] == line + 1);
+	memmove(&host_art[1], &host_art[0], i * sizeof(host_art[0]));
+	host_art[0] = line + 1;
+	return hit ? 0 : host_FLASH.ACR.v & FLASH_ACR_LATENCY;
+}
+
+static void host_flashWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	uint32_t acr = host_FLASH.ACR.v;
+
+	(void) p;
+	(void) old_value;
+	if (offset == offsetof(FLASH_TypeDef, ACR))
+	{
+		if ((acr & FLASH_ACR_ICRST) && !(acr & FLASH_ACR_ICEN))						// Reset only while disabled
+			memset(host_art, 0, sizeof(host_art));
+		host_checkClocks();
+	}
+}
+
+static void host_pwrWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	(void) p;
+	if (offset == offsetof(PWR_TypeDef, CR))
+	{
+		if (((host_PWR.CR.v ^ old_value) & PWR_CR_VOS) && (host_RCC.CR.v & RCC_CR_PLLON))
+		{
+			host_PWR.CR.v = old_value;																	// Written only while the PLL is off
+			host_clockFaults++;
+		}
+		host_checkClocks();
+	}
+}
+
+uint32_t HOST_getClockFaults(void)
+{
+	return host_clockFaults;
+}
+
+void HOST_execute(uint32_t address, uint32_t size, uint32_t cycles)
+{
+	uint32_t acr = host_FLASH.ACR.v;
+	uint32_t line, first, last, wait, stalls = 0;
+
+	if (size > 0 && host_inFlash(address))
+	{
+		first = (address % HOST_FLASH_SIZE) / HOST_FLASH_LINE;
+		last = (address % HOST_FLASH_SIZE + size - 1) / HOST_FLASH_LINE;
+		for (line = first; line <= last; line++)
+		{
+			wait = host_flashLine(line);
+			if (line != first && (acr & FLASH_ACR_PRFTEN))
+				wait = 0;																						// Read while the previous line executed
+			stalls += wait;
+		}
+	}
+	host_fetchStalls += stalls;
+	HOST_busy(cycles + stalls);
+}
+
+uint64_t HOST_getFetchStalls(void)
+{
+	return host_fetchStalls;
+}
+
+
+/*----------------------------------------------------------------------------
+  NVIC and exceptions
+ *----------------------------------------------------------------------------*/
+
+#define HOST_EXC_NUMBER			(16 + HOST_IRQ_NUMBER)
+#define HOST_THREAD_PRIORITY	0x100
+
+static bool host_enabled[HOST_EXC_NUMBER];
+static bool host_pending[HOST_EXC_NUMBER];
+static bool host_active[HOST_EXC_NUMBER];
+static uint8_t host_priority[HOST_EXC_NUMBER];
+static uint32_t host_primask;
+static uint32_t host_basepri;
+static uint32_t host_prigroup;																///< AIRCR PRIGROUP: the PRIGROUP+1 low bits of a priority are its sub-priority
+static uint32_t host_runPriority[HOST_EXC_NUMBER + 1];
+static uint32_t host_runDepth;
+static void (*host_threadHook)(void);
+
+void NMI_Handler(void);
+void HardFault_Handler(void);
+void SVC_Handler(void);
+void PendSV_Handler(void);
+void SysTick_Handler(void);
+
+typedef struct
+{
+	IRQn_Type irq;
+	void (*handler)(void);
+} HostVector;
+
+#define HOST_WEAK_HANDLER(name, irq) \
+	void name(void) __attribute__((weak)); \
+	void name(void) { host_defaultHandler(irq); }
+
+static void host_defaultHandler(IRQn_Type IRQn)
+{
+	host_unhandled++;
+	if (IRQn >= 0)
+		host_enabled[IRQn + 16] = false;
+}
+
+HOST_WEAK_HANDLER(NMI_Handler, NonMaskableInt_IRQn)
+HOST_WEAK_HANDLER(HardFault_Handler, (IRQn_Type) -13)
+HOST_WEAK_HANDLER(SVC_Handler, SVCall_IRQn)
+HOST_WEAK_HANDLER(PendSV_Handler, PendSV_IRQn)
+HOST_WEAK_HANDLER(SysTick_Handler, SysTick_IRQn)
+HOST_WEAK_HANDLER(EXTI0_IRQHandler, EXTI0_IRQn)
+HOST_WEAK_HANDLER(EXTI1_IRQHandler, EXTI1_IRQn)
+HOST_WEAK_HANDLER(EXTI2_IRQHandler, EXTI2_IRQn)
+HOST_WEAK_HANDLER(EXTI3_IRQHandler, EXTI3_IRQn)
+HOST_WEAK_HANDLER(EXTI4_IRQHandler, EXTI4_IRQn)
+HOST_WEAK_HANDLER(EXTI9_5_IRQHandler, EXTI9_5_IRQn)
+HOST_WEAK_HANDLER(EXTI15_10_IRQHandler, EXTI15_10_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream0_IRQHandler, DMA1_Stream0_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream1_IRQHandler, DMA1_Stream1_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream2_IRQHandler, DMA1_Stream2_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream3_IRQHandler, DMA1_Stream3_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream4_IRQHandler, DMA1_Stream4_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream5_IRQHandler, DMA1_Stream5_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream6_IRQHandler, DMA1_Stream6_IRQn)
+HOST_WEAK_HANDLER(DMA1_Stream7_IRQHandler, DMA1_Stream7_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream0_IRQHandler, DMA2_Stream0_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream1_IRQHandler, DMA2_Stream1_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream2_IRQHandler, DMA2_Stream2_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream3_IRQHandler, DMA2_Stream3_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream4_IRQHandler, DMA2_Stream4_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream5_IRQHandler, DMA2_Stream5_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream6_IRQHandler, DMA2_Stream6_IRQn)
+HOST_WEAK_HANDLER(DMA2_Stream7_IRQHandler, DMA2_Stream7_IRQn)
+HOST_WEAK_HANDLER(TIM2_IRQHandler, TIM2_IRQn)
+HOST_WEAK_HANDLER(TIM3_IRQHandler, TIM3_IRQn)
+HOST_WEAK_HANDLER(TIM4_IRQHandler, TIM4_IRQn)
+HOST_WEAK_HANDLER(TIM5_IRQHandler, TIM5_IRQn)
+HOST_WEAK_HANDLER(TIM6_DAC_IRQHandler, TIM6_DAC_IRQn)
+HOST_WEAK_HANDLER(TIM7_IRQHandler, TIM7_IRQn)
+HOST_WEAK_HANDLER(SPI1_IRQHandler, SPI1_IRQn)
+
+static const HostVector host_vectors[] =
+{
+	{ NonMaskableInt_IRQn, NMI_Handler },
+	{ SVCall_IRQn, SVC_Handler },
+	{ PendSV_IRQn, PendSV_Handler },
+	{ SysTick_IRQn, SysTick_Handler },
+	{ EXTI0_IRQn, EXTI0_IRQHandler },
+	{ EXTI1_IRQn, EXTI1_IRQHandler },
+	{ EXTI2_IRQn, EXTI2_IRQHandler },
+	{ EXTI3_IRQn, EXTI3_IRQHandler },
+	{ EXTI4_IRQn, EXTI4_IRQHandler },
+	{ EXTI9_5_IRQn, EXTI9_5_IRQHandler },
+	{ EXTI15_10_IRQn, EXTI15_10_IRQHandler },
+	{ DMA1_Stream0_IRQn, DMA1_Stream0_IRQHandler },
+	{ DMA1_Stream1_IRQn, DMA1_Stream1_IRQHandler },
+	{ DMA1_Stream2_IRQn, DMA1_Stream2_IRQHandler },
+	{ DMA1_Stream3_IRQn, DMA1_Stream3_IRQHandler },
+	{ DMA1_Stream4_IRQn, DMA1_Stream4_IRQHandler },
+	{ DMA1_Stream5_IRQn, DMA1_Stream5_IRQHandler },
+	{ DMA1_Stream6_IRQn, DMA1_Stream6_IRQHandler },
+	{ DMA1_Stream7_IRQn, DMA1_Stream7_IRQHandler },
+	{ DMA2_Stream0_IRQn, DMA2_Stream0_IRQHandler },
+	{ DMA2_Stream1_IRQn, DMA2_Stream1_IRQHandler },
+	{ DMA2_Stream2_IRQn, DMA2_Stream2_IRQHandler },
+	{ DMA2_Stream3_IRQn, DMA2_Stream3_IRQHandler },
+	{ DMA2_Stream4_IRQn, DMA2_Stream4_IRQHandler },
+	{ DMA2_Stream5_IRQn, DMA2_Stream5_IRQHandler },
+	{ DMA2_Stream6_IRQn, DMA2_Stream6_IRQHandler },
+	{ DMA2_Stream7_IRQn, DMA2_Stream7_IRQHandler },
+	{ TIM2_IRQn, TIM2_IRQHandler },
+	{ TIM3_IRQn, TIM3_IRQHandler },
+	{ TIM4_IRQn, TIM4_IRQHandler },
+	{ TIM5_IRQn, TIM5_IRQHandler },
+	{ TIM6_DAC_IRQn, TIM6_DAC_IRQHandler },
+	{ TIM7_IRQn, TIM7_IRQHandler },
+	{ SPI1_IRQn, SPI1_IRQHandler },
+};
+
+#define HOST_VECTOR_NUMBER	(sizeof(host_vectors) / sizeof(host_vectors[0]))
+
+/* Vector table in the flash, exported by the startup file on target (entry 0, the initial SP, unused) */
+void (* __Vectors[HOST_EXC_NUMBER])(void);
+
+static bool host_buildVectors(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < HOST_VECTOR_NUMBER; i++)
+		__Vectors[host_vectors[i].irq + 16] = host_vectors[i].handler;
+	return true;
+}
+
+static const bool host_vectorsBuilt = host_buildVectors();
+
+/* Handler of the table VTOR points to: 0 for the flash one, a host pointer once relocated to RAM */
+static void (*host_getHandler(int exc))(void)
+{
+	void (* const * table)(void) = __Vectors;
+
+	if (host_SCB.VTOR.v != 0)
+		table = (void (* const *)(void)) host_SCB.VTOR.v;
+	return table[exc];
+}
+
+/* Peripheral interrupt lines are level sensitive: re-pend while asserted */
+/*
+ * Interrupt line asserted: pending unless its handler is running, a line
+ * still asserted at the exception return pends it again (ARMv7-M)
+ */
+static void host_assertLine(IRQn_Type IRQn)
+{
+	if (!host_active[IRQn + 16])
+		host_pending[IRQn + 16] = true;
+}
+
+static void host_updateLines(void)
+{
+	uint8_t dma, stream;
+	uint8_t line;
+
+	if (host_spiLine(&host_spi1))
+		host_assertLine(SPI1_IRQn);
+
+	for (line = 0; line < 16; line++)
+	{
+		if (host_EXTI.PR.v & host_EXTI.IMR.v & (0x1 << line))
+			host_assertLine(host_extiIRQ(line));
+	}
+
+	for (dma = 0; dma < 2; dma++)
+	{
+		for (stream = 0; stream < 8; stream++)
+		{
+			if (host_dmaLine(&host_dmas[dma], stream))
+				host_assertLine(host_dmas[dma].irqs[stream]);
+		}
+	}
+}
+
+static int host_nextException(void)
+{
+	int exc, best = -1;
+	uint32_t best_priority = HOST_THREAD_PRIORITY;
+
+	for (exc = 0; exc < HOST_EXC_NUMBER; exc++)
+	{
+		if (host_pending[exc] && host_enabled[exc] && !host_active[exc] && host_priority[exc] < best_priority)
+		{
+			best = exc;
+			best_priority = host_priority[exc];
+		}
+	}
+	return best;
+}
+
+/* Group priority of a priority (thread priority unchanged) */
+static uint32_t host_groupPriority(uint32_t priority)
+{
+	if (priority >= HOST_THREAD_PRIORITY)
+		return priority;
+	return priority & (0xFF << (host_prigroup + 1)) & 0xFF;
+}
+
+/* Exception preempting the execution priority: handlers running and BASEPRI */
+static bool host_canPreempt(int exc)
+{
+	uint32_t group = host_groupPriority(host_priority[exc]);
+
+	if (group >= host_groupPriority(host_runPriority[host_runDepth]))
+		return false;
+	return host_basepri == 0 || group < host_groupPriority(host_basepri);
+}
+
+static void host_dispatch(void)
+{
+	if (host_advancing)																			// Taken once the events of the access ran
+		return;
+	for (;;)
+	{
+		int exc;
+		void (*handler)(void);
+
+		host_updateLines();
+		if (host_primask)
+			break;
+		exc = host_nextException();
+		if (exc < 0 || !host_canPreempt(exc))
+			break;
+
+		host_pending[exc] = false;
+		host_active[exc] = true;
+		host_monitor = NULL;																		// Exception entry clears the exclusive monitor
+		host_runPriority[++host_runDepth] = host_priority[exc];
+		host_cpu += HOST_EXC_ENTRY_CYCLES;
+		host_advanceTo(host_now + HOST_EXC_ENTRY_CYCLES);
+
+		handler = host_getHandler(exc);
+		if (handler != NULL)
+			handler();
+		else
+			host_defaultHandler((IRQn_Type) (exc - 16));
+
+		host_cpu += HOST_EXC_EXIT_CYCLES;
+		host_advanceTo(host_now + HOST_EXC_EXIT_CYCLES);
+		host_runDepth--;
+		host_active[exc] = false;
+	}
+	if (host_runDepth == 0 && host_threadHook != NULL)
+		host_threadHook();																		// Back in thread mode
+}
+
+void host_nvicEnable(IRQn_Type IRQn)
+{
+	if (IRQn >= 0)
+	{
+		host_enabled[IRQn + 16] = true;
+		host_dispatch();
+	}
+}
+
+void host_nvicDisable(IRQn_Type IRQn)
+{
+	if (IRQn >= 0)
+		host_enabled[IRQn + 16] = false;
+}
+
+void host_nvicSetPending(IRQn_Type IRQn)
+{
+	host_pending[IRQn + 16] = true;
+	host_dispatch();
+}
+
+void host_nvicClearPending(IRQn_Type IRQn)
+{
+	host_pending[IRQn + 16] = false;
+}
+
+uint32_t host_nvicGetPending(IRQn_Type IRQn)
+{
+	return host_pending[IRQn + 16] ? 1 : 0;
+}
+
+void host_nvicSetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+	host_priority[IRQn + 16] = (uint8_t) ((priority << (8 - __NVIC_PRIO_BITS)) & 0xFF);
+	if (IRQn < 0)
+		host_SCB.SHP[IRQn + 16 - 4].v = host_priority[IRQn + 16];
+}
+
+uint32_t host_nvicGetPriority(IRQn_Type IRQn)
+{
+	return host_priority[IRQn + 16] >> (8 - __NVIC_PRIO_BITS);
+}
+
+void host_setPrimask(uint32_t primask)
+{
+	host_primask = primask & 0x1;
+	if (!host_primask)
+		host_dispatch();
+}
+
+uint32_t host_getPrimask(void)
+{
+	return host_primask;
+}
+
+void host_setBasepri(uint32_t basepri)
+{
+	host_basepri = basepri & (0xFF << (8 - __NVIC_PRIO_BITS)) & 0xFF;
+	host_dispatch();
+}
+
+uint32_t host_getBasepri(void)
+{
+	return host_basepri;
+}
+
+void host_wfi(void)
+{
+	uint64_t start = host_now;
+
+	for (;;)
+	{
+		int exc;
+
+		host_updateLines();
+		exc = host_nextException();
+		if ((exc >= 0 && host_canPreempt(exc))
+			|| host_now - start >= HOST_WFI_LIMIT)
+			break;
+
+		host_advanceTo(host_nextChange(start + HOST_WFI_LIMIT));
+	}
+	host_dispatch();
+}
+
+/* ICSR PENDSVSET and PENDSTSET read as the pending status */
+static void host_scbRead(HostPeriph * p, uint32_t offset)
+{
+	(void) p;
+	if (offset == offsetof(SCB_Type, ICSR))
+	{
+		host_SCB.ICSR.v = 0;
+		if (host_pending[PendSV_IRQn + 16])
+			host_SCB.ICSR.v |= SCB_ICSR_PENDSVSET_Msk;
+		if (host_pending[SysTick_IRQn + 16])
+			host_SCB.ICSR.v |= SCB_ICSR_PENDSTSET_Msk;
+	}
+}
+
+static void host_scbWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	uint32_t icsr = host_SCB.ICSR.v;
+
+	(void) p;
+	(void) old_value;
+	if (offset == offsetof(SCB_Type, ICSR))
+	{
+		if (icsr & SCB_ICSR_PENDSVSET_Msk)
+			host_pending[PendSV_IRQn + 16] = true;
+		if (icsr & SCB_ICSR_PENDSVCLR_Msk)
+			host_pending[PendSV_IRQn + 16] = false;
+		if (icsr & SCB_ICSR_PENDSTSET_Msk)
+			host_pending[SysTick_IRQn + 16] = true;
+		if (icsr & SCB_ICSR_PENDSTCLR_Msk)
+			host_pending[SysTick_IRQn + 16] = false;
+		host_SCB.ICSR.v = 0;																		// Set and clear bits act on write
+	}
+	else if (offset == offsetof(SCB_Type, AIRCR))
+	{
+		if ((host_SCB.AIRCR.v >> SCB_AIRCR_VECTKEY_Pos) == 0x05FA)
+			host_prigroup = (host_SCB.AIRCR.v & SCB_AIRCR_PRIGROUP_Msk) >> SCB_AIRCR_PRIGROUP_Pos;
+		host_SCB.AIRCR.v = (0xFA05UL << SCB_AIRCR_VECTKEY_Pos) | (host_prigroup << SCB_AIRCR_PRIGROUP_Pos);
+	}
+	else if (offset >= offsetof(SCB_Type, SHP) && offset < offsetof(SCB_Type, SHP) + sizeof(host_SCB.SHP))
+	{
+		// System handler priorities 4..15, as NVIC_SetPriority writes them on target
+		uint8_t i = (uint8_t) (offset - offsetof(SCB_Type, SHP));
+		host_priority[i + 4] = host_SCB.SHP[i].v & (0xFF << (8 - __NVIC_PRIO_BITS));
+	}
+}
+
+
+/*----------------------------------------------------------------------------
+  DWT cycle counter
+ *----------------------------------------------------------------------------*/
+
+static uint64_t host_dwtSince;					///< Virtual clock when CYCCNT was last brought up to date
+static bool host_dwtCounting;
+
+/* CYCCNT brought up to the virtual clock, then counting state of the new CTRL/DEMCR */
+static void host_dwtUpdate(void)
+{
+	if (host_dwtCounting)
+		host_DWT.CYCCNT.v += (uint32_t) (host_now - host_dwtSince);
+	host_dwtSince = host_now;
+	host_dwtCounting = (host_CoreDebug.DEMCR.v & CoreDebug_DEMCR_TRCENA_Msk)
+		&& (host_DWT.CTRL.v & DWT_CTRL_CYCCNTENA_Msk);
+}
+
+static void host_dwtRead(HostPeriph * p, uint32_t offset)
+{
+	(void) p;
+	if (offset == offsetof(DWT_Type, CYCCNT))
+		host_dwtUpdate();
+}
+
+static void host_dwtWrite(HostPeriph * p, uint32_t offset, uint32_t old_value)
+{
+	(void) old_value;
+	if (p->base == &host_DWT && offset == offsetof(DWT_Type, CYCCNT))
+		host_dwtSince = host_now;															// Counts from the written value
+	else
+		host_dwtUpdate();
+}
+
+
+/*----------------------------------------------------------------------------
+  Time
+ *----------------------------------------------------------------------------*/
+
+#define HOST_EVENT_NUMBER		16
+
+typedef struct
+{
+	uint64_t when;
+	void (*event)(void * ctx);							///< NULL when the slot is free
+	void * ctx;
+} HostEvent;
+
+static HostEvent host_events[HOST_EVENT_NUMBER];
+
+/* Earliest scheduled event not later than until */
+static HostEvent * host_nextEvent(uint64_t until)
+{
+	HostEvent * next = NULL;
+	uint8_t i;
+
+	for (i = 0; i < HOST_EVENT_NUMBER; i++)
+	{
+		if (host_events[i].event != NULL && host_events[i].when <= until
+			&& (next == NULL || host_events[i].when < next->when))
+			next = &host_events[i];
+	}
+	return next;
+}
+
+/* Time of the next event or end of SPI frame, until at the latest */
+static uint64_t host_nextChange(uint64_t until)
+{
+	HostEvent * e = host_nextEvent(until);
+
+	if (e != NULL)
+		until = e->when;
+	if (host_spi1.shifting && host_spi1.shift_end < until)
+		until = host_spi1.shift_end;
+	return until;
+}
+
+static void host_advanceTo(uint64_t target)
+{
+	bool advancing = host_advancing;
+	HostEvent * e;
+
+	host_advancing = true;
+	for (;;)
+	{
+		uint64_t until = target;
+		void (*event)(void * ctx);
+		void * ctx;
+
+		e = host_nextEvent(target);
+		if (e != NULL)
+			until = e->when;
+		while (host_spi1.shifting && host_spi1.shift_end <= until)
+		{
+			host_now = host_spi1.shift_end;
+			host_spiComplete(&host_spi1);
+		}
+		if (e == NULL)
+			break;
+		if (e->when > host_now)
+			host_now = e->when;
+		event = e->event;
+		ctx = e->ctx;
+		e->event = NULL;																				// Free: the event may schedule the next one
+		event(ctx);
+	}
+	if (target > host_now)
+		host_now = target;
+	host_advancing = advancing;
+}
+
+/*
+ * Runs the clock for cycles, the pending interrupts are dispatched at each
+ * event. Busy, the cycles are CPU cycles of the current context: the time
+ * spent in the handlers which preempt it is added.
+ */
+static void host_run(uint32_t cycles, bool busy)
+{
+	uint64_t end = host_now + cycles;
+	uint64_t until, before;
+	HostEvent * e = NULL;
+
+	for (;;)
+	{
+		before = host_now;
+		host_dispatch();																				// Raised before or at the event
+		if (busy)
+			end += host_now - before;
+		if (host_now >= end && e == NULL)
+			break;
+
+		e = host_nextEvent(end);
+		until = (e != NULL) ? e->when : end;
+		if (until < host_now)
+			until = host_now;
+		if (busy)
+			host_cpu += until - host_now;
+		host_advanceTo(until);
+	}
+}
+
+void HOST_advance(uint32_t cycles)
+{
+	host_run(cycles, false);
+}
+
+void HOST_busy(uint32_t cycles)
+{
+	host_run(cycles, true);
+}
+
+void HOST_setThreadHook(void (*hook)(void))
+{
+	host_threadHook = hook;
+}
+
+bool HOST_schedule(uint32_t delay, void (*event)(void * ctx), void * ctx)
+{
+	uint8_t i;
+
+	for (i = 0; i < HOST_EVENT_NUMBER; i++)
+	{
+		if (host_events[i].event == NULL)
+		{
+			host_events[i].when = host_now + delay;
+			host_events[i].event = event;
+			host_events[i].ctx = ctx;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*----------------------------------------------------------------------------
+  Reset
+ *----------------------------------------------------------------------------*/
+
+void HOST_reset(void)
+{
+	uint32_t i;
+	int exc;
+
+	for (i = 0; i < HOST_PERIPH_NUMBER; i++)
+	{
+		memset(host_periphs[i].base, 0, host_periphs[i].size);
+		host_periphs[i].reads = 0;
+		host_periphs[i].writes = 0;
+	}
+
+	/* Reset values (RM0090) */
+	host_GPIOA.MODER.v = 0xA8000000;
+	host_GPIOA.OSPEEDR.v = 0x0C000000;
+	host_GPIOA.PUPDR.v = 0x64000000;
+	host_GPIOB.MODER.v = 0x00000280;
+	host_GPIOB.OSPEEDR.v = 0x000000C0;
+	host_GPIOB.PUPDR.v = 0x00000100;
+	host_SPI1.SR.v = SPI_SR_TXE;
+	host_SPI1.CRCPR.v = 0x0007;
+
+	/* Clocks as left by SystemInit: PLL at 168 MHz from the 8 MHz HSE */
+	host_RCC.CR.v = RCC_CR_HSION | RCC_CR_HSIRDY | RCC_CR_HSEON | RCC_CR_HSERDY | RCC_CR_PLLON | RCC_CR_PLLRDY;
+	host_RCC.PLLCFGR.v = 8 | (336 << 6) | RCC_PLLCFGR_PLLSRC_HSE | (7 << 24);
+	host_RCC.CFGR.v = RCC_CFGR_SW_PLL | RCC_CFGR_SWS_PLL | RCC_CFGR_HPRE_DIV1 | RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2;
+	host_FLASH.ACR.v = FLASH_ACR_LATENCY_5WS | FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN;
+	host_PWR.CR.v = PWR_CR_VOS;
+	host_clockFaults = 0;
+	memset(host_art, 0, sizeof(host_art));
+	host_fetchStalls = 0;
+	host_FPU.FPCCR.v = FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+	host_MPU.TYPE.v = 0x8 << 8;																// 8 regions
+	host_msp = (uintptr_t) STACK_MAIN_TOP;
+	memset(host_gpioInputs, 0, sizeof(host_gpioInputs));
+
+	memset(&host_spi1, 0, sizeof(host_spi1));
+	host_spi1.SPI = &host_SPI1;
+	host_spi1.irq = SPI1_IRQn;
+	memset(host_tims, 0, sizeof(host_tims));
+	memset(host_events, 0, sizeof(host_events));
+	for (i = 0; i < 2; i++)
+	{
+		memset(host_dmas[i].ndtr, 0, sizeof(host_dmas[i].ndtr));
+		memset(host_dmas[i].index, 0, sizeof(host_dmas[i].index));
+	}
+
+	for (exc = 0; exc < HOST_EXC_NUMBER; exc++)
+	{
+		host_enabled[exc] = (exc < 16);
+		host_pending[exc] = false;
+		host_active[exc] = false;
+		host_priority[exc] = 0;
+	}
+	host_primask = 0;
+	host_basepri = 0;
+	host_prigroup = 0;
+	host_SCB.AIRCR.v = 0xFA05UL << SCB_AIRCR_VECTKEY_Pos;
+	host_runDepth = 0;
+	host_runPriority[0] = HOST_THREAD_PRIORITY;
+	host_threadHook = NULL;
+	host_monitor = NULL;
+
+	host_now = 0;
+	host_cpu = 0;
+	host_dwtSince = 0;
+	host_dwtCounting = false;
+	host_unhandled = 0;
+	host_log = NULL;
+	host_logSize = 0;
+	host_logCount = 0;
+	SystemCoreClock = 168000000;
+}
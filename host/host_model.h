@@ -0,0 +1,267 @@
+/**
+* @file 		host_model.h
+* @brief		Header file of the host peripheral model.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	Header file listing the functions required to drive the peripheral
+* model behind the host stm32f4xx.h: reset, virtual clock, GPIO inputs,
+* SPI slaves, access counters and statistics.
+*
+*		1. Time is counted in CPU cycles (HCLK). Each CPU register access
+*		costs HOST_ACCESS_CYCLES, exception entry and exit are counted too.
+*		Code which doesn't touch the registers is free, HOST_execute()
+*		charges a block of code with the flash wait states.
+*		2. Interrupt handlers are the ones of the application, with the
+*		names of startup_stm32f40_41xxx.s. The model provides weak default
+*		handlers which disable the IRQ and count it as unhandled.
+*		3. A test usually goes like this:
+*				HOST_reset();
+*				HOST_SPI_attachSlave(SPI1, &slave);
+*				// call the drivers
+*				HOST_getSPIStats(SPI1, &stats);
+*/
+
+#ifndef HOST_MODEL_H
+#define HOST_MODEL_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+#define HOST_ACCESS_CYCLES				2						///< CPU cycles for one peripheral register access
+#define HOST_EXC_ENTRY_CYCLES			12					///< Cycles from exception to first handler instruction
+#define HOST_EXC_EXIT_CYCLES			10					///< Cycles of exception return
+#define HOST_WFI_LIMIT						100000000		///< Max cycles a WFI waits for an interrupt
+
+/* SPI slave attached on the MISO/MOSI lines of a SPI */
+typedef struct
+{
+	void (*select)(void * ctx);							///< Called on CS falling edge (may be NULL)
+	uint8_t (*exchange)(void * ctx, uint8_t mosi);	///< Called at the end of each frame, returns MISO
+	void (*deselect)(void * ctx);						///< Called on CS rising edge (may be NULL)
+	void * ctx;
+	GPIO_TypeDef * cs_port;									///< NULL when the slave is always selected
+	uint8_t cs_pin;
+} HOST_SPISlave;
+
+/* SPI bus statistics */
+typedef struct
+{
+	uint32_t frames;						///< Frames shifted
+	uint64_t busy_cycles;				///< Cycles with a frame on the bus
+	uint64_t gap_cycles;				///< Idle cycles between two frames of the same CS window
+	uint64_t max_gap;						///< Longest idle time between two frames of the same CS window
+	uint32_t overruns;					///< Frames received while RXNE was still set
+} HOST_SPIStats;
+
+/* Instruction of a CPU register access */
+typedef enum
+{
+	HOST_ACCESS_PLAIN,												///< LDR/STR
+	HOST_ACCESS_EXCLUSIVE,										///< LDREX/STREX (atomic.h), STREX logged only when it stores
+	HOST_ACCESS_BITBAND												///< Store to the bit-band alias, value is the register after it
+} HOST_AccessKind;
+
+/* One logged CPU register access */
+typedef struct
+{
+	const void * reg;
+	uint32_t value;
+	uint8_t size;
+	bool write;
+	HOST_AccessKind kind;
+} HOST_Access;
+
+
+/*----------------------------------------------------------------------------
+  Model control
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Model reset.
+ * This function puts every register at its reset value, clears the NVIC,
+ * the virtual clock, the counters and detaches the SPI slaves.
+ */
+void HOST_reset(void);
+
+/**
+ * Virtual clock.
+ * @retval uint64_t Cycles elapsed since HOST_reset().
+ */
+uint64_t HOST_getCycles(void);
+
+/**
+ * CPU cycles spent in register accesses and exception entry/exit.
+ * @retval uint64_t CPU cycles since HOST_reset().
+ */
+uint64_t HOST_getCpuCycles(void);
+
+/**
+ * Time advance.
+ * This function lets the peripherals run for the given number of cycles
+ * without any CPU access, then dispatches the pending interrupts. The
+ * interrupts raised by a scheduled event are dispatched at its time.
+ * @param[in]	cycles Cycles to let elapse.
+ */
+void HOST_advance(uint32_t cycles);
+
+/**
+ * CPU work.
+ * This function stands for cycles of computation of the current context
+ * (main loop or handler): the interrupts which preempt it are dispatched
+ * at the time they are raised and their duration is added.
+ * @param[in]	cycles CPU cycles of the work.
+ */
+void HOST_busy(uint32_t cycles);
+
+/**
+ * Event scheduled on the virtual clock.
+ * The event is called once, when the clock reaches it. It may drive the
+ * model inputs (HOST_GPIO_setInput...) and schedule the next event, not
+ * access the registers.
+ * @param[in]	delay Cycles from now.
+ * @param[in]	event Function called.
+ * @param[in]	ctx Passed to the function.
+ * @retval bool false if the 16 event slots are used.
+ */
+bool HOST_schedule(uint32_t delay, void (*event)(void * ctx), void * ctx);
+
+/**
+ * Thread mode hook.
+ * The hook is called each time the model returns to thread mode, once
+ * the pending interrupts ran: a kernel port switches threads there, as
+ * PendSV would on exception return. The hook may swap to another stack
+ * (ucontext) and return later, the model state is the one of thread mode.
+ * @param[in]	hook Function called, NULL for none (set by HOST_reset).
+ */
+void HOST_setThreadHook(void (*hook)(void));
+
+/**
+ * Counts CPU register accesses to a peripheral block.
+ * @param[in]	periph Peripheral (GPIOA, SPI1, ...) or NULL for all of them.
+ * @param[out]	reads Number of reads (may be NULL).
+ * @param[out]	writes Number of writes (may be NULL).
+ */
+void HOST_getAccessCount(const void * periph, uint32_t * reads, uint32_t * writes);
+
+/**
+ * Access log.
+ * This function starts logging every CPU register access in log.
+ * Pass NULL to stop logging.
+ * @param[in]	log Buffer to fill.
+ * @param[in]	size Capacity of the buffer.
+ */
+void HOST_startLog(HOST_Access * log, uint32_t size);
+
+/**
+ * Number of accesses logged since HOST_startLog().
+ * @retval uint32_t Accesses logged (may be bigger than the buffer size).
+ */
+uint32_t HOST_getLogCount(void);
+
+/**
+ * Unhandled interrupts.
+ * @retval uint32_t Number of interrupts which reached a default handler.
+ */
+uint32_t HOST_getUnhandledCount(void);
+
+/**
+ * Clock configuration faults.
+ * Flash latency too low for HCLK, HCLK above 144 MHz in VOS scale 2, PCLK1
+ * or PCLK2 above its limit, PLLCFGR or VOS written while the PLL runs.
+ * @retval uint32_t Number of faults since the reset.
+ */
+uint32_t HOST_getClockFaults(void);
+
+
+/*----------------------------------------------------------------------------
+  Flash and ART accelerator
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Code executed.
+ * This function runs the CPU for a block of straight-line code (HOST_busy).
+ * From the flash, each 128-bit line stalls the CPU for the FLASH ACR
+ * latency, except the lines found in the ART instruction cache (64 lines,
+ * ICEN) and, with PRFTEN, the lines following the first one. Code in RAM
+ * doesn't wait. The vector read of an exception entry overlaps the
+ * stacking: its wait states are not charged, wherever VTOR points.
+ * @param[in]	address Address of the code (FLASH_BASE, SRAM1_BASE, ...).
+ * @param[in]	size Size of the code in bytes.
+ * @param[in]	cycles CPU cycles of the code without wait states.
+ */
+void HOST_execute(uint32_t address, uint32_t size, uint32_t cycles);
+
+/**
+ * Flash wait states.
+ * @retval uint64_t CPU cycles stalled on code fetches since the reset.
+ */
+uint64_t HOST_getFetchStalls(void);
+
+
+/*----------------------------------------------------------------------------
+  GPIO and EXTI
+ *----------------------------------------------------------------------------*/
+
+/**
+ * GPIO input level.
+ * This function drives a pin from outside the MCU. An edge sets the pending
+ * bit of the EXTI line the pin is selected on (SYSCFG EXTICR) when the line
+ * is unmasked and the edge is enabled, the EXTI interrupts are dispatched.
+ * @param[in]	GPIO Port of the pin.
+ * @param[in]	pin Pin number (0..15).
+ * @param[in]	level Level of the pin.
+ */
+void HOST_GPIO_setInput(GPIO_TypeDef * GPIO, uint8_t pin, bool level);
+
+
+/*----------------------------------------------------------------------------
+  SPI
+ *----------------------------------------------------------------------------*/
+
+/**
+ * SPI slave attached.
+ * @param[in]	SPI SPI the slave is connected to.
+ * @param[in]	slave Slave description, copied (NULL to detach).
+ */
+void HOST_SPI_attachSlave(SPI_TypeDef * SPI, const HOST_SPISlave * slave);
+
+/**
+ * SPI statistics.
+ * @param[in]	SPI SPI to read.
+ * @param[out]	stats Statistics since the last reset.
+ */
+void HOST_SPI_getStats(SPI_TypeDef * SPI, HOST_SPIStats * stats);
+
+/**
+ * SPI statistics reset.
+ * @param[in]	SPI SPI to reset.
+ */
+void HOST_SPI_resetStats(SPI_TypeDef * SPI);
+
+
+/*----------------------------------------------------------------------------
+  Timers
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Timer update event.
+ * The counters don't run: this function stands for an overflow. It sets
+ * UIF, loads the preloaded CCRs and, when UDE is set, raises the DMA
+ * update request of the timer (TIM4 only) for a DMA burst of DBL + 1
+ * transfers through DMAR. A write of UG in EGR does the same.
+ * @param[in]	TIM Timer (TIM2-TIM7).
+ */
+void HOST_TIM_update(TIM_TypeDef * TIM);
+
+/**
+ * Active compare value of a channel.
+ * @param[in]	TIM Timer (TIM2-TIM5).
+ * @param[in]	channel Channel (1..4).
+ * @retval uint32_t CCR value in use: the last one written, or with the
+ * OCxPE preload the one loaded at the last update event.
+ */
+uint32_t HOST_TIM_getCompare(TIM_TypeDef * TIM, uint8_t channel);
+
+#endif
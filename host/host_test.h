@@ -0,0 +1,55 @@
+/**
+* @file 		host_test.h
+* @brief		Minimal test helpers of the host build.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	Each test_*.c file is a program: TEST_RUN() calls a test function
+* after resetting the peripheral model, TEST_ASSERT() records failures
+* and TEST_END() returns the exit status of main().
+*
+*/
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include "host_model.h"
+
+static int test_failures = 0;
+static int test_count = 0;
+
+#define TEST_ASSERT(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			printf("  %s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual) \
+	do { \
+		long long test_e = (long long) (expected); \
+		long long test_a = (long long) (actual); \
+		if (test_e != test_a) \
+		{ \
+			printf("  %s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, test_a, test_e); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_RUN(test) \
+	do { \
+		int test_before = test_failures; \
+		HOST_reset(); \
+		test(); \
+		test_count++; \
+		printf("%s %s\n", test_failures == test_before ? "PASS" : "FAIL", #test); \
+	} while (0)
+
+#define TEST_END() \
+	(printf("%d tests, %d failures\n", test_count, test_failures), test_failures == 0 ? 0 : 1)
+
+#endif
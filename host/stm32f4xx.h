@@ -0,0 +1,870 @@
+/**
+* @file 		stm32f4xx.h
+* @brief		Host stand-in for the STM32F4xx device header.
+* @author		Julien
+* @version	0.1
+* @details
+*
+*	Replaces the CMSIS device header when the drivers and services are
+* compiled on a Linux host. Peripheral register blocks keep the layout
+* and the names of the StdPeriph header, but every register is a
+* HostReg: a memory-backed cell which reports each CPU access to the
+* peripheral model (host_model.c). The model advances a virtual clock
+* on every access, applies the hardware side-effects (BSRR->ODR, SPI
+* status flags, DMA requests, ...) and dispatches pending interrupts.
+*
+*		1. The sources must be compiled as C++ (g++ -x c++), see Makefile.
+*		2. Only the peripherals used by the project are modelled.
+*		3. Addresses written in DMA address registers are host pointers,
+*		use (uintptr_t) casts in the drivers.
+*/
+
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+
+#ifndef __cplusplus
+#error "The host register model must be compiled as C++ (g++ -x c++)."
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define STM32F40_41xxx
+
+#define __I		volatile const
+#define __O		volatile
+#define __IO	volatile
+
+typedef uint32_t  u32;
+typedef uint16_t 	u16;
+typedef uint8_t  	u8;
+typedef int32_t  	s32;
+typedef int16_t 	s16;
+typedef int8_t  	s8;
+
+/*----------------------------------------------------------------------------
+  Register cell
+ *----------------------------------------------------------------------------*/
+
+void host_regRead(const void * reg, uint8_t size);
+void host_regReadDone(const void * reg, uint8_t size);
+void host_regWrite(void * reg, uint8_t size, uint32_t old_value);
+uint32_t host_regLoadExclusive(const void * reg, uint8_t size);
+uint32_t host_regStoreExclusive(void * reg, uint8_t size, uint32_t value);
+void host_regBitBand(void * reg, uint8_t size, uint8_t bit, uint32_t value);
+
+/**
+ * Memory-backed peripheral register.
+ * Every read or write goes through the peripheral model, compound
+ * assignments are decomposed in one read followed by one write like
+ * the LDR/ORR/STR sequence generated on target.
+ */
+template <typename T>
+struct HostReg
+{
+	T v;
+
+	operator T() const
+	{
+		host_regRead(this, sizeof(T));
+		T value = v;
+		host_regReadDone(this, sizeof(T));
+		return value;
+	}
+
+	HostReg & operator=(uint64_t value)
+	{
+		T old_value = v;
+		v = (T) value;
+		host_regWrite(this, sizeof(T), (uint32_t) old_value);
+		return *this;
+	}
+
+	HostReg & operator=(const HostReg & other)		{ return *this = (T) other; }
+	HostReg & operator|=(uint64_t value)	{ return *this = ((T) *this) | value; }
+	HostReg & operator&=(uint64_t value)	{ return *this = ((T) *this) & value; }
+	HostReg & operator^=(uint64_t value)	{ return *this = ((T) *this) ^ value; }
+	HostReg & operator+=(uint64_t value)	{ return *this = ((T) *this) + value; }
+	HostReg & operator-=(uint64_t value)	{ return *this = ((T) *this) - value; }
+};
+
+typedef HostReg<uint32_t>		HostReg32;
+typedef HostReg<uint16_t>		HostReg16;
+typedef HostReg<uint8_t>		HostReg8;
+typedef HostReg<uintptr_t>	HostRegPtr;		///< 32-bit address register, widened for host pointers
+
+/**
+ * Bit-band alias word of a register bit.
+ * The target writes the alias of the bit through a uint32_t pointer
+ * (ATOMIC_BIT of atomic.h), this proxy reports the single store and the
+ * locked read-modify-write of the bus to the model.
+ */
+template <typename T>
+struct HostBitBand
+{
+	HostReg<T> * reg;
+	uint8_t bit;
+
+	HostBitBand & operator=(uint32_t value)
+	{
+		host_regBitBand(reg, sizeof(T), bit, value & 0x1);
+		return *this;
+	}
+
+	operator uint32_t() const				{ return ((uint32_t) (T) *reg >> bit) & 0x1; }
+};
+
+template <typename T>
+static inline HostBitBand<T> host_bitBand(HostReg<T> & reg, uint32_t bit)
+{
+	HostBitBand<T> alias = { &reg, (uint8_t) bit };
+	return alias;
+}
+
+#define ATOMIC_BIT(reg, bit)		(host_bitBand((reg), (bit)))		///< Replaces the alias address of atomic.h
+#define ATOMIC_REG32						HostReg32												///< Registers of ATOMIC_modify32
+#define ATOMIC_REG16						HostReg16												///< Registers of ATOMIC_modify16
+
+
+/*----------------------------------------------------------------------------
+  Interrupt numbers
+ *----------------------------------------------------------------------------*/
+
+typedef enum IRQn
+{
+	NonMaskableInt_IRQn 				= -14,
+	MemoryManagement_IRQn 			= -12,
+	BusFault_IRQn 							= -11,
+	UsageFault_IRQn 						= -10,
+	SVCall_IRQn 								= -5,
+	DebugMonitor_IRQn 					= -4,
+	PendSV_IRQn 								= -2,
+	SysTick_IRQn 								= -1,
+	WWDG_IRQn 									= 0,
+	PVD_IRQn 										= 1,
+	TAMP_STAMP_IRQn 						= 2,
+	RTC_WKUP_IRQn 							= 3,
+	FLASH_IRQn 									= 4,
+	RCC_IRQn 										= 5,
+	EXTI0_IRQn 									= 6,
+	EXTI1_IRQn 									= 7,
+	EXTI2_IRQn 									= 8,
+	EXTI3_IRQn 									= 9,
+	EXTI4_IRQn 									= 10,
+	DMA1_Stream0_IRQn 					= 11,
+	DMA1_Stream1_IRQn 					= 12,
+	DMA1_Stream2_IRQn 					= 13,
+	DMA1_Stream3_IRQn 					= 14,
+	DMA1_Stream4_IRQn 					= 15,
+	DMA1_Stream5_IRQn 					= 16,
+	DMA1_Stream6_IRQn 					= 17,
+	ADC_IRQn 										= 18,
+	EXTI9_5_IRQn 								= 23,
+	TIM2_IRQn 									= 28,
+	TIM3_IRQn 									= 29,
+	TIM4_IRQn 									= 30,
+	SPI1_IRQn 									= 35,
+	SPI2_IRQn 									= 36,
+	EXTI15_10_IRQn 							= 40,
+	DMA1_Stream7_IRQn 					= 47,
+	TIM5_IRQn 									= 50,
+	SPI3_IRQn 									= 51,
+	TIM6_DAC_IRQn 							= 54,
+	TIM7_IRQn 									= 55,
+	DMA2_Stream0_IRQn 					= 56,
+	DMA2_Stream1_IRQn 					= 57,
+	DMA2_Stream2_IRQn 					= 58,
+	DMA2_Stream3_IRQn 					= 59,
+	DMA2_Stream4_IRQn 					= 60,
+	DMA2_Stream5_IRQn 					= 68,
+	DMA2_Stream6_IRQn 					= 69,
+	DMA2_Stream7_IRQn 					= 70,
+	FPU_IRQn 										= 81
+} IRQn_Type;
+
+#define HOST_IRQ_NUMBER			82				///< Number of device interrupts modelled (0..FPU_IRQn)
+
+#define __NVIC_PRIO_BITS		4
+#define __FPU_PRESENT				1
+
+
+/*----------------------------------------------------------------------------
+  Peripheral register blocks (StdPeriph layout)
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	HostReg32 MODER;
+	HostReg32 OTYPER;
+	HostReg32 OSPEEDR;
+	HostReg32 PUPDR;
+	HostReg32 IDR;
+	HostReg32 ODR;
+	HostReg16 BSRRL;
+	HostReg16 BSRRH;
+	HostReg32 LCKR;
+	HostReg32 AFR[2];
+} GPIO_TypeDef;
+
+typedef struct
+{
+	HostReg16 CR1;				uint16_t RESERVED0;
+	HostReg16 CR2;				uint16_t RESERVED1;
+	HostReg16 SR;					uint16_t RESERVED2;
+	HostReg16 DR;					uint16_t RESERVED3;
+	HostReg16 CRCPR;			uint16_t RESERVED4;
+	HostReg16 RXCRCR;			uint16_t RESERVED5;
+	HostReg16 TXCRCR;			uint16_t RESERVED6;
+	HostReg16 I2SCFGR;		uint16_t RESERVED7;
+	HostReg16 I2SPR;			uint16_t RESERVED8;
+} SPI_TypeDef;
+
+typedef struct
+{
+	HostReg32 CR;
+	HostReg32 NDTR;
+	HostRegPtr PAR;
+	HostRegPtr M0AR;
+	HostRegPtr M1AR;
+	HostReg32 FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct
+{
+	HostReg32 LISR;
+	HostReg32 HISR;
+	HostReg32 LIFCR;
+	HostReg32 HIFCR;
+} DMA_TypeDef;
+
+typedef struct
+{
+	HostReg32 CR;
+	HostReg32 PLLCFGR;
+	HostReg32 CFGR;
+	HostReg32 CIR;
+	HostReg32 AHB1RSTR;
+	HostReg32 AHB2RSTR;
+	HostReg32 AHB3RSTR;
+	uint32_t  RESERVED0;
+	HostReg32 APB1RSTR;
+	HostReg32 APB2RSTR;
+	uint32_t  RESERVED1[2];
+	HostReg32 AHB1ENR;
+	HostReg32 AHB2ENR;
+	HostReg32 AHB3ENR;
+	uint32_t  RESERVED2;
+	HostReg32 APB1ENR;
+	HostReg32 APB2ENR;
+	uint32_t  RESERVED3[2];
+	HostReg32 AHB1LPENR;
+	HostReg32 AHB2LPENR;
+	HostReg32 AHB3LPENR;
+	uint32_t  RESERVED4;
+	HostReg32 APB1LPENR;
+	HostReg32 APB2LPENR;
+	uint32_t  RESERVED5[2];
+	HostReg32 BDCR;
+	HostReg32 CSR;
+	uint32_t  RESERVED6[2];
+	HostReg32 SSCGR;
+	HostReg32 PLLI2SCFGR;
+} RCC_TypeDef;
+
+typedef struct
+{
+	HostReg32 IMR;
+	HostReg32 EMR;
+	HostReg32 RTSR;
+	HostReg32 FTSR;
+	HostReg32 SWIER;
+	HostReg32 PR;
+} EXTI_TypeDef;
+
+typedef struct
+{
+	HostReg32 MEMRMP;
+	HostReg32 PMC;
+	HostReg32 EXTICR[4];
+	uint32_t  RESERVED[2];
+	HostReg32 CMPCR;
+} SYSCFG_TypeDef;
+
+typedef struct
+{
+	HostReg16 CR1;				uint16_t RESERVED0;
+	HostReg16 CR2;				uint16_t RESERVED1;
+	HostReg16 SMCR;				uint16_t RESERVED2;
+	HostReg16 DIER;				uint16_t RESERVED3;
+	HostReg16 SR;					uint16_t RESERVED4;
+	HostReg16 EGR;				uint16_t RESERVED5;
+	HostReg16 CCMR1;			uint16_t RESERVED6;
+	HostReg16 CCMR2;			uint16_t RESERVED7;
+	HostReg16 CCER;				uint16_t RESERVED8;
+	HostReg32 CNT;
+	HostReg16 PSC;				uint16_t RESERVED9;
+	HostReg32 ARR;
+	HostReg16 RCR;				uint16_t RESERVED10;
+	HostReg32 CCR1;
+	HostReg32 CCR2;
+	HostReg32 CCR3;
+	HostReg32 CCR4;
+	HostReg16 BDTR;				uint16_t RESERVED11;
+	HostReg16 DCR;				uint16_t RESERVED12;
+	HostReg16 DMAR;				uint16_t RESERVED13;
+	HostReg16 OR;					uint16_t RESERVED14;
+} TIM_TypeDef;
+
+typedef struct
+{
+	HostReg32 ACR;
+	HostReg32 KEYR;
+	HostReg32 OPTKEYR;
+	HostReg32 SR;
+	HostReg32 CR;
+	HostReg32 OPTCR;
+	HostReg32 OPTCR1;
+} FLASH_TypeDef;
+
+typedef struct
+{
+	HostReg32 CR;
+	HostReg32 CSR;
+} PWR_TypeDef;
+
+typedef struct
+{
+	HostReg32 CTRL;
+	HostReg32 CYCCNT;
+	HostReg32 CPICNT;
+	HostReg32 EXCCNT;
+	HostReg32 SLEEPCNT;
+	HostReg32 LSUCNT;
+	HostReg32 FOLDCNT;
+	HostReg32 PCSR;
+} DWT_Type;
+
+typedef struct
+{
+	HostReg32 CPUID;
+	HostReg32 ICSR;
+	HostRegPtr VTOR;
+	HostReg32 AIRCR;
+	HostReg32 SCR;
+	HostReg32 CCR;
+	HostReg8 SHP[12];
+	HostReg32 SHCSR;
+	HostReg32 CFSR;
+	HostReg32 HFSR;
+	HostReg32 DFSR;
+	HostReg32 MMFAR;
+	HostReg32 BFAR;
+	HostReg32 AFSR;
+	HostReg32 PFR[2];
+	HostReg32 DFR;
+	HostReg32 ADR;
+	HostReg32 MMFR[4];
+	HostReg32 ISAR[5];
+	uint32_t RESERVED0[5];
+	HostReg32 CPACR;
+} SCB_Type;
+
+typedef struct
+{
+	HostReg32 DHCSR;
+	HostReg32 DCRSR;
+	HostReg32 DCRDR;
+	HostReg32 DEMCR;
+} CoreDebug_Type;
+
+typedef struct
+{
+	uint32_t RESERVED0[1];
+	HostReg32 FPCCR;
+	HostReg32 FPCAR;
+	HostReg32 FPDSCR;
+	HostReg32 MVFR0;
+	HostReg32 MVFR1;
+} FPU_Type;
+
+typedef struct
+{
+	HostReg32 TYPE;
+	HostReg32 CTRL;
+	HostReg32 RNR;
+	HostRegPtr RBAR;
+	HostReg32 RASR;
+} MPU_Type;
+
+
+/**
+ * 32-bit write of the BSRRL/BSRRH halves.
+ * The target writes BSRR through a uint32_t pointer on BSRRL, this proxy
+ * reports the same single 32-bit access to the model.
+ */
+struct HostBSRR
+{
+	GPIO_TypeDef * GPIO;
+
+	explicit HostBSRR(GPIO_TypeDef * gpio) : GPIO(gpio) {}
+
+	HostBSRR & operator=(uint32_t value)
+	{
+		memcpy(&GPIO->BSRRL.v, &value, sizeof(value));
+		host_regWrite(&GPIO->BSRRL, sizeof(value), 0);
+		return *this;
+	}
+};
+
+
+/*----------------------------------------------------------------------------
+  Peripheral instances
+ *----------------------------------------------------------------------------*/
+
+extern GPIO_TypeDef host_GPIOA, host_GPIOB, host_GPIOC, host_GPIOD, host_GPIOE;
+extern SPI_TypeDef host_SPI1;
+extern DMA_TypeDef host_DMA1, host_DMA2;
+extern DMA_Stream_TypeDef host_DMA1_Stream[8], host_DMA2_Stream[8];
+extern RCC_TypeDef host_RCC;
+extern EXTI_TypeDef host_EXTI;
+extern SYSCFG_TypeDef host_SYSCFG;
+extern TIM_TypeDef host_TIM2, host_TIM3, host_TIM4, host_TIM5, host_TIM6, host_TIM7;
+extern FLASH_TypeDef host_FLASH;
+extern PWR_TypeDef host_PWR;
+extern SCB_Type host_SCB;
+extern DWT_Type host_DWT;
+extern CoreDebug_Type host_CoreDebug;
+extern FPU_Type host_FPU;
+extern MPU_Type host_MPU;
+
+#define GPIOA								(&host_GPIOA)
+#define GPIOB								(&host_GPIOB)
+#define GPIOC								(&host_GPIOC)
+#define GPIOD								(&host_GPIOD)
+#define GPIOE								(&host_GPIOE)
+#define GPIO_BSRR(GPIO)			(HostBSRR((GPIO)))	///< 32-bit BSRR access, replaces the cast of gpio.h
+#define SPI1								(&host_SPI1)
+#define DMA1								(&host_DMA1)
+#define DMA2								(&host_DMA2)
+#define DMA1_Stream0				(&host_DMA1_Stream[0])
+#define DMA1_Stream1				(&host_DMA1_Stream[1])
+#define DMA1_Stream2				(&host_DMA1_Stream[2])
+#define DMA1_Stream3				(&host_DMA1_Stream[3])
+#define DMA1_Stream4				(&host_DMA1_Stream[4])
+#define DMA1_Stream5				(&host_DMA1_Stream[5])
+#define DMA1_Stream6				(&host_DMA1_Stream[6])
+#define DMA1_Stream7				(&host_DMA1_Stream[7])
+#define DMA2_Stream0				(&host_DMA2_Stream[0])
+#define DMA2_Stream1				(&host_DMA2_Stream[1])
+#define DMA2_Stream2				(&host_DMA2_Stream[2])
+#define DMA2_Stream3				(&host_DMA2_Stream[3])
+#define DMA2_Stream4				(&host_DMA2_Stream[4])
+#define DMA2_Stream5				(&host_DMA2_Stream[5])
+#define DMA2_Stream6				(&host_DMA2_Stream[6])
+#define DMA2_Stream7				(&host_DMA2_Stream[7])
+#define RCC									(&host_RCC)
+#define EXTI								(&host_EXTI)
+#define SYSCFG							(&host_SYSCFG)
+#define TIM2								(&host_TIM2)
+#define TIM3								(&host_TIM3)
+#define TIM4								(&host_TIM4)
+#define TIM5								(&host_TIM5)
+#define TIM6								(&host_TIM6)
+#define TIM7								(&host_TIM7)
+#define FLASH								(&host_FLASH)
+#define PWR									(&host_PWR)
+#define SCB									(&host_SCB)
+#define DWT									(&host_DWT)
+#define CoreDebug						(&host_CoreDebug)
+#define FPU									(&host_FPU)
+#define MPU									(&host_MPU)
+
+
+/*----------------------------------------------------------------------------
+  Bit definitions
+ *----------------------------------------------------------------------------*/
+
+/* SPI */
+#define SPI_CR1_CPHA						((uint16_t)0x0001)
+#define SPI_CR1_CPOL						((uint16_t)0x0002)
+#define SPI_CR1_MSTR						((uint16_t)0x0004)
+#define SPI_CR1_BR							((uint16_t)0x0038)
+#define SPI_CR1_BR_0						((uint16_t)0x0008)
+#define SPI_CR1_BR_1						((uint16_t)0x0010)
+#define SPI_CR1_BR_2						((uint16_t)0x0020)
+#define SPI_CR1_SPE							((uint16_t)0x0040)
+#define SPI_CR1_LSBFIRST				((uint16_t)0x0080)
+#define SPI_CR1_SSI							((uint16_t)0x0100)
+#define SPI_CR1_SSM							((uint16_t)0x0200)
+#define SPI_CR1_RXONLY					((uint16_t)0x0400)
+#define SPI_CR1_DFF							((uint16_t)0x0800)
+#define SPI_CR1_CRCNEXT					((uint16_t)0x1000)
+#define SPI_CR1_CRCEN						((uint16_t)0x2000)
+#define SPI_CR1_BIDIOE					((uint16_t)0x4000)
+#define SPI_CR1_BIDIMODE				((uint16_t)0x8000)
+
+#define SPI_CR2_RXDMAEN					((uint8_t)0x01)
+#define SPI_CR2_TXDMAEN					((uint8_t)0x02)
+#define SPI_CR2_SSOE						((uint8_t)0x04)
+#define SPI_CR2_ERRIE						((uint8_t)0x20)
+#define SPI_CR2_RXNEIE					((uint8_t)0x40)
+#define SPI_CR2_TXEIE						((uint8_t)0x80)
+
+#define SPI_SR_RXNE							((uint8_t)0x01)
+#define SPI_SR_TXE							((uint8_t)0x02)
+#define SPI_SR_CHSIDE						((uint8_t)0x04)
+#define SPI_SR_UDR							((uint8_t)0x08)
+#define SPI_SR_CRCERR						((uint8_t)0x10)
+#define SPI_SR_MODF							((uint8_t)0x20)
+#define SPI_SR_OVR							((uint8_t)0x40)
+#define SPI_SR_BSY							((uint8_t)0x80)
+
+/* DMA */
+#define DMA_SxCR_CHSEL					((uint32_t)0x0E000000)
+#define DMA_SxCR_CHSEL_0				((uint32_t)0x02000000)
+#define DMA_SxCR_CHSEL_1				((uint32_t)0x04000000)
+#define DMA_SxCR_CHSEL_2				((uint32_t)0x08000000)
+#define DMA_SxCR_MBURST					((uint32_t)0x01800000)
+#define DMA_SxCR_PBURST					((uint32_t)0x00600000)
+#define DMA_SxCR_CT							((uint32_t)0x00080000)
+#define DMA_SxCR_DBM						((uint32_t)0x00040000)
+#define DMA_SxCR_PL							((uint32_t)0x00030000)
+#define DMA_SxCR_PL_0						((uint32_t)0x00010000)
+#define DMA_SxCR_PL_1						((uint32_t)0x00020000)
+#define DMA_SxCR_PINCOS					((uint32_t)0x00008000)
+#define DMA_SxCR_MSIZE					((uint32_t)0x00006000)
+#define DMA_SxCR_MSIZE_0				((uint32_t)0x00002000)
+#define DMA_SxCR_MSIZE_1				((uint32_t)0x00004000)
+#define DMA_SxCR_PSIZE					((uint32_t)0x00001800)
+#define DMA_SxCR_PSIZE_0				((uint32_t)0x00000800)
+#define DMA_SxCR_PSIZE_1				((uint32_t)0x00001000)
+#define DMA_SxCR_MINC						((uint32_t)0x00000400)
+#define DMA_SxCR_PINC						((uint32_t)0x00000200)
+#define DMA_SxCR_CIRC						((uint32_t)0x00000100)
+#define DMA_SxCR_DIR						((uint32_t)0x000000C0)
+#define DMA_SxCR_DIR_0					((uint32_t)0x00000040)
+#define DMA_SxCR_DIR_1					((uint32_t)0x00000080)
+#define DMA_SxCR_PFCTRL					((uint32_t)0x00000020)
+#define DMA_SxCR_TCIE						((uint32_t)0x00000010)
+#define DMA_SxCR_HTIE						((uint32_t)0x00000008)
+#define DMA_SxCR_TEIE						((uint32_t)0x00000004)
+#define DMA_SxCR_DMEIE					((uint32_t)0x00000002)
+#define DMA_SxCR_EN							((uint32_t)0x00000001)
+
+#define DMA_SxFCR_DMDIS					((uint32_t)0x00000004)
+
+#define DMA_LISR_FEIF0					((uint32_t)0x00000001)
+#define DMA_LISR_DMEIF0					((uint32_t)0x00000004)
+#define DMA_LISR_TEIF0					((uint32_t)0x00000008)
+#define DMA_LISR_HTIF0					((uint32_t)0x00000010)
+#define DMA_LISR_TCIF0					((uint32_t)0x00000020)
+#define DMA_LISR_TCIF1					((uint32_t)0x00000800)
+#define DMA_LISR_TCIF2					((uint32_t)0x00200000)
+#define DMA_LISR_TEIF3					((uint32_t)0x02000000)
+#define DMA_LISR_TCIF3					((uint32_t)0x08000000)
+#define DMA_HISR_TCIF4					((uint32_t)0x00000020)
+#define DMA_HISR_TCIF5					((uint32_t)0x00000800)
+#define DMA_HISR_TEIF6					((uint32_t)0x00080000)
+#define DMA_HISR_TCIF6					((uint32_t)0x00200000)
+#define DMA_HISR_TCIF7					((uint32_t)0x08000000)
+
+#define DMA_LIFCR_CFEIF0				((uint32_t)0x00000001)
+#define DMA_LIFCR_CDMEIF0				((uint32_t)0x00000004)
+#define DMA_LIFCR_CTEIF0				((uint32_t)0x00000008)
+#define DMA_LIFCR_CHTIF0				((uint32_t)0x00000010)
+#define DMA_LIFCR_CTCIF0				((uint32_t)0x00000020)
+#define DMA_LIFCR_CFEIF3				((uint32_t)0x00400000)
+#define DMA_LIFCR_CDMEIF3				((uint32_t)0x01000000)
+#define DMA_LIFCR_CTEIF3				((uint32_t)0x02000000)
+#define DMA_LIFCR_CHTIF3				((uint32_t)0x04000000)
+#define DMA_LIFCR_CTCIF3				((uint32_t)0x08000000)
+#define DMA_HIFCR_CFEIF6				((uint32_t)0x00010000)
+#define DMA_HIFCR_CDMEIF6				((uint32_t)0x00040000)
+#define DMA_HIFCR_CTEIF6				((uint32_t)0x00080000)
+#define DMA_HIFCR_CHTIF6				((uint32_t)0x00100000)
+#define DMA_HIFCR_CTCIF6				((uint32_t)0x00200000)
+
+/* RCC */
+#define RCC_AHB1ENR_GPIOAEN			((uint32_t)0x00000001)
+#define RCC_AHB1ENR_GPIOBEN			((uint32_t)0x00000002)
+#define RCC_AHB1ENR_GPIOCEN			((uint32_t)0x00000004)
+#define RCC_AHB1ENR_GPIODEN			((uint32_t)0x00000008)
+#define RCC_AHB1ENR_GPIOEEN			((uint32_t)0x00000010)
+#define RCC_AHB1ENR_GPIOFEN			((uint32_t)0x00000020)
+#define RCC_AHB1ENR_GPIOGEN			((uint32_t)0x00000040)
+#define RCC_AHB1ENR_GPIOHEN			((uint32_t)0x00000080)
+#define RCC_AHB1ENR_GPIOIEN			((uint32_t)0x00000100)
+#define RCC_AHB1ENR_GPIOJEN			((uint32_t)0x00000200)
+#define RCC_AHB1ENR_GPIOKEN			((uint32_t)0x00000400)
+#define RCC_AHB1ENR_CCMDATARAMEN	((uint32_t)0x00100000)
+#define RCC_AHB1ENR_DMA1EN			((uint32_t)0x00200000)
+#define RCC_AHB1ENR_DMA2EN			((uint32_t)0x00400000)
+
+#define RCC_CR_HSION						((uint32_t)0x00000001)
+#define RCC_CR_HSIRDY						((uint32_t)0x00000002)
+#define RCC_CR_HSEON						((uint32_t)0x00010000)
+#define RCC_CR_HSERDY						((uint32_t)0x00020000)
+#define RCC_CR_PLLON						((uint32_t)0x01000000)
+#define RCC_CR_PLLRDY						((uint32_t)0x02000000)
+
+#define RCC_PLLCFGR_PLLM				((uint32_t)0x0000003F)
+#define RCC_PLLCFGR_PLLN				((uint32_t)0x00007FC0)
+#define RCC_PLLCFGR_PLLP				((uint32_t)0x00030000)
+#define RCC_PLLCFGR_PLLSRC			((uint32_t)0x00400000)
+#define RCC_PLLCFGR_PLLSRC_HSE	((uint32_t)0x00400000)
+#define RCC_PLLCFGR_PLLQ				((uint32_t)0x0F000000)
+
+#define RCC_CFGR_SW							((uint32_t)0x00000003)
+#define RCC_CFGR_SW_HSI					((uint32_t)0x00000000)
+#define RCC_CFGR_SW_HSE					((uint32_t)0x00000001)
+#define RCC_CFGR_SW_PLL					((uint32_t)0x00000002)
+#define RCC_CFGR_SWS						((uint32_t)0x0000000C)
+#define RCC_CFGR_SWS_HSI				((uint32_t)0x00000000)
+#define RCC_CFGR_SWS_HSE				((uint32_t)0x00000004)
+#define RCC_CFGR_SWS_PLL				((uint32_t)0x00000008)
+#define RCC_CFGR_HPRE						((uint32_t)0x000000F0)
+#define RCC_CFGR_HPRE_DIV1			((uint32_t)0x00000000)
+#define RCC_CFGR_PPRE1					((uint32_t)0x00001C00)
+#define RCC_CFGR_PPRE1_DIV1			((uint32_t)0x00000000)
+#define RCC_CFGR_PPRE1_DIV2			((uint32_t)0x00001000)
+#define RCC_CFGR_PPRE1_DIV4			((uint32_t)0x00001400)
+#define RCC_CFGR_PPRE1_DIV8			((uint32_t)0x00001800)
+#define RCC_CFGR_PPRE1_DIV16		((uint32_t)0x00001C00)
+#define RCC_CFGR_PPRE2					((uint32_t)0x0000E000)
+#define RCC_CFGR_PPRE2_DIV1			((uint32_t)0x00000000)
+#define RCC_CFGR_PPRE2_DIV2			((uint32_t)0x00008000)
+#define RCC_CFGR_PPRE2_DIV4			((uint32_t)0x0000A000)
+#define RCC_CFGR_PPRE2_DIV8			((uint32_t)0x0000C000)
+#define RCC_CFGR_PPRE2_DIV16		((uint32_t)0x0000E000)
+
+#define RCC_APB1ENR_TIM2EN			((uint32_t)0x00000001)
+#define RCC_APB1ENR_TIM3EN			((uint32_t)0x00000002)
+#define RCC_APB1ENR_TIM4EN			((uint32_t)0x00000004)
+#define RCC_APB1ENR_TIM5EN			((uint32_t)0x00000008)
+#define RCC_APB1ENR_TIM6EN			((uint32_t)0x00000010)
+#define RCC_APB1ENR_TIM7EN			((uint32_t)0x00000020)
+#define RCC_APB1ENR_PWREN				((uint32_t)0x10000000)
+
+#define RCC_APB2ENR_SPI1EN			((uint32_t)0x00001000)
+#define RCC_APB2ENR_SYSCFGEN		((uint32_t)0x00004000)
+
+/* FLASH */
+#define FLASH_ACR_LATENCY				((uint32_t)0x0000000F)
+#define FLASH_ACR_LATENCY_5WS		((uint32_t)0x00000005)
+#define FLASH_ACR_PRFTEN				((uint32_t)0x00000100)
+#define FLASH_ACR_ICEN					((uint32_t)0x00000200)
+#define FLASH_ACR_DCEN					((uint32_t)0x00000400)
+#define FLASH_ACR_ICRST					((uint32_t)0x00000800)
+#define FLASH_ACR_DCRST					((uint32_t)0x00001000)
+
+/* PWR */
+#define PWR_CR_VOS							((uint32_t)0x00004000)
+
+/* SYSCFG */
+#define SYSCFG_EXTICR1_EXTI0_PA	((uint16_t)0x0000)
+#define SYSCFG_EXTICR1_EXTI0_PB	((uint16_t)0x0001)
+#define SYSCFG_EXTICR1_EXTI0_PC	((uint16_t)0x0002)
+#define SYSCFG_EXTICR1_EXTI0_PD	((uint16_t)0x0003)
+#define SYSCFG_EXTICR1_EXTI0_PE	((uint16_t)0x0004)
+#define SYSCFG_EXTICR1_EXTI0_PF	((uint16_t)0x0005)
+#define SYSCFG_EXTICR1_EXTI0_PG	((uint16_t)0x0006)
+#define SYSCFG_EXTICR1_EXTI0_PH	((uint16_t)0x0007)
+#define SYSCFG_EXTICR1_EXTI0_PI	((uint16_t)0x0008)
+
+/* TIM */
+#define TIM_CR1_CEN							((uint16_t)0x0001)
+#define TIM_CR1_UDIS						((uint16_t)0x0002)
+#define TIM_CR1_URS							((uint16_t)0x0004)
+#define TIM_CR1_OPM							((uint16_t)0x0008)
+#define TIM_CR1_DIR							((uint16_t)0x0010)
+#define TIM_CR1_ARPE						((uint16_t)0x0080)
+
+#define TIM_DIER_UIE						((uint16_t)0x0001)
+#define TIM_DIER_CC1IE					((uint16_t)0x0002)
+#define TIM_DIER_UDE						((uint16_t)0x0100)
+
+#define TIM_SR_UIF							((uint16_t)0x0001)
+#define TIM_SR_CC1IF						((uint16_t)0x0002)
+
+#define TIM_EGR_UG							((uint8_t)0x01)
+
+#define TIM_CCMR1_CC1S					((uint16_t)0x0003)
+#define TIM_CCMR1_OC1PE					((uint16_t)0x0008)
+#define TIM_CCMR1_OC1M					((uint16_t)0x0070)
+#define TIM_CCMR1_OC1M_0				((uint16_t)0x0010)
+#define TIM_CCMR1_OC1M_1				((uint16_t)0x0020)
+#define TIM_CCMR1_OC1M_2				((uint16_t)0x0040)
+#define TIM_CCMR1_OC2PE					((uint16_t)0x0800)
+
+#define TIM_CCER_CC1E						((uint16_t)0x0001)
+#define TIM_CCER_CC1P						((uint16_t)0x0002)
+
+#define TIM_DCR_DBA							((uint16_t)0x001F)
+#define TIM_DCR_DBL							((uint16_t)0x1F00)
+
+/* SCB, DWT, CoreDebug (core_cm4.h) */
+#define SCB_ICSR_PENDSVSET_Msk			(1UL << 28)
+#define SCB_ICSR_PENDSVCLR_Msk			(1UL << 27)
+#define SCB_ICSR_PENDSTSET_Msk			(1UL << 26)
+#define SCB_ICSR_PENDSTCLR_Msk			(1UL << 25)
+#define SCB_AIRCR_VECTKEY_Pos				16
+#define SCB_AIRCR_VECTKEY_Msk				(0xFFFFUL << SCB_AIRCR_VECTKEY_Pos)
+#define SCB_AIRCR_PRIGROUP_Pos			8
+#define SCB_AIRCR_PRIGROUP_Msk			(7UL << SCB_AIRCR_PRIGROUP_Pos)
+#define DWT_CTRL_CYCCNTENA_Msk			(1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk	(1UL << 24)
+#define FPU_FPCCR_LSPEN_Msk					(1UL << 30)
+#define FPU_FPCCR_ASPEN_Msk					(1UL << 31)
+#define SCB_SHCSR_MEMFAULTENA_Msk		(1UL << 16)
+#define MPU_CTRL_ENABLE_Msk					(1UL << 0)
+#define MPU_CTRL_PRIVDEFENA_Msk			(1UL << 2)
+#define MPU_RASR_ENABLE_Msk					(1UL << 0)
+#define MPU_RASR_SIZE_Pos						1
+#define MPU_RASR_AP_Pos							24
+#define MPU_RASR_XN_Msk							(1UL << 28)
+
+
+/*----------------------------------------------------------------------------
+  System
+ *----------------------------------------------------------------------------*/
+
+#define FLASH_BASE							((uint32_t)0x08000000)		///< Code addresses of HOST_execute()
+#define CCMDATARAM_BASE					((uint32_t)0x10000000)
+#define SRAM1_BASE							((uint32_t)0x20000000)
+#define MEM_RAMCODE															///< No placement on the host (memory.h)
+#define MEM_CCM
+
+#define HOST_MAIN_STACK_WORDS		256													///< Stack_Size of the startup file
+extern uint32_t host_mainStack[HOST_MAIN_STACK_WORDS];
+#define STACK_MAIN_BASE					host_mainStack							///< Main stack of the model (stack.h), MSP at its top after HOST_reset
+#define STACK_MAIN_TOP					(host_mainStack + HOST_MAIN_STACK_WORDS)
+
+#define HSE_VALUE								((uint32_t)8000000)				///< Crystal of the Discovery
+#define HSI_VALUE								((uint32_t)16000000)
+
+extern uint32_t SystemCoreClock;
+
+void SystemInit(void);
+void SystemCoreClockUpdate(void);
+
+
+/*----------------------------------------------------------------------------
+  Core peripherals and intrinsics (core_cm4.h subset)
+ *----------------------------------------------------------------------------*/
+
+void host_nvicEnable(IRQn_Type IRQn);
+void host_nvicDisable(IRQn_Type IRQn);
+void host_nvicSetPending(IRQn_Type IRQn);
+void host_nvicClearPending(IRQn_Type IRQn);
+uint32_t host_nvicGetPending(IRQn_Type IRQn);
+void host_nvicSetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t host_nvicGetPriority(IRQn_Type IRQn);
+void host_setPrimask(uint32_t primask);
+uint32_t host_getPrimask(void);
+void host_setBasepri(uint32_t basepri);
+uint32_t host_getBasepri(void);
+extern uintptr_t host_msp;
+void host_wfi(void);
+
+static inline void NVIC_EnableIRQ(IRQn_Type IRQn)								{ host_nvicEnable(IRQn); }
+static inline void NVIC_DisableIRQ(IRQn_Type IRQn)							{ host_nvicDisable(IRQn); }
+static inline void NVIC_SetPendingIRQ(IRQn_Type IRQn)						{ host_nvicSetPending(IRQn); }
+static inline void NVIC_ClearPendingIRQ(IRQn_Type IRQn)					{ host_nvicClearPending(IRQn); }
+static inline uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)				{ return host_nvicGetPending(IRQn); }
+static inline void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)	{ host_nvicSetPriority(IRQn, priority); }
+static inline uint32_t NVIC_GetPriority(IRQn_Type IRQn)					{ return host_nvicGetPriority(IRQn); }
+
+/* Priority grouping, as core_cm4.h: through SCB AIRCR */
+static inline void NVIC_SetPriorityGrouping(uint32_t PriorityGroup)
+{
+	uint32_t reg_value = SCB->AIRCR;
+
+	reg_value &= ~(SCB_AIRCR_VECTKEY_Msk | SCB_AIRCR_PRIGROUP_Msk);
+	SCB->AIRCR = reg_value | (0x5FAUL << SCB_AIRCR_VECTKEY_Pos) | ((PriorityGroup & 0x07) << SCB_AIRCR_PRIGROUP_Pos);
+}
+
+static inline uint32_t NVIC_GetPriorityGrouping(void)
+{
+	return (SCB->AIRCR & SCB_AIRCR_PRIGROUP_Msk) >> SCB_AIRCR_PRIGROUP_Pos;
+}
+
+static inline uint32_t NVIC_EncodePriority(uint32_t PriorityGroup, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+	uint32_t group = PriorityGroup & 0x07;
+	uint32_t preempt_bits = ((7 - group) > __NVIC_PRIO_BITS) ? __NVIC_PRIO_BITS : 7 - group;
+	uint32_t sub_bits = ((group + __NVIC_PRIO_BITS) < 7) ? 0 : group - 7 + __NVIC_PRIO_BITS;
+
+	return ((PreemptPriority & ((1UL << preempt_bits) - 1)) << sub_bits) | (SubPriority & ((1UL << sub_bits) - 1));
+}
+
+static inline void NVIC_DecodePriority(uint32_t Priority, uint32_t PriorityGroup, uint32_t * pPreemptPriority, uint32_t * pSubPriority)
+{
+	uint32_t group = PriorityGroup & 0x07;
+	uint32_t preempt_bits = ((7 - group) > __NVIC_PRIO_BITS) ? __NVIC_PRIO_BITS : 7 - group;
+	uint32_t sub_bits = ((group + __NVIC_PRIO_BITS) < 7) ? 0 : group - 7 + __NVIC_PRIO_BITS;
+
+	*pPreemptPriority = (Priority >> sub_bits) & ((1UL << preempt_bits) - 1);
+	*pSubPriority = Priority & ((1UL << sub_bits) - 1);
+}
+
+static inline void __disable_irq(void)				{ host_setPrimask(1); }
+static inline void __enable_irq(void)					{ host_setPrimask(0); }
+static inline uint32_t __get_PRIMASK(void)		{ return host_getPrimask(); }
+static inline void __set_PRIMASK(uint32_t primask)	{ host_setPrimask(primask); }
+static inline uint32_t __get_BASEPRI(void)		{ return host_getBasepri(); }
+static inline void __set_BASEPRI(uint32_t basepri)	{ host_setBasepri(basepri); }
+static inline uintptr_t __get_MSP(void)				{ return host_msp; }				///< Address of the model, not of the host stack
+static inline void __set_MSP(uintptr_t msp)			{ host_msp = msp; }
+static inline void __WFI(void)								{ host_wfi(); }
+static inline void __NOP(void)								{ }
+static inline void __DSB(void)								{ __sync_synchronize(); }
+static inline void __ISB(void)								{ __sync_synchronize(); }
+static inline void __DMB(void)								{ __sync_synchronize(); }
+
+/*
+ * Exclusive monitor of the calling thread: STREX succeeds if the word
+ * still holds the value loaded by LDREX (compare-and-swap), so that the
+ * lock-free code also runs on several host threads. An interrupt handler
+ * run in between reloads the monitor and clears it with its own STREX,
+ * as the exception return does on target.
+ */
+static __thread volatile uint32_t * host_exclusiveAddr;
+static __thread uint32_t host_exclusiveValue;
+
+static inline uint32_t __LDREXW(volatile uint32_t * addr)
+{
+	host_exclusiveAddr = addr;
+	host_exclusiveValue = __atomic_load_n(addr, __ATOMIC_SEQ_CST);
+	return host_exclusiveValue;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t * addr)
+{
+	bool stored = host_exclusiveAddr == addr
+		&& __sync_bool_compare_and_swap(addr, host_exclusiveValue, value);
+	host_exclusiveAddr = NULL;
+	return stored ? 0 : 1;
+}
+
+static inline void __CLREX(void)							{ host_exclusiveAddr = NULL; }
+
+/* Exclusive accesses to the registers go through the monitor of the model */
+static inline uint32_t __LDREXW(HostReg32 * reg)						{ return host_regLoadExclusive(reg, 4); }
+static inline uint32_t __STREXW(uint32_t value, HostReg32 * reg)	{ return host_regStoreExclusive(reg, 4, value); }
+static inline uint16_t __LDREXH(HostReg16 * reg)						{ return (uint16_t) host_regLoadExclusive(reg, 2); }
+static inline uint32_t __STREXH(uint16_t value, HostReg16 * reg)	{ return host_regStoreExclusive(reg, 2, value); }
+
+static inline uint8_t __CLZ(uint32_t value)		{ return (uint8_t) (value == 0 ? 32 : __builtin_clz(value)); }
+static inline uint32_t __RBIT(uint32_t value)
+{
+	uint32_t result = 0;
+	for (int i = 0; i < 32; i++)
+	{
+		result = (result << 1) | (value & 0x1);
+		value >>= 1;
+	}
+	return result;
+}
+
+#endif
@@ -0,0 +1,189 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_atomic.c
+ * Purpose: Atomic register access layer host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	An EXTI handler changes other bits of the register the test modifies:
+ * its edge is scheduled during the load, the handler runs between the
+ * load and the store.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "atomic.h"
+#include "interrupt.h"
+#include "timer.h"
+#include "rcc.h"
+
+#define HANDLER_BITS			0x3UL																	///< OSPEEDR of pin 0, set by the handler
+#define MAIN_BITS					(0x3UL << 2)														///< OSPEEDR of pin 1, set by the test
+
+static uint32_t handled;
+
+/* Plain read-modify-write of the handler */
+static void on_edge(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	GPIOD->OSPEEDR |= HANDLER_BITS;
+	handled++;
+}
+
+static void raise_edge(void * context)
+{
+	(void) context;
+	HOST_GPIO_setInput(GPIOA, 3, true);
+	HOST_GPIO_setInput(GPIOA, 3, false);
+}
+
+static void setup(void)
+{
+	handled = 0;
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(3, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_edge, NULL);
+	GPIOD->OSPEEDR = 0;
+}
+
+static uint32_t count_kind(const HOST_Access * log, uint32_t count, HOST_AccessKind kind, bool write)
+{
+	uint32_t i, found = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		if (log[i].reg == &GPIOD->OSPEEDR && log[i].kind == kind && log[i].write == write)
+			found++;
+	}
+	return found;
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_bit_band_single_store(void)
+{
+	HOST_Access log[4];
+
+	GPIOD->OTYPER = 0x0F0F;
+	HOST_startLog(log, 4);
+	ATOMIC_SET_BIT(GPIOD->OTYPER, 0x0010);
+	ATOMIC_CLEAR_BIT(GPIOD->OTYPER, 0x0001);
+	TEST_ASSERT_EQUAL(2, HOST_getLogCount());
+	HOST_startLog(NULL, 0);
+
+	TEST_ASSERT(log[0].write && log[1].write);
+	TEST_ASSERT_EQUAL(HOST_ACCESS_BITBAND, log[0].kind);
+	TEST_ASSERT_EQUAL(HOST_ACCESS_BITBAND, log[1].kind);
+	TEST_ASSERT_EQUAL(0x0F1E, GPIOD->OTYPER);
+	TEST_ASSERT_EQUAL(1, ATOMIC_BIT(GPIOD->OTYPER, 4));
+	TEST_ASSERT_EQUAL(0, ATOMIC_BIT(GPIOD->OTYPER, 0));
+}
+
+static void test_modify_one_pair(void)
+{
+	HOST_Access log[4];
+
+	GPIOD->MODER = 0xFFFFFFFF;
+	HOST_startLog(log, 4);
+	ATOMIC_MODIFY32(GPIOD->MODER, 0x3 << 24, 0x1 << 24);
+	TEST_ASSERT_EQUAL(2, HOST_getLogCount());
+	HOST_startLog(NULL, 0);
+
+	TEST_ASSERT(!log[0].write && log[1].write);
+	TEST_ASSERT_EQUAL(HOST_ACCESS_EXCLUSIVE, log[0].kind);
+	TEST_ASSERT_EQUAL(HOST_ACCESS_EXCLUSIVE, log[1].kind);
+	TEST_ASSERT_EQUAL(0xFDFFFFFF, GPIOD->MODER);
+}
+
+static void test_modify_retried_after_interrupt(void)
+{
+	HOST_Access log[16];
+	uint32_t count;
+
+	setup();
+	HOST_startLog(log, 16);
+	HOST_schedule(1, raise_edge, NULL);																	// During the LDREX
+	ATOMIC_MODIFY32(GPIOD->OSPEEDR, 0, MAIN_BITS);
+	count = HOST_getLogCount();
+	HOST_startLog(NULL, 0);
+
+	// The handler cleared the monitor: STREX failed, loaded again
+	TEST_ASSERT_EQUAL(1, handled);
+	TEST_ASSERT_EQUAL(2, count_kind(log, count, HOST_ACCESS_EXCLUSIVE, false));
+	TEST_ASSERT_EQUAL(1, count_kind(log, count, HOST_ACCESS_EXCLUSIVE, true));
+	TEST_ASSERT_EQUAL(HANDLER_BITS | MAIN_BITS, GPIOD->OSPEEDR);
+	EXTI_detach(3);
+}
+
+static void test_plain_rmw_loses_interrupt(void)
+{
+	setup();
+	HOST_schedule(1, raise_edge, NULL);																	// During the LDR
+	GPIOD->OSPEEDR |= MAIN_BITS;
+
+	// Store of the value loaded before the handler: its bits undone
+	TEST_ASSERT_EQUAL(1, handled);
+	TEST_ASSERT_EQUAL(MAIN_BITS, GPIOD->OSPEEDR);
+	EXTI_detach(3);
+}
+
+static void test_store_without_load(void)
+{
+	GPIOD->ODR = 0;
+	TEST_ASSERT_EQUAL(1, __STREXW(0x1234, &GPIOD->ODR));
+	TEST_ASSERT_EQUAL(0, GPIOD->ODR);
+	TEST_ASSERT_EQUAL(0, __LDREXW(&GPIOD->ODR));
+	TEST_ASSERT_EQUAL(1, __STREXW(0x1234, &GPIOD->IDR));											// Other register
+	TEST_ASSERT_EQUAL(1, __STREXW(0x1234, &GPIOD->ODR));											// Monitor cleared by the failed STREX
+}
+
+static void test_timer_flag_cleared_alone(void)
+{
+	TIM3_CLK_ENABLE();
+	TIM3->SR.v = TIM_SR_CC1IF;
+	HOST_TIM_update(TIM3);
+	TEST_ASSERT_EQUAL(TIM_SR_UIF | TIM_SR_CC1IF, TIM3->SR);
+	TIM_resetIRFlag(TIM3);
+	TEST_ASSERT_EQUAL(TIM_SR_CC1IF, TIM3->SR);
+}
+
+static void test_pwm_mode_exclusive(void)
+{
+	HOST_Access log[8];
+	uint32_t count, i, exclusive = 0;
+
+	TIM4_CLK_ENABLE();
+	TIM4->CCMR2 = 0x0073;
+	HOST_startLog(log, 8);
+	TIM_initPWM(TIM4, 4);
+	count = HOST_getLogCount();
+	HOST_startLog(NULL, 0);
+
+	for (i = 0; i < count && i < 8; i++)
+	{
+		if (log[i].reg == &TIM4->CCMR2)
+		{
+			TEST_ASSERT_EQUAL(HOST_ACCESS_EXCLUSIVE, log[i].kind);
+			exclusive++;
+		}
+	}
+	TEST_ASSERT_EQUAL(2, exclusive);
+	TEST_ASSERT_EQUAL(0x6873, TIM4->CCMR2);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_bit_band_single_store);
+	TEST_RUN(test_modify_one_pair);
+	TEST_RUN(test_modify_retried_after_interrupt);
+	TEST_RUN(test_plain_rmw_loses_interrupt);
+	TEST_RUN(test_store_without_load);
+	TEST_RUN(test_timer_flag_cleared_alone);
+	TEST_RUN(test_pwm_mode_exclusive);
+	return TEST_END();
+}
@@ -0,0 +1,146 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_boot.c
+ * Purpose: Boot stage host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	The flash accelerator is checked through the wait states the model
+ * charges to HOST_execute().
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "boot.h"
+
+#define CODE_ADDRESS		(FLASH_BASE + 0x400)
+#define CODE_SIZE				64																						///< 4 flash lines
+
+static uint32_t tim7_count;
+
+static void on_tim7(void)
+{
+	tim7_count++;
+}
+
+/* Flash as left by the hardware reset: no prefetch, no cache */
+static void flash_reset(void)
+{
+	FLASH->ACR = FLASH_ACR_LATENCY_5WS;
+}
+
+static uint64_t execute_stalls(uint32_t address)
+{
+	uint64_t before = HOST_getFetchStalls();
+
+	HOST_execute(address, CODE_SIZE, 100);
+	return HOST_getFetchStalls() - before;
+}
+
+static void raise_tim7(void)
+{
+	NVIC_EnableIRQ(TIM7_IRQn);
+	NVIC_SetPendingIRQ(TIM7_IRQn);
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_read_hclk(void)
+{
+	TEST_ASSERT_EQUAL(168000000, RCC_readHCLK());
+	TEST_ASSERT(RCC_setSysclk(RCC_HSE_HZ));
+	TEST_ASSERT_EQUAL(8000000, RCC_readHCLK());
+	TEST_ASSERT(RCC_setSysclk(100000000));
+	TEST_ASSERT_EQUAL(100000000, RCC_readHCLK());
+	RCC->CFGR = RCC->CFGR | (0x9 << 4);																	// HPRE /4
+	TEST_ASSERT_EQUAL(25000000, RCC_readHCLK());
+	RCC->CFGR = RCC->CFGR | (0xF << 4);																	// HPRE /512
+	TEST_ASSERT_EQUAL(195312, RCC_readHCLK());
+}
+
+static void test_fetch_model(void)
+{
+	flash_reset();
+	TEST_ASSERT_EQUAL(4 * 5, execute_stalls(CODE_ADDRESS));									// Each line waits
+	TEST_ASSERT_EQUAL(0, execute_stalls(SRAM1_BASE));
+
+	FLASH->ACR = FLASH->ACR | FLASH_ACR_PRFTEN;
+	TEST_ASSERT_EQUAL(5, execute_stalls(CODE_ADDRESS));										// Branch to the first line only
+	TEST_ASSERT_EQUAL(5, execute_stalls(CODE_ADDRESS));
+
+	FLASH->ACR = FLASH->ACR | FLASH_ACR_ICEN;
+	TEST_ASSERT_EQUAL(5, execute_stalls(CODE_ADDRESS));
+	TEST_ASSERT_EQUAL(0, execute_stalls(CODE_ADDRESS));										// Cached
+	TEST_ASSERT_EQUAL(0, execute_stalls(CODE_ADDRESS - FLASH_BASE));						// Same lines aliased at 0
+}
+
+static void test_init_flash(void)
+{
+	flash_reset();
+	FLASH->ACR = FLASH->ACR | FLASH_ACR_ICEN;
+	execute_stalls(CODE_ADDRESS);
+
+	BOOT_initFlash(RCC_readHCLK());
+	TEST_ASSERT_EQUAL(FLASH_ACR_LATENCY_5WS | FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN, FLASH->ACR);
+	TEST_ASSERT_EQUAL(5, execute_stalls(CODE_ADDRESS));										// Cache reset first
+	TEST_ASSERT_EQUAL(0, execute_stalls(CODE_ADDRESS));
+
+	TEST_ASSERT(RCC_setSysclk(RCC_HSI_HZ));
+	BOOT_initFlash(RCC_readHCLK());
+	TEST_ASSERT_EQUAL(0, FLASH->ACR & FLASH_ACR_LATENCY);
+	TEST_ASSERT_EQUAL(0, HOST_getClockFaults());
+}
+
+static void test_init_fpu(void)
+{
+	FPU->FPCCR = 0;
+	TEST_ASSERT_EQUAL(0, SCB->CPACR);
+	BOOT_initFPU();
+	TEST_ASSERT_EQUAL(BOOT_CPACR_FPU, SCB->CPACR);
+	TEST_ASSERT_EQUAL(FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk, FPU->FPCCR);
+}
+
+static void test_init(void)
+{
+	flash_reset();
+	BOOT_init();
+	TEST_ASSERT_EQUAL(BOOT_CPACR_FPU, SCB->CPACR);
+	TEST_ASSERT_EQUAL(FLASH_ACR_LATENCY_5WS | FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN, FLASH->ACR);
+	TEST_ASSERT_EQUAL(0, HOST_getClockFaults());
+}
+
+static void test_relocate_vectors(void)
+{
+	static BOOT_Handler vectors[BOOT_VECTOR_NUMBER] __attribute__((aligned(BOOT_VECTOR_ALIGN)));
+	uint32_t i;
+
+	raise_tim7();
+	TEST_ASSERT_EQUAL(1, HOST_getUnhandledCount());												// Default handler of the flash table
+
+	BOOT_relocateVectors(vectors);
+	TEST_ASSERT(SCB->VTOR == (uintptr_t) vectors);
+	for (i = 0; i < BOOT_VECTOR_NUMBER; i++)
+		TEST_ASSERT(vectors[i] == __Vectors[i]);
+
+	tim7_count = 0;
+	vectors[TIM7_IRQn + 16] = on_tim7;																	// Changed at run time
+	raise_tim7();
+	TEST_ASSERT_EQUAL(1, tim7_count);
+	TEST_ASSERT_EQUAL(1, HOST_getUnhandledCount());
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_read_hclk);
+	TEST_RUN(test_fetch_model);
+	TEST_RUN(test_init_flash);
+	TEST_RUN(test_init_fpu);
+	TEST_RUN(test_init);
+	TEST_RUN(test_relocate_vectors);
+	return TEST_END();
+}
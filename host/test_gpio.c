@@ -0,0 +1,221 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_gpio.c
+ * Purpose: GPIO driver host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "gpio.h"
+#include "led.h"
+#include "mems_LIS3DSH.h"
+
+#define MEMS_SPI_PINS		((0x1 << MEMS_PIN_SCK) | (0x1 << MEMS_PIN_MISO) | (0x1 << MEMS_PIN_MOSI))
+
+/* Pin by pin configuration of the SPI pins, as MEMS_init() did before GPIO_configPins */
+static void config_pin_by_pin(void)
+{
+	GPIO_initAlternate(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
+	GPIO_initAlternate(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
+	GPIO_initAlternate(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
+	GPIO_initOutputMediumspeed(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
+	GPIO_initOutputMediumspeed(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
+	GPIO_initOutputMediumspeed(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
+	GPIO_initOutputPushpull(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
+	GPIO_initOutputPushpull(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
+	GPIO_initOutputPushpull(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
+	GPIO_initNopull(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
+	GPIO_initNopull(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
+	GPIO_initNopull(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
+	MEMS_GPIO_MAIN->AFR[0] |= (MEMS_SPI_AF << MEMS_PIN_SCK*4);
+	MEMS_GPIO_MAIN->AFR[0] |= (MEMS_SPI_AF << MEMS_PIN_MISO*4);
+	MEMS_GPIO_MAIN->AFR[0] |= (MEMS_SPI_AF << MEMS_PIN_MOSI*4);
+}
+
+typedef struct
+{
+	uint32_t MODER, OTYPER, OSPEEDR, PUPDR, AFR0, AFR1;
+} Snapshot;
+
+static void snapshot(GPIO_TypeDef * GPIO, Snapshot * s)
+{
+	s->MODER = GPIO->MODER;
+	s->OTYPER = GPIO->OTYPER;
+	s->OSPEEDR = GPIO->OSPEEDR;
+	s->PUPDR = GPIO->PUPDR;
+	s->AFR0 = GPIO->AFR[0];
+	s->AFR1 = GPIO->AFR[1];
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_same_result_fewer_accesses(void)
+{
+	static const GPIO_PinConfig spi = { GPIO_MODE_ALTERNATE, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_MEDIUM, GPIO_PULL_NONE, MEMS_SPI_AF };
+	Snapshot before, after;
+	uint32_t reads, writes, batch_reads, batch_writes;
+
+	config_pin_by_pin();
+	HOST_getAccessCount(MEMS_GPIO_MAIN, &reads, &writes);
+	snapshot(MEMS_GPIO_MAIN, &before);
+
+	HOST_reset();
+	GPIO_configPins(MEMS_GPIO_MAIN, MEMS_SPI_PINS, &spi);
+	HOST_getAccessCount(MEMS_GPIO_MAIN, &batch_reads, &batch_writes);
+	snapshot(MEMS_GPIO_MAIN, &after);
+
+	printf("  pin by pin %u reads %u writes, GPIO_configPins %u reads %u writes\n", reads, writes, batch_reads, batch_writes);
+	TEST_ASSERT_EQUAL(before.MODER, after.MODER);
+	TEST_ASSERT_EQUAL(before.OTYPER, after.OTYPER);
+	TEST_ASSERT_EQUAL(before.OSPEEDR, after.OSPEEDR);
+	TEST_ASSERT_EQUAL(before.PUPDR, after.PUPDR);
+	TEST_ASSERT_EQUAL(before.AFR0, after.AFR0);
+	TEST_ASSERT_EQUAL(before.AFR1, after.AFR1);
+	TEST_ASSERT_EQUAL(15, writes);																// One store per field and pin
+	TEST_ASSERT_EQUAL(5, batch_writes);
+	TEST_ASSERT_EQUAL(5, batch_reads);
+}
+
+static void test_moder_written_last(void)
+{
+	static const GPIO_PinConfig out = { GPIO_MODE_OUTPUT, GPIO_OTYPE_OPENDRAIN, GPIO_SPEED_HIGH, GPIO_PULL_UP, 0 };
+	HOST_Access log[16];
+	uint32_t count;
+
+	HOST_startLog(log, 16);
+	GPIO_configPins(GPIOD, 0xF000, &out);
+	count = HOST_getLogCount();
+	HOST_startLog(NULL, 0);
+
+	TEST_ASSERT_EQUAL(8, count);																// 4 read-modify-writes, no AFR
+	TEST_ASSERT(log[count - 1].write);
+	TEST_ASSERT(log[count - 1].reg == &GPIOD->MODER);
+	TEST_ASSERT_EQUAL(0x55000000, GPIOD->MODER);
+	TEST_ASSERT_EQUAL(0xF000, GPIOD->OTYPER);
+	TEST_ASSERT_EQUAL(0xFF000000, GPIOD->OSPEEDR);
+	TEST_ASSERT_EQUAL(0x55000000, GPIOD->PUPDR);
+}
+
+static void test_other_pins_kept(void)
+{
+	static const GPIO_PinConfig af = { GPIO_MODE_ALTERNATE, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_LOW, GPIO_PULL_DOWN, 0xA };
+	static const GPIO_PinConfig in = { GPIO_MODE_INPUT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_LOW, GPIO_PULL_NONE, 0 };
+
+	GPIOB->MODER = 0xFFFFFFFF;
+	GPIOB->OTYPER = 0xFFFF;
+	GPIOB->AFR[0] = 0x11111111;
+	GPIOB->AFR[1] = 0x11111111;
+	GPIO_configPins(GPIOB, (0x1 << 1) | (0x1 << 9), &af);
+	TEST_ASSERT_EQUAL(0xFFFBFFFB, GPIOB->MODER);
+	TEST_ASSERT_EQUAL(0xFDFD, GPIOB->OTYPER);
+	TEST_ASSERT_EQUAL(0x111111A1, GPIOB->AFR[0]);
+	TEST_ASSERT_EQUAL(0x111111A1, GPIOB->AFR[1]);
+
+	GPIO_configPins(GPIOB, (0x1 << 1), &in);
+	TEST_ASSERT_EQUAL(0xFFFBFFF3, GPIOB->MODER);
+	TEST_ASSERT_EQUAL(0x111111A1, GPIOB->AFR[0]);						// Untouched out of alternate mode
+
+	GPIO_configPins(GPIOB, 0, &af);
+	TEST_ASSERT_EQUAL(0xFFFBFFF3, GPIOB->MODER);
+}
+
+static void test_leds(void)
+{
+	uint32_t writes;
+
+	LED_initAllLeds();
+	HOST_getAccessCount(GPIO_LED, NULL, &writes);
+	TEST_ASSERT_EQUAL(4, writes);
+	TEST_ASSERT_EQUAL(0x55000000, GPIO_LED->MODER);
+	TEST_ASSERT_EQUAL(0xAA000000, GPIO_LED->OSPEEDR);
+}
+
+static void test_fast_path_single_store(void)
+{
+	HOST_Access log[4];
+
+	HOST_startLog(log, 4);
+	GPIO_SET_PIN(GPIOD, 12);
+	GPIO_RESET_PIN(GPIOD, 13);
+	TEST_ASSERT_EQUAL(2, HOST_getLogCount());
+	TEST_ASSERT(log[0].write && log[0].size == 4 && log[0].reg == &GPIOD->BSRRL);
+	TEST_ASSERT_EQUAL(GPIO_PIN(12), log[0].value);
+	TEST_ASSERT(log[1].write && log[1].size == 4 && log[1].reg == &GPIOD->BSRRL);
+	TEST_ASSERT_EQUAL((uint32_t) GPIO_PIN(13) << 16, log[1].value);
+	TEST_ASSERT_EQUAL(0x1000, GPIOD->ODR);
+	HOST_startLog(NULL, 0);
+}
+
+static void test_fast_toggle(void)
+{
+	HOST_Access log[4];
+
+	GPIOD->ODR = 0x1000;
+	HOST_startLog(log, 4);
+	GPIO_togglePins(GPIOD, GPIO_PIN(12) | GPIO_PIN(13));
+	TEST_ASSERT_EQUAL(2, HOST_getLogCount());										// ODR read, BSRR write
+	TEST_ASSERT(!log[0].write && log[0].reg == &GPIOD->ODR);
+	TEST_ASSERT(log[1].write && log[1].reg == &GPIOD->BSRRL);
+	TEST_ASSERT_EQUAL(0x10002000, log[1].value);
+	TEST_ASSERT_EQUAL(0x2000, GPIOD->ODR);
+	HOST_startLog(NULL, 0);
+}
+
+static void test_out_of_line_single_store(void)
+{
+	uint32_t reads, writes;
+
+	GPIO_setPin(GPIOD, 14);
+	GPIO_resetPin(GPIOD, 14);
+	GPIO_writePin(GPIOD, 15, GPIO_PIN_HIGH);
+	GPIO_togglePin(GPIOD, 15);
+	HOST_getAccessCount(GPIOD, &reads, &writes);
+	TEST_ASSERT_EQUAL(1, reads);
+	TEST_ASSERT_EQUAL(4, writes);
+	TEST_ASSERT_EQUAL(0, GPIOD->ODR);
+
+	GPIO_setPin(GPIOD, GPIO_MAX_PIN);
+	TEST_ASSERT_EQUAL(0, GPIOD->ODR);
+}
+
+static void test_leds_single_store(void)
+{
+	uint32_t reads, writes;
+
+	LED_switchON(LED_BLUE);
+	LED_toggle(LED_GREEN);
+	LED_switchOFF(LED_BLUE);
+	HOST_getAccessCount(GPIO_LED, &reads, &writes);
+	TEST_ASSERT_EQUAL(1, reads);
+	TEST_ASSERT_EQUAL(3, writes);
+	TEST_ASSERT_EQUAL(GPIO_PIN(PIN_LED_GREEN), GPIO_LED->ODR);
+}
+
+#ifdef TEST_GPIO_BAD_PIN
+/* Built by 'make test' which expects the compilation to fail */
+static void bad_pin(void)
+{
+	GPIO_SET_PIN(GPIOD, GPIO_MAX_PIN);
+}
+#endif
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_same_result_fewer_accesses);
+	TEST_RUN(test_moder_written_last);
+	TEST_RUN(test_other_pins_kept);
+	TEST_RUN(test_leds);
+	TEST_RUN(test_fast_path_single_store);
+	TEST_RUN(test_fast_toggle);
+	TEST_RUN(test_out_of_line_single_store);
+	TEST_RUN(test_leds_single_store);
+	return TEST_END();
+}
@@ -0,0 +1,292 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_interrupt.c
+ * Purpose: EXTI driver and dispatch table host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "interrupt.h"
+#include "rcc.h"
+
+/* Lines in the order of the callbacks */
+static u8 calls[EXTI_MAX_LINE];
+static u8 call_count;
+
+static void on_line(u8 line, void * context)
+{
+	calls[call_count++] = line;
+	(*(uint32_t *) context)++;
+}
+
+static void setup(void)
+{
+	call_count = 0;
+	SYSCFG_CLK_ENABLE();
+}
+
+/* Lines pended together by software, dispatched when the interrupts are unmasked */
+static void trigger(uint32_t lines)
+{
+	__disable_irq();
+	EXTI->SWIER = lines;
+	__enable_irq();
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_line_pin(void)
+{
+	u8 line;
+
+	setup();
+	for (line = 0; line < EXTI_MAX_LINE; line++)
+		EXTI_setLinePin(line, SYSCFG_EXTICR_EXTI_PI);
+	for (line = 0; line < 4; line++)
+		TEST_ASSERT_EQUAL(0x8888, SYSCFG->EXTICR[line]);
+
+	EXTI_setLinePin(6, SYSCFG_EXTICR_EXTI_PC);
+	EXTI_setLinePin(13, SYSCFG_EXTICR_EXTI_PA);
+	TEST_ASSERT_EQUAL(0x8288, SYSCFG->EXTICR[1]);
+	TEST_ASSERT_EQUAL(0x8808, SYSCFG->EXTICR[3]);
+
+	EXTI_setLinePin(16, SYSCFG_EXTICR_EXTI_PB);											// Ignored
+	EXTI_setLinePin(250, SYSCFG_EXTICR_EXTI_PB);
+	EXTI_setLinePin(2, SYSCFG_EXTICR_EXTI_PI + 1);
+	TEST_ASSERT_EQUAL(0x8888, SYSCFG->EXTICR[0]);
+	TEST_ASSERT_EQUAL(0x8808, SYSCFG->EXTICR[3]);
+}
+
+static void test_attach(void)
+{
+	uint32_t count = 0;
+
+	setup();
+	TEST_ASSERT(EXTI_attach(0, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, &count));
+	TEST_ASSERT_EQUAL(0x0001, EXTI->IMR);
+	TEST_ASSERT_EQUAL(0x0001, EXTI->RTSR);
+	TEST_ASSERT_EQUAL(0x0000, EXTI->FTSR);
+	TEST_ASSERT_EQUAL(0x0000, SYSCFG->EXTICR[0]);
+
+	HOST_GPIO_setInput(GPIOA, 0, true);
+	HOST_GPIO_setInput(GPIOA, 0, false);
+	HOST_GPIO_setInput(GPIOB, 0, true);															// Other port
+	TEST_ASSERT_EQUAL(1, count);
+	TEST_ASSERT_EQUAL(0, calls[0]);
+	TEST_ASSERT_EQUAL(0, EXTI->PR);
+
+	// Attached again: edges and port replaced
+	TEST_ASSERT(EXTI_attach(0, EXTI_EDGE_FALLING, SYSCFG_EXTICR_EXTI_PB, on_line, &count));
+	TEST_ASSERT_EQUAL(0x0000, EXTI->RTSR);
+	TEST_ASSERT_EQUAL(0x0001, EXTI->FTSR);
+	HOST_GPIO_setInput(GPIOB, 0, false);
+	HOST_GPIO_setInput(GPIOA, 0, true);
+	HOST_GPIO_setInput(GPIOA, 0, false);
+	TEST_ASSERT_EQUAL(2, count);
+
+	EXTI_detach(0);
+	TEST_ASSERT_EQUAL(0, EXTI->IMR);
+	TEST_ASSERT_EQUAL(0, EXTI->FTSR);
+	HOST_GPIO_setInput(GPIOB, 0, true);
+	HOST_GPIO_setInput(GPIOB, 0, false);
+	TEST_ASSERT_EQUAL(2, count);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_attach_out_of_range(void)
+{
+	uint32_t count = 0;
+
+	setup();
+	TEST_ASSERT(!EXTI_attach(16, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, &count));
+	TEST_ASSERT(!EXTI_attach(3, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PI + 1, on_line, &count));
+	TEST_ASSERT(!EXTI_attach(3, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, NULL, &count));
+	TEST_ASSERT(!EXTI_attach(3, (EXTI_Edge) 0, SYSCFG_EXTICR_EXTI_PA, on_line, &count));
+	TEST_ASSERT(!EXTI_attach(3, (EXTI_Edge) 4, SYSCFG_EXTICR_EXTI_PA, on_line, &count));
+	TEST_ASSERT_EQUAL(0, EXTI->IMR);
+	EXTI_detach(16);																								// Ignored
+}
+
+static void test_shared_dispatch(void)
+{
+	uint32_t count = 0;
+
+	setup();
+	TEST_ASSERT(EXTI_attach(5, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, &count));
+	TEST_ASSERT(EXTI_attach(7, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PB, on_line, &count));
+	TEST_ASSERT(EXTI_attach(9, EXTI_EDGE_BOTH, SYSCFG_EXTICR_EXTI_PE, on_line, &count));
+
+	// Both lines in one EXTI9_5 entry, highest first
+	trigger((0x1 << 5) | (0x1 << 9));
+	TEST_ASSERT_EQUAL(2, count);
+	TEST_ASSERT_EQUAL(9, calls[0]);
+	TEST_ASSERT_EQUAL(5, calls[1]);
+	TEST_ASSERT_EQUAL(0, EXTI->PR);
+
+	HOST_GPIO_setInput(GPIOB, 7, true);
+	HOST_GPIO_setInput(GPIOE, 9, true);
+	HOST_GPIO_setInput(GPIOE, 9, false);
+	TEST_ASSERT_EQUAL(5, count);
+	TEST_ASSERT_EQUAL(7, calls[2]);
+	TEST_ASSERT_EQUAL(9, calls[3]);
+	TEST_ASSERT_EQUAL(9, calls[4]);
+
+	// EXTI9_5 stays enabled until its last line is detached
+	EXTI_detach(5);
+	EXTI_detach(9);
+	trigger(0x1 << 7);
+	TEST_ASSERT_EQUAL(6, count);
+	EXTI_detach(7);
+	NVIC_SetPendingIRQ(EXTI9_5_IRQn);
+	TEST_ASSERT(NVIC_GetPendingIRQ(EXTI9_5_IRQn));
+	NVIC_ClearPendingIRQ(EXTI9_5_IRQn);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_dispatch_cost(void)
+{
+	uint32_t count = 0;
+	uint32_t reads, writes, reads_after, writes_after;
+	u8 line;
+
+	setup();
+	for (line = 10; line < EXTI_MAX_LINE; line++)
+		TEST_ASSERT(EXTI_attach(line, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PC, on_line, &count));
+
+	// One PR read and one PR write, whatever the pending lines
+	HOST_getAccessCount(EXTI, &reads, &writes);
+	trigger(0x1 << 14);
+	HOST_getAccessCount(EXTI, &reads_after, &writes_after);
+	TEST_ASSERT_EQUAL(1, count);
+	TEST_ASSERT_EQUAL(1, reads_after - reads);
+	TEST_ASSERT_EQUAL(1 + 1, writes_after - writes);								// SWIER and PR
+
+	HOST_getAccessCount(EXTI, &reads, &writes);
+	trigger(0xFC00);
+	HOST_getAccessCount(EXTI, &reads_after, &writes_after);
+	TEST_ASSERT_EQUAL(7, count);
+	TEST_ASSERT_EQUAL(1, reads_after - reads);
+	TEST_ASSERT_EQUAL(1 + 1, writes_after - writes);
+	TEST_ASSERT_EQUAL(15, calls[1]);
+	TEST_ASSERT_EQUAL(10, calls[6]);
+
+	for (line = 10; line < EXTI_MAX_LINE; line++)
+		EXTI_detach(line);
+}
+
+/* Lines 2 and 3 raised from the handler of line 1 */
+static void on_outer(u8 line, void * context)
+{
+	calls[call_count++] = line;
+	EXTI->SWIER = (0x1 << 2) | (0x1 << 3);
+	calls[call_count++] = line;
+}
+
+static void attach_levels(uint32_t * count)
+{
+	TEST_ASSERT(IRQ_setPriority(EXTI1_IRQn, IRQ_LEVEL_TIMER, 1));
+	TEST_ASSERT(IRQ_setPriority(EXTI2_IRQn, IRQ_LEVEL_TIMER, 0));
+	TEST_ASSERT(IRQ_setPriority(EXTI3_IRQn, IRQ_LEVEL_DRIVER, 0));
+	TEST_ASSERT(EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_outer, NULL));
+	TEST_ASSERT(EXTI_attach(2, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, count));
+	TEST_ASSERT(EXTI_attach(3, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, count));
+}
+
+static void test_priorities(void)
+{
+	uint32_t count = 0;
+	u8 line;
+
+	setup();
+	TEST_ASSERT(!IRQ_setPriority(TIM3_IRQn, IRQ_LEVELS, 0));
+	TEST_ASSERT(!IRQ_setPriority(TIM3_IRQn, 0, IRQ_SUB_LEVELS));
+	TEST_ASSERT(IRQ_setPriority(TIM3_IRQn, IRQ_LEVEL_TIMER, 1));
+	TEST_ASSERT_EQUAL((IRQ_LEVEL_TIMER << 2) | 1, NVIC_GetPriority(TIM3_IRQn));
+	TEST_ASSERT_EQUAL(IRQ_LEVEL_TIMER, IRQ_getLevel(TIM3_IRQn));
+	TEST_ASSERT(IRQ_setPriority(PendSV_IRQn, IRQ_LEVEL_DEFERRED, IRQ_SUB_LEVELS - 1));
+	TEST_ASSERT_EQUAL(0xF0, SCB->SHP[10]);
+	for (line = 0; line < EXTI_MAX_LINE; line++)
+		TEST_ASSERT(EXTI_getIRQn(line) == (line < 5 ? EXTI0_IRQn + line : line < 10 ? EXTI9_5_IRQn : EXTI15_10_IRQn));
+
+	// Without grouping, all the bits preempt: line 2 preempts line 1
+	attach_levels(&count);
+	HOST_GPIO_setInput(GPIOA, 1, true);
+	TEST_ASSERT_EQUAL(4, call_count);
+	TEST_ASSERT(calls[0] == 1 && calls[1] == 3 && calls[2] == 2 && calls[3] == 1);
+
+	// Grouped: the sub-priority only orders the pending lines of a level
+	call_count = 0;
+	IRQ_initGrouping();
+	TEST_ASSERT_EQUAL(IRQ_PRIORITY_GROUP, NVIC_GetPriorityGrouping());
+	TEST_ASSERT_EQUAL(IRQ_LEVEL_TIMER, IRQ_getLevel(TIM3_IRQn));
+	HOST_GPIO_setInput(GPIOA, 1, false);
+	HOST_GPIO_setInput(GPIOA, 1, true);
+	TEST_ASSERT_EQUAL(4, call_count);
+	TEST_ASSERT(calls[0] == 1 && calls[1] == 3 && calls[2] == 1 && calls[3] == 2);
+
+	for (line = 1; line <= 3; line++)
+		EXTI_detach(line);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_lock(void)
+{
+	uint32_t count = 0;
+	u32 key, inner, strongest;
+
+	setup();
+	IRQ_initGrouping();
+	attach_levels(&count);
+
+	key = IRQ_lock(IRQ_LEVEL_TIMER);
+	TEST_ASSERT_EQUAL(0, key);
+	TEST_ASSERT_EQUAL(IRQ_LEVEL_TIMER << (8 - IRQ_PREEMPT_BITS), __get_BASEPRI());
+	EXTI->SWIER = (0x1 << 2) | (0x1 << 3);
+	TEST_ASSERT_EQUAL(1, count);																		// Level 1 not masked
+	TEST_ASSERT_EQUAL(3, calls[0]);
+
+	// Nested: a weaker lock changes nothing, a stronger one is undone
+	inner = IRQ_lock(IRQ_LEVEL_DEFERRED);
+	TEST_ASSERT_EQUAL(__get_BASEPRI(), inner);
+	strongest = IRQ_lock(IRQ_LEVEL_DRIVER);
+	TEST_ASSERT_EQUAL(IRQ_LEVEL_DRIVER << (8 - IRQ_PREEMPT_BITS), __get_BASEPRI());
+	EXTI->SWIER = 0x1 << 3;
+	TEST_ASSERT_EQUAL(1, count);
+	IRQ_unlock(strongest);
+	TEST_ASSERT_EQUAL(2, count);
+	IRQ_unlock(inner);
+	TEST_ASSERT_EQUAL(2, count);
+	IRQ_unlock(key);
+	TEST_ASSERT_EQUAL(3, count);
+	TEST_ASSERT_EQUAL(2, calls[2]);
+
+	// Level 0 can't be masked with BASEPRI
+	TEST_ASSERT_EQUAL(0, IRQ_lock(IRQ_LEVEL_URGENT));
+	TEST_ASSERT_EQUAL(0, __get_BASEPRI());
+	TEST_ASSERT_EQUAL(0, IRQ_lock(IRQ_LEVELS));
+	TEST_ASSERT_EQUAL(0, __get_BASEPRI());
+
+	EXTI_detach(1);
+	EXTI_detach(2);
+	EXTI_detach(3);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_line_pin);
+	TEST_RUN(test_attach);
+	TEST_RUN(test_attach_out_of_range);
+	TEST_RUN(test_shared_dispatch);
+	TEST_RUN(test_dispatch_cost);
+	TEST_RUN(test_priorities);
+	TEST_RUN(test_lock);
+	return TEST_END();
+}
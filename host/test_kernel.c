@@ -0,0 +1,312 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_kernel.c
+ * Purpose: Preemptive kernel service host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	The threads run on the host port (host_kernel.h): each test runs them
+ * for a number of virtual cycles, then checks the order they ran in.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "host_kernel.h"
+#include "kernel.h"
+#include "kernel_port.h"
+#include "interrupt.h"
+#include "rcc.h"
+
+#define TICK_CYCLES			(168000000 / KERNEL_TICK_HZ)
+
+static uint32_t stacks[4][KERNEL_STACK_MIN];
+static KERNEL_Thread threads[4];
+
+/* Threads in the order they ran */
+static char trace[32];
+static uint8_t trace_count;
+
+static void mark(char name)
+{
+	if (trace_count < sizeof(trace) - 1)
+		trace[trace_count++] = name;
+	trace[trace_count] = '\0';
+}
+
+static void start(void)
+{
+	trace_count = 0;
+	trace[0] = '\0';
+	IRQ_initGrouping();
+	KERNEL_init();
+}
+
+static bool create(uint8_t i, KERNEL_Entry entry, void * arg, uint8_t priority)
+{
+	return KERNEL_createThread(&threads[i], "test", entry, arg, priority, stacks[i], KERNEL_STACK_MIN);
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void idle(void * arg)
+{
+	(void) arg;
+}
+
+static void test_create(void)
+{
+	start();
+	TEST_ASSERT(!create(0, NULL, NULL, 0));
+	TEST_ASSERT(!create(0, idle, NULL, KERNEL_PRIORITIES));
+	TEST_ASSERT(!KERNEL_createThread(&threads[0], "test", idle, NULL, 0, stacks[0], KERNEL_STACK_MIN - 1));
+	TEST_ASSERT(create(0, idle, NULL, KERNEL_PRIORITIES - 1));
+	TEST_ASSERT(KERNEL_getCurrent() == NULL);
+
+	// The thread returns, the idle thread runs
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT_EQUAL(KERNEL_EXITED, threads[0].state);
+	TEST_ASSERT(KERNEL_getCurrent() != &threads[0]);
+	TEST_ASSERT_EQUAL(2, KERNEL_getSwitchCount());
+}
+
+/* Frame of the core at the top of the stack, pc without the Thumb bit */
+static void test_initial_frame(void)
+{
+	uint32_t * frame = stacks[0] + KERNEL_STACK_MIN - KPORT_FRAME_WORDS;
+	int arg;
+
+	start();
+	TEST_ASSERT(create(0, idle, &arg, 0));
+	TEST_ASSERT_EQUAL(0, frame[6] & 0x1);																// pc halfword-aligned
+	TEST_ASSERT_EQUAL(KPORT_XPSR, frame[7]);
+	TEST_ASSERT_EQUAL((uint32_t) (uintptr_t) &arg, frame[0]);
+
+	// Function address of ARMCC, Thumb bit set
+	frame = KPORT_initFrame(stacks[1], KERNEL_STACK_MIN, (KERNEL_Entry) (uintptr_t) 0x08000235, NULL);
+	TEST_ASSERT_EQUAL(0x08000234, frame[6]);
+	TEST_ASSERT_EQUAL((uint32_t) (uintptr_t) KERNEL_exit, frame[5]);
+	TEST_ASSERT_EQUAL(0, (uintptr_t) frame % 8);
+}
+
+static KERNEL_Sem sem;
+
+static void waiter(void * arg)
+{
+	mark('w');
+	KERNEL_semTake(&sem, KERNEL_WAIT_FOREVER);
+	mark(*(const char *) arg);
+}
+
+static void giver(void * arg)
+{
+	(void) arg;
+	mark('g');
+	KERNEL_semGive(&sem);
+	mark('G');
+}
+
+static void test_preemption(void)
+{
+	static const char high = 'H';
+
+	start();
+	KERNEL_semInit(&sem, 0);
+	create(0, giver, NULL, 3);
+	create(1, waiter, (void *) &high, 1);
+
+	// The most urgent first, it preempts the giver at once
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT(strcmp(trace, "wgHG") == 0);
+	TEST_ASSERT_EQUAL(0, sem.count);
+}
+
+static void test_waiters_order(void)
+{
+	static const char names[] = "abc";
+
+	start();
+	KERNEL_semInit(&sem, 0);
+	create(0, waiter, (void *) &names[0], 2);
+	create(1, waiter, (void *) &names[1], 1);
+	create(2, waiter, (void *) &names[2], 2);
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT(strcmp(trace, "www") == 0);
+
+	// Given from the test: the most urgent waiter, then in order of arrival
+	KERNEL_semGive(&sem);
+	KERNEL_semGive(&sem);
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT(strcmp(trace, "wwwba") == 0);
+	KERNEL_semGive(&sem);
+	KERNEL_semGive(&sem);
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT(strcmp(trace, "wwwbac") == 0);
+	TEST_ASSERT_EQUAL(1, sem.count);
+}
+
+static void yielder(void * arg)
+{
+	uint8_t i;
+
+	for (i = 0; i < 3; i++)
+	{
+		mark(*(const char *) arg);
+		KERNEL_yield();
+	}
+}
+
+static void test_yield(void)
+{
+	static const char names[] = "abc";
+
+	start();
+	create(0, yielder, (void *) &names[0], 2);
+	create(1, yielder, (void *) &names[1], 2);
+	create(2, yielder, (void *) &names[2], 2);
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT(strcmp(trace, "abcabcabc") == 0);
+}
+
+static void sleeper(void * arg)
+{
+	KERNEL_sleep((uint32_t) (uintptr_t) arg);
+	mark((char) ('0' + KERNEL_getTicks()));
+}
+
+static void test_sleep(void)
+{
+	start();
+	create(0, sleeper, (void *) 3, 1);
+	create(1, sleeper, (void *) 1, 2);
+	create(2, sleeper, (void *) 2, 3);
+
+	// Woken in the order of their delays, whatever their priorities
+	HOST_KERNEL_run(5 * TICK_CYCLES + 1000);
+	TEST_ASSERT(strcmp(trace, "123") == 0);
+	TEST_ASSERT_EQUAL(5, KERNEL_getTicks());
+}
+
+static bool taken;
+static uint64_t woken;
+
+static void taker(void * arg)
+{
+	taken = KERNEL_semTake(&sem, (uint32_t) (uintptr_t) arg);
+	woken = HOST_getCycles();
+}
+
+static void test_timeout(void)
+{
+	start();
+	KERNEL_semInit(&sem, 0);
+	TEST_ASSERT(!KERNEL_semTake(&sem, KERNEL_NO_WAIT));
+	create(0, taker, (void *) 3, 0);
+
+	// No token: false after 3 ticks
+	taken = true;
+	HOST_KERNEL_run(10 * TICK_CYCLES);
+	TEST_ASSERT(!taken);
+	TEST_ASSERT(woken >= 3 * TICK_CYCLES && woken < 4 * TICK_CYCLES);
+	TEST_ASSERT(sem.waiters == NULL);
+
+	// Token given before the timeout
+	create(1, taker, (void *) 3, 0);
+	HOST_KERNEL_run(TICK_CYCLES);
+	KERNEL_semGive(&sem);
+	HOST_KERNEL_run(10 * TICK_CYCLES);
+	TEST_ASSERT(taken);
+	TEST_ASSERT_EQUAL(0, sem.count);
+}
+
+static KERNEL_Queue queue;
+static uint32_t sent, dropped;
+
+static void on_edge(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	if (KERNEL_send(&queue, &sent, KERNEL_NO_WAIT))
+		sent++;
+	else
+		dropped++;
+}
+
+static void raise_edge(void * context)
+{
+	(void) context;
+	HOST_GPIO_setInput(GPIOA, 3, true);
+	HOST_GPIO_setInput(GPIOA, 3, false);
+}
+
+static void receiver(void * arg)
+{
+	uint32_t item;
+
+	(void) arg;
+	for (;;)
+	{
+		KERNEL_receive(&queue, &item, KERNEL_WAIT_FOREVER);
+		mark((char) ('0' + item));
+	}
+}
+
+static void busy(void * arg)
+{
+	(void) arg;
+	for (;;)
+		HOST_busy(1000);
+}
+
+static void test_queue_from_isr(void)
+{
+	uint32_t buffer[2];
+	uint32_t item;
+
+	start();
+	TEST_ASSERT(!KERNEL_initQueue(&queue, buffer, sizeof(uint32_t), 0));
+	TEST_ASSERT(KERNEL_initQueue(&queue, buffer, sizeof(uint32_t), 2));
+	sent = 0;
+	dropped = 0;
+	SYSCFG_CLK_ENABLE();
+	TEST_ASSERT(EXTI_attach(3, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_edge, NULL));
+	IRQ_setPriority(EXTI_getIRQn(3), IRQ_LEVEL_DRIVER, 0);
+
+	// Nothing receives: the third edge finds the queue full
+	create(0, busy, NULL, 3);
+	HOST_schedule(1000, raise_edge, NULL);
+	HOST_schedule(2000, raise_edge, NULL);
+	HOST_schedule(3000, raise_edge, NULL);
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT_EQUAL(2, sent);
+	TEST_ASSERT_EQUAL(1, dropped);
+	TEST_ASSERT(KERNEL_receive(&queue, &item, KERNEL_NO_WAIT));
+	TEST_ASSERT_EQUAL(0, item);
+
+	// The receiver preempts the busy thread at each edge
+	create(1, receiver, NULL, 0);
+	HOST_schedule(1000, raise_edge, NULL);
+	HOST_schedule(2000, raise_edge, NULL);
+	HOST_KERNEL_run(10000);
+	TEST_ASSERT(strcmp(trace, "123") == 0);
+	TEST_ASSERT_EQUAL(4, sent);
+	TEST_ASSERT_EQUAL(1, dropped);
+	EXTI_detach(3);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_create);
+	TEST_RUN(test_initial_frame);
+	TEST_RUN(test_preemption);
+	TEST_RUN(test_waiters_order);
+	TEST_RUN(test_yield);
+	TEST_RUN(test_sleep);
+	TEST_RUN(test_timeout);
+	TEST_RUN(test_queue_from_isr);
+	return TEST_END();
+}
@@ -0,0 +1,118 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_latency.c
+ * Purpose: Interrupt latency measurement service host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "latency.h"
+#include "rcc.h"
+
+/* Entry from thread mode: SWIER write, NVIC entry, PR read and write, CYCCNT read */
+#define LAT_IDLE		(HOST_ACCESS_CYCLES + HOST_EXC_ENTRY_CYCLES + 3 * HOST_ACCESS_CYCLES)
+
+static void setup(void)
+{
+	SYSCFG_CLK_ENABLE();
+	IRQ_initGrouping();
+	LAT_init();
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_attach(void)
+{
+	setup();
+	TEST_ASSERT(!LAT_attach(IRQ_LEVELS));
+	TEST_ASSERT(LAT_getStats(IRQ_LEVELS) == NULL);
+	TEST_ASSERT(!LAT_trigger(IRQ_LEVEL_TIMER));												// Not attached
+
+	TEST_ASSERT(LAT_attach(IRQ_LEVEL_TIMER));
+	TEST_ASSERT_EQUAL(IRQ_LEVEL_TIMER, IRQ_getLevel(EXTI_getIRQn(LAT_LINE_BASE + IRQ_LEVEL_TIMER)));
+	TEST_ASSERT_EQUAL(0, EXTI->RTSR);
+
+	// The pin of the line doesn't trigger it
+	HOST_GPIO_setInput(GPIOA, LAT_LINE_BASE + IRQ_LEVEL_TIMER, true);
+	TEST_ASSERT_EQUAL(0, LAT_getStats(IRQ_LEVEL_TIMER)->count);
+	TEST_ASSERT_EQUAL(0, LAT_getMean(LAT_getStats(IRQ_LEVEL_TIMER)));
+	TEST_ASSERT_EQUAL(0, LAT_getJitter(LAT_getStats(IRQ_LEVEL_TIMER)));
+
+	LAT_detach(IRQ_LEVEL_TIMER);
+	TEST_ASSERT(!LAT_trigger(IRQ_LEVEL_TIMER));
+	TEST_ASSERT_EQUAL(0, EXTI->IMR);
+}
+
+static void test_idle(void)
+{
+	const LAT_Stats * stats;
+	int i;
+
+	setup();
+	TEST_ASSERT(LAT_attach(IRQ_LEVEL_DEFERRED));
+	for (i = 0; i < 10; i++)
+	{
+		TEST_ASSERT(LAT_trigger(IRQ_LEVEL_DEFERRED));
+		HOST_advance(100);
+	}
+
+	stats = LAT_getStats(IRQ_LEVEL_DEFERRED);
+	TEST_ASSERT_EQUAL(10, stats->count);
+	TEST_ASSERT_EQUAL(LAT_IDLE, stats->min);
+	TEST_ASSERT_EQUAL(0, LAT_getJitter(stats));
+	TEST_ASSERT_EQUAL(LAT_IDLE, LAT_getMean(stats));
+
+	LAT_reset();
+	TEST_ASSERT_EQUAL(0, stats->count);
+	LAT_detach(IRQ_LEVEL_DEFERRED);
+}
+
+static void test_locked(void)
+{
+	const LAT_Stats * stats;
+	u32 key;
+
+	setup();
+	TEST_ASSERT(LAT_attach(IRQ_LEVEL_DRIVER));
+	TEST_ASSERT(LAT_attach(IRQ_LEVEL_TIMER));
+
+	// Masked for 1000 cycles: the latency counts them, a trigger meanwhile is refused
+	key = IRQ_lock(IRQ_LEVEL_TIMER);
+	TEST_ASSERT(LAT_trigger(IRQ_LEVEL_TIMER));
+	TEST_ASSERT(LAT_trigger(IRQ_LEVEL_DRIVER));
+	HOST_busy(1000);
+	TEST_ASSERT(!LAT_trigger(IRQ_LEVEL_TIMER));
+	IRQ_unlock(key);
+
+	stats = LAT_getStats(IRQ_LEVEL_DRIVER);
+	TEST_ASSERT_EQUAL(1, stats->count);
+	TEST_ASSERT_EQUAL(LAT_IDLE, stats->max);
+	stats = LAT_getStats(IRQ_LEVEL_TIMER);
+	TEST_ASSERT_EQUAL(1, stats->count);
+	TEST_ASSERT(stats->min > 1000);
+
+	TEST_ASSERT(LAT_trigger(IRQ_LEVEL_TIMER));
+	TEST_ASSERT_EQUAL(2, stats->count);
+	TEST_ASSERT_EQUAL(LAT_IDLE, stats->min);
+	TEST_ASSERT(LAT_getJitter(stats) > 1000);
+
+	LAT_detach(IRQ_LEVEL_DRIVER);
+	LAT_detach(IRQ_LEVEL_TIMER);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_attach);
+	TEST_RUN(test_idle);
+	TEST_RUN(test_locked);
+	return TEST_END();
+}
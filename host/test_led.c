@@ -0,0 +1,114 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_led.c
+ * Purpose: LED service PWM mode host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "led.h"
+
+static void setup(void)
+{
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV4;																// TIM4 clock 84 MHz
+	LED_PWM_CLK_ENABLE();
+	TEST_ASSERT(LED_initPWM(100));
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_init(void)
+{
+	setup();
+	TEST_ASSERT(RCC->APB1ENR & RCC_APB1ENR_TIM4EN);
+	TEST_ASSERT(RCC->AHB1ENR & RCC_AHB1ENR_DMA1EN);
+	TEST_ASSERT_EQUAL(0xAA000000, GPIO_LED->MODER);
+	TEST_ASSERT_EQUAL(0x22220000, GPIO_LED->AFR[1]);
+	TEST_ASSERT_EQUAL(839, LED_PWM_TIM->PSC);												// 84 MHz / 840 / 1000 = 100 Hz
+	TEST_ASSERT_EQUAL(LED_BRIGHTNESS_MAX - 1, LED_PWM_TIM->ARR);
+	TEST_ASSERT_EQUAL(0x6868, LED_PWM_TIM->CCMR1);
+	TEST_ASSERT_EQUAL(0x6868, LED_PWM_TIM->CCMR2);
+	TEST_ASSERT_EQUAL(0x1111, LED_PWM_TIM->CCER);
+	TEST_ASSERT(LED_PWM_TIM->CR1 & TIM_CR1_CEN);
+
+	TEST_ASSERT(!LED_initPWM(0));
+	TEST_ASSERT(!LED_initPWM(1));																		// 84000 prescaler
+	TEST_ASSERT(!LED_initPWM(200000));															// 200 MHz steps
+}
+
+static void test_brightness(void)
+{
+	setup();
+	LED_setBrightness(LED_RED, 300);
+	LED_setBrightness(LED_BLUE, 5000);
+	LED_setBrightness((LED_Color) 4, 10);
+	TEST_ASSERT_EQUAL(0, HOST_TIM_getCompare(LED_PWM_TIM, 3));				// Next PWM period
+	HOST_TIM_update(LED_PWM_TIM);
+	TEST_ASSERT_EQUAL(0, HOST_TIM_getCompare(LED_PWM_TIM, 1));
+	TEST_ASSERT_EQUAL(300, HOST_TIM_getCompare(LED_PWM_TIM, 3));
+	TEST_ASSERT_EQUAL(LED_BRIGHTNESS_MAX, HOST_TIM_getCompare(LED_PWM_TIM, 4));
+}
+
+static void test_sequence(void)
+{
+	static LED_Frame fade[LED_BRIGHTNESS_MAX / 100 + 1];
+	uint32_t writes, writes_after;
+	int i;
+
+	for (i = 0; i <= LED_BRIGHTNESS_MAX / 100; i++)
+	{
+		fade[i][LED_GREEN] = (u16) (100 * i);
+		fade[i][LED_ORANGE] = 0;
+		fade[i][LED_RED] = (u16) (LED_BRIGHTNESS_MAX - 100 * i);
+		fade[i][LED_BLUE] = (i % 2) ? LED_BRIGHTNESS_MAX : 0;
+	}
+
+	setup();
+	TEST_ASSERT(LED_startSequence(fade, LED_BRIGHTNESS_MAX / 100 + 1, false));
+	TEST_ASSERT(LED_isSequenceRunning());
+	TEST_ASSERT(!LED_startSequence(fade, 2, false));
+
+	HOST_getAccessCount(NULL, NULL, &writes);
+	for (i = 0; i <= LED_BRIGHTNESS_MAX / 100; i++)
+	{
+		HOST_TIM_update(LED_PWM_TIM);
+		if (i > 0)
+		{
+			TEST_ASSERT_EQUAL(fade[i - 1][LED_GREEN], HOST_TIM_getCompare(LED_PWM_TIM, 1));
+			TEST_ASSERT_EQUAL(fade[i - 1][LED_RED], HOST_TIM_getCompare(LED_PWM_TIM, 3));
+			TEST_ASSERT_EQUAL(fade[i - 1][LED_BLUE], HOST_TIM_getCompare(LED_PWM_TIM, 4));
+		}
+	}
+	HOST_getAccessCount(NULL, NULL, &writes_after);
+	TEST_ASSERT_EQUAL(writes, writes_after);												// No CPU write for 11 frames
+	TEST_ASSERT(!LED_isSequenceRunning());
+
+	HOST_TIM_update(LED_PWM_TIM);
+	HOST_TIM_update(LED_PWM_TIM);
+	TEST_ASSERT_EQUAL(LED_BRIGHTNESS_MAX, HOST_TIM_getCompare(LED_PWM_TIM, 1));	// Last frame kept
+	TEST_ASSERT_EQUAL(0, HOST_TIM_getCompare(LED_PWM_TIM, 3));
+
+	TEST_ASSERT(LED_startSequence(fade, 2, true));
+	for (i = 0; i < 7; i++)
+		HOST_TIM_update(LED_PWM_TIM);
+	TEST_ASSERT(LED_isSequenceRunning());
+	TEST_ASSERT_EQUAL(LED_BRIGHTNESS_MAX, HOST_TIM_getCompare(LED_PWM_TIM, 4));	// Frame 1 of 0 1 0 1 0 1 0
+	LED_stopSequence();
+	TEST_ASSERT(!LED_isSequenceRunning());
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_brightness);
+	TEST_RUN(test_sequence);
+	return TEST_END();
+}
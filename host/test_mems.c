@@ -0,0 +1,410 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_mems.c
+ * Purpose: MEMS LIS3DSH service host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "host_lis3dsh.h"
+#include "mems_LIS3DSH.h"
+
+#define ODR_CYCLES		(168000000 / 1600)					///< Sample period at ODR 1600 Hz
+
+static void setup(void)
+{
+	HOST_LIS3DSH_attach(MEMS_SPI, MEMS_GPIO_CS, MEMS_PIN_CS);
+	HOST_LIS3DSH_attachInt1(MEMS_GPIO_INT1, MEMS_PIN_INT1);
+	MEMS_CLK_ENABLE();
+	MEMS_init();
+}
+
+/* FIFO callback: checks the samples follow each other (x = n, y = -n, z = 2n) */
+typedef struct
+{
+	uint32_t calls;
+	uint32_t samples;
+	int16_t next;
+	uint32_t errors;
+	uint8_t last_count;
+} FifoSink;
+
+static void on_samples(int16_t (*samples)[3], uint8_t count, void * context)
+{
+	FifoSink * sink = (FifoSink *) context;
+	uint8_t i;
+
+	sink->calls++;
+	sink->samples += count;
+	sink->last_count = count;
+	for (i = 0; i < count; i++)
+	{
+		if (samples[i][0] != sink->next || samples[i][1] != -sink->next || samples[i][2] != 2 * sink->next)
+			sink->errors++;
+		sink->next = samples[i][0] + 1;
+	}
+}
+
+static void push_samples(int16_t * n, uint32_t count)
+{
+	while (count-- > 0)
+	{
+		HOST_advance(ODR_CYCLES);
+		HOST_LIS3DSH_setSample(*n, (int16_t) -*n, (int16_t) (2 * *n));
+		(*n)++;
+	}
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_init(void)
+{
+	setup();
+	TEST_ASSERT_EQUAL(0x3F, MEMS_getData(MEMS_WHO_AM_I));
+	TEST_ASSERT(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG6) & MEMS_CTRL_REG6_ADD_INC);
+	MEMS_setData(MEMS_OFFSET_X, 0x12);
+	TEST_ASSERT_EQUAL(0x12, HOST_LIS3DSH_getRegister(MEMS_OFFSET_X));
+}
+
+static void test_burst_single_window(void)
+{
+	int16_t out[3] = { 0 };
+	HOST_SPIStats stats;
+	uint32_t windows;
+
+	setup();
+	HOST_LIS3DSH_setSample(-1000, 2, 16384);
+	windows = HOST_LIS3DSH_getWindows();
+	HOST_SPI_resetStats(MEMS_SPI);
+
+	MEMS_getOutXYZ(out);
+
+	TEST_ASSERT_EQUAL(-1000, out[0]);
+	TEST_ASSERT_EQUAL(2, out[1]);
+	TEST_ASSERT_EQUAL(16384, out[2]);
+	TEST_ASSERT_EQUAL(windows + 1, HOST_LIS3DSH_getWindows());
+	HOST_SPI_getStats(MEMS_SPI, &stats);
+	TEST_ASSERT_EQUAL(7, stats.frames);
+	TEST_ASSERT_EQUAL(0, stats.gap_cycles);
+}
+
+static void test_matches_single_axis_reads(void)
+{
+	int16_t out[3];
+
+	setup();
+	HOST_LIS3DSH_setSample(-32768, 32767, -1);
+	MEMS_getOutXYZ(out);
+	TEST_ASSERT_EQUAL((int16_t) MEMS_getOutX(), out[0]);
+	TEST_ASSERT_EQUAL((int16_t) MEMS_getOutY(), out[1]);
+	TEST_ASSERT_EQUAL((int16_t) MEMS_getOutZ(), out[2]);
+}
+
+static void test_bus_time(void)
+{
+	int16_t out[3];
+	uint64_t start, burst, separate;
+
+	setup();
+	start = HOST_getCycles();
+	MEMS_getOutXYZ(out);
+	burst = HOST_getCycles() - start;
+
+	start = HOST_getCycles();
+	MEMS_getOutX();
+	MEMS_getOutY();
+	MEMS_getOutZ();
+	separate = HOST_getCycles() - start;
+
+	printf("  burst %llu cycles, per-axis reads %llu cycles\n", (unsigned long long) burst, (unsigned long long) separate);
+	TEST_ASSERT(3 * burst < 2 * separate);
+}
+
+static void test_block_data_update(void)
+{
+	int16_t out[3];
+	uint8_t low;
+
+	setup();
+	MEMS_setBlockDataUpdate(true);
+	TEST_ASSERT(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG4) & MEMS_CTRL_REG4_BDU);
+	TEST_ASSERT(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG4) & MEMS_CTRL_REG4_XEN);
+
+	HOST_LIS3DSH_setSample(0x0102, 0, 0);
+	low = MEMS_getData(MEMS_OUT_X_L);
+	HOST_LIS3DSH_setSample(0x0304, 0, 0);
+	TEST_ASSERT_EQUAL(0x02, low);
+	TEST_ASSERT_EQUAL(0x01, MEMS_getData(MEMS_OUT_X_H));
+	MEMS_getOutXYZ(out);
+	TEST_ASSERT_EQUAL(0x0304, out[0]);
+
+	MEMS_setBlockDataUpdate(false);
+	TEST_ASSERT(!(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG4) & MEMS_CTRL_REG4_BDU));
+	TEST_ASSERT(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG4) & MEMS_CTRL_REG4_XEN);
+	low = MEMS_getData(MEMS_OUT_X_L);
+	HOST_LIS3DSH_setSample(0x0506, 0, 0);
+	TEST_ASSERT_EQUAL(0x05, MEMS_getData(MEMS_OUT_X_H));
+}
+
+static void test_fifo_stream(void)
+{
+	FifoSink sink = { 0 };
+	int16_t n = 0;
+	uint32_t windows;
+
+	setup();
+	MEMS_startFifoStream(25, on_samples, &sink);
+	TEST_ASSERT(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG6) & MEMS_CTRL_REG6_FIFO_EN);
+	TEST_ASSERT_EQUAL(MEMS_FIFO_CTRL_STREAM | 25, HOST_LIS3DSH_getRegister(MEMS_FIFO_CTRL));
+
+	windows = HOST_LIS3DSH_getWindows();
+	push_samples(&n, 24);
+	HOST_advance(ODR_CYCLES);
+	TEST_ASSERT_EQUAL(0, sink.calls);
+
+	push_samples(&n, 1);
+	HOST_advance(1);
+	TEST_ASSERT_EQUAL(1, sink.calls);
+	TEST_ASSERT_EQUAL(25, sink.last_count);
+	TEST_ASSERT_EQUAL(windows + 2, HOST_LIS3DSH_getWindows());	// FIFO_SRC, then one burst
+	TEST_ASSERT_EQUAL(0, HOST_LIS3DSH_getFifoCount());
+
+	push_samples(&n, 100);
+	HOST_advance(1);
+	TEST_ASSERT_EQUAL(5, sink.calls);
+	TEST_ASSERT_EQUAL(125, sink.samples);
+	TEST_ASSERT_EQUAL(0, sink.errors);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_fifo_late_interrupt(void)
+{
+	FifoSink sink = { 0 };
+	int16_t n = 0;
+
+	setup();
+	MEMS_startFifoStream(25, on_samples, &sink);
+	__disable_irq();
+	push_samples(&n, 40);
+	TEST_ASSERT_EQUAL(MEMS_FIFO_SIZE, HOST_LIS3DSH_getFifoCount());
+	TEST_ASSERT(MEMS_getData(MEMS_FIFO_SRC) & MEMS_FIFO_SRC_OVRN);
+	sink.next = 40 - MEMS_FIFO_SIZE;															// Stream mode kept the newest samples
+	__enable_irq();
+
+	TEST_ASSERT_EQUAL(1, sink.calls);
+	TEST_ASSERT_EQUAL(MEMS_FIFO_SIZE, sink.last_count);
+	TEST_ASSERT_EQUAL(0, sink.errors);
+
+	push_samples(&n, 25);
+	TEST_ASSERT_EQUAL(2, sink.calls);
+	TEST_ASSERT_EQUAL(0, sink.errors);
+}
+
+static void test_fifo_stop(void)
+{
+	FifoSink sink = { 0 };
+	int16_t n = 0;
+	int16_t samples[MEMS_FIFO_SIZE][3];
+
+	setup();
+	MEMS_startFifoStream(10, on_samples, &sink);
+	push_samples(&n, 5);
+	MEMS_stopFifoStream();
+	TEST_ASSERT_EQUAL(0, HOST_LIS3DSH_getFifoCount());
+	TEST_ASSERT(!(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG6) & MEMS_CTRL_REG6_FIFO_EN));
+	push_samples(&n, 20);
+	TEST_ASSERT_EQUAL(0, sink.calls);
+	TEST_ASSERT_EQUAL(0, MEMS_readFifo(samples));
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_shadow_single_write(void)
+{
+	uint32_t windows;
+
+	setup();
+	windows = HOST_LIS3DSH_getWindows();
+	MEMS_setValueBitsInRegister(MEMS_CTRL_REG4, MEMS_CTRL_REG4_ODR, (6 << 4));
+	MEMS_setBitsInRegister(MEMS_CTRL_REG5, MEMS_CTRL_REG5_FSCALE & (0x4 << 3));
+	MEMS_setData(MEMS_OFFSET_Y, 0x7F);
+	TEST_ASSERT_EQUAL(windows + 3, HOST_LIS3DSH_getWindows());
+
+	TEST_ASSERT_EQUAL(0x60 | 0x07, HOST_LIS3DSH_getRegister(MEMS_CTRL_REG4));
+	TEST_ASSERT_EQUAL(0x20, HOST_LIS3DSH_getRegister(MEMS_CTRL_REG5));
+	TEST_ASSERT_EQUAL(0x60, MEMS_getBitsInRegister(MEMS_CTRL_REG4, MEMS_CTRL_REG4_ODR));
+	TEST_ASSERT_EQUAL(0x7F, MEMS_getBitsInRegister(MEMS_OFFSET_Y, 0xFF));
+	TEST_ASSERT_EQUAL(windows + 3, HOST_LIS3DSH_getWindows());
+
+	MEMS_setBitsInRegister(MEMS_STATUS, 0x01);											// Not cached: read-modify-write
+	TEST_ASSERT_EQUAL(windows + 5, HOST_LIS3DSH_getWindows());
+}
+
+static void test_shadow_resync(void)
+{
+	setup();
+	HOST_LIS3DSH_setRegister(MEMS_CTRL_REG5, 0x18);
+	HOST_LIS3DSH_setRegister(MEMS_CSHIFT_Z, 0x05);
+	TEST_ASSERT_EQUAL(0x00, MEMS_getBitsInRegister(MEMS_CTRL_REG5, 0xFF));
+	TEST_ASSERT_EQUAL(0x18, MEMS_getData(MEMS_CTRL_REG5));
+
+	MEMS_resyncShadow();
+	TEST_ASSERT_EQUAL(0x18, MEMS_getBitsInRegister(MEMS_CTRL_REG5, 0xFF));
+	TEST_ASSERT_EQUAL(0x05, MEMS_getBitsInRegister(MEMS_CSHIFT_Z, 0xFF));
+	TEST_ASSERT(MEMS_getBitsInRegister(MEMS_CTRL_REG6, MEMS_CTRL_REG6_ADD_INC));
+
+	MEMS_setBitsInRegister(MEMS_CTRL_REG6, MEMS_CTRL_REG6_BOOT);
+	TEST_ASSERT_EQUAL(0, MEMS_getBitsInRegister(MEMS_CTRL_REG6, MEMS_CTRL_REG6_BOOT));
+	TEST_ASSERT_EQUAL(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG6), MEMS_getBitsInRegister(MEMS_CTRL_REG6, 0xFF));
+}
+
+static void test_shadow_soft_reset(void)
+{
+	setup();
+	MEMS_setBitsInRegister(MEMS_CTRL_REG5, 0x20);
+	MEMS_setBitsInRegister(MEMS_CTRL_REG3, MEMS_CTRL_REG3_STRT);
+	TEST_ASSERT_EQUAL(0, HOST_LIS3DSH_getRegister(MEMS_CTRL_REG3));
+	TEST_ASSERT_EQUAL(0, HOST_LIS3DSH_getRegister(MEMS_CTRL_REG5));
+	TEST_ASSERT_EQUAL(0, MEMS_getBitsInRegister(MEMS_CTRL_REG5, 0xFF));				// Shadow dropped, read from the MEMS
+
+	// STRT not written back: a second reset would clear CTRL_REG5 again
+	HOST_LIS3DSH_setRegister(MEMS_CTRL_REG5, 0x20);
+	MEMS_setBitsInRegister(MEMS_CTRL_REG3, MEMS_CTRL_REG3_DR_EN);
+	TEST_ASSERT_EQUAL(MEMS_CTRL_REG3_DR_EN, HOST_LIS3DSH_getRegister(MEMS_CTRL_REG3));
+	TEST_ASSERT_EQUAL(0x20, HOST_LIS3DSH_getRegister(MEMS_CTRL_REG5));
+
+	MEMS_resyncShadow();
+	MEMS_setBitsInRegister(MEMS_CTRL_REG3, MEMS_CTRL_REG3_STRT);
+	MEMS_resyncShadow();
+	MEMS_setBitsInRegister(MEMS_CTRL_REG3, MEMS_CTRL_REG3_INT1_EN);
+	TEST_ASSERT_EQUAL(MEMS_CTRL_REG3_INT1_EN, HOST_LIS3DSH_getRegister(MEMS_CTRL_REG3));
+}
+
+static void count_notify(void * context)
+{
+	(*(uint32_t *) context)++;
+}
+
+static void new_sample(void * ctx)
+{
+	(void) ctx;
+	HOST_LIS3DSH_setSample(7, -7, 14);
+}
+
+/* INT1 edge in the middle of a main loop read: the handler waits for CS high */
+static void test_data_ready_during_read(void)
+{
+	static int16_t storage[4][3];
+	RING_Buffer ring;
+	int16_t sample[3];
+	int i;
+
+	setup();
+	RING_init(&ring, storage, sizeof(storage[0]), 4);
+	MEMS_startDataReady(&ring, NULL, NULL);
+	for (i = 0; i < 8; i++)
+	{
+		HOST_schedule(4 + 8 * i, new_sample, NULL);									// From the CS falling edge to the last frame
+		TEST_ASSERT_EQUAL(0x3F, MEMS_getData(MEMS_WHO_AM_I));
+		TEST_ASSERT_EQUAL(MEMS_CTRL_REG3_DR_EN | MEMS_CTRL_REG3_INT1_EN | MEMS_CTRL_REG3_IEA,
+											MEMS_getData(MEMS_CTRL_REG3));
+		TEST_ASSERT(RING_pop(&ring, sample));
+		TEST_ASSERT_EQUAL(7, sample[0]);
+		TEST_ASSERT_EQUAL(14, sample[2]);
+	}
+	MEMS_stopDataReady();
+	TEST_ASSERT(GPIO_readPin(MEMS_GPIO_CS, MEMS_PIN_CS) == GPIO_PIN_HIGH);
+}
+
+static void test_data_ready(void)
+{
+	static int16_t storage[8][3];
+	RING_Buffer ring;
+	int16_t sample[3];
+	int16_t n = 0, expected = 0;
+	uint32_t notified = 0, before;
+	int i;
+
+	setup();
+	RING_init(&ring, storage, sizeof(storage[0]), 8);
+	MEMS_startDataReady(&ring, count_notify, &notified);
+	TEST_ASSERT(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG3) & MEMS_CTRL_REG3_DR_EN);
+
+	for (i = 0; i < 5; i++)
+	{
+		before = notified;
+		push_samples(&n, 3);
+		HOST_advance(1);
+		TEST_ASSERT_EQUAL(3, RING_getCount(&ring));
+		TEST_ASSERT(notified > before);
+		while (RING_pop(&ring, sample))
+		{
+			TEST_ASSERT_EQUAL(expected, sample[0]);
+			TEST_ASSERT_EQUAL(2 * expected, sample[2]);
+			expected++;
+		}
+	}
+	TEST_ASSERT_EQUAL(15, expected);
+	TEST_ASSERT_EQUAL(0, RING_getOverruns(&ring));
+
+	push_samples(&n, 10);																		// Main loop too slow
+	HOST_advance(1);
+	TEST_ASSERT_EQUAL(8, RING_getCount(&ring));
+	TEST_ASSERT_EQUAL(2, RING_getOverruns(&ring));
+
+	MEMS_stopDataReady();
+	TEST_ASSERT(!(HOST_LIS3DSH_getRegister(MEMS_CTRL_REG3) & MEMS_CTRL_REG3_DR_EN));
+	while (RING_pop(&ring, sample));
+	before = notified;
+	push_samples(&n, 3);
+	TEST_ASSERT_EQUAL(0, RING_getCount(&ring));
+	TEST_ASSERT_EQUAL(before, notified);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_data_ready_late_interrupt(void)
+{
+	static int16_t storage[8][3];
+	RING_Buffer ring;
+	int16_t sample[3];
+	int16_t n = 0;
+
+	setup();
+	RING_init(&ring, storage, sizeof(storage[0]), 8);
+	MEMS_startDataReady(&ring, NULL, NULL);
+	__disable_irq();
+	push_samples(&n, 2);
+	__enable_irq();																						// Reads the last sample only
+	TEST_ASSERT(RING_pop(&ring, sample));
+	TEST_ASSERT_EQUAL(1, sample[0]);
+
+	push_samples(&n, 1);																			// No edge lost: INT1 went low
+	TEST_ASSERT(RING_pop(&ring, sample));
+	TEST_ASSERT_EQUAL(2, sample[0]);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_burst_single_window);
+	TEST_RUN(test_matches_single_axis_reads);
+	TEST_RUN(test_bus_time);
+	TEST_RUN(test_block_data_update);
+	TEST_RUN(test_fifo_stream);
+	TEST_RUN(test_fifo_late_interrupt);
+	TEST_RUN(test_fifo_stop);
+	TEST_RUN(test_shadow_single_write);
+	TEST_RUN(test_shadow_resync);
+	TEST_RUN(test_shadow_soft_reset);
+	TEST_RUN(test_data_ready);
+	TEST_RUN(test_data_ready_during_read);
+	TEST_RUN(test_data_ready_late_interrupt);
+	return TEST_END();
+}
@@ -0,0 +1,242 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_pool.c
+ * Purpose: Fixed-block pool host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	The interrupt test allocates from an EXTI callback while the main loop
+ * holds blocks, the stress test from host threads, where the STREX of
+ * the model fails as on target when another context changed head.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "host_test.h"
+#include "pool.h"
+#include "interrupt.h"
+#include "rcc.h"
+
+#define BLOCKS				8
+#define BLOCK_SIZE		12																			///< Rounded up to 16
+#define THREADS				5
+#define ROUNDS				20000
+
+#ifdef TEST_POOL_BAD_COUNT
+static uint64_t bad_storage[POOL_STORAGE_SIZE(16, 0)];
+#endif
+
+static uint64_t storage[POOL_STORAGE_SIZE(BLOCK_SIZE, BLOCKS)];
+static POOL_Pool pool;
+
+static void setup(void)
+{
+	TEST_ASSERT(POOL_init(&pool, storage, BLOCK_SIZE, BLOCKS));
+}
+
+/* All the blocks allocated once, in any order */
+static uint32_t drain(void * blocks[BLOCKS])
+{
+	uint32_t n = 0;
+
+	while (n < BLOCKS && (blocks[n] = POOL_alloc(&pool)) != NULL)
+		n++;
+	return n;
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_init(void)
+{
+	TEST_ASSERT_EQUAL(BLOCKS * 2, sizeof(storage) / sizeof(storage[0]));
+	TEST_ASSERT(!POOL_init(&pool, storage, 0, BLOCKS));
+	TEST_ASSERT(!POOL_init(&pool, storage, BLOCK_SIZE, 0));
+	TEST_ASSERT(!POOL_init(&pool, storage, BLOCK_SIZE, POOL_MAX_BLOCKS + 1));
+	setup();
+	TEST_ASSERT_EQUAL(16, pool.block_size);
+	TEST_ASSERT_EQUAL(0, POOL_getUsed(&pool));
+	TEST_ASSERT_EQUAL(0, POOL_getPeak(&pool));
+}
+
+static void test_alloc_all(void)
+{
+	void * blocks[BLOCKS];
+	uint32_t i, j;
+
+	setup();
+	TEST_ASSERT_EQUAL(BLOCKS, drain(blocks));
+	for (i = 0; i < BLOCKS; i++)
+	{
+		TEST_ASSERT((uint8_t *) blocks[i] >= (uint8_t *) storage);
+		TEST_ASSERT((uint8_t *) blocks[i] < (uint8_t *) storage + sizeof(storage));
+		TEST_ASSERT_EQUAL(0, (uintptr_t) blocks[i] % POOL_ALIGN);
+		for (j = 0; j < i; j++)
+			TEST_ASSERT(blocks[i] != blocks[j]);
+	}
+	TEST_ASSERT(POOL_alloc(&pool) == NULL);
+	TEST_ASSERT_EQUAL(1, POOL_getFailures(&pool));
+	TEST_ASSERT_EQUAL(BLOCKS, POOL_getUsed(&pool));
+	TEST_ASSERT_EQUAL(BLOCKS, POOL_getPeak(&pool));
+}
+
+static void test_free(void)
+{
+	void * blocks[BLOCKS];
+	uint32_t i;
+
+	setup();
+	drain(blocks);
+	TEST_ASSERT(POOL_free(&pool, blocks[3]));
+	TEST_ASSERT(POOL_alloc(&pool) == blocks[3]);											// Last freed first
+	TEST_ASSERT(POOL_alloc(&pool) == NULL);
+
+	TEST_ASSERT(!POOL_free(&pool, NULL));
+	TEST_ASSERT(!POOL_free(&pool, (uint8_t *) blocks[0] + 4));						// Inside a block
+	TEST_ASSERT(!POOL_free(&pool, (uint8_t *) storage + sizeof(storage)));
+	TEST_ASSERT(!POOL_free(&pool, (void *) ((uintptr_t) storage - 16)));
+	TEST_ASSERT_EQUAL(BLOCKS, POOL_getUsed(&pool));
+
+	for (i = 0; i < BLOCKS; i++)
+		TEST_ASSERT(POOL_free(&pool, blocks[i]));
+	TEST_ASSERT_EQUAL(0, POOL_getUsed(&pool));
+	TEST_ASSERT_EQUAL(BLOCKS, drain(blocks));												// Free list still whole
+}
+
+static void test_peak(void)
+{
+	void * a, * b, * c;
+
+	setup();
+	a = POOL_alloc(&pool);
+	b = POOL_alloc(&pool);
+	c = POOL_alloc(&pool);
+	POOL_free(&pool, b);
+	POOL_free(&pool, c);
+	TEST_ASSERT_EQUAL(1, POOL_getUsed(&pool));
+	TEST_ASSERT_EQUAL(3, POOL_getPeak(&pool));
+	POOL_resetPeak(&pool);
+	TEST_ASSERT_EQUAL(1, POOL_getPeak(&pool));
+	POOL_free(&pool, a);
+	TEST_ASSERT_EQUAL(1, POOL_getPeak(&pool));
+}
+
+/* Two blocks taken and given back by each edge */
+static void on_edge(u8 line, void * context)
+{
+	void * a = POOL_alloc(&pool);
+	void * b = POOL_alloc(&pool);
+
+	(void) line;
+	*(uint32_t *) context += (a != NULL) + (b != NULL);
+	POOL_free(&pool, b);
+	POOL_free(&pool, a);
+}
+
+static void test_from_interrupt(void)
+{
+	void * held[BLOCKS];
+	uint32_t taken = 0, n;
+
+	setup();
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_edge, &taken);
+	for (n = 0; n < BLOCKS - 2; n++)
+		held[n] = POOL_alloc(&pool);
+	HOST_GPIO_setInput(GPIOA, 1, true);
+	HOST_GPIO_setInput(GPIOA, 1, false);
+	TEST_ASSERT_EQUAL(2, taken);
+
+	held[n] = POOL_alloc(&pool);																// One left for the handler
+	HOST_GPIO_setInput(GPIOA, 1, true);
+	TEST_ASSERT_EQUAL(3, taken);
+	TEST_ASSERT_EQUAL(1, POOL_getFailures(&pool));
+	TEST_ASSERT_EQUAL(BLOCKS, POOL_getPeak(&pool));
+	TEST_ASSERT_EQUAL(BLOCKS - 1, POOL_getUsed(&pool));
+	EXTI_detach(1);
+
+	for (n = 0; n < BLOCKS - 1; n++)
+		TEST_ASSERT(POOL_free(&pool, held[n]));
+	TEST_ASSERT_EQUAL(0, POOL_getUsed(&pool));
+}
+
+typedef struct
+{
+	uint32_t id;
+	uint32_t errors;
+	uint32_t failures;
+} Worker;
+
+/* Blocks stamped with the thread id while held, checked before the free */
+static void * worker(void * arg)
+{
+	Worker * w = (Worker *) arg;
+	uint32_t * held[2];
+	uint32_t round, i;
+
+	for (round = 0; round < ROUNDS; round++)
+	{
+		for (i = 0; i < 2; i++)
+		{
+			held[i] = (uint32_t *) POOL_alloc(&pool);
+			if (held[i] == NULL)
+				w->failures++;
+			else
+				held[i][1] = held[i][2] = w->id;
+		}
+		sched_yield();
+		for (i = 0; i < 2; i++)
+		{
+			if (held[i] == NULL)
+				continue;
+			if (held[i][1] != w->id || held[i][2] != w->id)
+				w->errors++;
+			if (!POOL_free(&pool, held[i]))
+				w->errors++;
+		}
+	}
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	static Worker w[THREADS];
+	pthread_t threads[THREADS];
+	void * blocks[BLOCKS];
+	uint32_t i, failures = 0;
+
+	setup();
+	for (i = 0; i < THREADS; i++)
+	{
+		w[i].id = i + 1;
+		TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, worker, &w[i]));
+	}
+	for (i = 0; i < THREADS; i++)
+	{
+		pthread_join(threads[i], NULL);
+		TEST_ASSERT_EQUAL(0, w[i].errors);
+		failures += w[i].failures;
+	}
+
+	printf("  %d threads, %u failed allocations, peak %u\n", THREADS, failures, POOL_getPeak(&pool));
+	TEST_ASSERT_EQUAL(failures, POOL_getFailures(&pool));
+	TEST_ASSERT_EQUAL(0, POOL_getUsed(&pool));
+	TEST_ASSERT(POOL_getPeak(&pool) <= BLOCKS);
+	TEST_ASSERT_EQUAL(BLOCKS, drain(blocks));
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_alloc_all);
+	TEST_RUN(test_free);
+	TEST_RUN(test_peak);
+	TEST_RUN(test_from_interrupt);
+	TEST_RUN(test_threads);
+	return TEST_END();
+}
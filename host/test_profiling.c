@@ -0,0 +1,190 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_profiling.c
+ * Purpose: Timestamp and profiling service host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	Built with PROF_ENABLED: the MEMS service registers its sections. The
+ * model counts CYCCNT on the virtual clock but not TIM2, the tests set
+ * TIM2 CNT where the hardware would be.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "host_lis3dsh.h"
+#include "profiling.h"
+#include "mems_LIS3DSH.h"
+
+/* TIM2 CNT of the virtual clock, offset by delta counts */
+static void follow_cycles(int32_t delta)
+{
+	TIM2->CNT.v = (uint32_t) (HOST_getCycles() >> PROF_TIM_SHIFT) + delta;
+}
+
+static void advance(uint64_t cycles)
+{
+	while (cycles > 0x80000000)
+	{
+		HOST_advance(0x80000000);
+		cycles -= 0x80000000;
+	}
+	HOST_advance((uint32_t) cycles);
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_init(void)
+{
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV2;
+	PROF_init();
+	TEST_ASSERT(CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+	TEST_ASSERT(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk);
+	TEST_ASSERT(RCC->APB1ENR & RCC_APB1ENR_TIM2EN);
+	TEST_ASSERT(TIM2->CR1 & TIM_CR1_CEN);
+	TEST_ASSERT_EQUAL(0xFFFF, TIM2->PSC);												// TIM2 clock = core clock
+	TEST_ASSERT_EQUAL(0xFFFFFFFF, TIM2->ARR);
+	TEST_ASSERT_EQUAL(168000000, PROF_getFrequency());
+
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV4;																// TIM2 clock = core clock / 2
+	PROF_init();
+	TEST_ASSERT_EQUAL(0x7FFF, TIM2->PSC);
+}
+
+static void test_timestamp(void)
+{
+	uint64_t t0, t1;
+
+	PROF_init();
+	follow_cycles(0);
+	t0 = PROF_getTimestamp();
+	TEST_ASSERT(t0 < 64);
+	HOST_advance(1000);
+	follow_cycles(0);
+	t1 = PROF_getTimestamp();
+	TEST_ASSERT(t1 - t0 >= 1000 && t1 - t0 < 1032);
+}
+
+static void test_timestamp_wraps(void)
+{
+	uint64_t t, now;
+
+	PROF_init();
+	advance(5 * 0x100000000ULL + 12345);														// CYCCNT wrapped 5 times
+	follow_cycles(0);
+	t = PROF_getTimestamp();
+	now = HOST_getCycles();
+	TEST_ASSERT(t <= now && now - t < 64);
+	TEST_ASSERT_EQUAL(5, t >> 32);
+}
+
+static void test_timestamp_timer_phase(void)
+{
+	uint64_t exact, early, late;
+
+	PROF_init();
+	advance(0x100000000ULL - 100);																	// CYCCNT about to wrap
+	follow_cycles(0);
+	exact = PROF_getTimestamp();
+	follow_cycles(-1);																							// TIM2 read a count behind CYCCNT
+	early = PROF_getTimestamp();
+	HOST_advance(200);																							// CYCCNT wrapped, TIM2 not yet
+	follow_cycles(-2);
+	late = PROF_getTimestamp();
+	TEST_ASSERT(early > exact && early - exact < 32);
+	TEST_ASSERT(late > early && late - early >= 200 && late - early < 232);
+	TEST_ASSERT_EQUAL(1, late >> 32);
+}
+
+static void test_section_stats(void)
+{
+	PROF_Id base = PROF_register("test_base");
+	PROF_Id id = PROF_register("test_section");
+	const PROF_Section * section;
+	uint32_t start, overhead;
+
+	TEST_ASSERT(id != PROF_NONE && id != base);
+	TEST_ASSERT_EQUAL(id, PROF_register("test_section"));
+	PROF_init();
+
+	start = PROF_begin();
+	PROF_end(base, start);
+	overhead = PROF_getSection(base)->max;
+	TEST_ASSERT(overhead > 0 && overhead < 16);
+
+	start = PROF_begin();
+	HOST_advance(100);
+	PROF_end(id, start);
+	start = PROF_begin();
+	HOST_advance(1000);
+	PROF_end(id, start);
+
+	section = PROF_getSection(id);
+	TEST_ASSERT(section->name != NULL && section->name[0] == 't');
+	TEST_ASSERT_EQUAL(2, section->count);
+	TEST_ASSERT_EQUAL(100 + overhead, section->min);
+	TEST_ASSERT_EQUAL(1000 + overhead, section->max);
+	TEST_ASSERT_EQUAL(550 + overhead, PROF_getMean(section));
+	TEST_ASSERT_EQUAL(1, section->histogram[6]);										// 64..127
+	TEST_ASSERT_EQUAL(1, section->histogram[9]);										// 512..1023
+
+	PROF_reset();
+	TEST_ASSERT_EQUAL(0, section->count);
+	TEST_ASSERT_EQUAL(0, PROF_getMean(section));
+	TEST_ASSERT_EQUAL(0, section->histogram[9]);
+	TEST_ASSERT_EQUAL(id, PROF_register("test_section"));
+}
+
+static void test_mems_sections(void)
+{
+	const PROF_Section * init;
+	const PROF_Section * get_data;
+	uint32_t count;
+
+	PROF_init();
+	HOST_LIS3DSH_attach(MEMS_SPI, MEMS_GPIO_CS, MEMS_PIN_CS);
+	MEMS_CLK_ENABLE();
+	MEMS_init();
+	init = PROF_getSection(PROF_register("MEMS_init"));
+	get_data = PROF_getSection(PROF_register("MEMS_getData"));
+	TEST_ASSERT_EQUAL(1, init->count);
+	TEST_ASSERT(init->min > 0);
+
+	count = get_data->count;
+	TEST_ASSERT_EQUAL(0x3F, MEMS_getData(MEMS_WHO_AM_I));
+	TEST_ASSERT_EQUAL(count + 1, get_data->count);
+	TEST_ASSERT(get_data->max < init->min);
+}
+
+static void test_table_full(void)
+{
+	static const char * const names[PROF_MAX_SECTIONS] =
+	{
+		"s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+		"s8", "s9", "s10", "s11", "s12", "s13", "s14", "s15"
+	};
+	uint8_t i;
+
+	for (i = PROF_getSectionCount(); i < PROF_MAX_SECTIONS; i++)
+		TEST_ASSERT_EQUAL(i, PROF_register(names[i]));
+	TEST_ASSERT_EQUAL(PROF_NONE, PROF_register("one too many"));
+	TEST_ASSERT(PROF_getSection(PROF_NONE) == NULL);
+	PROF_end(PROF_NONE, 0);																					// Ignored
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_timestamp);
+	TEST_RUN(test_timestamp_wraps);
+	TEST_RUN(test_timestamp_timer_phase);
+	TEST_RUN(test_section_stats);
+	TEST_RUN(test_mems_sections);
+	TEST_RUN(test_table_full);
+	return TEST_END();
+}
@@ -0,0 +1,199 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_rcc.c
+ * Purpose: RCC clock tree host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	The model starts in the SystemInit state (168 MHz from the PLL on the
+ * HSE) and counts the configurations out of the RM0090 limits: every
+ * switch must leave HOST_getClockFaults() at 0.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "rcc.h"
+#include "spi.h"
+#include "timer_wheel.h"
+
+static WHEEL_Wheel wheel;
+static uint32_t notified;
+
+static void on_clock(void * context)
+{
+	*(uint32_t *) context = RCC_getHCLK();
+	notified++;
+}
+
+/* Current SYSCLK source from SWS */
+static uint32_t sysclk_source(void)
+{
+	return RCC->CFGR & RCC_CFGR_SWS;
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_reset_state(void)
+{
+	TEST_ASSERT_EQUAL(168000000, RCC_getHCLK());
+	TEST_ASSERT_EQUAL(42000000, RCC_getPCLK1());
+	TEST_ASSERT_EQUAL(84000000, RCC_getPCLK2());
+	TEST_ASSERT_EQUAL(84000000, RCC_getTIMCLK(RCC_BUS_APB1));
+	TEST_ASSERT_EQUAL(168000000, RCC_getTIMCLK(RCC_BUS_APB2));
+}
+
+static void test_solve(void)
+{
+	RCC_ClockConfig config;
+
+	TEST_ASSERT(RCC_solveClocks(168000000, &config));
+	TEST_ASSERT_EQUAL(4, config.pllcfgr & RCC_PLLCFGR_PLLM);
+	TEST_ASSERT_EQUAL(168, (config.pllcfgr & RCC_PLLCFGR_PLLN) >> 6);
+	TEST_ASSERT_EQUAL(0, config.pllcfgr & RCC_PLLCFGR_PLLP);								// P = 2
+	TEST_ASSERT_EQUAL(7, (config.pllcfgr & RCC_PLLCFGR_PLLQ) >> 24);						// USB 48 MHz
+	TEST_ASSERT(config.pllcfgr & RCC_PLLCFGR_PLLSRC_HSE);
+	TEST_ASSERT_EQUAL(RCC_CFGR_SW_PLL | RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2, config.cfgr);
+	TEST_ASSERT_EQUAL(5, config.latency);
+	TEST_ASSERT(config.scale1);
+
+	TEST_ASSERT(RCC_solveClocks(84000000, &config));
+	TEST_ASSERT_EQUAL(84, (config.pllcfgr & RCC_PLLCFGR_PLLN) >> 6);
+	TEST_ASSERT_EQUAL(4, (config.pllcfgr & RCC_PLLCFGR_PLLQ) >> 24);						// USB 42 MHz
+	TEST_ASSERT_EQUAL(RCC_CFGR_SW_PLL | RCC_CFGR_PPRE1_DIV2 | RCC_CFGR_PPRE2_DIV1, config.cfgr);
+	TEST_ASSERT_EQUAL(2, config.latency);
+	TEST_ASSERT(!config.scale1);
+
+	TEST_ASSERT(RCC_solveClocks(RCC_HSE_HZ, &config));
+	TEST_ASSERT_EQUAL(0, config.pllcfgr);
+	TEST_ASSERT_EQUAL(RCC_CFGR_SW_HSE, config.cfgr);
+	TEST_ASSERT_EQUAL(0, config.latency);
+
+	TEST_ASSERT(!RCC_solveClocks(12000000, &config));										// Below the PLL range
+	TEST_ASSERT(!RCC_solveClocks(170000000, &config));
+	TEST_ASSERT(!RCC_solveClocks(100500000, &config));										// Not a whole MHz
+}
+
+static void test_switch_sequence(void)
+{
+	TEST_ASSERT(RCC_setSysclk(RCC_HSE_HZ));
+	TEST_ASSERT_EQUAL(RCC_CFGR_SWS_HSE, sysclk_source());
+	TEST_ASSERT_EQUAL(0, RCC->CR & RCC_CR_PLLON);
+	TEST_ASSERT_EQUAL(0, FLASH->ACR & FLASH_ACR_LATENCY);
+	TEST_ASSERT_EQUAL(8000000, RCC_getPCLK1());
+	TEST_ASSERT_EQUAL(8000000, RCC_getTIMCLK(RCC_BUS_APB1));
+
+	TEST_ASSERT(RCC_setSysclk(168000000));
+	TEST_ASSERT_EQUAL(RCC_CFGR_SWS_PLL, sysclk_source());
+	TEST_ASSERT_EQUAL(FLASH_ACR_LATENCY_5WS, FLASH->ACR & FLASH_ACR_LATENCY);
+	TEST_ASSERT(PWR->CR & PWR_CR_VOS);
+	TEST_ASSERT_EQUAL(168000000, SystemCoreClock);
+
+	TEST_ASSERT(RCC_setSysclk(RCC_HSI_HZ));
+	TEST_ASSERT_EQUAL(RCC_CFGR_SWS_HSI, sysclk_source());
+	TEST_ASSERT_EQUAL(0, RCC->CR & (RCC_CR_PLLON | RCC_CR_HSEON));						// Unused oscillators stopped
+	TEST_ASSERT_EQUAL(16000000, RCC_getPCLK2());
+
+	TEST_ASSERT(RCC_setSysclk(84000000));
+	TEST_ASSERT_EQUAL(RCC_CFGR_SWS_PLL, sysclk_source());
+	TEST_ASSERT_EQUAL(0, PWR->CR & PWR_CR_VOS);
+	TEST_ASSERT_EQUAL(42000000, RCC_getPCLK1());
+	TEST_ASSERT_EQUAL(84000000, RCC_getTIMCLK(RCC_BUS_APB1));
+	TEST_ASSERT_EQUAL(84000000, RCC_getTIMCLK(RCC_BUS_APB2));
+
+	TEST_ASSERT_EQUAL(0, HOST_getClockFaults());
+}
+
+static void test_invalid_unchanged(void)
+{
+	uint32_t cfgr = RCC->CFGR, pllcfgr = RCC->PLLCFGR;
+
+	TEST_ASSERT(!RCC_setSysclk(170000000));
+	TEST_ASSERT(!RCC_setSysclk(0));
+	TEST_ASSERT_EQUAL(cfgr, RCC->CFGR);
+	TEST_ASSERT_EQUAL(pllcfgr, RCC->PLLCFGR);
+	TEST_ASSERT_EQUAL(168000000, SystemCoreClock);
+}
+
+static void test_model_faults(void)
+{
+	FLASH->ACR = FLASH_ACR_PRFTEN;																				// 0 WS at 168 MHz
+	TEST_ASSERT_EQUAL(1, HOST_getClockFaults());
+	RCC->PLLCFGR = 0;																										// PLL running
+	TEST_ASSERT_EQUAL(2, HOST_getClockFaults());
+	TEST_ASSERT(RCC->PLLCFGR != 0);
+}
+
+static void test_listeners(void)
+{
+	RCC_ClockListener first, second;
+	uint32_t first_hclk = 0, second_hclk = 0;
+
+	notified = 0;
+	RCC_addListener(&first, on_clock, &first_hclk);
+	RCC_addListener(&second, on_clock, &second_hclk);
+	RCC_addListener(&first, on_clock, &first_hclk);										// Not added twice
+	TEST_ASSERT(RCC_setSysclk(RCC_HSE_HZ));
+	TEST_ASSERT_EQUAL(2, notified);
+	TEST_ASSERT_EQUAL(8000000, first_hclk);
+	TEST_ASSERT_EQUAL(8000000, second_hclk);
+
+	RCC_removeListener(&first);
+	TEST_ASSERT(RCC_setSysclk(168000000));
+	TEST_ASSERT_EQUAL(3, notified);
+	TEST_ASSERT_EQUAL(8000000, first_hclk);
+	TEST_ASSERT_EQUAL(168000000, second_hclk);
+
+	TEST_ASSERT(!RCC_setSysclk(1));																				// No change, no call
+	TEST_ASSERT_EQUAL(3, notified);
+	RCC_removeListener(&second);
+	RCC_removeListener(&second);
+}
+
+static void test_wheel_follows_clock(void)
+{
+	TIM3_CLK_ENABLE();
+	WHEEL_init(&wheel);
+	TEST_ASSERT(WHEEL_attachTimer(&wheel, TIM3, 1000, false));
+	TEST_ASSERT_EQUAL(83999, ((uint32_t) TIM3->PSC + 1) * (TIM3->ARR + 1) - 1);		// 1ms at 84MHz
+
+	TEST_ASSERT(RCC_setSysclk(RCC_HSE_HZ));
+	TEST_ASSERT_EQUAL(7999, ((uint32_t) TIM3->PSC + 1) * (TIM3->ARR + 1) - 1);		// 1ms at 8MHz
+	TEST_ASSERT(TIM3->DIER & TIM_DIER_UIE);
+	TEST_ASSERT_EQUAL(0, TIM3->SR & TIM_SR_UIF);
+
+	TEST_ASSERT(RCC_setSysclk(168000000));
+	TEST_ASSERT_EQUAL(83999, ((uint32_t) TIM3->PSC + 1) * (TIM3->ARR + 1) - 1);
+	WHEEL_init(&wheel);																									// Listener removed
+}
+
+static void test_spi_follows_clock(void)
+{
+	SPI1_CLK_ENABLE();
+	TEST_ASSERT_EQUAL(5250000, SPI_setBaudRate(SPI1, 10000000));							// 84 MHz / 16
+	TEST_ASSERT_EQUAL(5250000, SPI_getBaudRate(SPI1));
+
+	TEST_ASSERT(RCC_setSysclk(RCC_HSI_HZ));
+	TEST_ASSERT_EQUAL(8000000, SPI_getBaudRate(SPI1));										// 16 MHz / 2
+	TEST_ASSERT(RCC_setSysclk(100000000));
+	TEST_ASSERT(SPI_getBaudRate(SPI1) <= 10000000);
+	TEST_ASSERT_EQUAL(6250000, SPI_getBaudRate(SPI1));										// 100 MHz / 16
+	TEST_ASSERT_EQUAL(0, HOST_getClockFaults());
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_reset_state);
+	TEST_RUN(test_solve);
+	TEST_RUN(test_switch_sequence);
+	TEST_RUN(test_invalid_unchanged);
+	TEST_RUN(test_model_faults);
+	TEST_RUN(test_listeners);
+	TEST_RUN(test_wheel_follows_clock);
+	TEST_RUN(test_spi_follows_clock);
+	return TEST_END();
+}
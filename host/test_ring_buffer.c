@@ -0,0 +1,181 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_ring_buffer.c
+ * Purpose: Lock-free ring buffer host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	The threaded tests run a producer thread standing in for the
+ * interrupt handler against a consumer thread standing in for the main
+ * loop. They don't touch the peripheral model.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "host_test.h"
+#include "ring_buffer.h"
+
+#define ELEMENTS		200000
+
+typedef struct
+{
+	uint32_t sequence;
+	uint32_t check;													///< ~sequence, detects torn elements
+} Element;
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_init(void)
+{
+	RING_Buffer ring;
+	Element storage[8];
+
+	TEST_ASSERT(!RING_init(&ring, storage, sizeof(storage[0]), 0));
+	TEST_ASSERT(!RING_init(&ring, storage, sizeof(storage[0]), 6));
+	TEST_ASSERT(RING_init(&ring, storage, sizeof(storage[0]), 8));
+	TEST_ASSERT_EQUAL(0, RING_getCount(&ring));
+	TEST_ASSERT_EQUAL(0, RING_getOverruns(&ring));
+}
+
+static void test_fill_and_drain(void)
+{
+	RING_Buffer ring;
+	int16_t storage[4][3];
+	int16_t sample[3] = { 1, -2, 3 };
+	int16_t out[3];
+	int i;
+
+	RING_init(&ring, storage, sizeof(storage[0]), 4);
+	TEST_ASSERT(!RING_pop(&ring, out));
+	for (i = 0; i < 4; i++)
+	{
+		sample[0] = (int16_t) i;
+		TEST_ASSERT(RING_push(&ring, sample));
+	}
+	TEST_ASSERT(!RING_push(&ring, sample));
+	TEST_ASSERT_EQUAL(4, RING_getCount(&ring));
+	TEST_ASSERT_EQUAL(1, RING_getOverruns(&ring));
+
+	for (i = 0; i < 4; i++)
+	{
+		TEST_ASSERT(RING_pop(&ring, out));
+		TEST_ASSERT_EQUAL(i, out[0]);
+		TEST_ASSERT_EQUAL(-2, out[1]);
+	}
+	TEST_ASSERT(!RING_pop(&ring, out));
+}
+
+static void test_index_wrap(void)
+{
+	RING_Buffer ring;
+	uint32_t storage[2];
+	uint32_t value;
+	uint32_t i;
+
+	RING_init(&ring, storage, sizeof(storage[0]), 2);
+	ring.head = ring.tail = 0xFFFFFFFE;										// Free-running indices about to wrap
+	for (i = 0; i < 6; i++)
+	{
+		TEST_ASSERT(RING_push(&ring, &i));
+		TEST_ASSERT_EQUAL(1, RING_getCount(&ring));
+		TEST_ASSERT(RING_pop(&ring, &value));
+		TEST_ASSERT_EQUAL(i, value);
+	}
+	TEST_ASSERT(RING_push(&ring, &i));
+	TEST_ASSERT(RING_push(&ring, &i));
+	TEST_ASSERT(!RING_push(&ring, &i));
+}
+
+typedef struct
+{
+	RING_Buffer ring;
+	Element storage[64];
+	uint32_t pushed;
+	uint32_t popped;
+	uint32_t errors;
+	volatile bool done;
+} Threads;
+
+static void * producer(void * arg)
+{
+	Threads * t = (Threads *) arg;
+	uint32_t i;
+
+	for (i = 0; i < ELEMENTS; i++)
+	{
+		Element e = { i, ~i };
+		bool pushed = RING_push(&t->ring, &e);
+
+		while (!pushed && (i & 0x3FF) != 0)				// Element dropped on overrun 1 time in 1024
+		{
+			sched_yield();
+			pushed = RING_push(&t->ring, &e);
+		}
+		if (pushed)
+			t->pushed++;
+	}
+	__DMB();
+	t->done = true;
+	return NULL;
+}
+
+static void * consumer(void * arg)
+{
+	Threads * t = (Threads *) arg;
+	uint32_t last = 0;
+	bool first = true;
+	Element e;
+
+	for (;;)
+	{
+		bool done = t->done;
+
+		__DMB();
+		while (RING_pop(&t->ring, &e))
+		{
+			if (e.check != ~e.sequence || (!first && e.sequence <= last))
+				t->errors++;
+			last = e.sequence;
+			first = false;
+			t->popped++;
+		}
+		if (done)
+			break;
+		sched_yield();
+	}
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	static Threads t;
+	pthread_t p, c;
+
+	RING_init(&t.ring, t.storage, sizeof(t.storage[0]), 64);
+	TEST_ASSERT_EQUAL(0, pthread_create(&c, NULL, consumer, &t));
+	TEST_ASSERT_EQUAL(0, pthread_create(&p, NULL, producer, &t));
+	pthread_join(p, NULL);
+	pthread_join(c, NULL);
+
+	printf("  %u pushed, %u overruns (retried pushes included)\n", t.pushed, RING_getOverruns(&t.ring));
+	TEST_ASSERT_EQUAL(0, t.errors);
+	TEST_ASSERT_EQUAL(t.pushed, t.popped);
+	TEST_ASSERT(t.pushed + RING_getOverruns(&t.ring) >= ELEMENTS);
+	TEST_ASSERT(t.pushed >= ELEMENTS - ELEMENTS / 1024);
+	TEST_ASSERT_EQUAL(0, RING_getCount(&t.ring));
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_fill_and_drain);
+	TEST_RUN(test_index_wrap);
+	TEST_RUN(test_threads);
+	return TEST_END();
+}
@@ -0,0 +1,163 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_scheduler.c
+ * Purpose: Cooperative scheduler service host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "scheduler.h"
+#include "interrupt.h"
+#include "rcc.h"
+
+/* Tasks in the order they ran, with their events */
+static char trace[16];
+static uint32_t trace_events[16];
+static uint8_t trace_count;
+
+static void record(uint32_t events, void * context)
+{
+	trace_events[trace_count] = events;
+	trace[trace_count++] = *(const char *) context;
+}
+
+static void run_all(void)
+{
+	while (SCHED_runNext());
+	trace[trace_count] = '\0';
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_init(void)
+{
+	static const char a = 'a';
+	SCHED_Task task;
+
+	SCHED_init();
+	TEST_ASSERT(!SCHED_initTask(&task, NULL, NULL, 0));
+	TEST_ASSERT(!SCHED_initTask(&task, record, (void *) &a, SCHED_PRIORITIES));
+	TEST_ASSERT(SCHED_initTask(&task, record, (void *) &a, SCHED_PRIORITIES - 1));
+	TEST_ASSERT(!SCHED_runNext());
+
+	SCHED_post(&task, 0);																						// Nothing posted
+	TEST_ASSERT(!SCHED_runNext());
+	TEST_ASSERT_EQUAL(0, SCHED_getRunCount());
+}
+
+static void test_priorities(void)
+{
+	static const char names[] = "abcd";
+	SCHED_Task tasks[4];
+
+	trace_count = 0;
+	SCHED_init();
+	SCHED_initTask(&tasks[0], record, (void *) &names[0], 3);
+	SCHED_initTask(&tasks[1], record, (void *) &names[1], 1);
+	SCHED_initTask(&tasks[2], record, (void *) &names[2], 1);
+	SCHED_initTask(&tasks[3], record, (void *) &names[3], 0);
+
+	// Most urgent first, in order of readiness within a priority, flags merged
+	SCHED_post(&tasks[0], 0x1);
+	SCHED_post(&tasks[2], 0x1);
+	SCHED_post(&tasks[1], 0x2);
+	SCHED_post(&tasks[0], 0x4);
+	SCHED_post(&tasks[3], 0x8);
+	run_all();
+	TEST_ASSERT(strcmp(trace, "dcba") == 0);
+	TEST_ASSERT_EQUAL(0x8, trace_events[0]);
+	TEST_ASSERT_EQUAL(0x5, trace_events[3]);
+	TEST_ASSERT_EQUAL(4, SCHED_getRunCount());
+}
+
+static SCHED_Task self, other;
+
+static void repost(uint32_t events, void * context)
+{
+	record(events, context);
+	if (events & 0x1)
+	{
+		SCHED_post(&other, 0x1);
+		SCHED_post(&self, 0x2);																				// Runs again, after other
+	}
+}
+
+static void test_post_while_running(void)
+{
+	static const char s = 's', o = 'o';
+
+	trace_count = 0;
+	SCHED_init();
+	SCHED_initTask(&self, repost, (void *) &s, 2);
+	SCHED_initTask(&other, record, (void *) &o, 2);
+	SCHED_post(&self, 0x1);
+	run_all();
+	TEST_ASSERT(strcmp(trace, "sos") == 0);
+	TEST_ASSERT_EQUAL(0x2, trace_events[2]);
+}
+
+static uint64_t edge_time, run_time;
+
+static void on_edge(uint32_t events, void * context)
+{
+	(void) context;
+	run_time = HOST_getCycles();
+	trace_events[trace_count++] = events;
+}
+
+static void on_line_signal(u8 line, void * context)
+{
+	(void) line;
+	SCHED_signal(context);
+}
+
+static void raise_edge(void * context)
+{
+	(void) context;
+	edge_time = HOST_getCycles();
+	HOST_GPIO_setInput(GPIOA, 3, true);
+	HOST_GPIO_setInput(GPIOA, 3, false);
+}
+
+static void test_interrupt_wakeup(void)
+{
+	SCHED_Task task;
+	SCHED_Event event = { &task, 0x10 };
+	uint64_t cpu;
+
+	trace_count = 0;
+	SCHED_init();
+	SCHED_initTask(&task, on_edge, NULL, 0);
+	SYSCFG_CLK_ENABLE();
+	TEST_ASSERT(EXTI_attach(3, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line_signal, &event));
+
+	// Asleep until the edge, then the task runs: the CPU only counts the interrupt
+	cpu = HOST_getCpuCycles();
+	TEST_ASSERT(HOST_schedule(10000, raise_edge, NULL));
+	SCHED_runOnce();
+	TEST_ASSERT_EQUAL(1, SCHED_getIdleCount());
+	TEST_ASSERT(HOST_getCycles() >= edge_time && edge_time >= 10000);
+	TEST_ASSERT(SCHED_runNext());
+	TEST_ASSERT_EQUAL(1, trace_count);
+	TEST_ASSERT_EQUAL(0x10, trace_events[0]);
+	TEST_ASSERT(run_time - edge_time < 100);
+	TEST_ASSERT(HOST_getCpuCycles() - cpu < 200);
+	EXTI_detach(3);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_priorities);
+	TEST_RUN(test_post_while_running);
+	TEST_RUN(test_interrupt_wakeup);
+	return TEST_END();
+}
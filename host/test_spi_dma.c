@@ -0,0 +1,207 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_spi_dma.c
+ * Purpose: SPI DMA transfer engine host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "host_test.h"
+#include "spi.h"
+#include "rcc.h"
+
+/*----------------------------------------------------------------------------
+  Slave: records MOSI, answers the complement of the previous byte
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	uint8_t mosi[64];
+	uint32_t count;
+	uint8_t last;
+} Slave;
+
+static uint8_t slave_exchange(void * ctx, uint8_t mosi)
+{
+	Slave * slave = (Slave *) ctx;
+	uint8_t miso = (uint8_t) ~slave->last;
+
+	if (slave->count < sizeof(slave->mosi))
+		slave->mosi[slave->count] = mosi;
+	slave->count++;
+	slave->last = mosi;
+	return miso;
+}
+
+static Slave slave;
+static int callbacks;
+static void * callback_context;
+
+static void on_done(void * context)
+{
+	callbacks++;
+	callback_context = context;
+}
+
+static void setup(void)
+{
+	HOST_SPISlave desc = { NULL, slave_exchange, NULL, &slave, NULL, 0 };
+
+	memset(&slave, 0, sizeof(slave));
+	callbacks = 0;
+	callback_context = NULL;
+	HOST_SPI_attachSlave(SPI1, &desc);
+
+	SPI1_CLK_ENABLE();
+	DMA2_CLK_ENABLE();
+	SPI_initBaudRate(SPI1, SPI_BaudRatePrescaler_2);
+	SPI_initDataFrameFormat8b(SPI1);
+	SPI_initSoftwareSlaveMgmtEnabled(SPI1);
+	SPI_initSetInternalSlaveSelectHigh(SPI1);
+	SPI_initMasterConfiguration(SPI1);
+	SPI_enable(SPI1);
+	SPI_initDMA(SPI1);
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_transfer_full_duplex(void)
+{
+	const uint8_t tx[7] = { 0xE8, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+	uint8_t rx[7] = { 0 };
+	uint8_t i;
+
+	setup();
+	TEST_ASSERT(SPI_transferDMA(SPI1, tx, rx, sizeof(tx), on_done, &slave));
+	TEST_ASSERT(SPI_isDMABusy(SPI1));
+	TEST_ASSERT_EQUAL(0, callbacks);
+
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+
+	TEST_ASSERT_EQUAL(1, callbacks);
+	TEST_ASSERT(callback_context == &slave);
+	TEST_ASSERT_EQUAL(sizeof(tx), slave.count);
+	TEST_ASSERT(memcmp(slave.mosi, tx, sizeof(tx)) == 0);
+	TEST_ASSERT_EQUAL(0xFF, rx[0]);
+	for (i = 1; i < sizeof(tx); i++)
+		TEST_ASSERT_EQUAL((uint8_t) ~tx[i - 1], rx[i]);
+	TEST_ASSERT_EQUAL(0, SPI1->CR2 & (SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN));
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_transfer_without_buffers(void)
+{
+	uint8_t rx[4] = { 0xAA, 0xAA, 0xAA, 0xAA };
+
+	setup();
+	TEST_ASSERT(SPI_transferDMA(SPI1, NULL, rx, sizeof(rx), on_done, NULL));
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(4, slave.count);
+	TEST_ASSERT_EQUAL(0x00, slave.mosi[0]);
+	TEST_ASSERT_EQUAL(0x00, slave.mosi[3]);
+	TEST_ASSERT_EQUAL(0xFF, rx[1]);
+
+	TEST_ASSERT(SPI_transferDMA(SPI1, rx, NULL, sizeof(rx), on_done, NULL));
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(8, slave.count);
+	TEST_ASSERT_EQUAL(2, callbacks);
+}
+
+static void test_rejects_while_busy(void)
+{
+	uint8_t buffer[16] = { 0 };
+
+	setup();
+	TEST_ASSERT(!SPI_transferDMA(SPI1, buffer, buffer, 0, on_done, NULL));
+	TEST_ASSERT(SPI_transferDMA(SPI1, buffer, buffer, sizeof(buffer), on_done, NULL));
+	TEST_ASSERT(!SPI_transferDMA(SPI1, buffer, buffer, sizeof(buffer), on_done, NULL));
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(1, callbacks);
+	TEST_ASSERT(SPI_transferDMA(SPI1, buffer, buffer, sizeof(buffer), on_done, NULL));
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(2, callbacks);
+}
+
+static void chained(void * context)
+{
+	static uint8_t tx[2] = { 0x01, 0x02 };
+	int * remaining = (int *) context;
+
+	if (--(*remaining) > 0)
+		SPI_transferDMA(SPI1, tx, NULL, sizeof(tx), chained, context);
+}
+
+static void test_restart_from_callback(void)
+{
+	uint8_t tx[2] = { 0x01, 0x02 };
+	int remaining = 5;
+
+	setup();
+	TEST_ASSERT(SPI_transferDMA(SPI1, tx, NULL, sizeof(tx), chained, &remaining));
+	while (remaining > 0)
+		__WFI();
+	TEST_ASSERT_EQUAL(10, slave.count);
+	TEST_ASSERT(!SPI_isDMABusy(SPI1));
+}
+
+static void test_no_overrun(void)
+{
+	uint8_t buffer[256];
+	HOST_SPIStats stats;
+
+	setup();
+	memset(buffer, 0x5A, sizeof(buffer));
+	TEST_ASSERT(SPI_transferDMA(SPI1, buffer, buffer, sizeof(buffer), NULL, NULL));
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+	HOST_SPI_getStats(SPI1, &stats);
+	TEST_ASSERT_EQUAL(256, stats.frames);
+	TEST_ASSERT_EQUAL(0, stats.overruns);
+	TEST_ASSERT_EQUAL(0, stats.gap_cycles);
+}
+
+static void test_other_spi_unsupported(void)
+{
+	uint8_t buffer[2];
+
+	setup();
+	TEST_ASSERT(!SPI_transferDMA((SPI_TypeDef *) &slave, buffer, buffer, sizeof(buffer), NULL, NULL));
+	TEST_ASSERT(!SPI_isDMABusy((SPI_TypeDef *) &slave));
+}
+
+static void test_rejects_ccm_buffers(void)
+{
+	uint8_t buffer[2];
+	uint8_t * ccm = (uint8_t *) (uintptr_t) (CCMDATARAM_BASE + 0x100);					// Never dereferenced
+
+	setup();
+	TEST_ASSERT(!SPI_transferDMA(SPI1, ccm, buffer, sizeof(buffer), NULL, NULL));
+	TEST_ASSERT(!SPI_transferDMA(SPI1, buffer, ccm, sizeof(buffer), NULL, NULL));
+	TEST_ASSERT(!SPI_isDMABusy(SPI1));
+	TEST_ASSERT_EQUAL(0, DMA2_Stream0->CR & DMA_SxCR_EN);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_transfer_full_duplex);
+	TEST_RUN(test_transfer_without_buffers);
+	TEST_RUN(test_rejects_while_busy);
+	TEST_RUN(test_restart_from_callback);
+	TEST_RUN(test_no_overrun);
+	TEST_RUN(test_other_spi_unsupported);
+	TEST_RUN(test_rejects_ccm_buffers);
+	return TEST_END();
+}
@@ -0,0 +1,339 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_spi_queue.c
+ * Purpose: SPI interrupt-driven transaction queue host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "host_test.h"
+#include "spi.h"
+#include "gpio.h"
+#include "rcc.h"
+#include "interrupt.h"
+
+#define CS_PORT		GPIOE
+#define CS_PIN		3
+
+/*----------------------------------------------------------------------------
+  Slave: records MOSI per chip select window, answers 0xA0 + index
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	uint8_t mosi[8][16];
+	uint8_t length[8];
+	uint32_t selects;
+	uint32_t deselects;
+	bool selected;
+} Slave;
+
+static Slave slave;
+
+static void slave_select(void * ctx)
+{
+	Slave * s = (Slave *) ctx;
+	s->selected = true;
+	s->selects++;
+}
+
+static void slave_deselect(void * ctx)
+{
+	Slave * s = (Slave *) ctx;
+	s->selected = false;
+	s->deselects++;
+}
+
+static uint8_t slave_exchange(void * ctx, uint8_t mosi)
+{
+	Slave * s = (Slave *) ctx;
+	uint32_t window = s->selects - 1;
+	uint8_t index = s->length[window % 8];
+
+	s->mosi[window % 8][index % 16] = mosi;
+	s->length[window % 8]++;
+	return (uint8_t) (0xA0 + index);
+}
+
+static int order[8];
+static int done;
+
+static void on_done(void * context)
+{
+	order[done++] = (int) (intptr_t) context;
+}
+
+/* Slow enough for the interrupt of one frame to end before the next frame */
+static void setup(void)
+{
+	HOST_SPISlave desc = { slave_select, slave_exchange, slave_deselect, &slave, CS_PORT, CS_PIN };
+
+	memset(&slave, 0, sizeof(slave));
+	memset(order, 0, sizeof(order));
+	done = 0;
+
+	GPIOE_CLK_ENABLE();
+	GPIO_initOutput(CS_PORT, CS_PIN);
+	GPIO_setPin(CS_PORT, CS_PIN);
+	HOST_SPI_attachSlave(SPI1, &desc);
+
+	SPI1_CLK_ENABLE();
+	DMA2_CLK_ENABLE();
+	SPI_initBaudRate(SPI1, SPI_BaudRatePrescaler_32);
+	SPI_initSoftwareSlaveMgmtEnabled(SPI1);
+	SPI_initSetInternalSlaveSelectHigh(SPI1);
+	SPI_initMasterConfiguration(SPI1);
+	SPI_enable(SPI1);
+	SPI_initDMA(SPI1);
+	SPI_initQueue(SPI1);
+}
+
+static SPI_Transaction transaction(const uint8_t * tx, uint8_t * rx, uint16_t length, int id)
+{
+	SPI_Transaction t = { CS_PORT, CS_PIN, tx, rx, length, on_done, (void *) (intptr_t) id };
+	return t;
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_single_transaction(void)
+{
+	const uint8_t tx[3] = { 0x8F, 0x00, 0x00 };
+	uint8_t rx[3] = { 0 };
+	SPI_Transaction t = transaction(tx, rx, sizeof(tx), 1);
+	uint32_t loops = 0;
+
+	setup();
+	TEST_ASSERT(SPI_submit(SPI1, &t));
+	TEST_ASSERT(SPI_isQueueBusy(SPI1));
+	TEST_ASSERT(slave.selected);
+
+	while (SPI_isQueueBusy(SPI1))
+	{
+		loops++;
+		HOST_advance(8);
+	}
+
+	TEST_ASSERT(loops > 1);
+	TEST_ASSERT(!slave.selected);
+	TEST_ASSERT_EQUAL(1, slave.selects);
+	TEST_ASSERT_EQUAL(3, slave.length[0]);
+	TEST_ASSERT(memcmp(slave.mosi[0], tx, sizeof(tx)) == 0);
+	TEST_ASSERT_EQUAL(0xA0, rx[0]);
+	TEST_ASSERT_EQUAL(0xA2, rx[2]);
+	TEST_ASSERT_EQUAL(1, done);
+	TEST_ASSERT_EQUAL(0, SPI1->CR2 & (SPI_CR2_TXEIE | SPI_CR2_RXNEIE));
+}
+
+static void test_back_to_back(void)
+{
+	const uint8_t tx[3][4] = { { 1, 2, 3, 4 }, { 5, 6 }, { 7, 8, 9 } };
+	uint8_t rx[3][4];
+	SPI_Transaction t0 = transaction(tx[0], rx[0], 4, 10);
+	SPI_Transaction t1 = transaction(tx[1], rx[1], 2, 11);
+	SPI_Transaction t2 = transaction(tx[2], NULL, 3, 12);
+	HOST_SPIStats stats;
+
+	setup();
+	TEST_ASSERT(SPI_submit(SPI1, &t0));
+	TEST_ASSERT(SPI_submit(SPI1, &t1));
+	TEST_ASSERT(SPI_submit(SPI1, &t2));
+	while (SPI_isQueueBusy(SPI1))
+		__WFI();
+
+	TEST_ASSERT_EQUAL(3, done);
+	TEST_ASSERT_EQUAL(10, order[0]);
+	TEST_ASSERT_EQUAL(11, order[1]);
+	TEST_ASSERT_EQUAL(12, order[2]);
+	TEST_ASSERT_EQUAL(3, slave.selects);
+	TEST_ASSERT_EQUAL(3, slave.deselects);
+	TEST_ASSERT_EQUAL(4, slave.length[0]);
+	TEST_ASSERT_EQUAL(2, slave.length[1]);
+	TEST_ASSERT_EQUAL(3, slave.length[2]);
+	TEST_ASSERT(memcmp(slave.mosi[2], tx[2], 3) == 0);
+	TEST_ASSERT_EQUAL(0xA3, rx[0][3]);
+	TEST_ASSERT_EQUAL(0xA1, rx[1][1]);
+
+	HOST_SPI_getStats(SPI1, &stats);
+	TEST_ASSERT_EQUAL(9, stats.frames);
+	TEST_ASSERT_EQUAL(0, stats.overruns);
+}
+
+static void test_queue_full(void)
+{
+	uint8_t tx[2] = { 0 };
+	SPI_Transaction t = transaction(tx, NULL, sizeof(tx), 0);
+	int i;
+
+	setup();
+	for (i = 0; i < SPI_QUEUE_SIZE; i++)
+		TEST_ASSERT(SPI_submit(SPI1, &t));
+	TEST_ASSERT(!SPI_submit(SPI1, &t));
+	while (SPI_isQueueBusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(SPI_QUEUE_SIZE, done);
+	TEST_ASSERT(SPI_submit(SPI1, &t));
+	t.length = 0;
+	TEST_ASSERT(!SPI_submit(SPI1, &t));
+}
+
+static int resubmits;
+
+static void resubmit(void * context)
+{
+	static const uint8_t tx[1] = { 0x42 };
+	SPI_Transaction t = { CS_PORT, CS_PIN, tx, NULL, 1, resubmit, context };
+
+	done++;
+	if (--resubmits > 0)
+		SPI_submit(SPI1, &t);
+}
+
+static void test_submit_from_callback(void)
+{
+	static const uint8_t tx[1] = { 0x42 };
+	SPI_Transaction t = { CS_PORT, CS_PIN, tx, NULL, 1, resubmit, NULL };
+
+	setup();
+	resubmits = 4;
+	TEST_ASSERT(SPI_submit(SPI1, &t));
+	while (SPI_isQueueBusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(4, done);
+	TEST_ASSERT_EQUAL(4, slave.selects);
+}
+
+static void test_exclusive_with_dma(void)
+{
+	uint8_t tx[4] = { 0 };
+	SPI_Transaction t = transaction(tx, NULL, sizeof(tx), 0);
+
+	setup();
+	TEST_ASSERT(SPI_submit(SPI1, &t));
+	TEST_ASSERT(!SPI_transferDMA(SPI1, tx, NULL, sizeof(tx), NULL, NULL));
+	while (SPI_isQueueBusy(SPI1))
+		__WFI();
+	TEST_ASSERT(SPI_transferDMA(SPI1, tx, NULL, sizeof(tx), NULL, NULL));
+	TEST_ASSERT(!SPI_submit(SPI1, &t));
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static uint32_t edges;
+static bool submitted;
+
+static void submit_on_edge(u8 line, void * context)
+{
+	(void) line;
+	edges++;
+	submitted = SPI_submit(SPI1, (const SPI_Transaction *) context);
+}
+
+static void raise_edge(void * ctx)
+{
+	(void) ctx;
+	HOST_GPIO_setInput(GPIOA, 1, true);
+}
+
+/* Edge raised at the first access of SPI_transferDMA: the submit of its
+   handler finds the bus taken, no queued transaction drives SPI1 and CS */
+static void test_submit_during_dma(void)
+{
+	uint8_t tx[4] = { 0 };
+	SPI_Transaction t = transaction(tx, NULL, sizeof(tx), 1);
+
+	setup();
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, submit_on_edge, &t);
+	edges = 0;
+	submitted = true;
+	HOST_schedule(1, raise_edge, NULL);
+	TEST_ASSERT(SPI_transferDMA(SPI1, tx, NULL, sizeof(tx), NULL, NULL));
+	TEST_ASSERT_EQUAL(1, edges);
+	TEST_ASSERT(!submitted);
+	TEST_ASSERT(!SPI_isQueueBusy(SPI1));
+	while (SPI_isDMABusy(SPI1))
+		__WFI();
+	EXTI_detach(1);
+	TEST_ASSERT_EQUAL(0, slave.selects);
+	TEST_ASSERT_EQUAL(0, done);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+/* Handler more urgent than SPI1 and longer than several frames */
+static void on_long_edge(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	HOST_busy(8000);
+}
+
+static void test_overrun(void)
+{
+	uint8_t tx[8] = { 0 }, rx[8];
+	volatile SPI_Status status[2] = { SPI_DONE, SPI_DONE };
+	SPI_Transaction first = transaction(tx, rx, sizeof(tx), 1);
+	SPI_Transaction second = transaction(tx, NULL, sizeof(tx), 2);
+
+	setup();
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_long_edge, NULL);
+	IRQ_setPriority(EXTI1_IRQn, IRQ_LEVEL_URGENT, 0);
+	first.status = &status[0];
+	second.status = &status[1];
+	TEST_ASSERT(SPI_submit(SPI1, &first));
+	TEST_ASSERT(SPI_submit(SPI1, &second));
+	HOST_schedule(3000, raise_edge, NULL);													// Third frame of the first transaction
+	while (SPI_isQueueBusy(SPI1))
+		__WFI();
+	EXTI_detach(1);
+
+	// First one dropped with CS raised, second one complete
+	TEST_ASSERT_EQUAL(SPI_OVERRUN, status[0]);
+	TEST_ASSERT_EQUAL(SPI_DONE, status[1]);
+	TEST_ASSERT_EQUAL(2, done);
+	TEST_ASSERT_EQUAL(1, order[0]);
+	TEST_ASSERT_EQUAL(2, order[1]);
+	TEST_ASSERT_EQUAL(2, slave.deselects);
+	TEST_ASSERT_EQUAL(8, slave.length[1]);
+	TEST_ASSERT(GPIO_readPin(CS_PORT, CS_PIN) == GPIO_PIN_HIGH);
+	TEST_ASSERT_EQUAL(0, SPI1->CR2 & (SPI_CR2_TXEIE | SPI_CR2_RXNEIE | SPI_CR2_ERRIE));
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_without_chip_select(void)
+{
+	uint8_t tx[2] = { 0x12, 0x34 };
+	SPI_Transaction t = transaction(tx, NULL, sizeof(tx), 5);
+
+	setup();
+	t.cs_port = NULL;
+	TEST_ASSERT(SPI_submit(SPI1, &t));
+	while (SPI_isQueueBusy(SPI1))
+		__WFI();
+	TEST_ASSERT_EQUAL(1, done);
+	TEST_ASSERT_EQUAL(0, slave.selects);
+	TEST_ASSERT(GPIO_readPin(CS_PORT, CS_PIN) == GPIO_PIN_HIGH);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_single_transaction);
+	TEST_RUN(test_back_to_back);
+	TEST_RUN(test_queue_full);
+	TEST_RUN(test_submit_from_callback);
+	TEST_RUN(test_exclusive_with_dma);
+	TEST_RUN(test_submit_during_dma);
+	TEST_RUN(test_overrun);
+	TEST_RUN(test_without_chip_select);
+	return TEST_END();
+}
@@ -0,0 +1,182 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_spi_transfer.c
+ * Purpose: SPI pipelined polled buffer transfer host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+#include "host_test.h"
+#include "spi.h"
+#include "rcc.h"
+#include "interrupt.h"
+
+/*----------------------------------------------------------------------------
+  Slave: records MOSI, answers the complement of the previous byte
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	uint8_t mosi[512];
+	uint32_t count;
+	uint8_t last;
+} Slave;
+
+static uint8_t slave_exchange(void * ctx, uint8_t mosi)
+{
+	Slave * slave = (Slave *) ctx;
+	uint8_t miso = (uint8_t) ~slave->last;
+
+	if (slave->count < sizeof(slave->mosi))
+		slave->mosi[slave->count] = mosi;
+	slave->count++;
+	slave->last = mosi;
+	return miso;
+}
+
+static Slave slave;
+
+static void setup(uint16_t prescaler)
+{
+	HOST_SPISlave desc = { NULL, slave_exchange, NULL, &slave, NULL, 0 };
+
+	memset(&slave, 0, sizeof(slave));
+	HOST_SPI_attachSlave(SPI1, &desc);
+
+	SPI1_CLK_ENABLE();
+	SPI_initBaudRate(SPI1, prescaler);
+	SPI_initDataFrameFormat8b(SPI1);
+	SPI_initSoftwareSlaveMgmtEnabled(SPI1);
+	SPI_initSetInternalSlaveSelectHigh(SPI1);
+	SPI_initMasterConfiguration(SPI1);
+	SPI_enable(SPI1);
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_full_duplex(void)
+{
+	const uint8_t tx[7] = { 0xE8, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+	uint8_t rx[7] = { 0 };
+	uint8_t i;
+
+	setup(SPI_BaudRatePrescaler_2);
+	SPI_transferBuffer(SPI1, tx, rx, sizeof(tx));
+
+	TEST_ASSERT_EQUAL(sizeof(tx), slave.count);
+	TEST_ASSERT(memcmp(slave.mosi, tx, sizeof(tx)) == 0);
+	TEST_ASSERT_EQUAL(0xFF, rx[0]);
+	for (i = 1; i < sizeof(tx); i++)
+		TEST_ASSERT_EQUAL((uint8_t) ~tx[i - 1], rx[i]);
+	TEST_ASSERT(!SPI_hasDataToReceive(SPI1));
+	TEST_ASSERT(!SPI_isBusy(SPI1));
+}
+
+static void test_without_buffers(void)
+{
+	uint8_t buffer[4] = { 0xAA, 0xAA, 0xAA, 0xAA };
+
+	setup(SPI_BaudRatePrescaler_2);
+	SPI_transferBuffer(SPI1, NULL, buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL(4, slave.count);
+	TEST_ASSERT_EQUAL(0x00, slave.mosi[0]);
+	TEST_ASSERT_EQUAL(0x00, slave.mosi[3]);
+	TEST_ASSERT_EQUAL(0xFF, buffer[1]);
+
+	SPI_transferBuffer(SPI1, buffer, NULL, sizeof(buffer));
+	TEST_ASSERT_EQUAL(8, slave.count);
+	TEST_ASSERT_EQUAL(0xFF, slave.mosi[5]);
+	TEST_ASSERT(!SPI_hasDataToReceive(SPI1));
+
+	SPI_transferBuffer(SPI1, buffer, buffer, 0);
+	TEST_ASSERT_EQUAL(8, slave.count);
+}
+
+static void test_drops_stale_byte(void)
+{
+	const uint8_t tx[2] = { 0x0F, 0xF0 };
+	uint8_t rx[2] = { 0 };
+
+	setup(SPI_BaudRatePrescaler_2);
+	SPI_writeData(SPI1, 0x55);
+	while (!SPI_hasDataToReceive(SPI1))
+		HOST_advance(1);
+	SPI_transferBuffer(SPI1, tx, rx, sizeof(rx));
+	TEST_ASSERT_EQUAL((uint8_t) ~0x55, rx[0]);
+	TEST_ASSERT_EQUAL((uint8_t) ~0x0F, rx[1]);
+}
+
+static void test_back_to_back(void)
+{
+	static const uint16_t prescalers[3] = { SPI_BaudRatePrescaler_2, SPI_BaudRatePrescaler_8, SPI_BaudRatePrescaler_256 };
+	uint8_t buffer[256];
+	HOST_SPIStats stats;
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		HOST_reset();
+		setup(prescalers[i]);
+		memset(buffer, 0x5A, sizeof(buffer));
+		SPI_transferBuffer(SPI1, buffer, buffer, sizeof(buffer));
+		HOST_SPI_getStats(SPI1, &stats);
+		TEST_ASSERT_EQUAL(256, stats.frames);
+		TEST_ASSERT_EQUAL(0, stats.overruns);
+		TEST_ASSERT_EQUAL(0, stats.gap_cycles);
+		TEST_ASSERT_EQUAL(0xA5, buffer[255]);
+	}
+}
+
+/* Interrupt lasting several frames */
+static void on_long_edge(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	HOST_busy(1000);
+}
+
+static void raise_edge(void * context)
+{
+	(void) context;
+	HOST_GPIO_setInput(GPIOA, 1, true);
+}
+
+static void test_overrun(void)
+{
+	uint8_t tx[64], rx[64];
+	HOST_SPIStats stats;
+
+	setup(SPI_BaudRatePrescaler_8);
+	memset(tx, 0x5A, sizeof(tx));
+	SYSCFG_CLK_ENABLE();
+	EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_long_edge, NULL);
+	HOST_schedule(2000, raise_edge, NULL);
+	TEST_ASSERT(!SPI_transferBuffer(SPI1, tx, rx, sizeof(rx)));					// Returns instead of waiting for the lost frame
+	HOST_SPI_getStats(SPI1, &stats);
+	TEST_ASSERT(stats.overruns > 0);
+	TEST_ASSERT_EQUAL(0, SPI1->SR & (SPI_SR_OVR | SPI_SR_RXNE | SPI_SR_BSY));
+	EXTI_detach(1);
+
+	// Next transfer complete
+	memset(rx, 0, sizeof(rx));
+	TEST_ASSERT(SPI_transferBuffer(SPI1, tx, rx, sizeof(rx)));
+	TEST_ASSERT_EQUAL((uint8_t) ~0x5A, rx[63]);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_full_duplex);
+	TEST_RUN(test_without_buffers);
+	TEST_RUN(test_drops_stale_byte);
+	TEST_RUN(test_back_to_back);
+	TEST_RUN(test_overrun);
+	return TEST_END();
+}
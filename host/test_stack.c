@@ -0,0 +1,113 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_stack.c
+ * Purpose: Stack usage instrumentation host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	Built with STACK_GUARD_ENABLED. The main stack is the one of the model
+ * (STACK_MAIN_BASE of the host stm32f4xx.h): the tests move MSP and write
+ * the words a call would push.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "stack.h"
+
+#define GUARD_WORDS			(STACK_GUARD_SIZE / 4)
+
+static uint32_t * main_top(void)
+{
+	return STACK_MAIN_TOP;
+}
+
+/* Call chain of words bytes pushed below MSP, MSP left at its bottom */
+static void push(uint32_t words)
+{
+	uint32_t * sp = (uint32_t *) __get_MSP();
+
+	while (words-- > 0)
+		*--sp = (uint32_t) words;
+	__set_MSP((uintptr_t) sp);
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_paint_peak(void)
+{
+	uint32_t stack[64];
+
+	STACK_paint(stack, 64);
+	TEST_ASSERT_EQUAL(0, STACK_getPeak(stack, 64));
+	stack[63] = 0;
+	stack[54] = 0;
+	TEST_ASSERT_EQUAL(10 * 4, STACK_getPeak(stack, 64));
+	stack[20] = STACK_PAINT + 1;																// Lowest word written counts
+	TEST_ASSERT_EQUAL(44 * 4, STACK_getPeak(stack, 64));
+	stack[0] = 0;
+	TEST_ASSERT_EQUAL(64 * 4, STACK_getPeak(stack, 64));
+}
+
+static void test_main_stack(void)
+{
+	TEST_ASSERT(__get_MSP() == (uintptr_t) main_top());
+	push(8);																										// Reset_Handler and BOOT_init
+	STACK_initMain();
+	TEST_ASSERT_EQUAL(HOST_MAIN_STACK_WORDS * 4 - STACK_GUARD_SIZE, STACK_getMainSize());
+	TEST_ASSERT_EQUAL(8 * 4, STACK_getMainUsed());
+	TEST_ASSERT_EQUAL(8 * 4, STACK_getMainPeak());
+	TEST_ASSERT_EQUAL(0, STACK_MAIN_BASE[0]);													// Guard not painted
+	TEST_ASSERT_EQUAL(STACK_PAINT, STACK_MAIN_BASE[GUARD_WORDS]);
+
+	push(100);
+	TEST_ASSERT_EQUAL(108 * 4, STACK_getMainUsed());
+	__set_MSP((uintptr_t) (main_top() - 20));											// Calls returned
+	push(4);
+	TEST_ASSERT_EQUAL(24 * 4, STACK_getMainUsed());
+	TEST_ASSERT_EQUAL(108 * 4, STACK_getMainPeak());
+}
+
+static void test_full_main_stack(void)
+{
+	STACK_initMain();
+	push(HOST_MAIN_STACK_WORDS - GUARD_WORDS);
+	TEST_ASSERT_EQUAL(STACK_getMainSize(), STACK_getMainPeak());
+	TEST_ASSERT(__get_MSP() == (uintptr_t) (STACK_MAIN_BASE + GUARD_WORDS));			// Next push in the guard
+}
+
+static void test_guard(void)
+{
+	STACK_initMain();
+	TEST_ASSERT_EQUAL(STACK_GUARD_REGION, MPU->RNR);
+	TEST_ASSERT(MPU->RBAR == (uintptr_t) STACK_MAIN_BASE);
+	TEST_ASSERT_EQUAL(MPU_RASR_XN_Msk | (4 << MPU_RASR_SIZE_Pos) | MPU_RASR_ENABLE_Msk, MPU->RASR);	// AP 0, no access
+	TEST_ASSERT_EQUAL(MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk, MPU->CTRL);
+	TEST_ASSERT(SCB->SHCSR & SCB_SHCSR_MEMFAULTENA_Msk);
+}
+
+static void test_guard_arguments(void)
+{
+	static uint32_t stack[64] __attribute__((aligned(STACK_GUARD_SIZE)));
+
+	TEST_ASSERT(!STACK_setGuard(8, stack));
+	TEST_ASSERT(!STACK_setGuard(0, stack + 1));
+	TEST_ASSERT_EQUAL(0, MPU->CTRL);
+	TEST_ASSERT(STACK_setGuard(0, stack));
+	TEST_ASSERT_EQUAL(0, MPU->RNR);
+	TEST_ASSERT(MPU->RBAR == (uintptr_t) stack);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_paint_peak);
+	TEST_RUN(test_main_stack);
+	TEST_RUN(test_full_main_stack);
+	TEST_RUN(test_guard);
+	TEST_RUN(test_guard_arguments);
+	return TEST_END();
+}
@@ -0,0 +1,272 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_timer.c
+ * Purpose: TIMER driver host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "timer.h"
+
+#include <stdlib.h>
+
+#define TIM_CLK_84MHZ		84000000
+
+/* Constant expressions, usable in array sizes */
+static const char compile_time_psc[TIM_PSC_FOR(TIM_TICKS_NS(TIM_CLK_84MHZ, 500000000), TIM_ARR_MAX_16) + 1] = { 0 };
+static const char compile_time_arr[TIM_ARR_FOR(TIM_TICKS_NS(TIM_CLK_84MHZ, 22676), TIM_ARR_MAX_16) + 1] = { 0 };
+
+static uint64_t distance(uint64_t a, uint64_t b)
+{
+	return (a > b) ? a - b : b - a;
+}
+
+/* Every prescaler tried, smallest one kept on equal error */
+static void reference_solve(uint64_t ticks, uint64_t arr_count, uint64_t * best_psc_count, uint64_t * best_error)
+{
+	uint64_t psc_count, count;
+
+	*best_error = ~(uint64_t) 0;
+	for (psc_count = 1; psc_count <= TIM_PSC_MAX + 1; psc_count++)
+	{
+		count = (ticks + psc_count / 2) / psc_count;
+		if (count < 1)
+			count = 1;
+		if (count > arr_count)
+			count = arr_count;
+		if (distance(psc_count * count, ticks) < *best_error)
+		{
+			*best_error = distance(psc_count * count, ticks);
+			*best_psc_count = psc_count;
+		}
+	}
+}
+
+static uint64_t random_ticks(uint64_t max)
+{
+	uint64_t r = ((uint64_t) rand() << 31) ^ ((uint64_t) rand() << 16) ^ (uint64_t) rand();
+
+	return 1 + r % max;
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_clock(void)
+{
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV1;
+	TEST_ASSERT_EQUAL(168000000, TIM_getClock(TIM3));
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV2;
+	TEST_ASSERT_EQUAL(168000000, TIM_getClock(TIM3));
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV4;
+	TEST_ASSERT_EQUAL(84000000, TIM_getClock(TIM3));
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV16;
+	TEST_ASSERT_EQUAL(21000000, TIM_getClock(TIM3));
+	TEST_ASSERT_EQUAL(TIM_ARR_MAX_32, TIM_getARRMax(TIM2));
+	TEST_ASSERT_EQUAL(TIM_ARR_MAX_32, TIM_getARRMax(TIM5));
+	TEST_ASSERT_EQUAL(TIM_ARR_MAX_16, TIM_getARRMax(TIM3));
+}
+
+static void test_solver_all_ticks(void)
+{
+	TIM_PeriodConfig config;
+	uint64_t ticks, psc_count, macro_error, error;
+	uint32_t failures = 0;
+
+	for (ticks = 1; ticks <= 3 * (TIM_ARR_MAX_16 + 1); ticks++)
+	{
+		if (!TIM_solvePeriod(ticks, TIM_ARR_MAX_16, &config))
+			failures++;
+		psc_count = config.psc + 1;
+		error = distance(config.ticks, ticks);
+		macro_error = distance((TIM_PSC_FOR(ticks, TIM_ARR_MAX_16) + 1) * (TIM_ARR_FOR(ticks, TIM_ARR_MAX_16) + 1), ticks);
+		if (config.ticks != psc_count * ((uint64_t) config.arr + 1)
+			|| config.arr > TIM_ARR_MAX_16
+			|| psc_count < TIM_PSC_FOR(ticks, TIM_ARR_MAX_16) + 1
+			|| 2 * error > psc_count
+			|| error > macro_error
+			|| (ticks <= TIM_ARR_MAX_16 + 1 && error != 0))
+			failures++;
+	}
+	TEST_ASSERT_EQUAL(0, failures);
+}
+
+static void test_solver_optimal_16(void)
+{
+	TIM_PeriodConfig config;
+	uint64_t ticks, psc_count = 0, error;
+	uint32_t i, failures = 0;
+
+	srand(16);
+	for (i = 0; i < 1000; i++)
+	{
+		ticks = (TIM_ARR_MAX_16 + 1) + random_ticks((uint64_t) TIM_ARR_MAX_16 * (TIM_PSC_MAX + 1));
+		TEST_ASSERT(TIM_solvePeriod(ticks, TIM_ARR_MAX_16, &config));
+		reference_solve(ticks, TIM_ARR_MAX_16 + 1, &psc_count, &error);
+		if (distance(config.ticks, ticks) != error || (uint64_t) config.psc + 1 != psc_count)
+			failures++;
+	}
+	TEST_ASSERT_EQUAL(0, failures);
+}
+
+static void test_solver_optimal_32(void)
+{
+	TIM_PeriodConfig config;
+	uint64_t ticks, psc_count = 0, error;
+	uint32_t i, failures = 0;
+
+	srand(32);
+	for (i = 0; i < 300; i++)
+	{
+		ticks = random_ticks((uint64_t) (TIM_PSC_MAX + 1) << 32);
+		TEST_ASSERT(TIM_solvePeriod(ticks, TIM_ARR_MAX_32, &config));
+		reference_solve(ticks, (uint64_t) TIM_ARR_MAX_32 + 1, &psc_count, &error);
+		if (distance(config.ticks, ticks) != error || (uint64_t) config.psc + 1 != psc_count)
+			failures++;
+	}
+	TEST_ASSERT_EQUAL(0, failures);
+
+	TEST_ASSERT(TIM_solvePeriod(TIM_ARR_MAX_32, TIM_ARR_MAX_32, &config));
+	TEST_ASSERT_EQUAL(0, config.psc);
+	TEST_ASSERT_EQUAL(TIM_ARR_MAX_32 - 1, config.arr);
+}
+
+static void test_solver_out_of_range(void)
+{
+	TIM_PeriodConfig config;
+
+	TEST_ASSERT(!TIM_solvePeriod(0, TIM_ARR_MAX_16, &config));
+	TEST_ASSERT_EQUAL(0, config.psc);
+	TEST_ASSERT_EQUAL(0, config.arr);
+	TEST_ASSERT(TIM_solvePeriod((uint64_t) 0x10000 * 0x10000, TIM_ARR_MAX_16, &config));
+	TEST_ASSERT(!TIM_solvePeriod((uint64_t) 0x10000 * 0x10000 + 1, TIM_ARR_MAX_16, &config));
+	TEST_ASSERT_EQUAL(TIM_PSC_MAX, config.psc);
+	TEST_ASSERT_EQUAL(TIM_ARR_MAX_16, config.arr);
+}
+
+static void test_compile_time(void)
+{
+	TIM_PeriodConfig config;
+
+	TEST_ASSERT_EQUAL(641, sizeof(compile_time_psc));										// 500ms at 84MHz: PSC 640
+	TEST_ASSERT_EQUAL(1905, sizeof(compile_time_arr));									// 22.676us at 84MHz: ARR 1904
+	TIM_solvePeriod(TIM_TICKS_NS(TIM_CLK_84MHZ, 500000000), TIM_ARR_MAX_16, &config);
+	TEST_ASSERT_EQUAL(671, config.psc);																	// exact pair, the macro one is 750ns off
+	TEST_ASSERT_EQUAL(62499, config.arr);
+}
+
+static void test_set_period(void)
+{
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV4;
+
+	TEST_ASSERT_EQUAL(500000000, TIM_setPeriod(TIM3, 500000));
+	TEST_ASSERT_EQUAL(671, TIM3->PSC);
+	TEST_ASSERT_EQUAL(62499, TIM3->ARR);
+
+	TEST_ASSERT_EQUAL(10000000000ULL, TIM_setPeriod(TIM2, 10000000));				// 32-bit ARR, no prescaler
+	TEST_ASSERT_EQUAL(0, TIM2->PSC);
+	TEST_ASSERT_EQUAL(839999999, TIM2->ARR);
+
+	TEST_ASSERT_EQUAL(22679, TIM_setPeriodNs(TIM3, 22676));									// 44.1kHz, one 11.9ns cycle
+	TEST_ASSERT_EQUAL(0, TIM3->PSC);
+	TEST_ASSERT_EQUAL(1904, TIM3->ARR);
+
+	TEST_ASSERT(TIM_setPeriod(TIM4, 50000000) - 50000000000ULL < 1000);			// Was out of reach with PSC 9999
+}
+
+static void test_pwm(void)
+{
+	TIM_initPWM(TIM4, 1);
+	TIM_initPWM(TIM4, 4);
+	TEST_ASSERT_EQUAL(0x0068, TIM4->CCMR1);												// OC1M = 110 (PWM 1), OC1PE
+	TEST_ASSERT_EQUAL(0x6800, TIM4->CCMR2);
+	TEST_ASSERT_EQUAL(0x1001, TIM4->CCER);
+	TEST_ASSERT(TIM4->CR1 & TIM_CR1_ARPE);
+
+	TIM4->CCMR2 = 0x6873;																						// Channel 3 input capture
+	TIM_initPWM(TIM4, 3);
+	TEST_ASSERT_EQUAL(0x6868, TIM4->CCMR2);
+	TIM_initPWM(TIM4, 0);
+	TIM_initPWM(TIM4, 5);
+	TEST_ASSERT_EQUAL(0x0068, TIM4->CCMR1);												// Out of range: nothing written
+	TEST_ASSERT_EQUAL(0x6868, TIM4->CCMR2);
+	TEST_ASSERT_EQUAL(0x1101, TIM4->CCER);
+
+	// Preloaded: the new duty cycle waits for the update event
+	TIM_setCCR(TIM4, 3, 250);
+	TEST_ASSERT_EQUAL(250, TIM4->CCR3);
+	TEST_ASSERT_EQUAL(0, HOST_TIM_getCompare(TIM4, 3));
+	TIM_resetCNT(TIM4);
+	TEST_ASSERT_EQUAL(250, HOST_TIM_getCompare(TIM4, 3));
+	TIM_setCCR(TIM4, 2, 100);																				// Channel 2 not preloaded
+	TEST_ASSERT_EQUAL(100, HOST_TIM_getCompare(TIM4, 2));
+}
+
+static void test_ccr_stream(void)
+{
+	static const u16 frames[3][TIM_CHANNELS] = { { 1, 2, 3, 4 }, { 5, 6, 7, 8 }, { 9, 10, 11, 12 } };
+	uint32_t reads, writes, reads_after, writes_after;
+	int i;
+
+	for (i = 1; i <= TIM_CHANNELS; i++)
+		TIM_initPWM(TIM4, i);
+	TEST_ASSERT(!TIM_startCCRStream(TIM3, frames[0], 3, false));
+	TEST_ASSERT(!TIM_startCCRStream(TIM4, frames[0], 0, false));
+	TEST_ASSERT(!TIM_startCCRStream(TIM4, frames[0], 0x4000, false));
+	TEST_ASSERT(!TIM_startCCRStream(TIM4, (const u16 *) (uintptr_t) CCMDATARAM_BASE, 3, false));	// Out of reach of the DMA
+	TEST_ASSERT(TIM_startCCRStream(TIM4, frames[0], 3, false));
+	TEST_ASSERT(!TIM_startCCRStream(TIM4, frames[0], 3, false));						// Already running
+	TEST_ASSERT(TIM_isCCRStreamBusy(TIM4));
+	TEST_ASSERT_EQUAL(0x030D, TIM4->DCR);														// 4 transfers from CCR1
+
+	// No CPU access: one DMA burst per update, used from the next one
+	HOST_getAccessCount(NULL, &reads, &writes);
+	HOST_TIM_update(TIM4);
+	HOST_getAccessCount(NULL, &reads_after, &writes_after);
+	TEST_ASSERT_EQUAL(reads, reads_after);
+	TEST_ASSERT_EQUAL(writes, writes_after);
+	TEST_ASSERT_EQUAL(1, TIM4->CCR1);
+	TEST_ASSERT_EQUAL(4, TIM4->CCR4);
+	TEST_ASSERT_EQUAL(0, HOST_TIM_getCompare(TIM4, 1));
+	HOST_TIM_update(TIM4);
+	TEST_ASSERT_EQUAL(1, HOST_TIM_getCompare(TIM4, 1));
+	TEST_ASSERT_EQUAL(8, TIM4->CCR4);
+	HOST_TIM_update(TIM4);
+	HOST_TIM_update(TIM4);
+	TEST_ASSERT(!TIM_isCCRStreamBusy(TIM4));
+	TEST_ASSERT_EQUAL(9, HOST_TIM_getCompare(TIM4, 1));
+	TEST_ASSERT_EQUAL(12, HOST_TIM_getCompare(TIM4, 4));
+
+	// Repeated until stopped
+	TEST_ASSERT(TIM_startCCRStream(TIM4, frames[0], 2, true));
+	for (i = 0; i < 5; i++)
+		HOST_TIM_update(TIM4);
+	TEST_ASSERT_EQUAL(1, TIM4->CCR1);
+	TEST_ASSERT(TIM_isCCRStreamBusy(TIM4));
+	TIM_stopCCRStream(TIM4);
+	TEST_ASSERT(!TIM_isCCRStreamBusy(TIM4));
+	TEST_ASSERT(!(TIM4->DIER & TIM_DIER_UDE));
+	HOST_TIM_update(TIM4);
+	TEST_ASSERT_EQUAL(1, TIM4->CCR1);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_clock);
+	TEST_RUN(test_solver_all_ticks);
+	TEST_RUN(test_solver_optimal_16);
+	TEST_RUN(test_solver_optimal_32);
+	TEST_RUN(test_solver_out_of_range);
+	TEST_RUN(test_compile_time);
+	TEST_RUN(test_set_period);
+	TEST_RUN(test_pwm);
+	TEST_RUN(test_ccr_stream);
+	return TEST_END();
+}
@@ -0,0 +1,295 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_timer_wheel.c
+ * Purpose: Timer wheel service host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *
+ *----------------------------------------------------------------------------*/
+
+#include "host_test.h"
+#include "timer_wheel.h"
+
+#include <stdlib.h>
+
+static WHEEL_Wheel wheel;
+
+/* Expiries recorded by the callbacks */
+typedef struct
+{
+	WHEEL_Timer timer;
+	uint32_t expected;						///< Tick of the next expiry
+	uint32_t period;
+	uint32_t fired;
+	uint32_t errors;
+} Probe;
+
+static void on_probe(void * context)
+{
+	Probe * probe = (Probe *) context;
+
+	// wheel.now is the tick after the one running
+	if (wheel.now - 1 != probe->expected)
+		probe->errors++;
+	probe->fired++;
+	probe->expected += probe->period;
+}
+
+static void start_probe(Probe * probe, uint32_t delay, uint32_t period)
+{
+	probe->expected = wheel.now + delay - 1;
+	probe->period = period;
+	probe->fired = 0;
+	probe->errors = 0;
+	TEST_ASSERT(WHEEL_start(&wheel, &probe->timer, delay, period, on_probe, probe));
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_one_shot_boundaries(void)
+{
+	static const uint32_t delays[] = { 1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 262143, 262144, 262145,
+																		 WHEEL_SPAN - 1, WHEEL_SPAN, WHEEL_SPAN + 1, 3 * WHEEL_SPAN + 7 };
+	static Probe probes[sizeof(delays) / sizeof(delays[0])];
+	uint32_t i, n = sizeof(delays) / sizeof(delays[0]);
+
+	WHEEL_init(&wheel);
+	WHEEL_advance(&wheel, 12345);												// Not aligned on a slot
+	for (i = 0; i < n; i++)
+		start_probe(&probes[i], delays[i], 0);
+	TEST_ASSERT_EQUAL(n, wheel.count);
+	WHEEL_advance(&wheel, 3 * WHEEL_SPAN + 10);
+	for (i = 0; i < n; i++)
+	{
+		TEST_ASSERT_EQUAL(1, probes[i].fired);
+		TEST_ASSERT_EQUAL(0, probes[i].errors);
+		TEST_ASSERT(!WHEEL_isPending(&probes[i].timer));
+	}
+	TEST_ASSERT_EQUAL(0, wheel.count);
+}
+
+static void test_periodic_and_cancel(void)
+{
+	Probe probe;
+	uint32_t i;
+
+	WHEEL_init(&wheel);
+	start_probe(&probe, 5, 7);
+	for (i = 0; i < 5 + 7 * 9; i++)
+		WHEEL_tick(&wheel);
+	TEST_ASSERT_EQUAL(10, probe.fired);
+	TEST_ASSERT_EQUAL(0, probe.errors);
+	WHEEL_cancel(&wheel, &probe.timer);
+	WHEEL_cancel(&wheel, &probe.timer);
+	WHEEL_advance(&wheel, 100);
+	TEST_ASSERT_EQUAL(10, probe.fired);
+	TEST_ASSERT_EQUAL(0, wheel.count);
+}
+
+static void test_restart(void)
+{
+	Probe probe;
+
+	WHEEL_init(&wheel);
+	start_probe(&probe, 100, 0);
+	WHEEL_advance(&wheel, 50);
+	start_probe(&probe, 100, 0);												// Moved to 150
+	TEST_ASSERT_EQUAL(1, wheel.count);
+	WHEEL_advance(&wheel, 99);
+	TEST_ASSERT_EQUAL(0, probe.fired);
+	WHEEL_tick(&wheel);
+	TEST_ASSERT_EQUAL(1, probe.fired);
+	TEST_ASSERT_EQUAL(0, probe.errors);
+}
+
+static WHEEL_Timer victim, killer;
+static uint32_t victim_fired, killer_fired;
+
+static void on_victim(void * context)
+{
+	(void) context;
+	victim_fired++;
+}
+
+static void on_killer(void * context)
+{
+	(void) context;
+	killer_fired++;
+	WHEEL_cancel(&wheel, &victim);
+	if (killer_fired < 3)
+		WHEEL_start(&wheel, &killer, 1, 0, on_killer, NULL);
+}
+
+static void test_callbacks_modify_wheel(void)
+{
+	WHEEL_init(&wheel);
+	victim_fired = 0;
+	killer_fired = 0;
+	WHEEL_start(&wheel, &killer, 10, 0, on_killer, NULL);
+	WHEEL_start(&wheel, &victim, 10, 0, on_victim, NULL);				// Same slot, after the killer
+	WHEEL_advance(&wheel, 10);
+	TEST_ASSERT_EQUAL(1, killer_fired);
+	TEST_ASSERT_EQUAL(0, victim_fired);
+	WHEEL_advance(&wheel, 10);
+	TEST_ASSERT_EQUAL(3, killer_fired);																// Restarted for the next tick twice
+	TEST_ASSERT_EQUAL(0, wheel.count);
+}
+
+static void test_many_timers(void)
+{
+	static Probe probes[5000];
+	uint32_t i, fired = 0, errors = 0, expected = 0;
+	uint32_t delay, period;
+
+	srand(5000);
+	WHEEL_init(&wheel);
+	WHEEL_advance(&wheel, 777);
+	for (i = 0; i < 5000; i++)
+	{
+		delay = 1 + rand() % 100000;
+		period = (i % 4 == 0) ? 1 + rand() % 20000 : 0;
+		start_probe(&probes[i], delay, period);
+		if (delay <= 120000)
+			expected += (period == 0) ? 1 : 1 + (120000 - delay) / period;
+	}
+	for (i = 0; i < 120000; i++)
+		WHEEL_tick(&wheel);
+	for (i = 0; i < 5000; i++)
+	{
+		fired += probes[i].fired;
+		errors += probes[i].errors;
+	}
+	TEST_ASSERT_EQUAL(expected, fired);
+	TEST_ASSERT_EQUAL(0, errors);
+}
+
+static void test_advance_matches_ticks(void)
+{
+	static Probe probes[300];
+	uint32_t i, errors = 0, fired = 0;
+
+	srand(300);
+	WHEEL_init(&wheel);
+	for (i = 0; i < 300; i++)
+		start_probe(&probes[i], 1 + rand() % 3000000, (i % 2) ? rand() % 500000 : 0);
+	WHEEL_advance(&wheel, 1);
+	WHEEL_advance(&wheel, 4000000);
+	for (i = 0; i < 300; i++)
+	{
+		errors += probes[i].errors;
+		fired += probes[i].fired;
+	}
+	TEST_ASSERT_EQUAL(0, errors);
+	TEST_ASSERT(fired >= 300);
+	TEST_ASSERT_EQUAL(4000001, wheel.now);
+}
+
+static void test_next_delay(void)
+{
+	Probe near, far;
+
+	WHEEL_init(&wheel);
+	TEST_ASSERT_EQUAL(1000, WHEEL_getNextDelay(&wheel, 1000));
+	start_probe(&near, 40, 0);
+	TEST_ASSERT_EQUAL(40, WHEEL_getNextDelay(&wheel, 1000));
+	TEST_ASSERT_EQUAL(10, WHEEL_getNextDelay(&wheel, 10));
+	WHEEL_cancel(&wheel, &near.timer);
+	start_probe(&far, 5000, 0);																// Level 2, read in its slot
+	TEST_ASSERT_EQUAL(5000, WHEEL_getNextDelay(&wheel, 100000));
+	TEST_ASSERT_EQUAL(4000, WHEEL_getNextDelay(&wheel, 4000));
+	WHEEL_advance(&wheel, 4999);
+	TEST_ASSERT_EQUAL(1, WHEEL_getNextDelay(&wheel, 100000));
+	WHEEL_tick(&wheel);
+	TEST_ASSERT_EQUAL(1, far.fired);
+	TEST_ASSERT_EQUAL(0, far.errors);
+}
+
+static void test_periodic_timer(void)
+{
+	Probe probe;
+
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV4;
+	WHEEL_init(&wheel);
+	TEST_ASSERT(WHEEL_attachTimer(&wheel, TIM3, 1000, false));
+	TEST_ASSERT_EQUAL(83999, ((uint32_t) TIM3->PSC + 1) * (TIM3->ARR + 1) - 1);		// 1ms at 84MHz
+	TEST_ASSERT(TIM3->DIER & TIM_DIER_UIE);
+	TEST_ASSERT(TIM3->CR1 & TIM_CR1_CEN);
+	start_probe(&probe, 2, 0);
+	HOST_TIM_update(TIM3);
+	WHEEL_onTimerUpdate(&wheel);
+	TEST_ASSERT_EQUAL(0, TIM3->SR & TIM_SR_UIF);
+	HOST_TIM_update(TIM3);
+	WHEEL_onTimerUpdate(&wheel);
+	TEST_ASSERT_EQUAL(1, probe.fired);
+	TEST_ASSERT_EQUAL(0, probe.errors);
+}
+
+/* Counter of TIM3 at the end of the programmed ARR: update */
+static void tickless_update(void)
+{
+	TIM3->CNT = 0;
+	HOST_TIM_update(TIM3);
+	WHEEL_onTimerUpdate(&wheel);
+}
+
+static void test_tickless(void)
+{
+	Probe probe, early;
+
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | RCC_CFGR_PPRE1_DIV4;
+	WHEEL_init(&wheel);
+	TEST_ASSERT(WHEEL_attachTimer(&wheel, TIM3, 1000, true));
+	TEST_ASSERT_EQUAL(41999, TIM3->PSC);																// 2 counts per 1ms tick
+	TEST_ASSERT_EQUAL(2, wheel.counts_per_tick);
+	TEST_ASSERT_EQUAL(32768, wheel.max_sleep);
+	TEST_ASSERT_EQUAL(1, TIM3->ARR);
+
+	start_probe(&probe, 500, 0);
+	tickless_update();																					// First tick, then sleep until 500
+	TEST_ASSERT_EQUAL(499 * 2 - 1, TIM3->ARR);
+	tickless_update();
+	TEST_ASSERT_EQUAL(1, probe.fired);
+	TEST_ASSERT_EQUAL(0, probe.errors);
+	TEST_ASSERT_EQUAL(500, wheel.now);
+	TEST_ASSERT_EQUAL(32768 * 2 - 1, TIM3->ARR);												// Nothing pending: longest sleep
+
+	// Started 300 ticks into the sleep: ARR brought forward
+	TIM3->CNT = 600;
+	start_probe(&early, 10, 0);
+	early.expected = 500 + 300 + 10 - 1;
+	TEST_ASSERT_EQUAL(310 * 2 - 1, TIM3->ARR);
+	tickless_update();
+	TEST_ASSERT_EQUAL(810, wheel.now);
+	TEST_ASSERT_EQUAL(1, early.fired);
+	TEST_ASSERT_EQUAL(0, early.errors);
+
+	// Update pending while the interrupts are masked
+	TIM3->CNT = 4;
+	HOST_TIM_update(TIM3);
+	start_probe(&early, 10, 0);
+	early.expected = 810 + 32768 + 2 + 10 - 1;
+	TEST_ASSERT_EQUAL(32768 * 2 - 1, TIM3->ARR);
+	WHEEL_onTimerUpdate(&wheel);
+	TEST_ASSERT_EQUAL(810 + 32768, wheel.now);
+	TEST_ASSERT_EQUAL(12 * 2 - 1, TIM3->ARR);														// 2 + 10 ticks, counted from the update
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_one_shot_boundaries);
+	TEST_RUN(test_periodic_and_cancel);
+	TEST_RUN(test_restart);
+	TEST_RUN(test_callbacks_modify_wheel);
+	TEST_RUN(test_many_timers);
+	TEST_RUN(test_advance_matches_ticks);
+	TEST_RUN(test_next_delay);
+	TEST_RUN(test_periodic_timer);
+	TEST_RUN(test_tickless);
+	return TEST_END();
+}
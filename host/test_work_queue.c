@@ -0,0 +1,315 @@
+/*----------------------------------------------------------------------------
+ * Name:    test_work_queue.c
+ * Purpose: Deferred work queue service host test
+ * Note(s): make -C host test
+ *----------------------------------------------------------------------------
+ *
+ *	The threaded test runs producer threads standing in for handlers of
+ * different priorities against a consumer thread standing in for PendSV,
+ * without the peripheral model. The other tests run PendSV in the model.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "host_test.h"
+#include "work_queue.h"
+#include "interrupt.h"
+#include "rcc.h"
+
+#define PRODUCERS		4
+#define ITEMS				100000											///< Items per producer
+
+/* Order of the handlers and work functions */
+static char trace[16];
+static uint8_t trace_count;
+
+static void mark(void * context)
+{
+	if (trace_count < sizeof(trace) - 1)
+		trace[trace_count++] = *(const char *) context;
+}
+
+static void noop(void * context)
+{
+	(void) context;
+}
+
+/*----------------------------------------------------------------------------
+  Tests
+ *----------------------------------------------------------------------------*/
+
+static void test_init(void)
+{
+	WORK_Queue queue;
+	WORK_Item items[8];
+
+	TEST_ASSERT(!WORK_initQueue(&queue, items, 0));
+	TEST_ASSERT(!WORK_initQueue(&queue, items, 6));
+	TEST_ASSERT(WORK_initQueue(&queue, items, 8));
+	TEST_ASSERT_EQUAL(0, WORK_getCount(&queue));
+	TEST_ASSERT_EQUAL(0, WORK_getOverruns(&queue));
+}
+
+static void test_fill_and_drain(void)
+{
+	static const char names[] = "abcde";
+	WORK_Queue queue;
+	WORK_Item items[4];
+	WORK_Item item;
+	int i;
+
+	WORK_initQueue(&queue, items, 4);
+	TEST_ASSERT(!WORK_pop(&queue, &item));
+	for (i = 0; i < 4; i++)
+		TEST_ASSERT(WORK_push(&queue, mark, (void *) &names[i]));
+	TEST_ASSERT(!WORK_push(&queue, mark, (void *) &names[4]));
+	TEST_ASSERT_EQUAL(1, WORK_getOverruns(&queue));
+	TEST_ASSERT_EQUAL(4, WORK_getCount(&queue));
+
+	for (i = 0; i < 4; i++)
+	{
+		TEST_ASSERT(WORK_pop(&queue, &item));
+		TEST_ASSERT(item.function == mark);
+		TEST_ASSERT(item.context == &names[i]);
+	}
+	TEST_ASSERT(!WORK_pop(&queue, &item));
+
+	queue.head = queue.tail = 0xFFFFFFFE;									// Free-running indices about to wrap
+	for (i = 0; i < 6; i++)
+	{
+		TEST_ASSERT(WORK_push(&queue, noop, (void *) &names[i % 5]));
+		TEST_ASSERT(WORK_pop(&queue, &item));
+		TEST_ASSERT(item.context == &names[i % 5]);
+	}
+}
+
+static void test_unpublished_slot(void)
+{
+	static const char a = 'a', b = 'b';
+	WORK_Queue queue;
+	WORK_Item items[4];
+	WORK_Item item;
+
+	// A producer reserved slot 0 and was preempted before publishing it
+	WORK_initQueue(&queue, items, 4);
+	queue.head++;
+	TEST_ASSERT(WORK_push(&queue, mark, (void *) &b));
+	TEST_ASSERT(!WORK_pop(&queue, &item));
+	TEST_ASSERT_EQUAL(2, WORK_getCount(&queue));
+
+	items[0].function = mark;
+	items[0].context = (void *) &a;
+	items[0].sequence = 1;
+	TEST_ASSERT(WORK_pop(&queue, &item));
+	TEST_ASSERT(item.context == &a);
+	TEST_ASSERT(WORK_pop(&queue, &item));
+	TEST_ASSERT(item.context == &b);
+}
+
+typedef struct
+{
+	WORK_Queue queue;
+	WORK_Item items[64];
+	uint32_t next[PRODUCERS];							///< Next sequence expected from each producer
+	uint32_t popped;
+	uint32_t errors;
+	volatile uint32_t running;
+} Threads;
+
+typedef struct
+{
+	Threads * t;
+	uint32_t id;
+} Producer;
+
+static void * producer(void * arg)
+{
+	Producer * p = (Producer *) arg;
+	uint32_t i;
+
+	for (i = 0; i < ITEMS; i++)
+	{
+		void * context = (void *) (uintptr_t) ((p->id << 24) | i);
+
+		while (!WORK_push(&p->t->queue, noop, context))
+			sched_yield();
+	}
+	__sync_fetch_and_sub(&p->t->running, 1);
+	return NULL;
+}
+
+static void * consumer(void * arg)
+{
+	Threads * t = (Threads *) arg;
+	WORK_Item item;
+
+	for (;;)
+	{
+		bool done = (t->running == 0);
+
+		__DMB();
+		while (WORK_pop(&t->queue, &item))
+		{
+			uint32_t value = (uint32_t) (uintptr_t) item.context;
+			uint32_t id = value >> 24;
+
+			if (item.function != noop || id >= PRODUCERS || (value & 0xFFFFFF) != t->next[id])
+				t->errors++;
+			else
+				t->next[id]++;
+			t->popped++;
+		}
+		if (done)
+			break;
+		sched_yield();
+	}
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	static Threads t;
+	static Producer p[PRODUCERS];
+	pthread_t threads[PRODUCERS], c;
+	uint32_t i;
+
+	WORK_initQueue(&t.queue, t.items, 64);
+	t.running = PRODUCERS;
+	TEST_ASSERT_EQUAL(0, pthread_create(&c, NULL, consumer, &t));
+	for (i = 0; i < PRODUCERS; i++)
+	{
+		p[i].t = &t;
+		p[i].id = i;
+		TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, producer, &p[i]));
+	}
+	for (i = 0; i < PRODUCERS; i++)
+		pthread_join(threads[i], NULL);
+	pthread_join(c, NULL);
+
+	printf("  %u items from %d producers, %u overruns (retried pushes)\n", t.popped, PRODUCERS, WORK_getOverruns(&t.queue));
+	TEST_ASSERT_EQUAL(0, t.errors);
+	TEST_ASSERT_EQUAL(PRODUCERS * ITEMS, t.popped);
+	TEST_ASSERT_EQUAL(0, WORK_getCount(&t.queue));
+}
+
+static void on_line(u8 line, void * context)
+{
+	static const char isr_start = '[', isr_end = ']';
+	static const char work = 'w';
+
+	(void) line;
+	(void) context;
+	mark((void *) &isr_start);
+	WORK_defer(mark, (void *) &work);
+	HOST_busy(100);
+	mark((void *) &isr_end);
+}
+
+static void chain(void * context)
+{
+	static const char second = '2';
+
+	mark(context);
+	WORK_defer(mark, (void *) &second);
+}
+
+static void test_defer(void)
+{
+	static const char first = '1';
+
+	trace_count = 0;
+	WORK_init();
+	TEST_ASSERT_EQUAL(WORK_PENDSV_PRIORITY, NVIC_GetPriority(PendSV_IRQn));
+	TEST_ASSERT_EQUAL(WORK_PENDSV_PRIORITY << 4, SCB->SHP[10]);
+
+	// From a handler: after the handler returns
+	SYSCFG_CLK_ENABLE();
+	TEST_ASSERT(EXTI_attach(1, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_line, NULL));
+	HOST_GPIO_setInput(GPIOA, 1, true);
+	EXTI_detach(1);
+
+	// From the main loop: right away, with the work it defers
+	TEST_ASSERT(WORK_defer(chain, (void *) &first));
+	TEST_ASSERT_EQUAL(0, SCB->ICSR & SCB_ICSR_PENDSVSET_Msk);
+	TEST_ASSERT_EQUAL(0, WORK_getCount(WORK_getDeferQueue()));
+	trace[trace_count] = '\0';
+	TEST_ASSERT(strcmp(trace, "[]w12") == 0);
+	TEST_ASSERT_EQUAL(0, HOST_getUnhandledCount());
+}
+
+static void test_defer_masked(void)
+{
+	static const char work = 'w';
+
+	trace_count = 0;
+	WORK_init();
+	__disable_irq();
+	TEST_ASSERT(WORK_defer(mark, (void *) &work));
+	TEST_ASSERT(SCB->ICSR & SCB_ICSR_PENDSVSET_Msk);
+	TEST_ASSERT_EQUAL(0, trace_count);
+	__enable_irq();
+	TEST_ASSERT_EQUAL(1, trace_count);
+
+	// Full queue: the work is dropped
+	__disable_irq();
+	while (WORK_defer(noop, NULL));
+	TEST_ASSERT_EQUAL(WORK_DEFER_SIZE, WORK_getCount(WORK_getDeferQueue()));
+	TEST_ASSERT_EQUAL(1, WORK_getOverruns(WORK_getDeferQueue()));
+	__enable_irq();
+	TEST_ASSERT_EQUAL(0, WORK_getCount(WORK_getDeferQueue()));
+}
+
+static uint64_t edge_time, callback_time;
+
+static void on_urgent(u8 line, void * context)
+{
+	(void) line;
+	(void) context;
+	callback_time = HOST_getCycles();
+}
+
+static void raise_urgent(void * context)
+{
+	(void) context;
+	edge_time = HOST_getCycles();
+	HOST_GPIO_setInput(GPIOA, 2, true);
+}
+
+static void long_work(void * context)
+{
+	(void) context;
+	HOST_busy(5000);
+}
+
+static void test_work_preempted(void)
+{
+	uint64_t start;
+
+	WORK_init();
+	SYSCFG_CLK_ENABLE();
+	TEST_ASSERT(EXTI_attach(2, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, on_urgent, NULL));
+
+	start = HOST_getCycles();
+	TEST_ASSERT(HOST_schedule(1000, raise_urgent, NULL));
+	TEST_ASSERT(WORK_defer(long_work, NULL));
+	TEST_ASSERT(callback_time >= edge_time && callback_time - edge_time < 50);	// Not after the 5000 cycles
+	TEST_ASSERT(HOST_getCycles() - start > 5000);
+	EXTI_detach(2);
+}
+
+/*----------------------------------------------------------------------------
+  MAIN function
+ *----------------------------------------------------------------------------*/
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_fill_and_drain);
+	TEST_RUN(test_unpublished_slot);
+	TEST_RUN(test_threads);
+	TEST_RUN(test_defer);
+	TEST_RUN(test_defer_masked);
+	TEST_RUN(test_work_preempted);
+	return TEST_END();
+}
@@ -0,0 +1,412 @@
+/**
+* @file 		kernel.c
+* @brief		Source file of the preemptive kernel service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions required to run the application as
+* preemptive threads of fixed priorities. Portable: the contexts are
+* switched by the port (kernel_port.h).
+*
+*/
+
+#include <string.h>
+#include "kernel.h"
+#include "kernel_port.h"
+#include "interrupt.h"
+#include "stack.h"
+
+#define KERNEL_IDLE_PRIORITY		KERNEL_PRIORITIES						///< After the priorities of the application
+
+/* Ready threads of a priority, the running one first */
+typedef struct
+{
+	KERNEL_Thread * head;
+	KERNEL_Thread * tail;
+}KERNEL_ReadyQueue;
+
+static KERNEL_ReadyQueue kernel_queues[KERNEL_PRIORITIES + 1];
+static uint32_t kernel_ready;																///< Bit n set when queue n isn't empty
+static KERNEL_Thread * kernel_current;
+static KERNEL_Thread * kernel_delayed;												///< Delay list, the first to wake first
+static volatile uint32_t kernel_ticks;
+static uint32_t kernel_switches;
+static KERNEL_Thread kernel_idle;
+static uint32_t kernel_idleStack[KERNEL_STACK_MIN];
+
+/*----------------------------------------------------------------------------
+  Lists (kernel locked)
+ *----------------------------------------------------------------------------*/
+
+static u32 kernel_lock(void)
+{
+	return IRQ_lock(IRQ_LEVEL_DRIVER);
+}
+
+static void kernel_unlock(u32 key)
+{
+	IRQ_unlock(key);																			// PendSV taken here when it was pended
+}
+
+static void kernel_readyPush(KERNEL_Thread * thread)
+{
+	KERNEL_ReadyQueue * queue = &kernel_queues[thread->priority];
+
+	thread->next = NULL;
+	if (queue->tail != NULL)
+		queue->tail->next = thread;
+	else
+		queue->head = thread;
+	queue->tail = thread;
+	kernel_ready |= (0x1UL << thread->priority);
+}
+
+static void kernel_readyRemove(KERNEL_Thread * thread)
+{
+	KERNEL_ReadyQueue * queue = &kernel_queues[thread->priority];
+	KERNEL_Thread ** link = &queue->head;
+	KERNEL_Thread * previous = NULL;
+
+	while (*link != thread)
+	{
+		previous = *link;
+		link = &previous->next;
+	}
+	*link = thread->next;
+	if (queue->tail == thread)
+		queue->tail = previous;
+	if (queue->head == NULL)
+		kernel_ready &= ~(0x1UL << thread->priority);
+}
+
+static KERNEL_Thread * kernel_highest(void)
+{
+	return kernel_queues[31 - __CLZ(kernel_ready & -kernel_ready)].head;		// Lowest bit, the idle thread is always ready
+}
+
+/* PendSV pended when a more urgent thread is ready, or the current one isn't anymore */
+static void kernel_reschedule(void)
+{
+	if (kernel_current != NULL && kernel_highest() != kernel_current)
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+static void kernel_delayInsert(KERNEL_Thread * thread, uint32_t ticks)
+{
+	KERNEL_Thread ** link = &kernel_delayed;
+
+	thread->wake = kernel_ticks + ticks;
+	while (*link != NULL && (int32_t) ((*link)->wake - thread->wake) <= 0)		// Wraps around
+		link = &(*link)->delay_next;
+	thread->delay_next = *link;
+	*link = thread;
+	thread->delayed = true;
+}
+
+static void kernel_delayRemove(KERNEL_Thread * thread)
+{
+	KERNEL_Thread ** link = &kernel_delayed;
+
+	while (*link != thread)
+		link = &(*link)->delay_next;
+	*link = thread->delay_next;
+	thread->delayed = false;
+}
+
+/* Waiters sorted by priority, FIFO within a priority */
+static void kernel_waitInsert(KERNEL_Thread ** list, KERNEL_Thread * thread)
+{
+	KERNEL_Thread ** link = list;
+
+	while (*link != NULL && (*link)->priority <= thread->priority)
+		link = &(*link)->next;
+	thread->next = *link;
+	*link = thread;
+	thread->wait_list = list;
+}
+
+static void kernel_waitRemove(KERNEL_Thread * thread)
+{
+	KERNEL_Thread ** link = thread->wait_list;
+
+	while (*link != thread)
+		link = &(*link)->next;
+	*link = thread->next;
+	thread->wait_list = NULL;
+}
+
+static void kernel_block(KERNEL_Thread * thread, KERNEL_Thread ** wait_list, uint32_t timeout)
+{
+	kernel_readyRemove(thread);
+	thread->state = KERNEL_BLOCKED;
+	thread->result = false;
+	if (wait_list != NULL)
+		kernel_waitInsert(wait_list, thread);
+	if (timeout != KERNEL_WAIT_FOREVER)
+		kernel_delayInsert(thread, timeout);
+	kernel_reschedule();
+}
+
+static void kernel_wake(KERNEL_Thread * thread, bool result)
+{
+	if (thread->delayed)
+		kernel_delayRemove(thread);
+	if (thread->wait_list != NULL)
+		kernel_waitRemove(thread);
+	thread->result = result;
+	thread->state = KERNEL_READY;
+	kernel_readyPush(thread);
+}
+
+static void kernel_idleMain(void * arg)
+{
+	(void) arg;
+	for (;;)
+		KPORT_idle();
+}
+
+
+/*----------------------------------------------------------------------------
+  Threads
+ *----------------------------------------------------------------------------*/
+
+void KERNEL_init(void)
+{
+	uint8_t priority;
+
+	for (priority = 0; priority <= KERNEL_PRIORITIES; priority++)
+	{
+		kernel_queues[priority].head = NULL;
+		kernel_queues[priority].tail = NULL;
+	}
+	kernel_ready = 0;
+	kernel_current = NULL;
+	kernel_delayed = NULL;
+	kernel_ticks = 0;
+	kernel_switches = 0;
+	KPORT_init();
+
+	// Idle thread, created as the others but at the priority they can't have
+	kernel_idle.priority = KERNEL_IDLE_PRIORITY;
+	kernel_idle.name = "idle";
+	kernel_idle.stack = kernel_idleStack;
+	kernel_idle.stack_words = KERNEL_STACK_MIN;
+	kernel_idle.state = KERNEL_READY;
+	kernel_idle.wait_list = NULL;
+	kernel_idle.delayed = false;
+	kernel_idle.sp = KPORT_initStack(kernel_idleStack, KERNEL_STACK_MIN, kernel_idleMain, NULL);
+	kernel_readyPush(&kernel_idle);
+}
+
+bool KERNEL_createThread(KERNEL_Thread * thread, const char * name, KERNEL_Entry entry, void * arg,
+												 uint8_t priority, uint32_t * stack, uint32_t words)
+{
+	u32 key;
+
+	if (entry == NULL || priority >= KERNEL_PRIORITIES || stack == NULL || words < KERNEL_STACK_MIN)
+		return false;
+
+	thread->name = name;
+	thread->priority = priority;
+	thread->stack = stack;
+	thread->stack_words = words;
+	thread->state = KERNEL_READY;
+	thread->wait_list = NULL;
+	thread->delayed = false;
+	thread->result = false;
+	STACK_paint(stack, words);
+	thread->sp = KPORT_initStack(stack, words, entry, arg);
+
+	key = kernel_lock();
+	kernel_readyPush(thread);
+	kernel_reschedule();
+	kernel_unlock(key);
+	return true;
+}
+
+void KERNEL_start(void)
+{
+	KPORT_start();
+}
+
+void KERNEL_sleep(uint32_t ticks)
+{
+	u32 key;
+
+	if (ticks == 0)
+	{
+		KERNEL_yield();
+		return;
+	}
+	key = kernel_lock();
+	kernel_block(kernel_current, NULL, ticks);
+	kernel_unlock(key);
+}
+
+void KERNEL_yield(void)
+{
+	u32 key = kernel_lock();
+
+	kernel_readyRemove(kernel_current);
+	kernel_readyPush(kernel_current);
+	kernel_reschedule();
+	kernel_unlock(key);
+}
+
+KERNEL_Thread * KERNEL_getCurrent(void)
+{
+	return kernel_current;
+}
+
+uint32_t KERNEL_getTicks(void)
+{
+	return kernel_ticks;
+}
+
+uint32_t KERNEL_getSwitchCount(void)
+{
+	return kernel_switches;
+}
+
+
+/*----------------------------------------------------------------------------
+  Semaphores
+ *----------------------------------------------------------------------------*/
+
+void KERNEL_semInit(KERNEL_Sem * sem, uint32_t count)
+{
+	sem->count = count;
+	sem->waiters = NULL;
+}
+
+bool KERNEL_semTake(KERNEL_Sem * sem, uint32_t timeout)
+{
+	KERNEL_Thread * thread;
+	u32 key = kernel_lock();
+
+	if (sem->count > 0)
+	{
+		sem->count--;
+		kernel_unlock(key);
+		return true;
+	}
+	thread = kernel_current;
+	if (timeout == KERNEL_NO_WAIT || thread == NULL)
+	{
+		kernel_unlock(key);
+		return false;
+	}
+	kernel_block(thread, &sem->waiters, timeout);
+	kernel_unlock(key);																		// Switched out, back once woken
+	return thread->result;
+}
+
+void KERNEL_semGive(KERNEL_Sem * sem)
+{
+	u32 key = kernel_lock();
+
+	if (sem->waiters != NULL)
+	{
+		kernel_wake(sem->waiters, true);											// Token handed over, the count stays 0
+		kernel_reschedule();
+	}
+	else
+		sem->count++;
+	kernel_unlock(key);
+}
+
+void KERNEL_signal(void * sem)
+{
+	KERNEL_semGive((KERNEL_Sem *) sem);
+}
+
+
+/*----------------------------------------------------------------------------
+  Queues
+ *----------------------------------------------------------------------------*/
+
+bool KERNEL_initQueue(KERNEL_Queue * queue, void * buffer, uint32_t item_size, uint32_t length)
+{
+	if (item_size == 0 || length == 0)
+		return false;
+
+	queue->buffer = (uint8_t *) buffer;
+	queue->item_size = item_size;
+	queue->length = length;
+	queue->head = 0;
+	queue->tail = 0;
+	KERNEL_semInit(&queue->items, 0);
+	KERNEL_semInit(&queue->slots, length);
+	return true;
+}
+
+bool KERNEL_send(KERNEL_Queue * queue, const void * item, uint32_t timeout)
+{
+	u32 key;
+
+	if (!KERNEL_semTake(&queue->slots, timeout))
+		return false;
+
+	// Slot owned, the copy is locked against the other senders
+	key = kernel_lock();
+	memcpy(&queue->buffer[queue->head * queue->item_size], item, queue->item_size);
+	queue->head = (queue->head + 1 == queue->length) ? 0 : queue->head + 1;
+	kernel_unlock(key);
+	KERNEL_semGive(&queue->items);
+	return true;
+}
+
+bool KERNEL_receive(KERNEL_Queue * queue, void * item, uint32_t timeout)
+{
+	u32 key;
+
+	if (!KERNEL_semTake(&queue->items, timeout))
+		return false;
+
+	key = kernel_lock();
+	memcpy(item, &queue->buffer[queue->tail * queue->item_size], queue->item_size);
+	queue->tail = (queue->tail + 1 == queue->length) ? 0 : queue->tail + 1;
+	kernel_unlock(key);
+	KERNEL_semGive(&queue->slots);
+	return true;
+}
+
+
+/*----------------------------------------------------------------------------
+  Port
+ *----------------------------------------------------------------------------*/
+
+void * KERNEL_switch(void * sp)
+{
+	KERNEL_Thread * next = kernel_highest();
+
+	if (kernel_current != NULL)
+		kernel_current->sp = sp;
+	if (next != kernel_current)
+		kernel_switches++;
+	kernel_current = next;
+	return next->sp;
+}
+
+void KERNEL_tick(void)
+{
+	u32 key = kernel_lock();
+
+	kernel_ticks++;
+	while (kernel_delayed != NULL && (int32_t) (kernel_ticks - kernel_delayed->wake) >= 0)
+		kernel_wake(kernel_delayed, false);										// Timeout: not taken
+	kernel_reschedule();
+	kernel_unlock(key);
+}
+
+void KERNEL_exit(void)
+{
+	u32 key = kernel_lock();
+
+	kernel_readyRemove(kernel_current);
+	kernel_current->state = KERNEL_EXITED;
+	kernel_reschedule();
+	kernel_unlock(key);
+	for (;;);																							// Not resumed
+}
@@ -0,0 +1,274 @@
+/**
+* @file 		kernel.h
+* @brief		Header file of the preemptive kernel service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to run the application as
+* preemptive threads of fixed priorities, for workloads the cooperative
+* scheduler (scheduler.h) can't serve: a long task of low priority
+* (logging) is preempted as soon as an urgent one (acquisition) is ready.
+*
+*		1. KERNEL_PRIORITIES priorities, 0 the most urgent. The most urgent
+*		ready thread runs, the threads of a priority in FIFO order: a
+*		thread runs until it blocks, yields or a more urgent one is ready.
+*		There is no time slicing. An idle thread, less urgent than all the
+*		others, sleeps (WFI) when no thread is ready.
+*		2. The stacks are static arrays of the application, 8-byte aligned
+*		by the kernel. The threads run on PSP, the handlers on MSP: a stack
+*		only holds the calls of its thread and its saved context, up to
+*		KERNEL_STACK_MIN words when the thread used the FPU. The stacks are
+*		painted at creation: STACK_getPeak(thread.stack, thread.stack_words)
+*		gives their peak use (stack.h).
+*		3. The switch is done in PendSV_Handler, at the lowest priority,
+*		once all the handlers returned. The FPU registers are saved only
+*		for the threads which used them (lazy stacking, EXC_RETURN bit 4).
+*		PendSV_Handler runs the deferred work of work_queue.h first: build
+*		with KERNEL_ENABLED to remove the one of work_queue.c. SysTick gives
+*		the tick of the delays and timeouts, KERNEL_TICK_HZ.
+*		4. The kernel data is locked with IRQ_lock(IRQ_LEVEL_DRIVER): the
+*		handlers of the levels DRIVER, TIMER and DEFERRED may give the
+*		semaphores and send to the queues (without waiting), not the
+*		handlers of IRQ_LEVEL_URGENT, which the kernel never delays.
+*		5. The semaphores hand the token to the most urgent waiting thread,
+*		which is ready at once. KERNEL_signal() has the signature of the
+*		callbacks of the drivers and services (SPI, timer wheel, work queue,
+*		MEMS data-ready): they wake a thread without glue code.
+*		6. The queues copy items of a fixed size, in FIFO order.
+*		7. The portable core (kernel.c) is built for the target and the host
+*		model, the port (kernel_port.h) switches the contexts: kernel_port.c
+*		for the target, host/host_kernel_port.c for the host model.
+*		8. Use it as follow:
+*				static uint32_t sensor_stack[256];
+*				static KERNEL_Thread sensor;
+*				static KERNEL_Sem samples_ready;
+*
+*				IRQ_initGrouping();
+*				KERNEL_init();
+*				KERNEL_semInit(&samples_ready, 0);
+*				KERNEL_createThread(&sensor, "sensor", sensor_main, NULL, 0,
+*														sensor_stack, 256);
+*				MEMS_startDataReady(&ring, KERNEL_signal, &samples_ready);
+*				...
+*				KERNEL_start();												// never returns
+*
+*/
+
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+#define KERNEL_PRIORITIES				8										///< Thread priorities, 0 the most urgent
+#define KERNEL_TICK_HZ					1000								///< SysTick frequency
+#define KERNEL_STACK_MIN				64									///< Words, context saved with the FPU registers
+#define KERNEL_NO_WAIT					0x0UL								///< Timeout, returns at once
+#define KERNEL_WAIT_FOREVER			0xFFFFFFFFUL				///< Timeout, no limit
+
+typedef void (*KERNEL_Entry)(void * arg);
+
+typedef enum
+{
+	KERNEL_READY,																				///< Running or in its ready queue
+	KERNEL_BLOCKED,																			///< Waiting for a semaphore or a delay
+	KERNEL_EXITED																				///< Entry function returned
+}KERNEL_State;
+
+/* Thread, the kernel keeps a pointer to it until it exits */
+typedef struct KERNEL_Thread
+{
+	void * sp;																					///< Saved context, first member (read by the port)
+	struct KERNEL_Thread * next;												///< Next in its ready queue or wait list
+	struct KERNEL_Thread * delay_next;									///< Next in the delay list
+	struct KERNEL_Thread ** wait_list;									///< Wait list of a semaphore, NULL if none
+	uint32_t wake;																			///< Tick of the end of the delay
+	bool delayed;																				///< In the delay list
+	bool result;																				///< Semaphore taken when woken
+	uint8_t priority;
+	KERNEL_State state;
+	const char * name;
+	uint32_t * stack;
+	uint32_t stack_words;
+}KERNEL_Thread;
+
+/* Counting semaphore */
+typedef struct
+{
+	uint32_t count;																			///< Tokens, 0 while threads wait
+	KERNEL_Thread * waiters;														///< Waiting threads, the most urgent first
+}KERNEL_Sem;
+
+/* Queue of items of a fixed size */
+typedef struct
+{
+	uint8_t * buffer;
+	uint32_t item_size;
+	uint32_t length;																		///< Items of the buffer
+	uint32_t head;																			///< Next item written
+	uint32_t tail;																			///< Next item read
+	KERNEL_Sem items;																		///< Items to receive
+	KERNEL_Sem slots;																		///< Free items
+}KERNEL_Queue;
+
+
+/*----------------------------------------------------------------------------
+  Threads
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Kernel initialised.
+ * This function empties the ready queues and creates the idle thread.
+ * The application threads are created after it.
+ */
+void KERNEL_init(void);
+
+/**
+ * Thread created, ready.
+ * @param[out]	thread Thread.
+ * @param[in]	name Name, for the debugger.
+ * @param[in]	entry Function of the thread, it may return (thread exited).
+ * @param[in]	arg Passed to the function.
+ * @param[in]	priority Priority (0..KERNEL_PRIORITIES-1), 0 the most urgent.
+ * @param[in]	stack Stack of the thread, static.
+ * @param[in]	words Size of the stack in 32-bit words.
+ * @retval bool False if priority is out of range, entry is NULL or the
+ * stack is smaller than KERNEL_STACK_MIN words.
+ * @par Called from a thread, it runs at once if it is more urgent.
+ */
+bool KERNEL_createThread(KERNEL_Thread * thread, const char * name, KERNEL_Entry entry, void * arg,
+												 uint8_t priority, uint32_t * stack, uint32_t words);
+
+/**
+ * Threads started.
+ * This function starts SysTick and switches to the most urgent thread,
+ * the main stack is the one of the handlers afterwards.
+ * @par It never returns on the target (the host port returns, see host_kernel.h).
+ */
+void KERNEL_start(void);
+
+/**
+ * Current thread blocked for ticks (thread).
+ * @param[in]	ticks Ticks of KERNEL_TICK_HZ, 0 yields.
+ */
+void KERNEL_sleep(uint32_t ticks);
+
+/**
+ * Current thread put behind the ready threads of its priority (thread).
+ */
+void KERNEL_yield(void);
+
+/**
+ * Running thread.
+ * @retval KERNEL_Thread* Thread, NULL before KERNEL_start.
+ */
+KERNEL_Thread * KERNEL_getCurrent(void);
+
+/**
+ * Ticks since KERNEL_start.
+ * @retval uint32_t Ticks of KERNEL_TICK_HZ, wraps around.
+ */
+uint32_t KERNEL_getTicks(void);
+
+/**
+ * Context switches since KERNEL_init.
+ * @retval uint32_t Number of PendSV switching to another thread.
+ */
+uint32_t KERNEL_getSwitchCount(void);
+
+
+/*----------------------------------------------------------------------------
+  Semaphores
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Semaphore initialised.
+ * @param[out]	sem Semaphore.
+ * @param[in]	count Initial tokens.
+ */
+void KERNEL_semInit(KERNEL_Sem * sem, uint32_t count);
+
+/**
+ * Token taken (thread, or handler with KERNEL_NO_WAIT).
+ * @param[in]	sem Semaphore.
+ * @param[in]	timeout Ticks to wait for a token, KERNEL_NO_WAIT or KERNEL_WAIT_FOREVER.
+ * @retval bool False if no token came before the timeout.
+ * @par Not called with the kernel lock or PRIMASK set by the caller.
+ */
+bool KERNEL_semTake(KERNEL_Sem * sem, uint32_t timeout);
+
+/**
+ * Token given (any context but IRQ_LEVEL_URGENT).
+ * This function wakes the most urgent waiting thread, or adds a token.
+ * @param[in]	sem Semaphore.
+ */
+void KERNEL_semGive(KERNEL_Sem * sem);
+
+/**
+ * Token given (any context but IRQ_LEVEL_URGENT).
+ * @param[in]	sem KERNEL_Sem.
+ * @par Signature of SPI_Callback, WHEEL_Callback, WORK_Function and MEMS_Notify.
+ */
+void KERNEL_signal(void * sem);
+
+
+/*----------------------------------------------------------------------------
+  Queues
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Queue initialised, empty.
+ * @param[out]	queue Queue.
+ * @param[in]	buffer Buffer of length items of item_size bytes.
+ * @param[in]	item_size Size of an item in bytes.
+ * @param[in]	length Number of items.
+ * @retval bool False if item_size or length is 0.
+ */
+bool KERNEL_initQueue(KERNEL_Queue * queue, void * buffer, uint32_t item_size, uint32_t length);
+
+/**
+ * Item copied at the end of the queue (thread, or handler with KERNEL_NO_WAIT).
+ * @param[in]	queue Queue.
+ * @param[in]	item Item of item_size bytes.
+ * @param[in]	timeout Ticks to wait for a free item.
+ * @retval bool False if the queue stayed full until the timeout.
+ */
+bool KERNEL_send(KERNEL_Queue * queue, const void * item, uint32_t timeout);
+
+/**
+ * First item of the queue copied and removed (thread, or handler with KERNEL_NO_WAIT).
+ * @param[in]	queue Queue.
+ * @param[out]	item Item of item_size bytes.
+ * @param[in]	timeout Ticks to wait for an item.
+ * @retval bool False if the queue stayed empty until the timeout.
+ */
+bool KERNEL_receive(KERNEL_Queue * queue, void * item, uint32_t timeout);
+
+
+/*----------------------------------------------------------------------------
+  Port
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Context switched (PendSV, kernel locked).
+ * This function saves the context of the current thread and selects the
+ * most urgent ready thread.
+ * @param[in]	sp Context of the current thread, unused before the first switch.
+ * @retval void* Context of the thread to run.
+ */
+void * KERNEL_switch(void * sp);
+
+/**
+ * Tick (SysTick).
+ * This function wakes the threads whose delay or timeout elapsed.
+ */
+void KERNEL_tick(void);
+
+/**
+ * Current thread exited (its entry function returned).
+ * @par It never returns.
+ */
+void KERNEL_exit(void);
+
+#endif
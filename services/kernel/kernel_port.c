@@ -0,0 +1,142 @@
+/**
+* @file 		kernel_port.c
+* @brief		Source file of the Cortex-M4F port of the preemptive kernel service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the handlers which start and switch the threads
+* on the target, in the embedded assembler of ARMCC.
+*
+*		1. Saved context of a thread, on its stack (PSP), from the top: the
+*		frame stacked by the core on exception entry (r0-r3, r12, lr, pc,
+*		xPSR, plus s0-s15 and FPSCR when the thread used the FPU), s16-s31
+*		when the thread used the FPU, then r4-r11 and the EXC_RETURN of
+*		PendSV. KERNEL_Thread.sp points to r4.
+*		2. Lazy stacking (FPCCR ASPEN and LSPEN, the reset values): the core
+*		reserves the FPU frame and only writes it if the handler uses the
+*		FPU, and a thread which never used the FPU has no FPU frame at all.
+*		PendSV saves s16-s31 only when EXC_RETURN bit 4 is clear.
+*		3. The kernel data is read by KERNEL_switch with BASEPRI at the
+*		level of the kernel lock.
+*		4. SysTick is reloaded after each clock change (see RCC_setSysclk).
+*
+*/
+
+#include "kernel_port.h"
+#include "interrupt.h"
+#include "work_queue.h"
+#include "rcc.h"
+
+#define KPORT_EXC_RETURN		0xFFFFFFFDUL						///< Thread mode, PSP, no FPU frame
+#define KPORT_LOCK					(IRQ_LEVEL_DRIVER << (8 - IRQ_PREEMPT_BITS))	///< BASEPRI of kernel_lock
+
+__svc(0x00) void kport_startFirst(void);
+
+static RCC_ClockListener kport_clock;
+
+/* SysTick reloaded for the new core clock, the tick in progress restarts */
+static void kport_onClockChange(void * context)
+{
+	(void) context;
+	SysTick->LOAD = SystemCoreClock / KERNEL_TICK_HZ - 1;
+	SysTick->VAL = 0;
+}
+
+/*----------------------------------------------------------------------------
+  Port
+ *----------------------------------------------------------------------------*/
+
+void KPORT_init(void)
+{
+	WORK_init();																											// Run by PendSV, which it sets to the lowest priority
+}
+
+void * KPORT_initStack(uint32_t * stack, uint32_t words, KERNEL_Entry entry, void * arg)
+{
+	uint32_t * sp = KPORT_initFrame(stack, words, entry, arg);				// As if PendSV had preempted the thread at its entry
+
+	// Frame of PendSV
+	*--sp = KPORT_EXC_RETURN;
+	sp -= 8;																													// r4-r11
+	return sp;
+}
+
+void KPORT_start(void)
+{
+	FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+	SysTick_Config(SystemCoreClock / KERNEL_TICK_HZ);
+	IRQ_setPriority(SysTick_IRQn, IRQ_LEVEL_TIMER, 0);								// After SysTick_Config, which sets the lowest
+	RCC_addListener(&kport_clock, kport_onClockChange, NULL);
+	__enable_irq();
+	kport_startFirst();																								// SVC_Handler, not returning
+}
+
+void KPORT_idle(void)
+{
+	__WFI();
+}
+
+
+/*----------------------------------------------------------------------------
+  Handlers
+ *----------------------------------------------------------------------------*/
+
+/* First thread started, the main stack given back to the handlers */
+__asm void SVC_Handler(void)
+{
+	IMPORT	KERNEL_switch
+	PRESERVE8
+
+	LDR		r0, =0xE000ED08										; SCB->VTOR
+	LDR		r0, [r0]
+	LDR		r0, [r0]													; Initial MSP
+	MSR		MSP, r0
+	MOV		r0, #0
+	BL		KERNEL_switch											; r0: context of the first thread
+	LDMIA	r0!, {r4-r11, lr}
+	MSR		PSP, r0
+	ISB
+	BX		lr																; Thread mode on PSP, frame unstacked
+	ALIGN
+}
+
+/* Deferred work run, then context switched */
+__asm void PendSV_Handler(void)
+{
+	IMPORT	WORK_runDeferred
+	IMPORT	KERNEL_switch
+	PRESERVE8
+
+	PUSH	{r4, lr}													; r4 keeps MSP 8-byte aligned
+	BL		WORK_runDeferred
+	POP		{r4, lr}
+
+	MRS		r0, PSP
+	TST		lr, #0x10													; EXC_RETURN bit 4 clear: FPU frame
+	IT		EQ
+	VSTMDBEQ	r0!, {s16-s31}
+	STMDB	r0!, {r4-r11, lr}
+
+	MOV		r1, #__cpp(KPORT_LOCK)
+	MSR		BASEPRI, r1
+	DSB
+	ISB
+	BL		KERNEL_switch											; r0: context of the next thread
+	MOV		r1, #0
+	MSR		BASEPRI, r1
+
+	LDMIA	r0!, {r4-r11, lr}
+	TST		lr, #0x10
+	IT		EQ
+	VLDMIAEQ	r0!, {s16-s31}
+	MSR		PSP, r0
+	ISB
+	BX		lr
+	ALIGN
+}
+
+void SysTick_Handler(void)
+{
+	KERNEL_tick();
+}
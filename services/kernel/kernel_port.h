@@ -0,0 +1,88 @@
+/**
+* @file 		kernel_port.h
+* @brief		Header file of the port of the preemptive kernel service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions the portable core of the kernel
+* (kernel.c) calls to start the threads and switch their contexts.
+*
+*		1. kernel_port.c is the port of the target (Cortex-M4F): SVC starts
+*		the first thread, PendSV switches the contexts, SysTick ticks.
+*		2. host/host_kernel_port.c is the port of the host model: the
+*		threads are ucontext contexts switched when the model returns to
+*		thread mode after PendSV.
+*		3. Both ports build the frame of the core (KPORT_initFrame) at the
+*		top of the thread stack, the host one only as the image of the
+*		target stack (peak use, tests).
+*		4. The application doesn't call these functions.
+*
+*/
+
+#ifndef KERNEL_PORT_H
+#define KERNEL_PORT_H
+
+#include "kernel.h"
+
+#define KPORT_XPSR					0x01000000UL						///< Thumb state
+#define KPORT_PC_MASK				(~0x1UL)								///< Thumb bit of a function address, not loaded in pc
+#define KPORT_FRAME_WORDS		8												///< r0-r3, r12, lr, pc, xPSR
+
+/**
+ * Frame stacked by the core on exception entry built, as if the thread
+ * had been preempted at its entry.
+ * The exception return loads pc from it: a pc with bit 0 set is
+ * UNPREDICTABLE on ARMv7-M, the Thumb bit of entry is cleared.
+ * @param[in]	stack Stack of the thread.
+ * @param[in]	words Size of the stack in 32-bit words.
+ * @param[in]	entry Function of the thread, returns to KERNEL_exit.
+ * @param[in]	arg Passed to the function in r0.
+ * @retval uint32_t* Lowest word of the frame (r0), 8-byte aligned (AAPCS).
+ */
+static __inline uint32_t * KPORT_initFrame(uint32_t * stack, uint32_t words, KERNEL_Entry entry, void * arg)
+{
+	uint32_t * sp = (uint32_t *) ((uintptr_t) (stack + words) & ~(uintptr_t) 0x7);
+
+	*--sp = KPORT_XPSR;
+	*--sp = (uint32_t) (uintptr_t) entry & KPORT_PC_MASK;												// pc
+	*--sp = (uint32_t) (uintptr_t) KERNEL_exit;																// lr, entry returned
+	*--sp = 0;																																// r12
+	*--sp = 0;																																// r3
+	*--sp = 0;																																// r2
+	*--sp = 0;																																// r1
+	*--sp = (uint32_t) (uintptr_t) arg;																				// r0
+	return sp;
+}
+
+/**
+ * Port initialised (KERNEL_init).
+ * This function initialises the deferred work of PendSV (WORK_init), which
+ * sets PendSV to the lowest priority. The host port also frees the
+ * contexts of the previous threads.
+ */
+void KPORT_init(void);
+
+/**
+ * Initial context of a thread built.
+ * @param[in]	stack Stack of the thread.
+ * @param[in]	words Size of the stack in 32-bit words.
+ * @param[in]	entry Function of the thread, KERNEL_exit called when it returns.
+ * @param[in]	arg Passed to the function.
+ * @retval void* Context, as saved by the switch.
+ */
+void * KPORT_initStack(uint32_t * stack, uint32_t words, KERNEL_Entry entry, void * arg);
+
+/**
+ * First thread started (KERNEL_start).
+ * This function starts SysTick and switches to the thread selected by
+ * KERNEL_switch.
+ */
+void KPORT_start(void);
+
+/**
+ * Core asleep until an interrupt (idle thread).
+ */
+void KPORT_idle(void);
+
+#endif
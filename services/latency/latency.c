@@ -0,0 +1,133 @@
+/**
+* @file 		latency.c
+* @brief		Source file of the interrupt latency measurement service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions required to measure the entry
+* latency of the interrupts at each preemption level.
+*
+*/
+
+#include "latency.h"
+#include "atomic.h"
+
+/* Measure of a level */
+typedef struct
+{
+	LAT_Stats stats;
+	volatile uint32_t trigger;														///< CYCCNT before the SWIER write
+	volatile bool armed;																	///< Triggered, callback not run yet
+}LAT_Level;
+
+static LAT_Level lat_levels[IRQ_LEVELS];
+static u8 lat_attached;																	///< Bit n set when level n is attached
+
+static void LAT_clear(LAT_Stats * stats)
+{
+	stats->count = 0;
+	stats->min = 0xFFFFFFFF;
+	stats->max = 0;
+	stats->total = 0;
+}
+
+/* Callback of the line of a level: the latency is read first */
+static void LAT_onEntry(u8 line, void * context)
+{
+	uint32_t latency = DWT->CYCCNT;
+	LAT_Level * level = (LAT_Level *) context;
+	LAT_Stats * stats = &level->stats;
+
+	(void) line;
+	latency -= level->trigger;
+	stats->count++;
+	stats->total += latency;
+	if (latency < stats->min)
+		stats->min = latency;
+	if (latency > stats->max)
+		stats->max = latency;
+	level->armed = false;
+}
+
+void LAT_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	LAT_reset();
+}
+
+bool LAT_attach(u8 level)
+{
+	u8 line = LAT_LINE_BASE + level;
+
+	if (level >= IRQ_LEVELS)
+		return false;
+
+	lat_levels[level].armed = false;
+	IRQ_setPriority(EXTI_getIRQn(line), level, 0);
+	if (!EXTI_attach(line, EXTI_EDGE_RISING, SYSCFG_EXTICR_EXTI_PA, LAT_onEntry, &lat_levels[level]))
+		return false;
+	ATOMIC_BIT(EXTI->RTSR, line) = 0;								// SWIER only, the pin is ignored
+	lat_attached |= (0x1 << level);
+	return true;
+}
+
+void LAT_detach(u8 level)
+{
+	if (level >= IRQ_LEVELS)
+		return;
+
+	lat_attached &= ~(0x1 << level);
+	EXTI_detach(LAT_LINE_BASE + level);
+	lat_levels[level].armed = false;
+}
+
+bool LAT_trigger(u8 level)
+{
+	LAT_Level * l;
+
+	if (level >= IRQ_LEVELS || (lat_attached & (0x1 << level)) == 0)
+		return false;
+	l = &lat_levels[level];
+	if (l->armed)
+		return false;
+
+	l->armed = true;
+	l->trigger = DWT->CYCCNT;
+	EXTI->SWIER = 0x1UL << (LAT_LINE_BASE + level);
+	return true;
+}
+
+const LAT_Stats * LAT_getStats(u8 level)
+{
+	if (level >= IRQ_LEVELS)
+		return NULL;
+	return &lat_levels[level].stats;
+}
+
+uint32_t LAT_getMean(const LAT_Stats * stats)
+{
+	if (stats->count == 0)
+		return 0;
+	return (uint32_t) (stats->total / stats->count);
+}
+
+uint32_t LAT_getJitter(const LAT_Stats * stats)
+{
+	if (stats->count == 0)
+		return 0;
+	return stats->max - stats->min;
+}
+
+void LAT_reset(void)
+{
+	uint32_t primask;
+	u8 level;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	for (level = 0; level < IRQ_LEVELS; level++)
+		LAT_clear(&lat_levels[level].stats);
+	__set_PRIMASK(primask);
+}
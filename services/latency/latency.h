@@ -0,0 +1,111 @@
+/**
+* @file 		latency.h
+* @brief		Header file of the interrupt latency measurement service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to measure the entry
+* latency of the interrupts at each preemption level (interrupt.h),
+* with the load of the application running: count, min, max, mean and
+* jitter per level.
+*
+*		1. Level n is measured with EXTI line LAT_LINE_BASE + n, attached at
+*		preemption level n. Its edges are cleared: only LAT_trigger()
+*		pends it, through EXTI SWIER. The pin of the line stays free.
+*		2. LAT_trigger() reads DWT CYCCNT then writes SWIER, the callback
+*		reads CYCCNT first: the latency counts the SWIER write, the NVIC
+*		entry and the dispatch of interrupt.c, plus the handlers of the
+*		same or a more urgent level running meanwhile, and the BASEPRI or
+*		PRIMASK sections of the code.
+*		3. A level is triggered again only once its callback has run, a
+*		trigger before returns false and isn't counted.
+*		4. The jitter is max - min. The latencies are 32-bit cycles.
+*		5. Use it as follow, the triggers in a periodic handler of level 0
+*		(or anything running while the load of the application does):
+*				IRQ_initGrouping();
+*				SYSCFG_CLK_ENABLE();
+*				LAT_init();
+*				LAT_attach(IRQ_LEVEL_TIMER);
+*				...
+*				LAT_trigger(IRQ_LEVEL_TIMER);
+*				...
+*				LAT_getJitter(LAT_getStats(IRQ_LEVEL_TIMER));
+*
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+#include "interrupt.h"
+
+#define LAT_LINE_BASE						1										///< EXTI line of level 0, the next levels on the next lines
+
+/* Entry latencies of a level, in cycles */
+typedef struct
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;																			///< Sum of the latencies, mean is total / count
+}LAT_Stats;
+
+/**
+ * Service initialised.
+ * This function starts DWT CYCCNT and clears the statistics. The lines
+ * already attached stay attached.
+ */
+void LAT_init(void);
+
+/**
+ * Level measured.
+ * The function sets the priority of the line of the level and attaches it.
+ * @param[in]	level Preemption level (0..IRQ_LEVELS-1).
+ * @retval bool False if the level is out of range.
+ * @par The SYSCFG clock must be enabled. IRQ_initGrouping must be called before.
+ */
+bool LAT_attach(u8 level);
+
+/**
+ * Level not measured anymore.
+ * @param[in]	level Preemption level (0..IRQ_LEVELS-1).
+ */
+void LAT_detach(u8 level);
+
+/**
+ * Interrupt of a level triggered, its entry measured.
+ * @param[in]	level Preemption level.
+ * @retval bool False if the level isn't attached or its previous trigger
+ * isn't handled yet.
+ */
+bool LAT_trigger(u8 level);
+
+/**
+ * Statistics of a level.
+ * @param[in]	level Preemption level.
+ * @retval const LAT_Stats* NULL if level is out of range.
+ */
+const LAT_Stats * LAT_getStats(u8 level);
+
+/**
+ * Mean latency.
+ * @param[in]	stats Statistics of a level.
+ * @retval uint32_t total / count, 0 if nothing was measured.
+ */
+uint32_t LAT_getMean(const LAT_Stats * stats);
+
+/**
+ * Latency jitter.
+ * @param[in]	stats Statistics of a level.
+ * @retval uint32_t max - min, 0 if nothing was measured.
+ */
+uint32_t LAT_getJitter(const LAT_Stats * stats);
+
+/**
+ * Statistics of all the levels cleared.
+ */
+void LAT_reset(void);
+
+#endif
@@ -61,6 +61,18 @@ void LED_initLed(LED_Color LED)
 	GPIO_initOutputFastspeed(GPIO_LED, pin_LED);
 }
 
+/**
+ * Initializes the 4 leds.
+ * The function initialises the 4 GPIO pins as Output push-pull, fast-speed pins
+ * with a single write of each GPIO configuration register.
+ */
+void LED_initAllLeds(void)
+{
+	static const GPIO_PinConfig led_pins = { GPIO_MODE_OUTPUT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_FAST, GPIO_PULL_NONE, 0 };
+	
+	GPIO_configPins(GPIO_LED, GPIO_PIN(PIN_LED_GREEN) | GPIO_PIN(PIN_LED_ORANGE) | GPIO_PIN(PIN_LED_RED) | GPIO_PIN(PIN_LED_BLUE), &led_pins);
+}
+
 /**
  * Switches ON led based on its color.
  * The function sets the appropriate GPIO pin.
@@ -69,7 +81,7 @@ void LED_initLed(LED_Color LED)
 void LED_switchON(LED_Color LED)
 {
 	u8 pin_LED = LED_getPinNumber(LED);
-	GPIO_setPin(GPIO_LED, pin_LED);
+	GPIO_setPins(GPIO_LED, (0x1 << pin_LED));
 }
 
 /**
@@ -80,7 +92,7 @@ void LED_switchON(LED_Color LED)
 void LED_switchOFF(LED_Color LED)
 {
 	u8 pin_LED = LED_getPinNumber(LED);
-	GPIO_resetPin(GPIO_LED, pin_LED);
+	GPIO_resetPins(GPIO_LED, (0x1 << pin_LED));
 }
 
 /**
@@ -91,6 +103,89 @@ void LED_switchOFF(LED_Color LED)
 void LED_toggle(LED_Color LED)
 {
 	u8 pin_LED = LED_getPinNumber(LED);
-	GPIO_togglePin(GPIO_LED, pin_LED);
+	GPIO_togglePins(GPIO_LED, (0x1 << pin_LED));
+}
+
+
+/**
+ * Initializes the 4 leds in PWM mode.
+ * The function sets the 4 pins in the TIM4 alternate function and starts
+ * TIM4 with the 4 channels in PWM mode, all leds OFF.
+ * @param[in]	frequency PWM frequency in Hz.
+ * @retval bool false if the TIM4 clock can't count LED_BRIGHTNESS_MAX steps at this frequency.
+ */
+bool LED_initPWM(u32 frequency)
+{
+	static const GPIO_PinConfig led_pins = { GPIO_MODE_ALTERNATE, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_FAST, GPIO_PULL_NONE, LED_PWM_AF };
+	uint64_t steps = (uint64_t) frequency * LED_BRIGHTNESS_MAX;
+	uint64_t psc_count;
+	u8 channel;
+	
+	if (steps == 0)
+		return false;
+	psc_count = (TIM_getClock(LED_PWM_TIM) + steps / 2) / steps;
+	if (psc_count == 0 || psc_count > (uint64_t) TIM_PSC_MAX + 1)
+		return false;
+	
+	for (channel = 1; channel <= TIM_CHANNELS; channel++)
+	{
+		TIM_initPWM(LED_PWM_TIM, channel);
+		TIM_setCCR(LED_PWM_TIM, channel, 0);
+	}
+	TIM_initUpcount(LED_PWM_TIM);
+	TIM_setPSC(LED_PWM_TIM, (u16) (psc_count - 1));
+	TIM_setARR(LED_PWM_TIM, LED_BRIGHTNESS_MAX - 1);
+	TIM_resetCNT(LED_PWM_TIM);																// Loads PSC, ARR and the CCRs
+	TIM_enable(LED_PWM_TIM);
+	
+	GPIO_configPins(GPIO_LED, GPIO_PIN(PIN_LED_GREEN) | GPIO_PIN(PIN_LED_ORANGE) | GPIO_PIN(PIN_LED_RED) | GPIO_PIN(PIN_LED_BLUE), &led_pins);
+	
+	return true;
+}
+
+/**
+ * Sets the brightness of a led in PWM mode.
+ * The new duty cycle is used from the next PWM period.
+ * @param[in]	LED color of the led (see LED_Color typedef).
+ * @param[in]	brightness 0 (OFF) to LED_BRIGHTNESS_MAX (ON).
+ */
+void LED_setBrightness(LED_Color LED, u16 brightness)
+{
+	if (LED > LED_BLUE)
+		return;
+	if (brightness > LED_BRIGHTNESS_MAX)
+		brightness = LED_BRIGHTNESS_MAX;
+	TIM_setCCR(LED_PWM_TIM, (u8) LED + 1, brightness);
+}
+
+/**
+ * Starts a sequence in PWM mode.
+ * The function returns immediately, the DMA writes a frame at the start
+ * of each PWM period. It overrides LED_setBrightness while it runs.
+ * @param[in]	frames Frames to play, kept by reference until the sequence ends.
+ * @param[in]	length Number of frames (at most 16383).
+ * @param[in]	repeat true to loop, false to keep the last frame at the end.
+ * @retval bool false if length is out of range or a sequence is running.
+ */
+bool LED_startSequence(const LED_Frame * frames, u16 length, bool repeat)
+{
+	return TIM_startCCRStream(LED_PWM_TIM, frames[0], length, repeat);
 }
 
+/**
+ * Stops the sequence.
+ * The leds keep the brightness of the last frame written.
+ */
+void LED_stopSequence(void)
+{
+	TIM_stopCCRStream(LED_PWM_TIM);
+}
+
+/**
+ * Sequence running.
+ * @retval bool true until the last frame of a sequence which doesn't repeat.
+ */
+bool LED_isSequenceRunning(void)
+{
+	return TIM_isCCRStreamBusy(LED_PWM_TIM);
+}
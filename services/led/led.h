@@ -11,10 +11,22 @@
 *
 * 	1. Use it as follow:
 *			__LED_CLK_ENABLE();
-*			LED_initLed(LED_GREEN);
+*			LED_initLed(LED_GREEN);				// or LED_initAllLeds();
 *			LED_switchON(LED_GREEN);	
 *			LED_switchOFF(LED_GREEN);
 *			LED_toggle(LED_GREEN);
+*		2. In PWM mode, TIM4 CH1-CH4 drive the leds (alternate function 2 of
+*		PD12-PD15) and LED_setBrightness() sets their duty cycle. The GPIO
+*		functions above don't drive the pins anymore until LED_initLed() or
+*		LED_initAllLeds() is called again.
+*		3. A sequence is a table of LED_Frame, one per PWM period, streamed
+*		in the TIM4 CCRs by DMA: fades and blink patterns run without any
+*		CPU time. At 100 Hz, each frame lasts 10 ms:
+*			static const LED_Frame blink[100] = { { LED_BRIGHTNESS_MAX, 0, 0, 0 }, ... };
+*			LED_PWM_CLK_ENABLE();
+*			LED_initPWM(100);
+*			LED_setBrightness(LED_BLUE, LED_BRIGHTNESS_MAX / 4);
+*			LED_startSequence(blink, 100, true);
 *
 */
 
@@ -25,6 +37,7 @@
 #include <stm32f4xx.h>
 #include "gpio.h"
 #include "rcc.h"
+#include "timer.h"
  
 #define GPIO_LED 		GPIOD 		///< GPIO handling 4 user leds
 
@@ -35,6 +48,12 @@
 #define PIN_LED_RED 		14				///< Pin number of red led
 #define PIN_LED_BLUE 		15				///< Pin number of blue led
 
+#define LED_PWM_TIM							TIM4				///< Timer of the leds, channel n + 1 drives LED_Color n
+#define LED_PWM_AF							2						///< TIM4 Alternate Function Number
+#define LED_BRIGHTNESS_MAX			1000				///< Brightness of a led fully ON, timer counts per PWM period
+
+#define LED_PWM_CLK_ENABLE()		(GPIOD_CLK_ENABLE(), TIM4_CLK_ENABLE(), DMA1_CLK_ENABLE())	///< Macro to switch ON the LED PWM CLKs
+
 typedef enum
 {
 	LED_GREEN = 0,
@@ -43,6 +62,8 @@ typedef enum
 	LED_BLUE	
 }LED_Color;
 
+typedef u16 LED_Frame[4];						///< Brightness of each led, indexed by LED_Color
+
 /**
  * Returns pin number of the led according to its color.
  * The function matches the pin number with the color (see schematics).
@@ -60,6 +81,13 @@ u8 LED_getPinNumber(LED_Color LED);
  * @param[in]	LED color of the led (see LED_Color typedef).
  */
 void LED_initLed(LED_Color LED);
+
+/**
+ * Initializes the 4 leds.
+ * The function initialises the 4 GPIO pins as Output push-pull, fast-speed pins
+ * with a single write of each GPIO configuration register.
+ */
+void LED_initAllLeds(void);
  
 /**
  * Switches ON led based on its color.
@@ -82,10 +110,45 @@ void LED_switchOFF(LED_Color LED);
  */
 void LED_toggle(LED_Color LED);
 
- 
- 
- 
- 
- 
+/**
+ * Initializes the 4 leds in PWM mode.
+ * The function sets the 4 pins in the TIM4 alternate function and starts
+ * TIM4 with the 4 channels in PWM mode, all leds OFF.
+ * @param[in]	frequency PWM frequency in Hz.
+ * @retval bool false if the TIM4 clock can't count LED_BRIGHTNESS_MAX steps at this frequency.
+ */
+bool LED_initPWM(u32 frequency);
+
+/**
+ * Sets the brightness of a led in PWM mode.
+ * The new duty cycle is used from the next PWM period.
+ * @param[in]	LED color of the led (see LED_Color typedef).
+ * @param[in]	brightness 0 (OFF) to LED_BRIGHTNESS_MAX (ON).
+ */
+void LED_setBrightness(LED_Color LED, u16 brightness);
+
+/**
+ * Starts a sequence in PWM mode.
+ * The function returns immediately, the DMA writes a frame at the start
+ * of each PWM period. It overrides LED_setBrightness while it runs.
+ * @param[in]	frames Frames to play, kept by reference until the sequence ends.
+ * @param[in]	length Number of frames (at most 16383).
+ * @param[in]	repeat true to loop, false to keep the last frame at the end.
+ * @retval bool false if length is out of range or a sequence is running.
+ */
+bool LED_startSequence(const LED_Frame * frames, u16 length, bool repeat);
+
+/**
+ * Stops the sequence.
+ * The leds keep the brightness of the last frame written.
+ */
+void LED_stopSequence(void);
+
+/**
+ * Sequence running.
+ * @retval bool true until the last frame of a sequence which doesn't repeat.
+ */
+bool LED_isSequenceRunning(void);
+
 #endif
 
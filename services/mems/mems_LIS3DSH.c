@@ -1,36 +1,89 @@
-#include "mems_lis3dsh.h"
+#include "mems_LIS3DSH.h"
+
+static uint8_t mems_fifo_rx[6 * MEMS_FIFO_SIZE];
+static int16_t mems_fifo_samples[MEMS_FIFO_SIZE][3];
+static MEMS_FifoCallback mems_fifo_callback;
+static void * mems_fifo_context;
+static RING_Buffer * mems_ring;															///< Data-ready mode when not NULL
+static MEMS_Notify mems_notify;
+static void * mems_notify_context;
+
+/* Write-through shadow: OFFSET_X..CSHIFT_Z, then CTRL_REG4..CTRL_REG6 (CTRL_REG1/2 slots unused) */
+static uint8_t mems_shadow[12];
+static bool mems_shadow_valid;
+
+static PROF_Id mems_prof_init = PROF_NONE;
+static PROF_Id mems_prof_get_data = PROF_NONE;
+static PROF_Id mems_prof_int1 = PROF_NONE;
+
+static uint8_t * MEMS_getShadow(uint8_t reg_address)
+{
+	if (!mems_shadow_valid)
+		return NULL;
+	if (reg_address >= MEMS_OFFSET_X && reg_address <= MEMS_CSHIFT_Z)
+		return &mems_shadow[reg_address - MEMS_OFFSET_X];
+	if (reg_address == MEMS_CTRL_REG4 || (reg_address >= MEMS_CTRL_REG3 && reg_address <= MEMS_CTRL_REG6))
+		return &mems_shadow[6 + reg_address - MEMS_CTRL_REG4];
+	return NULL;
+}
+
+/* CS window kept from the INT1 handler, which reads the MEMS on the same bus */
+static u32 MEMS_lockBus(void)
+{
+	return IRQ_lock(IRQ_LEVEL_DRIVER);
+}
+
+/* Reads consecutive registers in a single CS window (needs CTRL_REG6 ADD_INC) */
+static void MEMS_getRegisters(uint8_t reg_address, uint8_t * data, uint16_t length)
+{
+	uint8_t address = 0x80 | reg_address;
+	u32 key = MEMS_lockBus();
+	
+	MEMS_setCSLow();
+	SPI_transferBuffer(MEMS_SPI, &address, NULL, 1);
+	SPI_transferBuffer(MEMS_SPI, NULL, data, length);
+	MEMS_setCSHigh();
+	IRQ_unlock(key);
+}
+
+static void MEMS_int1Handler(u8 line, void * context);
+
+static void MEMS_enableInt1(void)
+{
+	GPIO_initInput(MEMS_GPIO_INT1, MEMS_PIN_INT1);
+	SYSCFG_CLK_ENABLE();
+	IRQ_setPriority(EXTI_getIRQn(MEMS_PIN_INT1), IRQ_LEVEL_DRIVER, 0);
+	EXTI_attach(MEMS_PIN_INT1, EXTI_EDGE_RISING, MEMS_INT1_EXTI_PORT, MEMS_int1Handler, NULL);
+}
+
+static void MEMS_disableInt1(void)
+{
+	EXTI_detach(MEMS_PIN_INT1);
+}
+
+static const GPIO_PinConfig mems_spi_pins = { GPIO_MODE_ALTERNATE, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_MEDIUM, GPIO_PULL_NONE, MEMS_SPI_AF };
+static const GPIO_PinConfig mems_cs_pin = { GPIO_MODE_OUTPUT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_MEDIUM, GPIO_PULL_UP, 0 };
 
 void MEMS_init(void) 
 {
+	uint32_t prof_start;
+	
+	mems_prof_init = PROF_REGISTER("MEMS_init");
+	mems_prof_get_data = PROF_REGISTER("MEMS_getData");
+	mems_prof_int1 = PROF_REGISTER("MEMS_INT1");
+	prof_start = PROF_BEGIN();
+	mems_shadow_valid = false;
+	
 	MEMS_GPIO_MAIN_CLK_ENABLE();
 	MEMS_GPIO_CS_CLK_ENABLE();
 	
-	GPIO_initAlternate(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
-	GPIO_initAlternate(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
-	GPIO_initAlternate(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
-	GPIO_initOutputMediumspeed(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
-	GPIO_initOutputMediumspeed(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
-	GPIO_initOutputMediumspeed(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
-	GPIO_initOutputPushpull(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
-	GPIO_initOutputPushpull(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
-	GPIO_initOutputPushpull(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
-	GPIO_initNopull(MEMS_GPIO_MAIN, MEMS_PIN_SCK);
-	GPIO_initNopull(MEMS_GPIO_MAIN, MEMS_PIN_MISO);
-	GPIO_initNopull(MEMS_GPIO_MAIN, MEMS_PIN_MOSI);
-	
-	GPIO_initOutput(MEMS_GPIO_CS, MEMS_PIN_CS);
-	GPIO_initOutputMediumspeed(MEMS_GPIO_CS, MEMS_PIN_CS);
-	GPIO_initOutputPushpull(MEMS_GPIO_CS, MEMS_PIN_CS);
-	GPIO_initPullup(MEMS_GPIO_CS, MEMS_PIN_CS);
-	GPIO_setPin(MEMS_GPIO_CS, MEMS_PIN_CS);	
-	
-	// Assigns GPIO Alternate Function to SPI
-	MEMS_GPIO_MAIN->AFR[0] |= (MEMS_SPI_AF << MEMS_PIN_SCK*4);
-	MEMS_GPIO_MAIN->AFR[0] |= (MEMS_SPI_AF << MEMS_PIN_MISO*4);
-	MEMS_GPIO_MAIN->AFR[0] |= (MEMS_SPI_AF << MEMS_PIN_MOSI*4);
+	GPIO_configPins(MEMS_GPIO_MAIN, GPIO_PIN(MEMS_PIN_SCK) | GPIO_PIN(MEMS_PIN_MISO) | GPIO_PIN(MEMS_PIN_MOSI), &mems_spi_pins);
+	
+	GPIO_SET_PIN(MEMS_GPIO_CS, MEMS_PIN_CS);													// CS high as soon as it drives
+	GPIO_configPins(MEMS_GPIO_CS, GPIO_PIN(MEMS_PIN_CS), &mems_cs_pin);
 	
 	SPI_initUnidirectionalData2LineUni(MEMS_SPI); 							// essential
-	SPI_initBaudRate(MEMS_SPI, SPI_BaudRatePrescaler_2);
+	SPI_setBaudRate(MEMS_SPI, MEMS_SPI_MAX_HZ);								// Follows the clock changes
 	SPI_initClockPolarityIdleHigh(MEMS_SPI);
 	SPI_initClockPhaseEdgeTwo(MEMS_SPI);
 	SPI_initDataFrameFormat8b(MEMS_SPI);
@@ -40,73 +93,90 @@ void MEMS_init(void)
 	SPI_initMasterConfiguration(MEMS_SPI);
 	SPI_enable(MEMS_SPI);
 	
-	GPIO_resetPin(MEMS_GPIO_CS, MEMS_PIN_CS);
+	MEMS_setBitsInRegister(MEMS_CTRL_REG6, MEMS_CTRL_REG6_ADD_INC);	// Burst reads
+	MEMS_resyncShadow();
+	PROF_END(mems_prof_init, prof_start);
+}
+
+void MEMS_resyncShadow(void)
+{
+	MEMS_getRegisters(MEMS_OFFSET_X, &mems_shadow[0], 6);
+	MEMS_getRegisters(MEMS_CTRL_REG4, &mems_shadow[6], 6);
+	mems_shadow_valid = true;
 }
 
 void MEMS_setCSLow(void)
 {
-	GPIO_resetPin(MEMS_GPIO_CS, MEMS_PIN_CS);
+	GPIO_RESET_PIN(MEMS_GPIO_CS, MEMS_PIN_CS);
 }
 
 void MEMS_setCSHigh(void)
 {
-	GPIO_setPin(MEMS_GPIO_CS, MEMS_PIN_CS);
+	GPIO_SET_PIN(MEMS_GPIO_CS, MEMS_PIN_CS);
 }
 
 uint8_t MEMS_getData(uint8_t reg_address)
 {
-	uint8_t read_address = 0x80 | reg_address;
-	uint8_t tmp_rcvd;
+	uint8_t tx[2] = { (uint8_t) (0x80 | reg_address), 0x0 };
+	uint8_t rx[2];
+	uint32_t prof_start = PROF_BEGIN();
+	u32 key = MEMS_lockBus();
 	
 	MEMS_setCSLow();
+	SPI_transferBuffer(MEMS_SPI, tx, rx, 2);
+	MEMS_setCSHigh();
+	IRQ_unlock(key);
 	
-	while (SPI_hasDataToSend(MEMS_SPI)); 							// While there is something in Tx Reg...
-	SPI_writeData(MEMS_SPI, read_address);
-	while (!SPI_hasDataToReceive(MEMS_SPI)); 					// While there is nothing in Rx Reg...
-	tmp_rcvd = (uint8_t) SPI_readData(MEMS_SPI);
-	while (SPI_hasDataToSend(MEMS_SPI)); 							// While there is something in Tx Reg...
-	SPI_writeData(MEMS_SPI, 0x0);		
-	while (!SPI_hasDataToReceive(MEMS_SPI)); 					// While there is nothing in Rx Reg...
-
-	MEMS_setCSHigh();	
-	
-	return ((uint8_t) SPI_readData(MEMS_SPI));
+	PROF_END(mems_prof_get_data, prof_start);
+	return rx[1];
 }
 
 void MEMS_setData(uint8_t reg_address, uint8_t data)
 {
-	uint8_t write_address = reg_address;
-	uint8_t tmp_rcvd;
+	uint8_t tx[2] = { reg_address, data };
+	uint8_t * shadow = MEMS_getShadow(reg_address);
+	u32 key = MEMS_lockBus();
 	
 	MEMS_setCSLow();
+	SPI_transferBuffer(MEMS_SPI, tx, NULL, 2);
+	MEMS_setCSHigh();
+	IRQ_unlock(key);
 	
-	while (SPI_hasDataToSend(MEMS_SPI)); 							// While there is something in Tx Reg...
-	SPI_writeData(MEMS_SPI, write_address);
-	while (!SPI_hasDataToReceive(MEMS_SPI)); 					// While there is nothing in Rx Reg...
-	tmp_rcvd = (uint8_t) SPI_readData(MEMS_SPI);
-	while (SPI_hasDataToSend(MEMS_SPI)); 							// While there is something in Tx Reg...
-	SPI_writeData(MEMS_SPI, data);		
-	while (!SPI_hasDataToReceive(MEMS_SPI)); 					// While there is nothing in Rx Reg...
-	tmp_rcvd = (uint8_t) SPI_readData(MEMS_SPI);
+	if (shadow != NULL)
+	{
+		if (reg_address == MEMS_CTRL_REG6)
+			data &= ~MEMS_CTRL_REG6_BOOT;														// Cleared by the MEMS once the reboot is done
+		else if (reg_address == MEMS_CTRL_REG3)
+			data &= ~MEMS_CTRL_REG3_STRT;														// Cleared by the MEMS once the soft reset is done
+		*shadow = data;
+	}
+	if (reg_address == MEMS_CTRL_REG3 && (tx[1] & MEMS_CTRL_REG3_STRT))
+		mems_shadow_valid = false;																// Every register back to its default
+}
 
-	MEMS_setCSHigh();	
+/* Register value from the shadow when it is cached, from the MEMS otherwise */
+static uint8_t MEMS_getCachedData(uint8_t reg_address)
+{
+	uint8_t * shadow = MEMS_getShadow(reg_address);
+	
+	return (shadow != NULL) ? *shadow : MEMS_getData(reg_address);
 }
 
 uint8_t MEMS_getBitsInRegister(uint8_t reg_address, uint8_t bits)
 {
-	return (MEMS_getData(reg_address) & bits);
+	return (MEMS_getCachedData(reg_address) & bits);
 }
 
 void MEMS_setBitsInRegister(uint8_t reg_address, uint8_t bit)
 {
-	uint8_t reg_value = MEMS_getData(reg_address);
+	uint8_t reg_value = MEMS_getCachedData(reg_address);
 	reg_value |= bit;
 	MEMS_setData(reg_address, reg_value);	
 }
 
 void MEMS_setValueBitsInRegister(uint8_t reg_address, uint8_t bits, uint8_t data)
 {
-	uint8_t reg_value =  MEMS_getData(reg_address);
+	uint8_t reg_value =  MEMS_getCachedData(reg_address);
 	reg_value &= ~bits;
 	reg_value |= data; // caller has to shift data to the left accordingly to bits
 	MEMS_setData(reg_address, reg_value);		
@@ -139,6 +209,122 @@ uint16_t MEMS_getOutZ(void)
 	return rcvd_z;
 }
 
+void MEMS_getOutXYZ(int16_t out[3])
+{
+	uint8_t tx[7] = { 0x80 | MEMS_OUT_X_L };
+	uint8_t rx[7];
+	u32 key = MEMS_lockBus();
+	
+	MEMS_setCSLow();
+	SPI_transferBuffer(MEMS_SPI, tx, rx, 7);									// Address, then X_L, X_H, Y_L, Y_H, Z_L, Z_H
+	MEMS_setCSHigh();
+	IRQ_unlock(key);
+	
+	out[0] = (int16_t) ((rx[2] << 8) | rx[1]);
+	out[1] = (int16_t) ((rx[4] << 8) | rx[3]);
+	out[2] = (int16_t) ((rx[6] << 8) | rx[5]);
+}
+
+void MEMS_setBlockDataUpdate(bool enabled)
+{
+	MEMS_setValueBitsInRegister(MEMS_CTRL_REG4, MEMS_CTRL_REG4_BDU, enabled ? MEMS_CTRL_REG4_BDU : 0x0);
+}
+
+void MEMS_startFifoStream(uint8_t watermark, MEMS_FifoCallback callback, void * context)
+{
+	if (watermark == 0 || watermark >= MEMS_FIFO_SIZE)
+		watermark = MEMS_FIFO_SIZE - 1;
+	
+	mems_fifo_callback = callback;
+	mems_fifo_context = context;
+	
+	MEMS_setData(MEMS_FIFO_CTRL, MEMS_FIFO_CTRL_BYPASS);					// Empties the FIFO
+	MEMS_enableInt1();
+	
+	MEMS_setBitsInRegister(MEMS_CTRL_REG3, MEMS_CTRL_REG3_INT1_EN | MEMS_CTRL_REG3_IEA);	// INT1 active high
+	MEMS_setBitsInRegister(MEMS_CTRL_REG6, MEMS_CTRL_REG6_FIFO_EN | MEMS_CTRL_WTM_EN | MEMS_CTRL_REG6_P1_WTM);
+	MEMS_setData(MEMS_FIFO_CTRL, MEMS_FIFO_CTRL_STREAM | watermark);
+}
+
+void MEMS_stopFifoStream(void)
+{
+	MEMS_disableInt1();
+	
+	MEMS_setValueBitsInRegister(MEMS_CTRL_REG6, MEMS_CTRL_REG6_FIFO_EN | MEMS_CTRL_WTM_EN | MEMS_CTRL_REG6_P1_WTM, 0x0);
+	MEMS_setData(MEMS_FIFO_CTRL, MEMS_FIFO_CTRL_BYPASS);
+	mems_fifo_callback = NULL;
+}
+
+void MEMS_startDataReady(RING_Buffer * ring, MEMS_Notify notify, void * context)
+{
+	mems_ring = ring;
+	mems_notify = notify;
+	mems_notify_context = context;
+	MEMS_enableInt1();
+	MEMS_setBitsInRegister(MEMS_CTRL_REG3, MEMS_CTRL_REG3_DR_EN | MEMS_CTRL_REG3_INT1_EN | MEMS_CTRL_REG3_IEA);
+}
+
+void MEMS_stopDataReady(void)
+{
+	MEMS_disableInt1();
+	MEMS_setValueBitsInRegister(MEMS_CTRL_REG3, MEMS_CTRL_REG3_DR_EN, 0x0);
+	mems_ring = NULL;
+}
+
+uint8_t MEMS_readFifo(int16_t (*samples)[3])
+{
+	uint8_t src = MEMS_getData(MEMS_FIFO_SRC);
+	uint8_t count = (src & MEMS_FIFO_SRC_OVRN) ? MEMS_FIFO_SIZE : (src & MEMS_FIFO_SRC_FSS);
+	uint8_t i;
+	
+	if (src & MEMS_FIFO_SRC_EMPTY)
+		count = 0;
+	if (count == 0)
+		return 0;
+	
+	MEMS_getRegisters(MEMS_OUT_X_L, mems_fifo_rx, 6 * count);			// Address wraps from OUT_Z_H to OUT_X_L
+	
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t * rx = &mems_fifo_rx[6 * i];
+		
+		samples[i][0] = (int16_t) ((rx[1] << 8) | rx[0]);
+		samples[i][1] = (int16_t) ((rx[3] << 8) | rx[2]);
+		samples[i][2] = (int16_t) ((rx[5] << 8) | rx[4]);
+	}
+	return count;
+}
+
+/**
+ * INT1 interrupt: new sample (data-ready mode) or FIFO watermark reached.
+ * The sensor is read again while INT1 stays high, since a sample arriving
+ * during the read would otherwise keep it high with no new edge.
+ */
+static void MEMS_int1Handler(u8 line, void * context)
+{
+	uint32_t prof_start = PROF_BEGIN();
+	
+	(void) context;
+	do
+	{
+		EXTI_clearPending(line);
+		if (mems_ring != NULL)
+		{
+			MEMS_getOutXYZ(mems_fifo_samples[0]);
+			RING_push(mems_ring, mems_fifo_samples[0]);
+		}
+		else
+		{
+			uint8_t count = MEMS_readFifo(mems_fifo_samples);
+			if (count > 0 && mems_fifo_callback != NULL)
+				mems_fifo_callback(mems_fifo_samples, count, mems_fifo_context);
+		}
+	} while (GPIO_readPin(MEMS_GPIO_INT1, MEMS_PIN_INT1) == GPIO_PIN_HIGH);
+	if (mems_ring != NULL && mems_notify != NULL)
+		mems_notify(mems_notify_context);
+	PROF_END(mems_prof_int1, prof_start);
+}
+
 uint8_t MEMS_getTemperature(void)
 {
 	return MEMS_getData(MEMS_TEMPERATURE);
@@ -10,10 +10,34 @@
 * the value of an entire register and get the X/Y/Z accelerations and
 * temperature.
 *
-*		1. The Timer, interrupts, offset corrections are not supported.
-*		2. The initialization of LIS3DSH MEMS goes like this:
+*		1. The Timer, offset corrections are not supported. MEMS_init()
+*		enables the register address auto-increment which MEMS_getOutXYZ()
+*		and the FIFO burst reads rely on.
+*		2. The control registers (CTRL_REG3..6, OFFSET_*, CSHIFT_*) are
+*		cached by the service: the bit functions read the cache, so they
+*		cost a single SPI write.
+*		3. The initialization of LIS3DSH MEMS goes like this:
 *				MEMS_CLK_ENABLE();
 *       MEMS_init();
+*		4. The FIFO streaming mode raises INT1 (MEMS_PIN_INT1) when the FIFO
+*		reaches the watermark. Its EXTI callback then drains the whole FIFO
+*		in one SPI burst and hands the samples to the callback:
+*				MEMS_startFifoStream(25, on_samples, NULL);
+*		5. The data-ready mode raises INT1 for each new sample instead.
+*		The INT1 callback reads it and pushes it in a ring buffer of
+*		int16_t[3] elements, which the main loop empties at its own pace:
+*				RING_init(&ring, storage, sizeof(storage[0]), 64);
+*				MEMS_startDataReady(&ring, NULL, NULL);
+*				while (RING_pop(&ring, sample)) ...
+*		The notification wakes the reader instead of polling the ring, e.g.
+*		SCHED_signal (scheduler.h) with the event of the reader task.
+*		In both modes the INT1 handler reads the MEMS on SPI1: each MEMS_*
+*		call holds IRQ_lock(IRQ_LEVEL_DRIVER) for its CS window, so an INT1
+*		edge waits for the end of the frame. MEMS_setCSLow/High and other
+*		SPI1 users must do the same while a mode is started.
+*		6. Built with PROF_ENABLED, MEMS_init() registers the "MEMS_init",
+*		"MEMS_getData" and "MEMS_INT1" profiling sections, which measure
+*		these functions and the INT1 callback.
 *
 */
 
@@ -24,8 +48,12 @@
 #include "spi.h"
 #include "gpio.h"
 #include "rcc.h"
+#include "interrupt.h"
+#include "ring_buffer.h"
+#include "profiling.h"
 
 #define MEMS_SPI					SPI1																///< SPI connected to MEMS
+#define MEMS_SPI_MAX_HZ		10000000														///< SPC max of the LIS3DSH datasheet
 
 #define MEMS_GPIO_MAIN		GPIOA																///< GPIO used by MEMS
 #define MEMS_PIN_SCK			5
@@ -36,6 +64,10 @@
 
 #define MEMS_SPI_AF				5																		///< Mems Alternate Function Number
 
+#define MEMS_GPIO_INT1		GPIOE																///< INT1 line of the MEMS
+#define MEMS_PIN_INT1			0
+#define MEMS_INT1_EXTI_PORT	SYSCFG_EXTICR_EXTI_PE
+
 #define MEMS_GPIO_MAIN_CLK_ENABLE()			GPIOA_CLK_ENABLE();		///< Make sure this is consistent with defines above
 #define MEMS_GPIO_CS_CLK_ENABLE()				GPIOE_CLK_ENABLE();
 
@@ -78,6 +110,8 @@
 #define MEMS_OUT_Y_H 							0x2B 
 #define MEMS_OUT_Z_L 							0x2C
 #define MEMS_OUT_Z_H 							0x2D
+#define MEMS_FIFO_CTRL						0x2E
+#define MEMS_FIFO_SRC							0x2F
 
 /* Define bits in registers */
 #define MEMS_CTRL_REG3_DR_EN 			0x80
@@ -103,11 +137,25 @@
 #define MEMS_CTRL_REG6_FIFO_EN		0x40
 #define MEMS_CTRL_WTM_EN					0x20
 #define MEMS_CTRL_REG6_ADC_IN			0x10
+#define MEMS_CTRL_REG6_ADD_INC		0x10																///< Register address auto-increment (same bit as ADC_IN)
 #define MEMS_CTRL_REG6_P1_EMPTY		0x08
 #define MEMS_CTRL_REG6_P1_WTM			0x04
 #define MEMS_CTRL_REG6_P1_OVERRUN	0x02
 #define MEMS_CTRL_REG6_P2_BOOT		0x01
 
+#define MEMS_FIFO_CTRL_FMODE			0xE0
+#define MEMS_FIFO_CTRL_BYPASS			0x00
+#define MEMS_FIFO_CTRL_FIFO				0x20
+#define MEMS_FIFO_CTRL_STREAM			0x40
+#define MEMS_FIFO_CTRL_WTMP				0x1F
+
+#define MEMS_FIFO_SRC_WTM					0x80
+#define MEMS_FIFO_SRC_OVRN				0x40
+#define MEMS_FIFO_SRC_EMPTY				0x20
+#define MEMS_FIFO_SRC_FSS					0x1F
+
+#define MEMS_FIFO_SIZE						32																	///< Samples in the MEMS FIFO
+
 #define MEMS_STATUS_ZYXOR					0x80
 #define MEMS_STATUS_ZOR						0x40
 #define MEMS_STATUS_YOR						0x20
@@ -118,6 +166,22 @@
 #define MEMS_STATUS_XDA						0x10
 
 
+/**
+ * FIFO samples callback, called from the INT1 interrupt.
+ * @param[in]	samples X/Y/Z samples, oldest first (valid during the call only).
+ * @param[in]	count Number of samples.
+ * @param[in]	context Context given to MEMS_startFifoStream().
+ */
+typedef void (*MEMS_FifoCallback)(int16_t (*samples)[3], uint8_t count, void * context);
+
+/**
+ * Data-ready notification, called from the INT1 interrupt once the samples
+ * are pushed in the ring buffer.
+ * @param[in]	context Context given to MEMS_startDataReady().
+ */
+typedef void (*MEMS_Notify)(void * context);
+
+
 /*----------------------------------------------------------------------------
    LIS3DSH MEMS Methods
  *----------------------------------------------------------------------------*/
@@ -143,11 +207,21 @@ void MEMS_setCSLow(void);
  */
 void MEMS_setCSHigh(void);
 
+/**
+ * MEMS shadow resynchronised.
+ * This function reads back the registers cached by the service (CTRL_REG3..6,
+ * OFFSET_X/Y/Z, CSHIFT_X/Y/Z) in two bursts.
+ * @par MEMS_init() calls it. Call it again if the MEMS was reset or its
+ * registers were written without MEMS_setData().
+ */
+void MEMS_resyncShadow(void);
+
 /**
  * MEMS get register value.
  * This function returns the value of the specified MEMS register.
  * @param[in] reg_address Address of the register.
  * @retval uint8_t Value of the 8-bit register.
+ * @par The register is always read from the MEMS, even when it is cached.
  */
 uint8_t MEMS_getData(uint8_t reg_address);
 
@@ -156,6 +230,9 @@ uint8_t MEMS_getData(uint8_t reg_address);
  * This function sets the specified MEMS register to the specified value.
  * @param[in] reg_address Address of the register.
  * @param[in] data Value of the 8-bit register.
+ * @par The shadow of a cached register is written through, without the
+ * self-clearing BOOT and STRT bits. A soft reset (CTRL_REG3 STRT) drops
+ * the shadow: call MEMS_resyncShadow() once the MEMS restarted.
  */
 void MEMS_setData(uint8_t reg_address, uint8_t data);
 
@@ -208,6 +285,69 @@ uint16_t MEMS_getOutY(void);
  */
 uint16_t MEMS_getOutZ(void);
 
+/**
+ * MEMS get X/Y/Z accelerations.
+ * This function reads OUT_X_L..OUT_Z_H in a single CS window using the
+ * register address auto-increment of the MEMS.
+ * @param[out] out X, Y and Z accelerations (signed).
+ * @par The 3 axes come from the same sample as long as the read ends before
+ * the next sample (or Block Data Update is enabled).
+ */
+void MEMS_getOutXYZ(int16_t out[3]);
+
+/**
+ * MEMS Block Data Update configured.
+ * This function sets or clears MEMS_CTRL_REG4_BDU. When set, the output
+ * registers of an axis are not updated between the reads of its low and high bytes.
+ * @param[in] enabled true to enable Block Data Update.
+ */
+void MEMS_setBlockDataUpdate(bool enabled);
+
+/**
+ * MEMS FIFO streaming started.
+ * This function empties the FIFO, puts it in stream mode and routes the
+ * watermark to INT1, configured on the EXTI with a rising edge.
+ * @param[in] watermark Number of samples (1..31) which raises INT1.
+ * @param[in] callback Function receiving the samples (may be NULL).
+ * @param[in] context Passed to the callback.
+ * @par The output data rate is not changed: set CTRL_REG4 ODR beforehand.
+ */
+void MEMS_startFifoStream(uint8_t watermark, MEMS_FifoCallback callback, void * context);
+
+/**
+ * MEMS FIFO streaming stopped.
+ * This function disables the INT1 interrupt and puts the FIFO back in bypass mode.
+ */
+void MEMS_stopFifoStream(void);
+
+/**
+ * MEMS data-ready acquisition started.
+ * This function routes the data-ready signal to INT1 (CTRL_REG3 DR_EN and
+ * INT1_EN), configured on the EXTI with a rising edge. Each sample is then
+ * pushed in the ring buffer from the interrupt.
+ * @param[in] ring Ring buffer of int16_t[3] elements. Samples arriving while it
+ * is full are dropped and counted by RING_getOverruns().
+ * @param[in] notify Called from the interrupt after the samples are pushed, may be NULL.
+ * @param[in] context Passed to notify.
+ * @par The FIFO streaming mode must be stopped. The output data rate is not changed.
+ */
+void MEMS_startDataReady(RING_Buffer * ring, MEMS_Notify notify, void * context);
+
+/**
+ * MEMS data-ready acquisition stopped.
+ * This function disables the INT1 interrupt and the data-ready signal.
+ */
+void MEMS_stopDataReady(void);
+
+/**
+ * MEMS FIFO read.
+ * This function reads FIFO_SRC, then all the samples it reports in a single
+ * CS window (the address wraps from OUT_Z_H to OUT_X_L while the FIFO is enabled).
+ * @param[out] samples Buffer of MEMS_FIFO_SIZE samples.
+ * @retval uint8_t Number of samples read.
+ */
+uint8_t MEMS_readFifo(int16_t (*samples)[3]);
+
 /**
  * MEMS get temperature.
  * This function returns the temperature.
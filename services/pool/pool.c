@@ -0,0 +1,129 @@
+/**
+* @file 		pool.c
+* @brief		Source file of the fixed-block memory pool service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions required to allocate and free
+* blocks of one size from the main loop and from the interrupt handlers,
+* in constant time and without masking interrupts.
+*
+*/
+
+#include "pool.h"
+
+#define POOL_END					0xFFFF													///< Index of the end of the free list
+#define POOL_INDEX				0xFFFF													///< Index field of head
+#define POOL_TAG_ONE			0x10000													///< Tag increment of head
+
+/* Link to the next free block, in the first word of a free block */
+#define POOL_LINK(pool, index)		(*(volatile uint32_t *) &(pool)->storage[(index) * (pool)->block_size])
+
+static uint32_t POOL_add(volatile uint32_t * counter, int32_t value)
+{
+	uint32_t count;
+
+	do
+	{
+		count = __LDREXW(counter) + value;
+	} while (__STREXW(count, counter) != 0);
+	return count;
+}
+
+static void POOL_raisePeak(POOL_Pool * pool, uint32_t used)
+{
+	uint32_t peak;
+
+	do
+	{
+		peak = __LDREXW(&pool->peak);
+		if (peak >= used)
+		{
+			__CLREX();
+			return;
+		}
+	} while (__STREXW(used, &pool->peak) != 0);
+}
+
+bool POOL_init(POOL_Pool * pool, uint64_t * storage, uint32_t size, uint32_t count)
+{
+	uint32_t i;
+
+	if (size == 0 || count == 0 || count > POOL_MAX_BLOCKS)
+		return false;
+
+	pool->storage = (uint8_t *) storage;
+	pool->block_size = POOL_BLOCK_UNITS(size) * POOL_ALIGN;
+	pool->count = count;
+	for (i = 0; i < count; i++)
+		POOL_LINK(pool, i) = (i + 1 < count) ? i + 1 : POOL_END;
+	pool->head = 0;
+	pool->used = 0;
+	pool->peak = 0;
+	pool->failures = 0;
+	return true;
+}
+
+void * POOL_alloc(POOL_Pool * pool)
+{
+	uint32_t head, index;
+
+	// First block popped unless another context changed head in between
+	do
+	{
+		head = __LDREXW(&pool->head);
+		index = head & POOL_INDEX;
+		if (index == POOL_END)															// Empty
+		{
+			__CLREX();
+			POOL_add(&pool->failures, 1);
+			return NULL;
+		}
+	} while (__STREXW(((head & ~POOL_INDEX) + POOL_TAG_ONE) | (POOL_LINK(pool, index) & POOL_INDEX), &pool->head) != 0);
+
+	POOL_raisePeak(pool, POOL_add(&pool->used, 1));
+	return &pool->storage[index * pool->block_size];
+}
+
+bool POOL_free(POOL_Pool * pool, void * block)
+{
+	uintptr_t offset = (uintptr_t) block - (uintptr_t) pool->storage;		// Wraps around below the storage
+	uint32_t head, index;
+
+	if (offset >= (uintptr_t) pool->count * pool->block_size || offset % pool->block_size != 0)
+		return false;
+	index = offset / pool->block_size;
+
+	POOL_add(&pool->used, -1);
+	do
+	{
+		head = __LDREXW(&pool->head);
+		POOL_LINK(pool, index) = head & POOL_INDEX;
+		__DMB();																							// Link written before the block is published
+	} while (__STREXW(((head & ~POOL_INDEX) + POOL_TAG_ONE) | index, &pool->head) != 0);
+	return true;
+}
+
+uint32_t POOL_getUsed(const POOL_Pool * pool)
+{
+	return pool->used;
+}
+
+uint32_t POOL_getPeak(const POOL_Pool * pool)
+{
+	return pool->peak;
+}
+
+uint32_t POOL_getFailures(const POOL_Pool * pool)
+{
+	return pool->failures;
+}
+
+void POOL_resetPeak(POOL_Pool * pool)
+{
+	do
+	{
+		__LDREXW(&pool->peak);
+	} while (__STREXW(pool->used, &pool->peak) != 0);
+}
@@ -0,0 +1,120 @@
+/**
+* @file 		pool.h
+* @brief		Header file of the fixed-block memory pool service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to allocate and free
+* blocks of one size (sample blocks, transaction descriptors) from the
+* main loop and from the interrupt handlers, in constant time.
+*
+*		1. The storage of a pool is a static array sized at compile time
+*		with POOL_STORAGE_SIZE(): a count out of range doesn't compile. There
+*		is no heap (Heap_Size 0 in startup_stm32f40_41xxx.s), the blocks
+*		are never shared between two pools.
+*		2. The free blocks are linked by their index in their first word.
+*		POOL_alloc() pops the first one, POOL_free() pushes it back, both
+*		with LDREX/STREX on head and without masking interrupts: a handler
+*		which allocates in between makes the STREX fail (its exception
+*		return clears the monitor) and the operation starts again. head
+*		carries a tag incremented by each change, so that a head which came
+*		back to the same block (ABA) is detected on the host threads too.
+*		3. The statistics (blocks in use, peak, failed allocations) are
+*		updated after the pop and before the push: they are never above the
+*		real values and exact when no allocation or free is in progress.
+*		4. Use it as follow:
+*				static uint64_t blocks[POOL_STORAGE_SIZE(sizeof(Sample), 8)];
+*				static POOL_Pool samples;
+*				POOL_init(&samples, blocks, sizeof(Sample), 8);
+*
+*				Sample * sample = (Sample *) POOL_alloc(&samples);	// NULL when empty
+*				...
+*				POOL_free(&samples, sample);
+*
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+#define POOL_MAX_BLOCKS			0xFFFE																///< Blocks of a pool, index 0xFFFF ends the list
+#define POOL_ALIGN					sizeof(uint64_t)											///< Block alignment and size granularity
+
+/* Storage units of count blocks of size bytes, count checked at compile time */
+#define POOL_BLOCK_UNITS(size)					(((size) + POOL_ALIGN - 1) / POOL_ALIGN)
+#define POOL_STORAGE_SIZE(size, count)	((count) * POOL_BLOCK_UNITS(size) \
+																					+ 0 * sizeof(char[((count) >= 1 && (count) <= POOL_MAX_BLOCKS) ? 1 : -1]))
+
+typedef struct
+{
+	uint8_t * storage;
+	uint32_t block_size;									///< Size of a block rounded up to POOL_ALIGN
+	uint32_t count;												///< Number of blocks
+	volatile uint32_t head;								///< Tag << 16 | index of the first free block (LDREX/STREX)
+	volatile uint32_t used;								///< Blocks allocated (LDREX/STREX)
+	volatile uint32_t peak;								///< Highest used (LDREX/STREX)
+	volatile uint32_t failures;						///< Allocations on an empty pool (LDREX/STREX)
+}POOL_Pool;
+
+/**
+ * Pool initialised.
+ * This function links all the blocks of the storage in the free list.
+ * @param[out]	pool Pool to initialise.
+ * @param[in]	storage Array of POOL_STORAGE_SIZE(size, count) uint64_t.
+ * @param[in]	size Size of a block in bytes (at least 1).
+ * @param[in]	count Number of blocks (1..POOL_MAX_BLOCKS).
+ * @retval bool false if size or count is out of range.
+ * @par Must not be called while the pool is used.
+ */
+bool POOL_init(POOL_Pool * pool, uint64_t * storage, uint32_t size, uint32_t count);
+
+/**
+ * Block allocated.
+ * Constant time, interrupt-safe.
+ * @param[in]	pool Pool.
+ * @retval void* Block of the pool, aligned on POOL_ALIGN, or NULL if all
+ * of them are in use (counted as a failure).
+ */
+void * POOL_alloc(POOL_Pool * pool);
+
+/**
+ * Block freed.
+ * Constant time, interrupt-safe.
+ * @param[in]	pool Pool the block was allocated from.
+ * @param[in]	block Block returned by POOL_alloc().
+ * @retval bool false if block isn't a block of the pool: nothing is done.
+ * @par A block freed twice is not detected.
+ */
+bool POOL_free(POOL_Pool * pool, void * block);
+
+/**
+ * Blocks in use.
+ * @param[in]	pool Pool.
+ * @retval uint32_t Blocks allocated and not freed.
+ */
+uint32_t POOL_getUsed(const POOL_Pool * pool);
+
+/**
+ * High-water mark.
+ * @param[in]	pool Pool.
+ * @retval uint32_t Most blocks in use at once since POOL_init() or POOL_resetPeak().
+ */
+uint32_t POOL_getPeak(const POOL_Pool * pool);
+
+/**
+ * Failed allocations.
+ * @param[in]	pool Pool.
+ * @retval uint32_t POOL_alloc() calls which returned NULL since POOL_init().
+ */
+uint32_t POOL_getFailures(const POOL_Pool * pool);
+
+/**
+ * High-water mark restarted from the blocks in use.
+ * @param[in]	pool Pool.
+ */
+void POOL_resetPeak(POOL_Pool * pool);
+
+#endif
@@ -0,0 +1,192 @@
+/**
+* @file 		profiling.c
+* @brief		Source file of the timestamp and profiling service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file of the functions required to read a 64-bit cycle
+* timestamp and to measure the duration of code sections.
+*
+*/
+
+#include "profiling.h"
+#include <string.h>
+#include "rcc.h"
+#include "timer.h"
+
+#ifdef PROF_HOST_CLOCK
+#include <time.h>
+#endif
+
+static PROF_Section prof_sections[PROF_MAX_SECTIONS];
+static uint8_t prof_count;
+
+/*----------------------------------------------------------------------------
+  Timestamp
+ *----------------------------------------------------------------------------*/
+
+#ifdef PROF_HOST_CLOCK
+
+void PROF_init(void)
+{
+}
+
+uint64_t PROF_getTimestamp(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint32_t PROF_getFrequency(void)
+{
+	return 1000000000;
+}
+
+uint32_t PROF_begin(void)
+{
+	return (uint32_t) PROF_getTimestamp();
+}
+
+#else
+
+void PROF_init(void)
+{
+	uint32_t primask;
+
+	TIM2_CLK_ENABLE();
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	TIM_initUpcount(PROF_TIM);
+	// TIM2 clock = core clock / 1, 2, 4 or 8: prescaled to one count every 2^PROF_TIM_SHIFT cycles
+	TIM_setPSC(PROF_TIM, (u16) ((0x1UL << PROF_TIM_SHIFT) / (SystemCoreClock / TIM_getClock(PROF_TIM)) - 1));
+	TIM_setARR(PROF_TIM, TIM_ARR_MAX_32);
+
+	// Both counters from 0 within a few cycles
+	primask = __get_PRIMASK();
+	__disable_irq();
+	TIM_resetCNT(PROF_TIM);																// Loads PSC, clears the prescaler counter
+	DWT->CYCCNT = 0;
+	TIM_enable(PROF_TIM);
+	__set_PRIMASK(primask);
+}
+
+uint64_t PROF_getTimestamp(void)
+{
+	uint32_t cycles = DWT->CYCCNT;
+	uint64_t coarse = (uint64_t) PROF_TIM->CNT << PROF_TIM_SHIFT;
+
+	// coarse is within 2^31 cycles of the timestamp, CYCCNT gives its low 32 bits
+	return coarse + (int32_t) (cycles - (uint32_t) coarse);
+}
+
+uint32_t PROF_getFrequency(void)
+{
+	return SystemCoreClock;
+}
+
+uint32_t PROF_begin(void)
+{
+	return DWT->CYCCNT;
+}
+
+#endif
+
+
+/*----------------------------------------------------------------------------
+  Sections
+ *----------------------------------------------------------------------------*/
+
+static void PROF_clear(PROF_Section * section)
+{
+	const char * name = section->name;
+
+	memset(section, 0, sizeof(*section));
+	section->name = name;
+	section->min = 0xFFFFFFFF;
+}
+
+PROF_Id PROF_register(const char * name)
+{
+	PROF_Id id;
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	for (id = 0; id < prof_count; id++)
+	{
+		if (strcmp(prof_sections[id].name, name) == 0)
+			break;
+	}
+	if (id == prof_count)
+	{
+		if (prof_count < PROF_MAX_SECTIONS)
+		{
+			prof_sections[id].name = name;
+			PROF_clear(&prof_sections[id]);
+			prof_count++;
+		}
+		else
+		{
+			id = PROF_NONE;
+		}
+	}
+	__set_PRIMASK(primask);
+
+	return id;
+}
+
+void PROF_end(PROF_Id id, uint32_t start)
+{
+	uint32_t duration = PROF_begin() - start;
+	PROF_Section * section;
+	uint32_t primask;
+
+	if (id >= prof_count)
+		return;
+	section = &prof_sections[id];
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	section->count++;
+	section->total += duration;
+	if (duration < section->min)
+		section->min = duration;
+	if (duration > section->max)
+		section->max = duration;
+	section->histogram[duration == 0 ? 0 : 31 - __CLZ(duration)]++;
+	__set_PRIMASK(primask);
+}
+
+const PROF_Section * PROF_getSection(PROF_Id id)
+{
+	if (id >= prof_count)
+		return NULL;
+	return &prof_sections[id];
+}
+
+uint8_t PROF_getSectionCount(void)
+{
+	return prof_count;
+}
+
+uint32_t PROF_getMean(const PROF_Section * section)
+{
+	if (section->count == 0)
+		return 0;
+	return (uint32_t) (section->total / section->count);
+}
+
+void PROF_reset(void)
+{
+	uint8_t id;
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	for (id = 0; id < prof_count; id++)
+		PROF_clear(&prof_sections[id]);
+	__set_PRIMASK(primask);
+}
@@ -0,0 +1,155 @@
+/**
+* @file 		profiling.h
+* @brief		Header file of the timestamp and profiling service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to read a 64-bit cycle
+* timestamp and to measure the duration of code sections: count, min,
+* max, mean and log2 histogram per section.
+*
+*		1. The timestamp counts the core clock cycles (168 MHz). DWT CYCCNT
+*		gives the low 32 bits, TIM2 counts every 2^PROF_TIM_SHIFT cycles
+*		and tells how many times CYCCNT wrapped: the timestamp covers 2^48
+*		cycles (19 days) without interrupt nor periodic read. PROF_init()
+*		takes TIM2 for itself.
+*		2. Built with PROF_HOST_CLOCK, the timestamp is the Linux
+*		CLOCK_MONOTONIC in ns instead, so that the same sections can be
+*		measured in the host benchmarks. PROF_getFrequency() gives the unit.
+*		3. The durations are 32-bit: a section must be shorter than 2^32
+*		timestamp units (25 s on target, 4 s on host).
+*		4. The sections are kept in a static table of PROF_MAX_SECTIONS
+*		entries, registered by name. PROF_end() masks the interrupts for a
+*		few instructions, the same section may be ended from the main loop
+*		and from an interrupt.
+*		5. The drivers and services are instrumented with the PROF_REGISTER,
+*		PROF_BEGIN and PROF_END macros, which compile to nothing unless
+*		PROF_ENABLED is defined:
+*				static PROF_Id prof_read = PROF_NONE;
+*				prof_read = PROF_REGISTER("read");					// once, at init
+*				uint32_t start = PROF_BEGIN();
+*				...
+*				PROF_END(prof_read, start);
+*		6. Initialization of the service on target:
+*				PROF_init();
+*
+*/
+
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+#define PROF_MAX_SECTIONS				16									///< Entries of the section table
+#define PROF_HISTOGRAM_BINS			32									///< One bin per power of two of the 32-bit durations
+#define PROF_NONE								0xFF								///< Id of no section, ignored by PROF_end
+#define PROF_TIM								TIM2								///< 32-bit timer extending CYCCNT
+#define PROF_TIM_SHIFT					16									///< log2 of the cycles per PROF_TIM increment
+
+typedef uint8_t PROF_Id;
+
+/* Statistics of a section, durations in timestamp units */
+typedef struct
+{
+	const char * name;
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;																			///< Sum of the durations, mean is total / count
+	uint32_t histogram[PROF_HISTOGRAM_BINS];							///< Bin n counts the durations in [2^n, 2^(n+1)), bin 0 also counts 0
+}PROF_Section;
+
+#ifdef PROF_ENABLED
+#define PROF_REGISTER(name)					PROF_register(name)
+#define PROF_BEGIN()								PROF_begin()
+#define PROF_END(id, start)					PROF_end((id), (start))
+#else
+#define PROF_REGISTER(name)					((PROF_Id) PROF_NONE)
+#define PROF_BEGIN()								((uint32_t) 0)
+#define PROF_END(id, start)					((void) (id), (void) (start))
+#endif
+
+
+/*----------------------------------------------------------------------------
+  Timestamp
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Timestamp initialised.
+ * This function enables DWT CYCCNT and starts TIM2 (clock enabled by the
+ * function), both from 0. Nothing is done with PROF_HOST_CLOCK.
+ * @par The TIM2 prescaler depends on the clock tree: call it again after
+ * a change of the AHB or APB1 prescalers.
+ */
+void PROF_init(void);
+
+/**
+ * 64-bit timestamp.
+ * @retval uint64_t Cycles since PROF_init (ns with PROF_HOST_CLOCK).
+ * @par Lock-free: CYCCNT and TIM2 are read once each.
+ */
+uint64_t PROF_getTimestamp(void);
+
+/**
+ * Timestamp frequency.
+ * @retval uint32_t Timestamp units per second.
+ */
+uint32_t PROF_getFrequency(void);
+
+
+/*----------------------------------------------------------------------------
+  Sections
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Section registered.
+ * @param[in]	name Name of the section, kept by reference.
+ * @retval PROF_Id Id of the section already registered with this name, or
+ * of a new one. PROF_NONE if the table is full.
+ */
+PROF_Id PROF_register(const char * name);
+
+/**
+ * Start of a section.
+ * @retval uint32_t Low 32 bits of the timestamp, to pass to PROF_end.
+ */
+uint32_t PROF_begin(void);
+
+/**
+ * End of a section.
+ * This function adds the time elapsed since start to the statistics of
+ * the section.
+ * @param[in]	id Section, nothing is done for PROF_NONE.
+ * @param[in]	start Value returned by PROF_begin.
+ */
+void PROF_end(PROF_Id id, uint32_t start);
+
+/**
+ * Statistics of a section.
+ * @param[in]	id Section.
+ * @retval const PROF_Section* NULL if id isn't registered.
+ */
+const PROF_Section * PROF_getSection(PROF_Id id);
+
+/**
+ * Number of registered sections.
+ * @retval uint8_t The ids are 0 to this value - 1.
+ */
+uint8_t PROF_getSectionCount(void);
+
+/**
+ * Mean duration of a section.
+ * @param[in]	section Section.
+ * @retval uint32_t Mean in timestamp units, 0 if the section never ended.
+ */
+uint32_t PROF_getMean(const PROF_Section * section);
+
+/**
+ * Statistics cleared.
+ * The sections stay registered.
+ */
+void PROF_reset(void);
+
+#endif
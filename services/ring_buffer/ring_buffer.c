@@ -0,0 +1,67 @@
+/**
+* @file 		ring_buffer.c
+* @brief		Source file of the lock-free ring buffer service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions required to pass fixed-size
+* elements from one producer to one consumer (typically an interrupt
+* handler and the main loop) without masking interrupts.
+*
+*/
+
+#include <string.h>
+#include "ring_buffer.h"
+
+bool RING_init(RING_Buffer * ring, void * storage, uint16_t element_size, uint32_t size)
+{
+	if (size == 0 || (size & (size - 1)) != 0)
+		return false;
+	
+	ring->storage = (uint8_t *) storage;
+	ring->element_size = element_size;
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->overruns = 0;
+	return true;
+}
+
+bool RING_push(RING_Buffer * ring, const void * element)
+{
+	uint32_t head = ring->head;
+	
+	if (head - ring->tail > ring->mask)										// Full
+	{
+		ring->overruns++;
+		return false;
+	}
+	memcpy(&ring->storage[(head & ring->mask) * ring->element_size], element, ring->element_size);
+	__DMB();																							// Element written before it is published
+	ring->head = head + 1;
+	return true;
+}
+
+bool RING_pop(RING_Buffer * ring, void * element)
+{
+	uint32_t tail = ring->tail;
+	
+	if (ring->head == tail)																// Empty
+		return false;
+	__DMB();																							// Head read before the element
+	memcpy(element, &ring->storage[(tail & ring->mask) * ring->element_size], ring->element_size);
+	__DMB();																							// Element read before its slot is released
+	ring->tail = tail + 1;
+	return true;
+}
+
+uint32_t RING_getCount(const RING_Buffer * ring)
+{
+	return ring->head - ring->tail;
+}
+
+uint32_t RING_getOverruns(const RING_Buffer * ring)
+{
+	return ring->overruns;
+}
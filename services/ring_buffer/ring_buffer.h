@@ -0,0 +1,85 @@
+/**
+* @file 		ring_buffer.h
+* @brief		Header file of the lock-free ring buffer service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to pass fixed-size
+* elements from one producer to one consumer (typically an interrupt
+* handler and the main loop) without masking interrupts.
+*
+*		1. Only the producer writes head, only the consumer writes tail: a
+*		push and a pop never race on the same index. __DMB() orders the copy
+*		of an element and the publication of the index.
+*		2. The number of elements must be a power of two. The indices are
+*		free-running, so all the elements of the storage are usable.
+*		3. A push on a full ring drops the new element and counts an overrun.
+*		4. Use it as follow:
+*				static int16_t storage[64][3];
+*				static RING_Buffer ring;
+*				RING_init(&ring, storage, sizeof(storage[0]), 64);
+*				RING_push(&ring, sample);					// producer
+*				while (RING_pop(&ring, sample))		// consumer
+*					...
+*
+*/
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+typedef struct
+{
+	uint8_t * storage;
+	uint16_t element_size;
+	uint32_t mask;												///< Number of elements - 1
+	volatile uint32_t head;								///< Elements pushed (written by the producer only)
+	volatile uint32_t tail;								///< Elements popped (written by the consumer only)
+	volatile uint32_t overruns;						///< Elements dropped (written by the producer only)
+} RING_Buffer;
+
+/**
+ * Ring buffer initialised.
+ * @param[out]	ring Ring buffer to initialise.
+ * @param[in]	storage Memory of size * element_size bytes.
+ * @param[in]	element_size Size of an element in bytes.
+ * @param[in]	size Number of elements, power of two.
+ * @retval bool false if size isn't a power of two.
+ * @par Must not be called while the producer or the consumer runs.
+ */
+bool RING_init(RING_Buffer * ring, void * storage, uint16_t element_size, uint32_t size);
+
+/**
+ * Element pushed (producer side).
+ * @param[in]	ring Ring buffer.
+ * @param[in]	element Element to copy.
+ * @retval bool false if the ring is full: the element is dropped and counted as overrun.
+ */
+bool RING_push(RING_Buffer * ring, const void * element);
+
+/**
+ * Element popped (consumer side).
+ * @param[in]	ring Ring buffer.
+ * @param[out]	element Element copied out of the ring.
+ * @retval bool false if the ring is empty.
+ */
+bool RING_pop(RING_Buffer * ring, void * element);
+
+/**
+ * Number of elements in the ring.
+ * @param[in]	ring Ring buffer.
+ * @retval uint32_t Elements pushed and not popped yet.
+ */
+uint32_t RING_getCount(const RING_Buffer * ring);
+
+/**
+ * Number of elements dropped because the ring was full.
+ * @param[in]	ring Ring buffer.
+ * @retval uint32_t Overruns since RING_init().
+ */
+uint32_t RING_getOverruns(const RING_Buffer * ring);
+
+#endif
@@ -0,0 +1,156 @@
+/**
+* @file 		scheduler.c
+* @brief		Source file of the cooperative scheduler service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions required to run the application as
+* run-to-completion tasks woken by events.
+*
+*/
+
+#include "scheduler.h"
+
+/* Ready tasks of a priority, in the order they became ready */
+typedef struct
+{
+	SCHED_Task * head;
+	SCHED_Task * tail;
+}SCHED_Queue;
+
+static SCHED_Queue sched_queues[SCHED_PRIORITIES];
+static volatile uint32_t sched_ready;												///< Bit n set when queue n isn't empty
+static uint32_t sched_runs;
+static uint32_t sched_idles;
+
+/*----------------------------------------------------------------------------
+  Tasks
+ *----------------------------------------------------------------------------*/
+
+void SCHED_init(void)
+{
+	uint8_t priority;
+
+	for (priority = 0; priority < SCHED_PRIORITIES; priority++)
+	{
+		sched_queues[priority].head = NULL;
+		sched_queues[priority].tail = NULL;
+	}
+	sched_ready = 0;
+	sched_runs = 0;
+	sched_idles = 0;
+}
+
+bool SCHED_initTask(SCHED_Task * task, SCHED_Function function, void * context, uint8_t priority)
+{
+	if (function == NULL || priority >= SCHED_PRIORITIES)
+		return false;
+
+	task->function = function;
+	task->context = context;
+	task->priority = priority;
+	task->events = 0;
+	task->ready = false;
+	task->next = NULL;
+	return true;
+}
+
+void SCHED_post(SCHED_Task * task, uint32_t events)
+{
+	SCHED_Queue * queue;
+	uint32_t primask;
+
+	if (events == 0)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	task->events |= events;
+	if (!task->ready)
+	{
+		queue = &sched_queues[task->priority];
+		task->ready = true;
+		task->next = NULL;
+		if (queue->tail != NULL)
+			queue->tail->next = task;
+		else
+			queue->head = task;
+		queue->tail = task;
+		sched_ready |= (0x1UL << task->priority);
+	}
+	__set_PRIMASK(primask);
+}
+
+void SCHED_signal(void * event)
+{
+	SCHED_post(((SCHED_Event *) event)->task, ((SCHED_Event *) event)->events);
+}
+
+
+/*----------------------------------------------------------------------------
+  Run
+ *----------------------------------------------------------------------------*/
+
+bool SCHED_runNext(void)
+{
+	SCHED_Queue * queue;
+	SCHED_Task * task;
+	uint32_t events, ready, primask;
+
+	// Task dequeued with its flags: the ones posted while it runs queue it again
+	primask = __get_PRIMASK();
+	__disable_irq();
+	ready = sched_ready;
+	if (ready == 0)
+	{
+		__set_PRIMASK(primask);
+		return false;
+	}
+	queue = &sched_queues[31 - __CLZ(ready & -ready)];						// Lowest bit, the most urgent
+	task = queue->head;
+	queue->head = task->next;
+	if (queue->head == NULL)
+	{
+		queue->tail = NULL;
+		sched_ready = ready & ~(0x1UL << task->priority);
+	}
+	events = task->events;
+	task->events = 0;
+	task->ready = false;
+	__set_PRIMASK(primask);
+
+	sched_runs++;
+	task->function(events, task->context);
+	return true;
+}
+
+void SCHED_runOnce(void)
+{
+	while (SCHED_runNext());
+
+	// Masked, an event posted between the test and WFI still wakes it up
+	__disable_irq();
+	if (sched_ready == 0)
+	{
+		sched_idles++;
+		__WFI();
+	}
+	__enable_irq();
+}
+
+void SCHED_run(void)
+{
+	for (;;)
+		SCHED_runOnce();
+}
+
+uint32_t SCHED_getRunCount(void)
+{
+	return sched_runs;
+}
+
+uint32_t SCHED_getIdleCount(void)
+{
+	return sched_idles;
+}
@@ -0,0 +1,134 @@
+/**
+* @file 		scheduler.h
+* @brief		Header file of the cooperative scheduler service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to run the application as
+* run-to-completion tasks woken by events, instead of a main loop
+* polling the drivers. The core sleeps (WFI) when no task is ready.
+*
+*		1. A task is a function called with the event flags posted to it
+*		since its last run, 32 flags per task. It runs to completion and
+*		is only preempted by the interrupts.
+*		2. The flags are posted from any context, interrupt handlers
+*		included: SCHED_post() ORs them in the task and queues it when it
+*		isn't already. The interrupts are masked for a few instructions.
+*		3. SCHED_PRIORITIES ready queues, 0 the most urgent. The most
+*		urgent ready task runs first, the tasks of a priority in the order
+*		they became ready. A task posted while it runs runs again after.
+*		4. SCHED_signal() posts a SCHED_Event: its signature is the one of
+*		the callbacks of the drivers and services (SPI, timer wheel, work
+*		queue, MEMS data-ready), they post events without glue code:
+*				static SCHED_Event samples_ready = { &sensor, EVENT_SAMPLES };
+*				MEMS_startDataReady(&ring, SCHED_signal, &samples_ready);
+*		5. Use it as follow:
+*				SCHED_init();
+*				SCHED_initTask(&sensor, on_sensor, NULL, 0);
+*				SCHED_initTask(&display, on_display, NULL, 2);
+*				...
+*				SCHED_run();												// never returns
+*
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+#define SCHED_PRIORITIES				8										///< Ready queues, 0 the most urgent
+
+typedef void (*SCHED_Function)(uint32_t events, void * context);
+
+/* Task, in a ready queue while events are posted to it */
+typedef struct SCHED_Task
+{
+	SCHED_Function function;
+	void * context;
+	uint8_t priority;
+	volatile uint32_t events;														///< Flags posted since the last run
+	volatile bool ready;																///< In its ready queue
+	struct SCHED_Task * next;														///< Next ready task of the priority
+}SCHED_Task;
+
+/* Flags to post to a task, as context of a callback */
+typedef struct
+{
+	SCHED_Task * task;
+	uint32_t events;
+}SCHED_Event;
+
+
+/*----------------------------------------------------------------------------
+  Tasks
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Scheduler initialised.
+ * This function empties the ready queues and clears the counters.
+ */
+void SCHED_init(void);
+
+/**
+ * Task initialised.
+ * @param[out]	task Task, not ready.
+ * @param[in]	function Function of the task.
+ * @param[in]	context Passed to the function.
+ * @param[in]	priority Priority (0..SCHED_PRIORITIES-1), 0 the most urgent.
+ * @retval bool False if priority is out of range or function is NULL.
+ */
+bool SCHED_initTask(SCHED_Task * task, SCHED_Function function, void * context, uint8_t priority);
+
+/**
+ * Events posted to a task (any context).
+ * @param[in]	task Task initialised by SCHED_initTask.
+ * @param[in]	events Flags ORed with the ones not handled yet, 0 does nothing.
+ */
+void SCHED_post(SCHED_Task * task, uint32_t events);
+
+/**
+ * Event posted (any context).
+ * @param[in]	event SCHED_Event: task and flags.
+ * @par Signature of SPI_Callback, WHEEL_Callback, WORK_Function and MEMS_Notify.
+ */
+void SCHED_signal(void * event);
+
+
+/*----------------------------------------------------------------------------
+  Run
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Most urgent ready task run.
+ * @retval bool False if no task was ready.
+ */
+bool SCHED_runNext(void);
+
+/**
+ * Ready tasks run, then sleep.
+ * This function runs the tasks until none is ready, then waits for an
+ * interrupt (WFI) and returns once its handler ran.
+ */
+void SCHED_runOnce(void);
+
+/**
+ * Scheduler run forever.
+ * This function calls SCHED_runOnce in a loop, it never returns.
+ */
+void SCHED_run(void);
+
+/**
+ * Tasks run since SCHED_init.
+ * @retval uint32_t Number of task functions called.
+ */
+uint32_t SCHED_getRunCount(void);
+
+/**
+ * Sleeps since SCHED_init.
+ * @retval uint32_t Number of WFI with no task ready.
+ */
+uint32_t SCHED_getIdleCount(void);
+
+#endif
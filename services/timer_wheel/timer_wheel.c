@@ -0,0 +1,419 @@
+/**
+* @file 		timer_wheel.c
+* @brief		Source file of the software timer wheel service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file of the functions required to run many one-shot and
+* periodic software timers from the update interrupt of a single
+* hardware timer (TIM2-TIM7).
+*
+*/
+
+#include "timer_wheel.h"
+#include "atomic.h"
+#include "rcc.h"
+
+#define WHEEL_MASK			(WHEEL_SLOTS - 1)
+
+/*----------------------------------------------------------------------------
+  Lists
+ *----------------------------------------------------------------------------*/
+
+static void WHEEL_listInit(WHEEL_List * list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static bool WHEEL_listIsEmpty(const WHEEL_List * list)
+{
+	return list->next == list;
+}
+
+static void WHEEL_listAppend(WHEEL_List * list, WHEEL_List * link)
+{
+	link->next = list;
+	link->prev = list->prev;
+	list->prev->next = link;
+	list->prev = link;
+}
+
+static void WHEEL_listRemove(WHEEL_List * link)
+{
+	link->prev->next = link->next;
+	link->next->prev = link->prev;
+	link->next = NULL;
+	link->prev = NULL;
+}
+
+/* Moves all the links of from to the empty list to */
+static void WHEEL_listMove(WHEEL_List * from, WHEEL_List * to)
+{
+	if (WHEEL_listIsEmpty(from))
+	{
+		WHEEL_listInit(to);
+		return;
+	}
+	to->next = from->next;
+	to->prev = from->prev;
+	to->next->prev = to;
+	to->prev->next = to;
+	WHEEL_listInit(from);
+}
+
+
+/*----------------------------------------------------------------------------
+  Wheel
+ *----------------------------------------------------------------------------*/
+
+/* Timer linked in the slot of its expiry, relative to the current tick */
+static void WHEEL_insert(WHEEL_Wheel * wheel, WHEEL_Timer * timer)
+{
+	uint32_t expiry = timer->expiry;
+	uint32_t delta = expiry - wheel->now;
+	uint8_t level = 0;
+
+	if (delta >= WHEEL_SPAN)
+	{
+		expiry = wheel->now + WHEEL_SPAN - 1;				// Moved down again when its top slot is reached
+		delta = WHEEL_SPAN - 1;
+	}
+	while (delta >= (0x1UL << (WHEEL_SLOT_BITS * (level + 1))))
+		level++;
+	WHEEL_listAppend(&wheel->slots[level][(expiry >> (WHEEL_SLOT_BITS * level)) & WHEEL_MASK], &timer->link);
+}
+
+/* Timers of an upper slot moved down to the lower levels */
+static void WHEEL_cascade(WHEEL_Wheel * wheel, uint8_t level, uint32_t index)
+{
+	WHEEL_List moved;
+	WHEEL_List * link;
+
+	WHEEL_listMove(&wheel->slots[level][index], &moved);
+	while (!WHEEL_listIsEmpty(&moved))
+	{
+		link = moved.next;
+		WHEEL_listRemove(link);
+		WHEEL_insert(wheel, (WHEEL_Timer *) link);
+	}
+}
+
+void WHEEL_init(WHEEL_Wheel * wheel)
+{
+	uint8_t level;
+	uint32_t index;
+
+	for (level = 0; level < WHEEL_LEVELS; level++)
+	{
+		for (index = 0; index < WHEEL_SLOTS; index++)
+			WHEEL_listInit(&wheel->slots[level][index]);
+	}
+	RCC_removeListener(&wheel->clock);
+	wheel->now = 0;
+	wheel->count = 0;
+	wheel->TIM = NULL;
+	wheel->counts_per_tick = 1;
+	wheel->max_sleep = 0;
+	wheel->sleep = 1;
+}
+
+static uint32_t WHEEL_getSleepElapsed(WHEEL_Wheel * wheel);
+static void WHEEL_program(WHEEL_Wheel * wheel, uint32_t ticks);
+
+bool WHEEL_start(WHEEL_Wheel * wheel, WHEEL_Timer * timer, uint32_t delay, uint32_t period, WHEEL_Callback callback, void * context)
+{
+	uint32_t primask;
+	uint32_t elapsed = 0;
+	bool sleeping;
+
+	if (delay > WHEEL_MAX_DELAY || period > WHEEL_MAX_DELAY)
+		return false;
+	if (delay == 0)
+		delay = 1;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (timer->link.next != NULL)
+	{
+		WHEEL_listRemove(&timer->link);
+		wheel->count--;
+	}
+	// In tickless mode, the ticks counted since the last update haven't run yet
+	sleeping = (wheel->max_sleep != 0 && wheel->sleep != 0);
+	if (sleeping)
+		elapsed = WHEEL_getSleepElapsed(wheel);
+	timer->expiry = wheel->now + elapsed + delay - 1;
+	timer->period = period;
+	timer->callback = callback;
+	timer->context = context;
+	WHEEL_insert(wheel, timer);
+	wheel->count++;
+	if (sleeping && elapsed + delay < wheel->sleep)
+		WHEEL_program(wheel, elapsed + delay);
+	__set_PRIMASK(primask);
+
+	return true;
+}
+
+void WHEEL_cancel(WHEEL_Wheel * wheel, WHEEL_Timer * timer)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (timer->link.next != NULL)
+	{
+		WHEEL_listRemove(&timer->link);
+		wheel->count--;
+	}
+	__set_PRIMASK(primask);
+}
+
+bool WHEEL_isPending(const WHEEL_Timer * timer)
+{
+	return timer->link.next != NULL;
+}
+
+void WHEEL_tick(WHEEL_Wheel * wheel)
+{
+	uint32_t tick = wheel->now;
+	uint32_t index;
+	uint8_t level;
+	WHEEL_List expired;
+	WHEEL_Timer * timer;
+
+	if ((tick & WHEEL_MASK) == 0)
+	{
+		for (level = 1; level < WHEEL_LEVELS; level++)
+		{
+			index = (tick >> (WHEEL_SLOT_BITS * level)) & WHEEL_MASK;
+			WHEEL_cascade(wheel, level, index);
+			if (index != 0)
+				break;
+		}
+	}
+	WHEEL_listMove(&wheel->slots[0][tick & WHEEL_MASK], &expired);
+	wheel->now = tick + 1;
+
+	// The callbacks may cancel the timers left in expired
+	while (!WHEEL_listIsEmpty(&expired))
+	{
+		timer = (WHEEL_Timer *) expired.next;
+		WHEEL_listRemove(&timer->link);
+		wheel->count--;
+		if (timer->period != 0)
+		{
+			timer->expiry += timer->period;
+			WHEEL_insert(wheel, timer);
+			wheel->count++;
+		}
+		timer->callback(timer->context);
+	}
+}
+
+/* Earliest expiry of the timers of a slot, in WHEEL_tick calls */
+static uint32_t WHEEL_getSlotDelay(WHEEL_Wheel * wheel, const WHEEL_List * slot)
+{
+	const WHEEL_List * link;
+	uint32_t delay = WHEEL_MAX_DELAY;
+
+	for (link = slot->next; link != slot; link = link->next)
+	{
+		if (((const WHEEL_Timer *) link)->expiry - wheel->now < delay)
+			delay = ((const WHEEL_Timer *) link)->expiry - wheel->now;
+	}
+	return delay + 1;
+}
+
+/*
+ * Ticks until the first tick which runs a callback (exact) or which runs
+ * a callback or moves timers down a level (!exact, the ticks before can
+ * be skipped).
+ */
+static uint32_t WHEEL_scan(WHEEL_Wheel * wheel, uint32_t limit, bool exact)
+{
+	uint32_t tick = wheel->now;
+	uint32_t delay = 1;
+	uint32_t best = limit;
+	uint32_t index, slot_delay;
+	uint8_t level;
+
+	if (wheel->count == 0)
+		return limit;
+	while (delay < best)
+	{
+		if ((tick & WHEEL_MASK) == 0)
+		{
+			for (level = 1; level < WHEEL_LEVELS; level++)
+			{
+				index = (tick >> (WHEEL_SLOT_BITS * level)) & WHEEL_MASK;
+				if (!WHEEL_listIsEmpty(&wheel->slots[level][index]))
+				{
+					if (!exact)
+						return delay;
+					slot_delay = WHEEL_getSlotDelay(wheel, &wheel->slots[level][index]);
+					if (slot_delay < best)
+						best = slot_delay;
+				}
+				if (index != 0)
+					break;
+			}
+		}
+		if (delay <= WHEEL_SLOTS)
+		{
+			// Level 0 slot of a tick: timers expiring at this tick
+			if (!WHEEL_listIsEmpty(&wheel->slots[0][tick & WHEEL_MASK]))
+				return delay;
+			tick++;
+			delay++;
+		}
+		else
+		{
+			// Level 0 timers all expire in the first WHEEL_SLOTS ticks, only a cascade can add some
+			index = WHEEL_SLOTS - (tick & WHEEL_MASK);
+			tick += index;
+			delay += index;
+		}
+	}
+	return best;
+}
+
+void WHEEL_advance(WHEEL_Wheel * wheel, uint32_t ticks)
+{
+	uint32_t idle;
+
+	while (ticks > 0)
+	{
+		idle = WHEEL_scan(wheel, ticks, false) - 1;
+		wheel->now += idle;
+		WHEEL_tick(wheel);
+		ticks -= idle + 1;
+	}
+}
+
+uint32_t WHEEL_getNextDelay(WHEEL_Wheel * wheel, uint32_t limit)
+{
+	return WHEEL_scan(wheel, limit, true);
+}
+
+
+/*----------------------------------------------------------------------------
+  Hardware timer
+ *----------------------------------------------------------------------------*/
+
+/* Ticks counted since the last update (tickless mode) */
+static uint32_t WHEEL_getSleepElapsed(WHEEL_Wheel * wheel)
+{
+	uint32_t cnt = wheel->TIM->CNT;
+
+	if (wheel->TIM->SR & TIM_SR_UIF)
+		return wheel->sleep + wheel->TIM->CNT / wheel->counts_per_tick;		// Update not handled yet
+	return cnt / wheel->counts_per_tick;
+}
+
+/* Next update in ticks from the last one (tickless mode) */
+static void WHEEL_program(WHEEL_Wheel * wheel, uint32_t ticks)
+{
+	uint32_t arr = ticks * wheel->counts_per_tick - 1;
+	uint32_t cnt;
+
+	wheel->sleep = ticks;
+	wheel->TIM->ARR = arr;
+	cnt = wheel->TIM->CNT;
+	if (cnt > arr)
+	{
+		// The counter went past the new ARR before it was written: update now
+		wheel->sleep = cnt / wheel->counts_per_tick;
+		wheel->TIM->EGR = TIM_EGR_UG;
+	}
+}
+
+/* PSC and ARR of one tick at the current timer clock, TIM unchanged on failure */
+static bool WHEEL_setTickPeriod(WHEEL_Wheel * wheel, bool tickless)
+{
+	TIM_TypeDef * TIM = wheel->TIM;
+	uint64_t cycles = (uint64_t) TIM_getClock(TIM) * wheel->tick_us / 1000000;
+	uint64_t arr_count = (uint64_t) TIM_getARRMax(TIM) + 1;
+	uint64_t counts;
+
+	if (cycles == 0)
+		return false;
+	if (tickless)
+	{
+		// Fewest counter increments per tick with an exact prescaler: longest sleep
+		counts = (cycles + TIM_PSC_MAX) / (TIM_PSC_MAX + 1);
+		while (counts <= arr_count && cycles % counts != 0)
+			counts++;
+		if (counts > arr_count)
+			return false;
+		wheel->counts_per_tick = (uint32_t) counts;
+		wheel->max_sleep = (arr_count / counts > WHEEL_MAX_DELAY) ? WHEEL_MAX_DELAY : (uint32_t) (arr_count / counts);
+		TIM_setPSC(TIM, (u16) (cycles / counts - 1));
+		TIM_setARR(TIM, (u32) (counts - 1));
+	}
+	else
+	{
+		TIM_setPeriod(TIM, wheel->tick_us);
+		wheel->counts_per_tick = TIM->ARR + 1;
+	}
+	return true;
+}
+
+/* Timer clock changed: the tick in progress restarts at the new clock */
+static void WHEEL_onClockChange(void * context)
+{
+	WHEEL_Wheel * wheel = (WHEEL_Wheel *) context;
+	bool tickless = (wheel->max_sleep != 0);
+	uint32_t elapsed;
+
+	ATOMIC_CLEAR_BIT(wheel->TIM->DIER, TIM_DIER_UIE);
+	elapsed = WHEEL_getSleepElapsed(wheel);													// Whole ticks, counted at the old clock
+	if (WHEEL_setTickPeriod(wheel, tickless))
+	{
+		TIM_resetCNT(wheel->TIM);																		// Loads PSC, raises the update
+		if (tickless)
+			wheel->sleep = elapsed;																		// Run by the update interrupt
+		else if (elapsed == 0)
+			TIM_resetIRFlag(wheel->TIM);
+	}
+	ATOMIC_SET_BIT(wheel->TIM->DIER, TIM_DIER_UIE);
+}
+
+bool WHEEL_attachTimer(WHEEL_Wheel * wheel, TIM_TypeDef * TIM, uint32_t tick_us, bool tickless)
+{
+	wheel->TIM = TIM;
+	wheel->tick_us = tick_us;
+	wheel->max_sleep = 0;
+	wheel->sleep = 1;
+	if (!WHEEL_setTickPeriod(wheel, tickless))
+	{
+		wheel->TIM = NULL;
+		return false;
+	}
+	ATOMIC_CLEAR_BIT(TIM->CR1, TIM_CR1_ARPE);										// ARR written during a sleep is used at once
+	TIM_initUpcount(TIM);
+	TIM_resetCNT(TIM);																		// Loads PSC
+	TIM_resetIRFlag(TIM);
+	ATOMIC_SET_BIT(TIM->DIER, TIM_DIER_UIE);
+	TIM_enable(TIM);
+	RCC_addListener(&wheel->clock, WHEEL_onClockChange, wheel);
+
+	return true;
+}
+
+void WHEEL_onTimerUpdate(WHEEL_Wheel * wheel)
+{
+	uint32_t elapsed = wheel->sleep;
+
+	TIM_resetIRFlag(wheel->TIM);
+	if (wheel->max_sleep == 0)
+	{
+		WHEEL_tick(wheel);
+		return;
+	}
+	wheel->sleep = 0;																			// Callbacks don't reprogram ARR
+	WHEEL_advance(wheel, elapsed);
+	WHEEL_program(wheel, WHEEL_getNextDelay(wheel, wheel->max_sleep));
+}
@@ -0,0 +1,188 @@
+/**
+* @file 		timer_wheel.h
+* @brief		Header file of the software timer wheel service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to run many one-shot and
+* periodic software timers from the update interrupt of a single
+* hardware timer (TIM2-TIM7).
+*
+*		1. The wheel is hierarchical: WHEEL_LEVELS levels of WHEEL_SLOTS
+*		slots, level n holding the timers which expire in less than
+*		WHEEL_SLOTS^(n+1) ticks. Start and cancel are O(1), a tick runs the
+*		timers of one slot and, once every WHEEL_SLOTS ticks, moves the
+*		timers of an upper slot down one level: O(1) per timer and tick.
+*		Timers longer than WHEEL_SPAN ticks wait in the top level and are
+*		moved again until they are in range.
+*		2. The timers are owned by the caller (no allocation). A timer must
+*		not be reused for something else while it is pending.
+*		3. The callbacks run in the context of WHEEL_tick (the TIMx update
+*		interrupt when attached). They may start or cancel any timer,
+*		including their own. The functions called from the main loop mask
+*		the interrupts for a few instructions.
+*		4. In tickless mode, the timer interrupt only fires at the next
+*		deadline: ARR is reprogrammed after each update and when an earlier
+*		timer is started.
+*		5. After a clock change (see RCC_setSysclk), PSC and ARR are solved
+*		again for the new timer clock and the tick in progress restarts: the
+*		wheel is late by less than one tick. WHEEL_init() detaches the
+*		wheel from the clock changes.
+*		6. Use it as follow:
+*				static WHEEL_Wheel wheel;
+*				static WHEEL_Timer blink;
+*				WHEEL_init(&wheel);
+*				TIM3_CLK_ENABLE();
+*				WHEEL_attachTimer(&wheel, TIM3, 1000, true);		// 1ms ticks, tickless
+*				IRQ_setPriority(TIM3_IRQn, IRQ_LEVEL_TIMER, 0);
+*				NVIC_EnableIRQ(TIM3_IRQn);
+*				WHEEL_start(&wheel, &blink, 500, 500, toggle, NULL);
+*
+*				void TIM3_IRQHandler(void)
+*				{
+*					WHEEL_onTimerUpdate(&wheel);
+*				}
+*
+*/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+#include "timer.h"
+#include "rcc.h"
+
+#define WHEEL_SLOT_BITS			6																		///< log2 of the number of slots per level
+#define WHEEL_SLOTS					(0x1 << WHEEL_SLOT_BITS)							///< Slots per level
+#define WHEEL_LEVELS				4																		///< Levels of the wheel
+#define WHEEL_SPAN					(0x1UL << (WHEEL_SLOT_BITS * WHEEL_LEVELS))	///< Delays covered by the levels, longer timers move down from the top level
+#define WHEEL_MAX_DELAY			0x7FFFFFFF													///< Longest delay or period in ticks
+
+typedef void (*WHEEL_Callback)(void * context);
+
+/* Links of a circular doubly linked list */
+typedef struct WHEEL_List
+{
+	struct WHEEL_List * next;
+	struct WHEEL_List * prev;
+}WHEEL_List;
+
+/* Software timer */
+typedef struct
+{
+	WHEEL_List link;											///< Must be first, next is NULL when the timer isn't pending
+	uint32_t expiry;											///< Tick of the next expiry
+	uint32_t period;											///< Ticks between two expiries, 0 for a one-shot timer
+	WHEEL_Callback callback;
+	void * context;
+}WHEEL_Timer;
+
+/* Timer wheel */
+typedef struct
+{
+	WHEEL_List slots[WHEEL_LEVELS][WHEEL_SLOTS];
+	volatile uint32_t now;								///< Ticks elapsed (next tick to run)
+	uint32_t count;												///< Pending timers
+	TIM_TypeDef * TIM;										///< Hardware timer, NULL when ticked by hand
+	uint32_t counts_per_tick;							///< Counter increments per tick (tickless mode)
+	uint32_t max_sleep;										///< Longest ARR period in ticks, 0 when not tickless
+	uint32_t sleep;												///< Ticks of the ARR period being counted (tickless mode)
+	uint32_t tick_us;											///< Tick period, solved again after a clock change
+	RCC_ClockListener clock;							///< Added by WHEEL_attachTimer
+}WHEEL_Wheel;
+
+
+/*----------------------------------------------------------------------------
+  Timers
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Timer wheel initialised.
+ * @param[out]	wheel Wheel to initialise, empty and at tick 0.
+ */
+void WHEEL_init(WHEEL_Wheel * wheel);
+
+/**
+ * Timer started (or restarted if it is pending).
+ * @param[in]	wheel Wheel.
+ * @param[in]	timer Timer to start.
+ * @param[in]	delay Ticks before the first expiry, 1 for the next tick.
+ * @param[in]	period Ticks between the next expiries, 0 for a one-shot timer.
+ * @param[in]	callback Function called at each expiry.
+ * @param[in]	context Argument of the callback.
+ * @retval bool false if delay or period is longer than WHEEL_MAX_DELAY, the timer is not started.
+ */
+bool WHEEL_start(WHEEL_Wheel * wheel, WHEEL_Timer * timer, uint32_t delay, uint32_t period, WHEEL_Callback callback, void * context);
+
+/**
+ * Timer cancelled.
+ * Nothing is done if the timer isn't pending.
+ * @param[in]	wheel Wheel.
+ * @param[in]	timer Timer to cancel.
+ */
+void WHEEL_cancel(WHEEL_Wheel * wheel, WHEEL_Timer * timer);
+
+/**
+ * Timer pending.
+ * @param[in]	timer Timer.
+ * @retval bool true if the timer will expire.
+ */
+bool WHEEL_isPending(const WHEEL_Timer * timer);
+
+/**
+ * One tick.
+ * This function runs the callbacks of the timers which expire at this tick.
+ * @param[in]	wheel Wheel.
+ */
+void WHEEL_tick(WHEEL_Wheel * wheel);
+
+/**
+ * Several ticks.
+ * This function runs the ticks in order, jumping over the ticks without
+ * any expiry (see WHEEL_getNextDelay).
+ * @param[in]	wheel Wheel.
+ * @param[in]	ticks Number of ticks.
+ */
+void WHEEL_advance(WHEEL_Wheel * wheel, uint32_t ticks);
+
+/**
+ * Ticks until the next expiry.
+ * @param[in]	wheel Wheel.
+ * @param[in]	limit Value returned when no timer expires in less than limit ticks.
+ * @retval uint32_t Number of WHEEL_tick calls until the next tick which runs a callback.
+ * @par At most WHEEL_SLOTS + limit / WHEEL_SLOTS slots are checked, the
+ * timers of the non-empty upper slots are read.
+ */
+uint32_t WHEEL_getNextDelay(WHEEL_Wheel * wheel, uint32_t limit);
+
+
+/*----------------------------------------------------------------------------
+  Hardware timer
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Wheel ticked by a timer.
+ * This function configures the timer and its update interrupt. The NVIC
+ * interrupt must be enabled by the caller.
+ * @param[in]	wheel Wheel.
+ * @param[in]	TIM Timer (TIM2-TIM7), clock enabled.
+ * @param[in]	tick_us Period of a tick in us.
+ * @param[in]	tickless true to only interrupt at the deadlines.
+ * @retval bool false if the tick can't be counted exactly in tickless mode.
+ * @par In tickless mode, a clock at which the tick can't be counted
+ * exactly leaves PSC unchanged: the ticks are then off by the clock ratio.
+ */
+bool WHEEL_attachTimer(WHEEL_Wheel * wheel, TIM_TypeDef * TIM, uint32_t tick_us, bool tickless);
+
+/**
+ * Update interrupt of the timer.
+ * This function acknowledges the interrupt, runs the elapsed ticks and in
+ * tickless mode programs the next deadline. It must be called by the
+ * TIMx_IRQHandler of the attached timer.
+ * @param[in]	wheel Wheel.
+ */
+void WHEEL_onTimerUpdate(WHEEL_Wheel * wheel);
+
+#endif
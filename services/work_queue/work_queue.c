@@ -0,0 +1,130 @@
+/**
+* @file 		work_queue.c
+* @brief		Source file of the deferred work queue service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Source file listing the functions required to move the work of the
+* interrupt handlers out of the handlers, into PendSV.
+*
+*/
+
+#include "work_queue.h"
+
+static WORK_Item work_items[WORK_DEFER_SIZE];
+static WORK_Queue work_defer_queue;
+
+/*----------------------------------------------------------------------------
+  Queue
+ *----------------------------------------------------------------------------*/
+
+bool WORK_initQueue(WORK_Queue * queue, WORK_Item * items, uint32_t size)
+{
+	uint32_t i;
+
+	if (size == 0 || (size & (size - 1)) != 0)
+		return false;
+
+	for (i = 0; i < size; i++)
+		items[i].sequence = 0;
+	queue->items = items;
+	queue->mask = size - 1;
+	queue->head = 0;
+	queue->tail = 0;
+	queue->overruns = 0;
+	return true;
+}
+
+bool WORK_push(WORK_Queue * queue, WORK_Function function, void * context)
+{
+	WORK_Item * item;
+	uint32_t head, overruns;
+
+	// Slot reserved: head incremented unless another producer did it first
+	do
+	{
+		head = __LDREXW(&queue->head);
+		if (head - queue->tail > queue->mask)								// Full
+		{
+			__CLREX();
+			do
+			{
+				overruns = __LDREXW(&queue->overruns);
+			} while (__STREXW(overruns + 1, &queue->overruns) != 0);
+			return false;
+		}
+	} while (__STREXW(head + 1, &queue->head) != 0);
+
+	item = &queue->items[head & queue->mask];
+	item->function = function;
+	item->context = context;
+	__DMB();																							// Item written before it is published
+	item->sequence = head + 1;
+	return true;
+}
+
+bool WORK_pop(WORK_Queue * queue, WORK_Item * item)
+{
+	uint32_t tail = queue->tail;
+	WORK_Item * slot = &queue->items[tail & queue->mask];
+
+	if (slot->sequence != tail + 1)												// Empty, or producer preempted before publishing
+		return false;
+	__DMB();																							// Sequence read before the item
+	item->function = slot->function;
+	item->context = slot->context;
+	item->sequence = slot->sequence;
+	__DMB();																							// Item read before its slot is released
+	queue->tail = tail + 1;
+	return true;
+}
+
+uint32_t WORK_getCount(const WORK_Queue * queue)
+{
+	return queue->head - queue->tail;
+}
+
+uint32_t WORK_getOverruns(const WORK_Queue * queue)
+{
+	return queue->overruns;
+}
+
+
+/*----------------------------------------------------------------------------
+  Deferred work
+ *----------------------------------------------------------------------------*/
+
+void WORK_init(void)
+{
+	WORK_initQueue(&work_defer_queue, work_items, WORK_DEFER_SIZE);
+	NVIC_SetPriority(PendSV_IRQn, WORK_PENDSV_PRIORITY);
+}
+
+bool WORK_defer(WORK_Function function, void * context)
+{
+	if (!WORK_push(&work_defer_queue, function, context))
+		return false;
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;										// Write-1-to-set, the other bits ignored
+	return true;
+}
+
+void WORK_runDeferred(void)
+{
+	WORK_Item item;
+
+	while (WORK_pop(&work_defer_queue, &item))
+		item.function(item.context);
+}
+
+const WORK_Queue * WORK_getDeferQueue(void)
+{
+	return &work_defer_queue;
+}
+
+#ifndef KERNEL_ENABLED
+void PendSV_Handler(void)
+{
+	WORK_runDeferred();
+}
+#endif
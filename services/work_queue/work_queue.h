@@ -0,0 +1,149 @@
+/**
+* @file 		work_queue.h
+* @brief		Header file of the deferred work queue service.
+* @author		Julien
+* @version	1.0
+* @details
+*
+*	Header file listing the functions required to move the work of the
+* interrupt handlers out of the handlers: a handler only queues a work
+* item (function and context), which PendSV runs later at the lowest
+* priority, where any other interrupt can preempt it.
+*
+*		1. A queue takes items from several producers (handlers of any
+*		priority, main loop) and gives them to one consumer, without masking
+*		interrupts. A producer reserves a slot with LDREX/STREX on head,
+*		fills it, then publishes it with its sequence number. The consumer
+*		stops at the first slot not published yet: its producer was
+*		preempted and queues PendSV again when it publishes it.
+*		2. The number of items must be a power of two. A push on a full
+*		queue drops the item and counts an overrun.
+*		3. WORK_defer() pushes to the queue of the service and pends PendSV.
+*		PendSV_Handler (defined in work_queue.c) runs the items in their
+*		order of reservation until the queue is empty. An item may defer
+*		other work, which runs in the same PendSV.
+*		4. The work functions run in handler mode at the lowest priority:
+*		they may be long, not block waiting for another handler.
+*		5. With the preemptive kernel (kernel.h), built with KERNEL_ENABLED,
+*		PendSV_Handler is the one of the kernel port: it runs the deferred
+*		work before switching the threads.
+*		6. Use it as follow:
+*				WORK_init();
+*
+*				void TIM3_IRQHandler(void)
+*				{
+*					TIM_resetIRFlag(TIM3);
+*					WORK_defer(filter, &samples);			// filter(&samples) in PendSV
+*				}
+*
+*/
+
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <stm32f4xx.h>
+#include <stdbool.h>
+
+#define WORK_DEFER_SIZE				32															///< Items of the queue of WORK_defer, power of two
+#define WORK_PENDSV_PRIORITY	((0x1 << __NVIC_PRIO_BITS) - 1)		///< PendSV priority set by WORK_init, the lowest
+
+typedef void (*WORK_Function)(void * context);
+
+/* Slot of a queue */
+typedef struct
+{
+	WORK_Function function;
+	void * context;
+	volatile uint32_t sequence;					///< Reservation number + 1 once published
+}WORK_Item;
+
+/* Multiple producers, single consumer queue */
+typedef struct
+{
+	WORK_Item * items;
+	uint32_t mask;												///< Number of items - 1
+	volatile uint32_t head;								///< Slots reserved (LDREX/STREX by the producers)
+	volatile uint32_t tail;								///< Items popped (written by the consumer only)
+	volatile uint32_t overruns;						///< Items dropped (LDREX/STREX by the producers)
+}WORK_Queue;
+
+
+/*----------------------------------------------------------------------------
+  Queue
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Queue initialised.
+ * @param[out]	queue Queue to initialise.
+ * @param[in]	items Memory of size items.
+ * @param[in]	size Number of items, power of two.
+ * @retval bool false if size isn't a power of two.
+ * @par Must not be called while a producer or the consumer runs.
+ */
+bool WORK_initQueue(WORK_Queue * queue, WORK_Item * items, uint32_t size);
+
+/**
+ * Item pushed (producer side, any context).
+ * @param[in]	queue Queue.
+ * @param[in]	function Function of the item.
+ * @param[in]	context Passed to the function.
+ * @retval bool false if the queue is full: the item is dropped and counted as overrun.
+ */
+bool WORK_push(WORK_Queue * queue, WORK_Function function, void * context);
+
+/**
+ * Item popped (consumer side).
+ * @param[in]	queue Queue.
+ * @param[out]	item Copy of the oldest item.
+ * @retval bool false if the queue is empty or its oldest slot isn't published yet.
+ */
+bool WORK_pop(WORK_Queue * queue, WORK_Item * item);
+
+/**
+ * Number of items in a queue.
+ * @param[in]	queue Queue.
+ * @retval uint32_t Slots reserved and not popped yet.
+ */
+uint32_t WORK_getCount(const WORK_Queue * queue);
+
+/**
+ * Number of items dropped since WORK_initQueue.
+ * @param[in]	queue Queue.
+ * @retval uint32_t Overruns.
+ */
+uint32_t WORK_getOverruns(const WORK_Queue * queue);
+
+
+/*----------------------------------------------------------------------------
+  Deferred work
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Deferred work initialised.
+ * This function empties the queue of WORK_defer and sets PendSV to the
+ * lowest priority.
+ */
+void WORK_init(void);
+
+/**
+ * Work deferred to PendSV.
+ * @param[in]	function Function to run.
+ * @param[in]	context Passed to the function.
+ * @retval bool false if the queue is full, the work is dropped.
+ */
+bool WORK_defer(WORK_Function function, void * context);
+
+/**
+ * Deferred work run.
+ * This function runs the deferred items until the queue is empty. It is
+ * the body of PendSV_Handler.
+ */
+void WORK_runDeferred(void);
+
+/**
+ * Queue of WORK_defer.
+ * @retval const WORK_Queue* For WORK_getCount and WORK_getOverruns.
+ */
+const WORK_Queue * WORK_getDeferQueue(void);
+
+#endif